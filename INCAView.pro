@@ -5,7 +5,7 @@
 #-------------------------------------------------
 QMAKE_CXXFLAGS += -std=c++14
 
-QT       += core gui sql widgets printsupport
+QT       += core gui sql widgets printsupport concurrent
 
 #CONFIG += static
 
@@ -23,9 +23,24 @@ SOURCES += main.cpp\
     parameter.cpp \
     parametermodel.cpp \
     sshInterface.cpp \
+    channelreader.cpp \
     parametereditdelegate.cpp \
     plotter.cpp \
-    sqlinterface.cpp
+    sqlinterface.cpp \
+    dataservice.cpp \
+    seriescache.cpp \
+    seriesaggregates.cpp \
+    minmaxpyramid.cpp \
+    statistics.cpp \
+    goodnessoffit.cpp \
+    calibration.cpp \
+    seriesexport.cpp \
+    numberformat.cpp \
+    seriescolumns.cpp \
+    modelrunner.cpp \
+    parametersweep.cpp \
+    sweepdialog.cpp \
+    remotejobs.cpp
 
 HEADERS  += mainwindow.h \
     treemodel.h \
@@ -34,10 +49,28 @@ HEADERS  += mainwindow.h \
     parameter.h \
     parametermodel.h \
     sshInterface.h \
+    channelreader.h \
     parametereditdelegate.h \
     plotter.h \
     sqlinterface.h \
-    sqlhandler/serialization.h
+    dataservice.h \
+    seriesdata.h \
+    seriescache.h \
+    seriesaggregates.h \
+    calendar.h \
+    minmaxpyramid.h \
+    statistics.h \
+    goodnessoffit.h \
+    calibration.h \
+    seriesexport.h \
+    numberformat.h \
+    seriescolumns.h \
+    modelrunner.h \
+    parametersweep.h \
+    sweepdialog.h \
+    remotejobs.h \
+    sqlhandler/serialization.h \
+    sqlhandler/compression.h
 
 FORMS    += mainwindow.ui
 
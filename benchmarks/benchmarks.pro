@@ -0,0 +1,9 @@
+#NOTE: The benchmarks print their timings and are not run as part of the tests. See the comment at the top of each for what it measures.
+
+TEMPLATE = subdirs
+
+SUBDIRS += statistics \
+    minmaxpyramid \
+    channelreader \
+    sqlinterface \
+    compression
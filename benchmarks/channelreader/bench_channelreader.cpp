@@ -0,0 +1,139 @@
+#include "../../channelreader.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//NOTE: Latency and throughput of reading the output of a command over ssh, with the channel reader that SSHInterface uses and with the read
+// loop it had before (poll, read 255 bytes, sleep 50 ms). Latency is the time for a command that prints one line, which is what most of the
+// commands INCAView runs look like. Throughput is for a command that prints a lot, like a model run that logs as it goes.
+// usage: bench_channelreader <host> <port> <user> <private key file> [commands] [megabytes]
+// run_bench_channelreader.sh starts a throwaway sshd on localhost to run it against.
+
+//NOTE: This is how SSHInterface::readFromChannel read before, minus the error logging.
+static bool readChannelPolling(ssh_channel channel, const std::function<bool(const char *, size_t)> &handleOutput)
+{
+    int poll_rc;
+    char readData[256];
+
+    while((poll_rc = ssh_channel_poll(channel, 0)) != SSH_EOF)
+    {
+        if(poll_rc == SSH_ERROR) return false;
+        int rc = ssh_channel_read(channel, readData, sizeof(readData), 0);
+        if(rc == SSH_ERROR) return false;
+
+        if(rc > 0 && !handleOutput(readData, (size_t)rc)) break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return true;
+}
+
+//NOTE: Runs the command like SSHInterface::streamCommand does and returns the time in ms it took until the output was read, or a negative
+// number if it failed.
+static double runCommand(ssh_session session, const char *command, bool polling, size_t &bytes)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    ssh_channel channel = ssh_channel_new(session);
+    if(ssh_channel_open_session(channel) != SSH_OK)
+    {
+        fprintf(stderr, "Failed to open channel: %s\n", ssh_get_error(session));
+        ssh_channel_free(channel);
+        return -1.0;
+    }
+    ssh_channel_request_exec(channel, command);
+
+    bytes = 0;
+    auto count = [&](const char *, size_t size) { bytes += size; return true; };
+    std::string error;
+    bool success = polling ? readChannelPolling(channel, count) : readChannel(session, channel, count, error);
+
+    ssh_channel_close(channel);
+    ssh_channel_free(channel);
+
+    auto end = std::chrono::steady_clock::now();
+    if(!success)
+    {
+        fprintf(stderr, "Failed to read from channel: %s\n", error.data());
+        return -1.0;
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static ssh_session connect(const char *host, unsigned int port, const char *user, const char *keyfile)
+{
+    ssh_session session = ssh_new();
+    if(!session) return nullptr;
+
+    int nohostcheck = 0;
+    ssh_options_set(session, SSH_OPTIONS_HOST, host);
+    ssh_options_set(session, SSH_OPTIONS_PORT, &port);
+    ssh_options_set(session, SSH_OPTIONS_USER, user);
+    ssh_options_set(session, SSH_OPTIONS_STRICTHOSTKEYCHECK, &nohostcheck);
+    ssh_options_set(session, SSH_OPTIONS_KNOWNHOSTS, "/dev/null");
+
+    if(ssh_connect(session) != SSH_OK)
+    {
+        fprintf(stderr, "Failed to connect: %s\n", ssh_get_error(session));
+        ssh_free(session);
+        return nullptr;
+    }
+    if(ssh_userauth_privatekey_file(session, nullptr, keyfile, nullptr) != SSH_AUTH_SUCCESS)
+    {
+        fprintf(stderr, "Failed to authenticate: %s\n", ssh_get_error(session));
+        ssh_disconnect(session);
+        ssh_free(session);
+        return nullptr;
+    }
+    return session;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 5)
+    {
+        fprintf(stderr, "usage: bench_channelreader <host> <port> <user> <private key file> [commands] [megabytes]\n");
+        return 1;
+    }
+    int commands = argc > 5 ? atoi(argv[5]) : 50;
+    int megabytes = argc > 6 ? atoi(argv[6]) : 16;
+
+    ssh_init();
+    ssh_session session = connect(argv[1], (unsigned int)atoi(argv[2]), argv[3], argv[4]);
+    if(!session) return 1;
+
+    printf("%-10s %20s %20s %20s\n", "reader", "latency (median)", "latency (max)", "throughput");
+    for(bool polling : {true, false})
+    {
+        //NOTE: The median, so that a hiccup of the sshd does not count.
+        std::vector<double> latencies;
+        size_t bytes;
+        for(int c = 0; c < commands; ++c)
+        {
+            double ms = runCommand(session, "echo done", polling, bytes);
+            if(ms < 0.0) return 1;
+            latencies.push_back(ms);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        //NOTE: The polling reader gets 256 bytes per 50 ms, so it is only given 64 KB of bulk output, which takes it about 13 s.
+        int bulkbytes = polling ? 64*1024 : megabytes*1024*1024;
+        char bulkcommand[128];
+        snprintf(bulkcommand, sizeof(bulkcommand), "head -c %d /dev/zero", bulkbytes);
+        double ms = runCommand(session, bulkcommand, polling, bytes);
+        if(ms < 0.0) return 1;
+
+        printf("%-10s %17.2f ms %17.2f ms %15.2f MB/s\n", polling ? "polling" : "event", latencies[latencies.size()/2], latencies.back(),
+               (double)bytes / (1024.0*1024.0) / (ms / 1000.0));
+    }
+
+    ssh_disconnect(session);
+    ssh_free(session);
+    ssh_finalize();
+    return 0;
+}
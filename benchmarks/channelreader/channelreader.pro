@@ -0,0 +1,16 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console release
+CONFIG -= qt app_bundle
+
+TARGET = bench_channelreader
+TEMPLATE = app
+
+SOURCES += bench_channelreader.cpp \
+    ../../channelreader.cpp
+
+HEADERS += ../../channelreader.h
+
+INCLUDEPATH += $$PWD/../../include
+
+LIBS += -L$$PWD/../../lib/ -lssh
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+#NOTE: Starts a throwaway sshd on localhost, with its own host key and a key for the current user in a temporary directory, and runs
+# bench_channelreader against it. sshd runs as the current user, so no root is needed.
+# usage: bash run_bench_channelreader.sh <bench_channelreader binary> [commands] [megabytes]
+#   SSHD : the sshd to use, if it is not on the PATH.
+#   PORT : the port to listen on (default 2222).
+
+BENCH=$1
+shift
+SSHD=${SSHD:-$(command -v sshd || echo /usr/sbin/sshd)}
+PORT=${PORT:-2222}
+
+if [ ! -x "$BENCH" ] || [ ! -x "$SSHD" ]; then
+    echo "usage: bash run_bench_channelreader.sh <bench_channelreader binary> [commands] [megabytes]. sshd is needed as well."
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+trap 'kill $SSHD_PID 2>/dev/null; rm -rf $WORK' EXIT
+
+ssh-keygen -t rsa -f $WORK/hostkey -N '' -q
+ssh-keygen -t rsa -f $WORK/userkey -N '' -q
+cp $WORK/userkey.pub $WORK/authorized_keys
+
+cat > $WORK/sshd_config <<CONFIG
+Port $PORT
+ListenAddress 127.0.0.1
+HostKey $WORK/hostkey
+AuthorizedKeysFile $WORK/authorized_keys
+PidFile $WORK/sshd.pid
+PasswordAuthentication no
+UsePAM no
+StrictModes no
+CONFIG
+
+# sshd has to be started with its full path.
+$SSHD -D -e -f $WORK/sshd_config 2> $WORK/sshd.log &
+SSHD_PID=$!
+sleep 1
+if ! kill -0 $SSHD_PID 2>/dev/null; then
+    echo "sshd did not start:"
+    cat $WORK/sshd.log
+    exit 1
+fi
+
+$BENCH 127.0.0.1 $PORT $(whoami) $WORK/userkey "$@"
@@ -0,0 +1,144 @@
+#include "../../sqlhandler/compression.h"
+#include <zlib.h>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+//NOTE: The compression ratio and the time of the compressed value export (export_values_compressed in the sqlhandler), on synthetic series
+// that look like what a model run gives: daily series where most are continuous noisy flows and some are precipitation-like inputs with
+// zeros and gaps. Each series goes through the same steps as write_series_compressed in sqlhandler.cpp (Gorilla encoding, then zlib level
+// 1 if the encoding halved the series and level 0 otherwise, or plain doubles if the encoding did not shrink it), and is decoded back the
+// way SSHInterface does it (inflate, then gorilla_decode) to check that every value comes back bit-exactly.
+// usage: bench_compression [flow series] [precipitation series] [years]
+
+struct SeriesResult
+{
+    uint64_t rawSize = 0;
+    uint64_t sentSize = 0;
+    double encodeMs = 0.0;
+    double decodeMs = 0.0;
+    bool roundTripOk = true;
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static SeriesResult compressSeries(const std::vector<double> &values)
+{
+    SeriesResult result;
+    uint64_t count = values.size();
+    result.rawSize = count*sizeof(double);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> encoded(gorilla_max_encoded_size(count));
+    uint64_t encodedSize = gorilla_encode(values.data(), count, encoded.data());
+    if(encodedSize >= result.rawSize)
+    {
+        result.sentSize = result.rawSize;
+        result.encodeMs = elapsedMs(start);
+        return result;
+    }
+
+    int level = (encodedSize < result.rawSize/2) ? 1 : 0;
+    uLongf compressedSize = compressBound((uLong)encodedSize);
+    std::vector<uint8_t> compressed(compressedSize);
+    compress2(compressed.data(), &compressedSize, encoded.data(), (uLong)encodedSize, level);
+    result.sentSize = sizeof(uint64_t) + 4 + compressedSize; //NOTE: The size field and the qCompress size prefix.
+    result.encodeMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> inflated(encodedSize);
+    uLongf inflatedSize = (uLongf)encodedSize;
+    std::vector<double> decoded(count);
+    result.roundTripOk = uncompress(inflated.data(), &inflatedSize, compressed.data(), compressedSize) == Z_OK
+                      && inflatedSize == encodedSize
+                      && gorilla_decode(inflated.data(), inflatedSize, decoded.data(), count)
+                      && memcmp(decoded.data(), values.data(), result.rawSize) == 0;
+    result.decodeMs = elapsedMs(start);
+
+    return result;
+}
+
+//NOTE: A recession with rain events on top, plus measurement-like noise, so the low mantissa bits are close to random as in a model output.
+static std::vector<double> makeFlow(std::mt19937_64 &rng, int days)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> values(days);
+    double flow = 5.0 + 10.0*uniform(rng);
+    for(double &value : values)
+    {
+        flow = 0.97*flow + (uniform(rng) < 0.1 ? 5.0*uniform(rng) : 0.0) + 0.05;
+        value = flow*(1.0 + 0.01*noise(rng));
+    }
+    return values;
+}
+
+//NOTE: Dry days are exactly zero, and the record has gaps of a few days to a few months where it is missing.
+static std::vector<double> makePrecipitation(std::mt19937_64 &rng, int days)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<double> values(days);
+    for(int day = 0; day < days; ++day)
+    {
+        if(uniform(rng) < 0.002)
+        {
+            int gap = 3 + (int)(100*uniform(rng));
+            for(int end = std::min(days, day + gap); day < end; ++day) values[day] = std::numeric_limits<double>::quiet_NaN();
+            --day;
+            continue;
+        }
+        values[day] = uniform(rng) < 0.6 ? 0.0 : std::round(-10.0*std::log(uniform(rng))*10.0)/10.0;
+    }
+    return values;
+}
+
+static void printSummary(const char *what, int numSeries, const SeriesResult &total)
+{
+    printf("%-22s %4d series  %9.1f KB -> %9.1f KB  (%.2fx)  encode %7.1f ms  decode %7.1f ms\n", what, numSeries, total.rawSize/1024.0,
+           total.sentSize/1024.0, (double)total.rawSize/total.sentSize, total.encodeMs, total.decodeMs);
+}
+
+static void add(SeriesResult &total, const SeriesResult &result)
+{
+    total.rawSize += result.rawSize;
+    total.sentSize += result.sentSize;
+    total.encodeMs += result.encodeMs;
+    total.decodeMs += result.decodeMs;
+    total.roundTripOk = total.roundTripOk && result.roundTripOk;
+}
+
+int main(int argc, char **argv)
+{
+    int numFlows = argc > 1 ? atoi(argv[1]) : 180;
+    int numPrecipitation = argc > 2 ? atoi(argv[2]) : 20;
+    int years = argc > 3 ? atoi(argv[3]) : 30;
+    int days = years*365;
+
+    std::mt19937_64 rng(2015);
+    SeriesResult flows, precipitation;
+    for(int i = 0; i < numFlows; ++i) add(flows, compressSeries(makeFlow(rng, days)));
+    for(int i = 0; i < numPrecipitation; ++i) add(precipitation, compressSeries(makePrecipitation(rng, days)));
+
+    SeriesResult total = flows;
+    add(total, precipitation);
+
+    printf("%d daily values per series\n", days);
+    printSummary("flow-like", numFlows, flows);
+    printSummary("precipitation-like", numPrecipitation, precipitation);
+    printSummary("overall", numFlows + numPrecipitation, total);
+
+    if(!total.roundTripOk)
+    {
+        fprintf(stderr, "Some series did not decode to the values they were encoded from\n");
+        return 1;
+    }
+    return 0;
+}
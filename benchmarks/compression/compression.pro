@@ -0,0 +1,13 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console release
+CONFIG -= qt app_bundle
+
+TARGET = bench_compression
+TEMPLATE = app
+
+SOURCES += bench_compression.cpp
+
+HEADERS += ../../sqlhandler/compression.h
+
+LIBS += -lz
@@ -0,0 +1,99 @@
+#include "../../minmaxpyramid.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+
+//NOTE: Frame time of the plot with 50 series of 50000 daily values, drawn with all their points and through the min/max pyramid, at a few
+// zoom levels. This is what a replot costs when panning or zooming (see Plotter::updateLevelOfDetail).
+// usage: bench_minmaxpyramid [series] [values per series]
+// Runs without a display with QT_QPA_PLATFORM=offscreen.
+
+static double frameTime(QCustomPlot &plot, int frames)
+{
+    //NOTE: toPixmap draws everything whether or not the widget is shown. The best frame is taken, so that a hiccup does not count.
+    double best = 1e30;
+    for(int f = 0; f < frames; ++f)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        plot.toPixmap(plot.width(), plot.height());
+        best = std::min(best, timer.nsecsElapsed() / 1e6);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    int numseries = argc > 1 ? atoi(argv[1]) : 50;
+    int count = argc > 2 ? atoi(argv[2]) : 50000;
+
+    QCustomPlot plot;
+    plot.resize(1200, 600);
+
+    QVector<QSharedPointer<QCPGraphDataContainer>> data(numseries);
+    QVector<MinMaxPyramid> pyramids(numseries);
+    QVector<QCPGraph *> graphs(numseries);
+
+    QElapsedTimer buildTimer;
+    qint64 buildNanoseconds = 0;
+    for(int s = 0; s < numseries; ++s)
+    {
+        QVector<QCPGraphData> points(count);
+        for(int i = 0; i < count; ++i)
+        {
+            double value = 10.0*s + 5.0*std::sin(i*0.0172) + std::sin(i*1.7 + s);
+            points[i] = QCPGraphData(946684800.0 + 86400.0*i, value);
+        }
+        data[s].reset(new QCPGraphDataContainer);
+        data[s]->set(points, true);
+
+        buildTimer.start();
+        pyramids[s].build(*data[s]);
+        buildNanoseconds += buildTimer.nsecsElapsed();
+
+        graphs[s] = plot.addGraph();
+    }
+
+    printf("%d series of %d points, plot %dx%d. Building the pyramids took %.1f ms in total.\n", numseries, count, plot.width(), plot.height(),
+           buildNanoseconds / 1e6);
+    printf("%-12s %14s %14s %14s\n", "visible", "all points", "pyramid", "decimating");
+
+    const int frames = 5;
+    for(double fraction : {1.0, 0.25, 0.05, 0.005})
+    {
+        double start = 946684800.0, end = 946684800.0 + 86400.0*(count - 1);
+        QCPRange range(start + (end - start)*(1.0 - fraction)/2.0, start + (end - start)*(1.0 + fraction)/2.0);
+        plot.xAxis->setRange(range);
+        plot.yAxis->setRange(-10.0, 10.0*numseries + 10.0);
+
+        for(int s = 0; s < numseries; ++s) graphs[s]->setData(data[s]);
+        double full = frameTime(plot, frames);
+
+        //NOTE: What Plotter::updateLevelOfDetail does for every graph when the range changes.
+        QElapsedTimer decimateTimer;
+        decimateTimer.start();
+        int maxBuckets = plot.xAxis->axisRect()->width();
+        QVector<QCPGraphData> decimated;
+        for(int s = 0; s < numseries; ++s)
+        {
+            if(pyramids[s].decimate(*data[s], range, maxBuckets, decimated))
+            {
+                QSharedPointer<QCPGraphDataContainer> shown(new QCPGraphDataContainer);
+                shown->set(decimated, true);
+                graphs[s]->setData(shown);
+            }
+        }
+        double decimate = decimateTimer.nsecsElapsed() / 1e6;
+        double lod = frameTime(plot, frames);
+
+        char visible[32];
+        snprintf(visible, sizeof(visible), "%.1f%%", fraction*100.0);
+        printf("%-12s %11.1f ms %11.1f ms %11.1f ms\n", visible, full, lod, decimate);
+    }
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core gui widgets printsupport
+
+CONFIG += console release
+CONFIG -= app_bundle
+
+TARGET = bench_minmaxpyramid
+TEMPLATE = app
+
+SOURCES += bench_minmaxpyramid.cpp \
+    ../../minmaxpyramid.cpp \
+    ../../qcustomplot.cpp
+
+HEADERS += ../../minmaxpyramid.h \
+    ../../qcustomplot.h
@@ -0,0 +1,69 @@
+#!/bin/bash
+
+#NOTE: Times export_values of the sqlhandler on a synthetic results database, so that two builds of the sqlhandler can be compared (e.g. the
+# one from before the value export was batched and the current one).
+
+# usage:
+# ./bench_export_values.sh <sqlhandler> [<sqlhandler> ...]
+#
+# environment:
+#   NUM_SERIES     : number of series in the database (default 1000)
+#   NUM_VALUES     : values per series (default 20000, which is 55 years of daily values)
+#   NUM_REQUESTED  : how many of the series are exported in one request (default 200)
+#   WORK_DIR       : where the database is made (default /tmp/incaview_bench). It is reused between runs if it has the same size.
+#
+# The rows are inserted one time step at a time with all the series in each step, like the model writes them, so the values of one series
+# are spread over the whole table. Each sqlhandler gets its own copy of the database, since the current one adds an index to it. It is timed
+# on the first export (which includes building that index, i.e. what the first fetch after a model run costs) and on a second export.
+
+NUM_SERIES=${NUM_SERIES:-1000}
+NUM_VALUES=${NUM_VALUES:-20000}
+NUM_REQUESTED=${NUM_REQUESTED:-200}
+WORK_DIR=${WORK_DIR:-/tmp/incaview_bench}
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <sqlhandler> [<sqlhandler> ...]"
+    exit 1
+fi
+
+mkdir -p $WORK_DIR
+DB=$WORK_DIR/results_${NUM_SERIES}x${NUM_VALUES}.db
+
+if [ ! -f $DB ]; then
+    echo "Creating $DB ..."
+    sqlite3 $DB > /dev/null <<EOF
+PRAGMA journal_mode = OFF;
+PRAGMA synchronous = OFF;
+CREATE TABLE Results (ID INTEGER, date INTEGER, value REAL);
+WITH RECURSIVE
+    step(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM step WHERE i + 1 < $NUM_VALUES),
+    series(id) AS (SELECT 1 UNION ALL SELECT id + 1 FROM series WHERE id < $NUM_SERIES)
+INSERT INTO Results (ID, date, value)
+    SELECT id, 946684800 + i*86400, CASE WHEN (i*7 + id) % 97 = 0 THEN NULL ELSE sin(i*0.01 + id) * 10.0 + id END
+    FROM step, series ORDER BY i, id;
+EOF
+    if [ $? -ne 0 ]; then
+        rm -f $DB
+        exit 1
+    fi
+fi
+
+echo "$(du -h $DB | cut -f1) database, $NUM_SERIES series of $NUM_VALUES values, exporting $NUM_REQUESTED of them."
+
+# The requested series are spread over the ID range.
+IDS=""
+for ((i = 0; i < NUM_REQUESTED; ++i)); do
+    IDS="$IDS $((1 + i*NUM_SERIES/NUM_REQUESTED))"
+done
+
+for SQLHANDLER in "$@"; do
+    COPY=$WORK_DIR/copy.db
+    cp $DB $COPY
+    for RUN in first second; do
+        START=$(date +%s.%N)
+        RESULT=$($SQLHANDLER export_values $COPY $WORK_DIR/values.dat Results $IDS | tail -n 1)
+        END=$(date +%s.%N)
+        printf "%-40s %-6s export: %8.2f s  %s\n" "$SQLHANDLER" $RUN $(awk "BEGIN { print $END - $START }") "$(echo $RESULT | cut -c1-40)"
+    done
+    rm -f $COPY $WORK_DIR/values.dat
+done
@@ -0,0 +1,227 @@
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+//NOTE: The statement patterns of SQLInterface::getResultOrInputValues and SQLInterface::writeParameterValues, before and after they kept the
+// connection open and reused prepared statements. Qt is not needed for this, so it is written against libsqlite3, which is what QSQLITE
+// calls into. QSqlQuery adds its own overhead per prepare on top of this, so the difference in the application is at least as large.
+//  series     : read NUM_SERIES series of NUM_VALUES values by ID from a Results table, like fetching the plotted series after a model run.
+//  parameters : write NUM_PARAMETERS double parameters in one transaction, like saving the parameters before a model run.
+// usage: bench_sqlinterface [work directory] [num series] [num values] [num parameters] [repetitions]
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool exec(sqlite3 *db, const char *sql)
+{
+    char *error = nullptr;
+    if(sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK)
+    {
+        fprintf(stderr, "%s: %s\n", sql, error);
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+//NOTE: The rows are written one time step at a time with all the series in each step, like the model writes them.
+static bool createResultsDatabase(const std::string &path, int numSeries, int numValues)
+{
+    remove(path.c_str());
+    sqlite3 *db;
+    if(sqlite3_open(path.c_str(), &db) != SQLITE_OK) return false;
+
+    bool success = exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;")
+                && exec(db, "CREATE TABLE Results (ID INTEGER, date INTEGER, value REAL);")
+                && exec(db, "BEGIN;");
+
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO Results (ID, date, value) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+    for(int step = 0; step < numValues && success; ++step)
+    {
+        for(int ID = 1; ID <= numSeries; ++ID)
+        {
+            sqlite3_bind_int(stmt, 1, ID);
+            sqlite3_bind_int64(stmt, 2, (sqlite3_int64)step * 86400);
+            sqlite3_bind_double(stmt, 3, ID * 0.5 + step);
+            success = success && sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    success = success && exec(db, "COMMIT;") && exec(db, "CREATE INDEX Results_ID_date_value ON Results (ID, date, value);");
+    sqlite3_close(db);
+    return success;
+}
+
+static bool createParameterDatabase(const std::string &path, int numParameters)
+{
+    remove(path.c_str());
+    sqlite3 *db;
+    if(sqlite3_open(path.c_str(), &db) != SQLITE_OK) return false;
+
+    char sql[256];
+    sprintf(sql, "WITH RECURSIVE p(id) AS (SELECT 1 UNION ALL SELECT id + 1 FROM p WHERE id < %d) "
+                 "INSERT INTO ParameterValues_double (ID, value) SELECT id, 0.0 FROM p;", numParameters);
+
+    bool success = exec(db, "CREATE TABLE ParameterValues_double (ID INTEGER PRIMARY KEY, value DOUBLE);")
+                && exec(db, sql);
+    sqlite3_close(db);
+    return success;
+}
+
+static void readSeries(sqlite3_stmt *stmt, std::vector<double> &series)
+{
+    series.clear();
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if(sqlite3_column_type(stmt, 1) == SQLITE_NULL) series.push_back(std::numeric_limits<double>::quiet_NaN());
+        else series.push_back(sqlite3_column_double(stmt, 1));
+    }
+}
+
+//NOTE: How getResultOrInputValues read before: open the database, prepare a sprintf query per ID, close the database.
+static double readSeriesOld(const std::string &path, int numSeries, double &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    sqlite3 *db;
+    sqlite3_open(path.c_str(), &db);
+    std::vector<double> series;
+    char sqlcommand[512];
+    for(int ID = 1; ID <= numSeries; ++ID)
+    {
+        sprintf(sqlcommand, "SELECT date, value FROM %s WHERE ID=%d ORDER BY date;", "Results", ID);
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, sqlcommand, -1, &stmt, nullptr);
+        readSeries(stmt, series);
+        sqlite3_finalize(stmt);
+        checksum += series.back();
+    }
+    sqlite3_close(db);
+
+    return elapsedMs(start);
+}
+
+//NOTE: How getResultOrInputValues reads now: the connection and the prepared statement are kept, and the ID is bound into it.
+static double readSeriesNew(sqlite3 *db, sqlite3_stmt *&stmt, int numSeries, double &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if(!stmt) sqlite3_prepare_v2(db, "SELECT date, value FROM Results WHERE ID=? ORDER BY date;", -1, &stmt, nullptr);
+    std::vector<double> series;
+    for(int ID = 1; ID <= numSeries; ++ID)
+    {
+        sqlite3_bind_int(stmt, 1, ID);
+        readSeries(stmt, series);
+        sqlite3_reset(stmt);
+        checksum += series.back();
+    }
+
+    return elapsedMs(start);
+}
+
+//NOTE: How writeParameterValues wrote before: open the database, prepare the UPDATE per parameter, close the database.
+static double writeParametersOld(const std::string &path, int numParameters, double value)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    sqlite3 *db;
+    sqlite3_open(path.c_str(), &db);
+    exec(db, "BEGIN;");
+    for(int ID = 1; ID <= numParameters; ++ID)
+    {
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(db, "UPDATE ParameterValues_double SET value =(:value) WHERE ID = (:id);", -1, &stmt, nullptr);
+        sqlite3_bind_double(stmt, 1, value);
+        sqlite3_bind_int(stmt, 2, ID);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+    exec(db, "COMMIT;");
+    sqlite3_close(db);
+
+    return elapsedMs(start);
+}
+
+//NOTE: How writeParameterValues writes now: one kept prepared UPDATE per type on the open connection.
+static double writeParametersNew(sqlite3 *db, sqlite3_stmt *&stmt, int numParameters, double value)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if(!stmt) sqlite3_prepare_v2(db, "UPDATE ParameterValues_double SET value =(:value) WHERE ID = (:id);", -1, &stmt, nullptr);
+    exec(db, "BEGIN;");
+    for(int ID = 1; ID <= numParameters; ++ID)
+    {
+        sqlite3_bind_double(stmt, 1, value);
+        sqlite3_bind_int(stmt, 2, ID);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    exec(db, "COMMIT;");
+
+    return elapsedMs(start);
+}
+
+int main(int argc, char **argv)
+{
+    std::string workdir = argc > 1 ? argv[1] : "/tmp";
+    int numSeries     = argc > 2 ? atoi(argv[2]) : 1000;
+    int numValues     = argc > 3 ? atoi(argv[3]) : 365;
+    int numParameters = argc > 4 ? atoi(argv[4]) : 10000;
+    int repetitions   = argc > 5 ? atoi(argv[5]) : 3;
+
+    std::string resultsPath = workdir + "/bench_sqlinterface_results.db";
+    std::string parametersPath = workdir + "/bench_sqlinterface_parameters.db";
+
+    if(!createResultsDatabase(resultsPath, numSeries, numValues) || !createParameterDatabase(parametersPath, numParameters))
+    {
+        fprintf(stderr, "Unable to create the databases in %s\n", workdir.c_str());
+        return 1;
+    }
+
+    sqlite3 *resultsDb;
+    sqlite3 *parametersDb;
+    sqlite3_open(resultsPath.c_str(), &resultsDb);
+    sqlite3_open(parametersPath.c_str(), &parametersDb);
+    sqlite3_stmt *readStmt = nullptr;
+    sqlite3_stmt *writeStmt = nullptr;
+
+    double checksumOld = 0.0;
+    double checksumNew = 0.0;
+    double bestReadOld = 1e300, bestReadNew = 1e300, bestWriteOld = 1e300, bestWriteNew = 1e300;
+    for(int rep = 0; rep < repetitions; ++rep)
+    {
+        bestReadOld  = std::min(bestReadOld,  readSeriesOld(resultsPath, numSeries, checksumOld));
+        bestReadNew  = std::min(bestReadNew,  readSeriesNew(resultsDb, readStmt, numSeries, checksumNew));
+        bestWriteOld = std::min(bestWriteOld, writeParametersOld(parametersPath, numParameters, rep + 1.0));
+        bestWriteNew = std::min(bestWriteNew, writeParametersNew(parametersDb, writeStmt, numParameters, rep + 2.0));
+    }
+
+    sqlite3_finalize(readStmt);
+    sqlite3_finalize(writeStmt);
+    sqlite3_close(resultsDb);
+    sqlite3_close(parametersDb);
+    remove(resultsPath.c_str());
+    remove(parametersPath.c_str());
+
+    if(checksumOld != checksumNew)
+    {
+        fprintf(stderr, "The old and new reads did not give the same values\n");
+        return 1;
+    }
+
+    printf("best of %d\n", repetitions);
+    printf("read %d series of %d values:  old %8.2f ms   new %8.2f ms\n", numSeries, numValues, bestReadOld, bestReadNew);
+    printf("write %d parameters:        old %8.2f ms   new %8.2f ms\n", numParameters, bestWriteOld, bestWriteNew);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console release
+CONFIG -= qt app_bundle
+
+TARGET = bench_sqlinterface
+TEMPLATE = app
+
+SOURCES += bench_sqlinterface.cpp
+
+LIBS += -lsqlite3
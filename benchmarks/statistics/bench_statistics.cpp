@@ -0,0 +1,138 @@
+#include "../../statistics.h"
+#include <boost/accumulators/accumulators.hpp>
+#include <boost/accumulators/statistics/stats.hpp>
+#include <boost/accumulators/statistics/mean.hpp>
+#include <boost/accumulators/statistics/min.hpp>
+#include <boost/accumulators/statistics/max.hpp>
+#include <boost/accumulators/statistics/variance.hpp>
+#include <boost/accumulators/statistics/covariance.hpp>
+#include <boost/accumulators/statistics/variates/covariate.hpp>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+//NOTE: Compares the statistics kernel with the Boost accumulators that the summary panel and the error plots used before it, on the same
+// numbers. The accumulator code is what Plotter::plotGraphs did, minus the drawing.
+// usage: bench_statistics [values per series] [series]
+
+using namespace boost::accumulators;
+
+static double summaryAccumulators(const std::vector<double> &values)
+{
+    accumulator_set<double, stats<tag::min, tag::max, tag::mean, tag::variance>> acc;
+    for(double d : values)
+    {
+        if(!std::isnan(d)) acc(d);
+    }
+    return min(acc) + max(acc) + mean(acc) + std::sqrt(variance(acc));
+}
+
+static double summaryKernel(const std::vector<double> &values)
+{
+    SummaryStatistics stats = summaryStatistics(values.data(), (int64_t)values.size());
+    return stats.min + stats.max + stats.mean + stats.standardDeviation();
+}
+
+static double residualAccumulators(const std::vector<double> &observed, const std::vector<double> &modeled, double startDate)
+{
+    accumulator_set<double, stats<tag::variance>> obsacc;
+    accumulator_set<double, stats<tag::mean, tag::min, tag::max>>  residualacc;
+    accumulator_set<double, stats<tag::mean>> residualabsacc;
+    accumulator_set<double, stats<tag::mean>> residualsquareacc;
+    accumulator_set<double, stats<tag::mean, tag::variance, tag::covariance<double, tag::covariate1>>> xacc;
+
+    for(size_t i = 0; i < observed.size(); ++i)
+    {
+        double x = startDate + 86400.0*(double)i;
+        double mod = modeled[i];
+        double obs = observed[i];
+        if(!std::isnan(mod) && !std::isnan(obs))
+        {
+            double residual = obs - mod;
+            obsacc(obs);
+            residualacc(residual);
+            residualabsacc(std::abs(residual));
+            residualsquareacc(residual*residual);
+            xacc(x, covariate1=residual);
+        }
+    }
+    return variance(obsacc) + mean(xacc) + variance(xacc) + covariance(xacc) + min(residualacc) + max(residualacc)
+         + mean(residualacc) + mean(residualabsacc) + mean(residualsquareacc);
+}
+
+static double residualKernel(const std::vector<double> &observed, const std::vector<double> &modeled, double startDate)
+{
+    ResidualStatistics stats = residualStatistics(observed.data(), modeled.data(), (int64_t)observed.size(), startDate, 86400.0);
+    return stats.observedVariance + stats.xMean + stats.xVariance + stats.xResidualCovariance + stats.minResidual + stats.maxResidual
+         + stats.meanError + stats.meanAbsoluteError + stats.meanSquaredError;
+}
+
+template<typename F> static double timeIt(const char *name, int repeats, F f)
+{
+    //NOTE: The best of a few repeats, so that a scheduling hiccup does not count.
+    double best = std::numeric_limits<double>::max();
+    volatile double sink = 0.0;
+    for(int r = 0; r < repeats; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    printf("%-24s %9.3f ms\n", name, best);
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+    int numseries = argc > 2 ? atoi(argv[2]) : 50;
+
+    std::vector<std::vector<double>> observed(numseries), modeled(numseries);
+    srand(1);
+    for(int s = 0; s < numseries; ++s)
+    {
+        observed[s].resize(count);
+        modeled[s].resize(count);
+        for(int i = 0; i < count; ++i)
+        {
+            double base = 10.0 + 5.0*std::sin(i*0.0172);
+            observed[s][i] = (i % 17 == 0) ? std::numeric_limits<double>::quiet_NaN() : base + (double)rand()/RAND_MAX;
+            modeled[s][i] = base + (double)rand()/RAND_MAX;
+        }
+    }
+
+    printf("%d series of %d values, every 17th observed value missing\n", numseries, count);
+
+    const int repeats = 5;
+    double accsummary = timeIt("summary, accumulators", repeats, [&]()
+    {
+        double sum = 0.0;
+        for(int s = 0; s < numseries; ++s) sum += summaryAccumulators(observed[s]);
+        return sum;
+    });
+    double kernelsummary = timeIt("summary, kernel", repeats, [&]()
+    {
+        double sum = 0.0;
+        for(int s = 0; s < numseries; ++s) sum += summaryKernel(observed[s]);
+        return sum;
+    });
+    double accresidual = timeIt("residuals, accumulators", repeats, [&]()
+    {
+        double sum = 0.0;
+        for(int s = 0; s < numseries; ++s) sum += residualAccumulators(observed[s], modeled[s], 946684800.0);
+        return sum;
+    });
+    double kernelresidual = timeIt("residuals, kernel", repeats, [&]()
+    {
+        double sum = 0.0;
+        for(int s = 0; s < numseries; ++s) sum += residualKernel(observed[s], modeled[s], 946684800.0);
+        return sum;
+    });
+
+    printf("speedup: summary %.1fx, residuals %.1fx\n", accsummary / kernelsummary, accresidual / kernelresidual);
+    return 0;
+}
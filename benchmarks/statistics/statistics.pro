@@ -0,0 +1,14 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console release
+CONFIG -= qt app_bundle
+
+TARGET = bench_statistics
+TEMPLATE = app
+
+SOURCES += bench_statistics.cpp \
+    ../../statistics.cpp
+
+HEADERS += ../../statistics.h
+
+INCLUDEPATH += $$PWD/../../include #NOTE: For boost, which only the benchmark still uses.
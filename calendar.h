@@ -0,0 +1,70 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <stdint.h>
+
+//NOTE: Conversion between seconds since epoch (UTC, which is what all dates in the databases are) and calendar dates with plain integer
+// arithmetic. This is a lot faster than stepping a QDateTime forward and asking it for the year and month at every step, which matters
+// when we go through every value of a long daily series.
+//NOTE: The day conversions are from Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms", and are exact for the proleptic
+// Gregorian calendar.
+
+static const int64_t seconds_per_day = 86400;
+
+struct calendar_date
+{
+    int32_t year;
+    int32_t month; //NOTE: 1-12
+    int32_t day;   //NOTE: 1-31
+};
+
+//NOTE: Rounds towards negative infinity, so that times before 1970 end up in the right day.
+static inline int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    if((a % b != 0) && ((a < 0) != (b < 0))) --q;
+    return q;
+}
+
+static inline int64_t days_from_civil(int32_t year, int32_t month, int32_t day)
+{
+    int64_t y = (int64_t)year - (month <= 2);
+    int64_t era = floor_div(y, 400);
+    int64_t yoe = y - era*400;                                               // [0, 399]
+    int64_t doy = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;      // [0, 365]
+    int64_t doe = yoe*365 + yoe/4 - yoe/100 + doy;                           // [0, 146096]
+    return era*146097 + doe - 719468;
+}
+
+static inline calendar_date civil_from_days(int64_t days)
+{
+    days += 719468;
+    int64_t era = floor_div(days, 146097);
+    int64_t doe = days - era*146097;                                         // [0, 146096]
+    int64_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;           // [0, 399]
+    int64_t doy = doe - (365*yoe + yoe/4 - yoe/100);                         // [0, 365]
+    int64_t mp  = (5*doy + 2)/153;                                           // [0, 11]
+
+    calendar_date date;
+    date.day   = (int32_t)(doy - (153*mp + 2)/5 + 1);
+    date.month = (int32_t)(mp < 10 ? mp + 3 : mp - 9);
+    date.year  = (int32_t)(yoe + era*400 + (date.month <= 2));
+    return date;
+}
+
+static inline int64_t day_from_seconds(int64_t seconds)
+{
+    return floor_div(seconds, seconds_per_day);
+}
+
+static inline calendar_date date_from_seconds(int64_t seconds)
+{
+    return civil_from_days(day_from_seconds(seconds));
+}
+
+static inline int64_t seconds_from_date(int32_t year, int32_t month, int32_t day)
+{
+    return days_from_civil(year, month, day)*seconds_per_day;
+}
+
+#endif // CALENDAR_H
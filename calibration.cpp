@@ -0,0 +1,94 @@
+#include "calibration.h"
+#include <QHash>
+#include <QSet>
+#include <QFile>
+#include <QTextStream>
+#include <cmath>
+
+static void findLeaves(const QVector<TreeData> &structure, QVector<int> &leafIdx, QHash<int, QString> &names)
+{
+    QSet<int> parents;
+    for(const TreeData &item : structure)
+    {
+        names[item.ID] = item.name;
+        if(item.parentID != 0) parents.insert(item.parentID);
+    }
+    for(int idx = 0; idx < structure.count(); ++idx)
+    {
+        if(!parents.contains(structure[idx].ID)) leafIdx.push_back(idx);
+    }
+}
+
+QVector<CalibrationPair> findCalibrationPairs(const QVector<TreeData> &resultStructure, const QVector<TreeData> &inputStructure)
+{
+    QVector<int> resultLeaves, inputLeaves;
+    QHash<int, QString> resultNames, inputNames;
+    findLeaves(resultStructure, resultLeaves, resultNames);
+    findLeaves(inputStructure, inputLeaves, inputNames);
+
+    auto key = [](const QString &name, const QString &parentName) { return parentName + QChar('\n') + name; };
+
+    QHash<QString, int> inputByKey;
+    for(int idx : inputLeaves)
+    {
+        const TreeData &item = inputStructure[idx];
+        QString k = key(item.name, inputNames.value(item.parentID));
+        if(!inputByKey.contains(k)) inputByKey[k] = item.ID;
+    }
+
+    QVector<CalibrationPair> pairs;
+    for(int idx : resultLeaves)
+    {
+        const TreeData &item = resultStructure[idx];
+        QString parentName = resultNames.value(item.parentID);
+        auto found = inputByKey.find(key(item.name, parentName));
+        if(found == inputByKey.end()) continue;
+
+        CalibrationPair pair;
+        pair.resultID = item.ID;
+        pair.inputID = found.value();
+        pair.name = item.name;
+        pair.parentName = parentName;
+        pairs.push_back(pair);
+    }
+    return pairs;
+}
+
+QStringList calibrationColumnNames()
+{
+    return QStringList()
+        << "count" << "NSE" << "log NSE" << "KGE" << "KGE r" << "KGE alpha" << "KGE beta"
+        << "PBIAS" << "R2" << "RMSE" << "MAE" << "bias";
+}
+
+QVector<double> calibrationColumnValues(const GoodnessOfFit &fit)
+{
+    return QVector<double>()
+        << (double)fit.residuals.count << fit.nashSutcliffe << fit.logNashSutcliffe << fit.klingGupta << fit.kgeCorrelation << fit.kgeVariability << fit.kgeBias
+        << fit.percentBias << fit.rSquared << fit.rootMeanSquaredError << fit.meanAbsoluteError << fit.meanError;
+}
+
+bool writeCalibrationReport(const QString &path, const QVector<CalibrationRow> &rows)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    out << "\"index\",\"series\"";
+    for(const QString &column : calibrationColumnNames()) out << ",\"" << column << "\"";
+    out << "\n";
+
+    for(const CalibrationRow &row : rows)
+    {
+        out << "\"" << row.pair.parentName << "\",\"" << row.pair.name << "\"";
+        for(double value : calibrationColumnValues(row.fit))
+        {
+            out << ",";
+            if(!std::isnan(value)) out << QString::number(value, 'g', 10); //NOTE: Missing metrics (e.g. for series that could not be aligned) are left empty.
+        }
+        out << "\n";
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,36 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "goodnessoffit.h"
+#include "treemodel.h"
+#include <QVector>
+#include <QString>
+#include <QStringList>
+
+//NOTE: A result series and the observed input series that it is calibrated against. They are paired when they have the same name and
+// sit under an index with the same name in their trees, e.g. "Reach flow" under "Tay" in both the results and the inputs. The IDs are the
+// database IDs, i.e. the input ID is not offset by maxresultID_.
+struct CalibrationPair
+{
+    int resultID;
+    int inputID;
+    QString name;
+    QString parentName;
+};
+
+struct CalibrationRow
+{
+    CalibrationPair pair;
+    GoodnessOfFit fit;
+};
+
+//NOTE: The pairs are in the order the results appear in the result structure.
+QVector<CalibrationPair> findCalibrationPairs(const QVector<TreeData> &resultStructure, const QVector<TreeData> &inputStructure);
+
+//NOTE: The columns of the calibration report, shared by the table in the GUI and the exported file so that the two always agree.
+QStringList calibrationColumnNames();
+QVector<double> calibrationColumnValues(const GoodnessOfFit &fit);
+
+bool writeCalibrationReport(const QString &path, const QVector<CalibrationRow> &rows);
+
+#endif // CALIBRATION_H
@@ -0,0 +1,63 @@
+#include "channelreader.h"
+#include <vector>
+
+bool readChannel(ssh_session session, ssh_channel channel, const std::function<bool(const char *, size_t)> &handleOutput, std::string &error)
+{
+    //NOTE: Instead of polling the channel and sleeping in between, we wait on the session socket with an ssh_event and read whatever has
+    // arrived every time it wakes up, so we return as soon as the command is done. The buffer starts out small since most commands
+    // only print a line or two, and doubles every time a read fills it up so that large outputs are read in large chunks.
+
+    ssh_event event = ssh_event_new();
+    if(!event || ssh_event_add_session(event, session) != SSH_OK)
+    {
+        error = "Failed to set up waiting on the session.";
+        if(event) ssh_event_free(event);
+        return false;
+    }
+
+    const size_t maxbuffersize = 1024*1024;
+    std::vector<char> buffer(4096);
+
+    bool success = true;
+    while(true)
+    {
+        int rc = ssh_channel_read_nonblocking(channel, buffer.data(), (uint32_t)buffer.size(), 0);
+        if(rc == SSH_ERROR)
+        {
+            error = std::string("Error while reading from channel: ") + ssh_get_error(session);
+            success = false;
+            break;
+        }
+        else if(rc == SSH_EOF)
+        {
+            break;
+        }
+        else if(rc > 0)
+        {
+            if(!handleOutput(buffer.data(), (size_t)rc)) break;
+
+            if((size_t)rc == buffer.size() && buffer.size() < maxbuffersize)
+            {
+                buffer.resize(buffer.size()*2);
+            }
+            continue;
+        }
+
+        //NOTE: Nothing more has arrived yet.
+        if(ssh_channel_is_eof(channel) || ssh_channel_is_closed(channel)) break;
+
+        //NOTE: The timeout is only there so that we don't hang forever if we for some reason miss a wakeup. Data arriving wakes us up immediately.
+        rc = ssh_event_dopoll(event, 1000);
+        if(rc == SSH_ERROR)
+        {
+            error = std::string("Error while waiting for data from channel: ") + ssh_get_error(session);
+            success = false;
+            break;
+        }
+    }
+
+    ssh_event_remove_session(event, session);
+    ssh_event_free(event);
+
+    return success;
+}
@@ -0,0 +1,13 @@
+#ifndef CHANNELREADER_H
+#define CHANNELREADER_H
+
+#include <libssh/libssh.h>
+#include <functional>
+#include <string>
+
+//NOTE: Reads stdout of the channel until EOF, or until handleOutput returns false to say that it does not want any more. If reading fails
+// it returns false with a description of what went wrong in error. This is what SSHInterface reads the output of every command with. It does
+// not depend on the rest of SSHInterface so that it can be benchmarked on its own (see benchmarks/channelreader).
+bool readChannel(ssh_session session, ssh_channel channel, const std::function<bool(const char *, size_t)> &handleOutput, std::string &error);
+
+#endif // CHANNELREADER_H
@@ -0,0 +1,589 @@
+#include "dataservice.h"
+#include "seriesexport.h"
+#include "seriescolumns.h"
+#include "calendar.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+#include <algorithm>
+
+DataService::DataService(SSHInterface *sshInterface)
+{
+    sshInterface_ = sshInterface;
+
+    qRegisterMetaType<SeriesRequest>();
+    qRegisterMetaType<SeriesResult>();
+    qRegisterMetaType<ModelRunRequest>();
+    qRegisterMetaType<ModelRunResult>();
+    qRegisterMetaType<CalibrationRequest>();
+    qRegisterMetaType<CalibrationReport>();
+    qRegisterMetaType<ExportRequest>();
+    qRegisterMetaType<RemoteJobRequest>();
+
+    //NOTE: An SSH error is often the first we hear of the connection being lost. The errors are emitted on this thread, so this is a direct call.
+    QObject::connect(sshInterface_, &SSHInterface::logError, this, &DataService::checkConnectionAfterError);
+}
+
+DataService::~DataService()
+{
+    if(localDb_) delete localDb_;
+}
+
+SQLInterface *DataService::localDb()
+{
+    if(!localDb_) localDb_ = new SQLInterface("DataService");
+    return localDb_;
+}
+
+void DataService::fetchSeries(const SeriesRequest &request)
+{
+    //NOTE: If the user has selected something else since this was requested, nobody wants the data anymore.
+    if(isStale(request)) return;
+
+    SeriesResult result;
+    result.generation = request.generation;
+    result.resultsGeneration = request.resultsGeneration;
+    result.inputsGeneration = request.inputsGeneration;
+    result.prefetch = request.prefetch;
+
+    //TODO: Formalize the paths to the databases in some way so that they are not just scattered around in the code.
+    bool success = true;
+    if(!request.resultIDs.empty())
+    {
+        success = getDataSets(request, "results.db", request.resultIDs, "Results", result, 0);
+    }
+
+    //NOTE: If the request went stale in the meantime we still hand over what we got, since the MainWindow can cache it.
+    if(success && !request.inputIDs.empty() && !isStale(request))
+    {
+        success = getDataSets(request, "inputs.db", request.inputIDs, "Inputs", result, request.inputIDOffset);
+    }
+
+    if(success) emit seriesReady(result);
+    else        emit seriesFailed(request.generation, request.prefetch);
+}
+
+bool DataService::getDataSets(const SeriesRequest &request, const char *dbname, const QVector<int> &IDs, const char *table, SeriesResult &result, int IDOffset)
+{
+    QVector<SeriesData> series;
+    QVector<int64_t> startDates;
+    QVector<int64_t> timesteps;
+
+    bool success = false;
+    if(request.remote)
+    {
+        if(!sshInterface_->isInstanceConnected())
+        {
+            emit instanceDisconnected();
+            return false;
+        }
+
+        QString remotedb = request.remoteDirectory.isEmpty() ? QString(dbname) : request.remoteDirectory + "/" + dbname;
+        QByteArray remotedb2 = remotedb.toLatin1();
+        success = sshInterface_->getDataSets(remotedb2.data(), IDs, table, series, startDates, timesteps);
+    }
+    else
+    {
+        QString dbpath = QDir(request.projectDirectory).absoluteFilePath(dbname);
+        SQLInterface *db = localDb();
+        db->setDatabase(dbpath);
+        success = db->getResultOrInputValues(table, IDs, series, startDates, timesteps);
+    }
+
+    if(!success) return false;
+
+    for(int ID : IDs) result.IDs.push_back(ID + IDOffset);
+    result.series += series;
+    result.startDates += startDates;
+    result.timesteps += timesteps;
+
+    return true;
+}
+
+bool DataService::getStructure(const ModelRunRequest &request, const char *dbname, const char *table, QVector<TreeData> &structure)
+{
+    if(request.remote)
+    {
+        return sshInterface_->getStructureData(dbname, table, structure);
+    }
+    else
+    {
+        QString dbpath = QDir(request.projectDirectory).absoluteFilePath(dbname);
+        SQLInterface *db = localDb();
+        db->setDatabase(dbpath);
+        return db->getResultOrInputStructure(structure, table);
+    }
+}
+
+void DataService::runModel(const ModelRunRequest &request)
+{
+    ModelRunResult result;
+    result.inputFilePath = request.inputFilePath;
+
+    const char *ResultDb = "results.db";
+    const char *InputDb  = "inputs.db";
+
+    QString exename;
+    QString parameterDbPath = request.parameterDbPath;
+    localDb()->setDatabase(parameterDbPath);
+    localDb()->getExenameFromParameterInfo(exename);
+    //NOTE: The MainWindow owns the connection to the parameter database, we only needed the exe name. Keeping it open here would hold the
+    // file when it is replaced, e.g. by the optimizer.
+    localDb()->closeDatabase(parameterDbPath);
+
+    qDebug() << "exe name was: " << exename;
+
+    bool success = true;
+
+    if(request.remote)
+    {
+        if(!sshInterface_->isInstanceConnected())
+        {
+            result.parameterUploadFailed = true;
+            emit instanceDisconnected();
+            emit modelRunFinished(result);
+            return;
+        }
+
+        if(request.uploadInputFile) //NOTE: If the input file was selected before we connected it has not been uploaded yet, so we have to do it now.
+        {
+            const char *remoteInputFileName = "uploadedinputs.dat";
+
+            QByteArray filename2 = request.inputFilePath.toLatin1();
+            result.inputFileWasUploaded = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteInputFileName);
+        }
+
+        const char *remoteParameterDbName = "parameters.db";
+
+        //NOTE: A parameter edit only changes a few values, so we send those instead of the whole database when we can.
+        bool parametersAreUploaded = false;
+        if(!request.uploadParameterDb)
+        {
+            parametersAreUploaded = request.changedParameters.isEmpty() || sshInterface_->importParameterValues(remoteParameterDbName, request.changedParameters);
+            if(!parametersAreUploaded) emit log("Uploading the entire parameter database instead.");
+        }
+        if(!parametersAreUploaded)
+        {
+            QByteArray dbpath = request.parameterDbPath.toLatin1();
+            parametersAreUploaded = sshInterface_->uploadEntireFile(dbpath.data(), "~/", remoteParameterDbName);
+        }
+        if(!parametersAreUploaded)
+        {
+            //NOTE: Running anyway would give results from whatever parameters the instance had before.
+            result.parameterUploadFailed = true;
+            emit logError("Unable to upload the parameters to the instance. The model was not run.");
+            emit modelRunFinished(result);
+            return;
+        }
+
+        QByteArray exename2 = exename.toLatin1();
+
+        const char *remoteInputFile = "uploadedinputs.dat";
+        sshInterface_->runModel(exename2.data(), remoteInputFile, remoteParameterDbName); //TODO: This one should also report success/error?
+    }
+    else
+    {
+        QDir projectDirectory(request.projectDirectory);
+
+        //For now, assume the exe is in the same directory as the parameter database.
+        QString program = projectDirectory.absoluteFilePath(exename);
+
+        //TODO: Deleting the previous inputs and results db may not be that clean, but we don't have any system for managing it properly yet, so not deleting them causes errors.
+        //NOTE: We keep the databases open between fetches, so we have to let go of them before they are deleted.
+        //NOTE: The MainWindow reserved its model runner before it asked for this run, so the run is certain to be started when we hand it back,
+        // and we are not throwing away the results of a run that is still being written.
+        QString resultpath = projectDirectory.absoluteFilePath(ResultDb);
+        localDb()->closeDatabase(resultpath);
+        QFile::remove(resultpath);
+        QString inputpath = projectDirectory.absoluteFilePath(InputDb);
+        localDb()->closeDatabase(inputpath);
+        QFile::remove(inputpath);
+
+        qDebug() << "trying to run program " << program;
+
+        QStringList arguments;
+        arguments << "run" << request.inputFilePath << request.parameterDbPath;
+
+        //NOTE: The MainWindow runs the process, so that it can be followed and cancelled while it runs. We continue in finishLocalModelRun.
+        emit localModelRunReady(request, program, arguments);
+        return;
+    }
+
+    result.success = success;
+    finishModelRun(request, result);
+}
+
+void DataService::finishLocalModelRun(const ModelRunRequest &request, bool success)
+{
+    ModelRunResult result;
+    result.inputFilePath = request.inputFilePath;
+    result.success = success;
+    finishModelRun(request, result);
+}
+
+void DataService::finishModelRun(const ModelRunRequest &request, ModelRunResult &result)
+{
+    if(result.success && request.loadStructure)
+    {
+        emit log("Attempting to load result and input structure.");
+
+        result.structureWasLoaded = getStructure(request, "results.db", "ResultsStructure", result.resultStructure)
+                                 && getStructure(request, "inputs.db", "InputsStructure", result.inputStructure);
+    }
+
+    emit modelRunFinished(result);
+}
+
+void DataService::scoreCalibration(const CalibrationRequest &request)
+{
+    CalibrationReport report;
+    report.run = request.run;
+    report.sweepRun = request.sweepRun;
+    report.success = true;
+    report.rows.reserve(request.pairs.count());
+
+    //NOTE: The pairs are fetched and scored a chunk at a time, so that a large catchment set never has all of its series in memory at once.
+    // The scoring of a chunk is spread over all the cores.
+    const int chunkSize = 64;
+
+    SeriesRequest seriesRequest;
+    seriesRequest.remote = request.remote;
+    seriesRequest.projectDirectory = request.projectDirectory;
+    seriesRequest.remoteDirectory = request.remoteDirectory;
+
+    for(int start = 0; start < request.pairs.count(); start += chunkSize)
+    {
+        int end = std::min(start + chunkSize, request.pairs.count());
+
+        QVector<int> resultIDs;
+        QVector<int> inputIDs;
+        for(int idx = start; idx < end; ++idx)
+        {
+            resultIDs.push_back(request.pairs[idx].resultID);
+            inputIDs.push_back(request.pairs[idx].inputID);
+        }
+
+        SeriesResult modeled;
+        SeriesResult observed;
+        if(!getDataSets(seriesRequest, "results.db", resultIDs, "Results", modeled, 0)
+            || !getDataSets(seriesRequest, "inputs.db", inputIDs, "Inputs", observed, 0))
+        {
+            emit logError("Unable to load the series for the calibration report.");
+            report.success = false;
+            break;
+        }
+
+        auto viewOf = [](const SeriesResult &result, int idx)
+        {
+            TimeSeriesView view;
+            view.values = result.series[idx].data();
+            view.count = result.series[idx].count();
+            view.startDate = result.startDates[idx];
+            view.timestep = result.timesteps[idx];
+            return view;
+        };
+
+        QVector<GoodnessOfFitInput> inputs(end - start);
+        for(int idx = 0; idx < inputs.count(); ++idx)
+        {
+            inputs[idx].modeled = viewOf(modeled, idx);
+            inputs[idx].observed = viewOf(observed, idx);
+        }
+
+        QVector<GoodnessOfFit> fits = computeGoodnessOfFit(inputs);
+        for(int idx = 0; idx < fits.count(); ++idx)
+        {
+            CalibrationRow row;
+            row.pair = request.pairs[start + idx];
+            row.fit = fits[idx];
+            report.rows.push_back(row);
+        }
+    }
+
+    if(request.closeDatabases && !request.remote)
+    {
+        QDir projectDirectory(request.projectDirectory);
+        localDb()->closeDatabase(projectDirectory.absoluteFilePath("results.db"));
+        localDb()->closeDatabase(projectDirectory.absoluteFilePath("inputs.db"));
+    }
+
+    emit calibrationScored(report);
+}
+
+void DataService::exportSeries(const ExportRequest &request)
+{
+    bool success = (request.format == ExportFormat_Columnar) ? exportColumnar(request) : exportCSV(request);
+    emit exportFinished(request.path, success);
+}
+
+bool DataService::forEachExportChunk(const ExportRequest &request, const std::function<bool(const SeriesResult &)> &process)
+{
+    //NOTE: The series are fetched a chunk at a time, so that there is no limit to how many can be exported at once.
+    const int chunkSize = 64;
+
+    SeriesRequest seriesRequest;
+    seriesRequest.remote = request.remote;
+    seriesRequest.projectDirectory = request.projectDirectory;
+
+    for(int start = 0; start < request.resultIDs.count(); start += chunkSize)
+    {
+        SeriesResult chunk;
+        if(!getDataSets(seriesRequest, "results.db", request.resultIDs.mid(start, chunkSize), "Results", chunk, 0))
+        {
+            emit logError("Unable to load the series for the export.");
+            return false;
+        }
+        if(!process(chunk)) return false;
+    }
+    return true;
+}
+
+bool DataService::exportCSV(const ExportRequest &request)
+{
+    //NOTE: The file has a row per date, so every row needs a value from every series. Rather than holding all the series in memory, they are
+    // spilled to a temporary file as they come in, which is then mapped and read back row by row. The operating system pages the spilled
+    // values in and out as needed.
+    struct SpilledSeries
+    {
+        qint64 offset;
+        int64_t count;
+        int64_t startDate;
+        int64_t timestep;
+    };
+
+    QTemporaryFile spill;
+    if(!spill.open())
+    {
+        emit logError("Unable to create a temporary file for the export.");
+        return false;
+    }
+
+    QVector<SpilledSeries> spilled;
+    bool success = forEachExportChunk(request, [&](const SeriesResult &chunk)
+    {
+        for(int idx = 0; idx < chunk.series.count(); ++idx)
+        {
+            const SeriesData &series = chunk.series[idx];
+            SpilledSeries entry = {spill.pos(), series.count(), chunk.startDates[idx], chunk.timesteps[idx]};
+            qint64 bytes = (qint64)series.count()*sizeof(double);
+            if(spill.write((const char *)series.data(), bytes) != bytes)
+            {
+                emit logError("Unable to write to the temporary file for the export.");
+                return false;
+            }
+            spilled.push_back(entry);
+        }
+        return true;
+    }
+    );
+    if(!success) return false;
+
+    //NOTE: The timestep of an empty series does not mean anything.
+    int64_t timestep = 0;
+    for(const SpilledSeries &entry : spilled)
+    {
+        if(entry.count == 0) continue;
+        if(timestep != 0 && entry.timestep != timestep)
+        {
+            emit logError("Can not export series that have different timesteps to the same CSV file.");
+            return false;
+        }
+        timestep = entry.timestep;
+    }
+
+    spill.flush();
+    const uchar *mapped = spill.size() > 0 ? spill.map(0, spill.size()) : nullptr;
+    if(spill.size() > 0 && !mapped)
+    {
+        emit logError("Unable to map the temporary file for the export.");
+        return false;
+    }
+
+    QVector<ExportColumn> columns(spilled.count());
+    for(int idx = 0; idx < spilled.count(); ++idx)
+    {
+        columns[idx].name = request.names[idx];
+        columns[idx].values = mapped ? (const double *)(mapped + spilled[idx].offset) : nullptr; //NOTE: The offsets are multiples of 8 and the mapping is page aligned.
+        columns[idx].count = spilled[idx].count;
+        columns[idx].startDate = spilled[idx].startDate;
+    }
+
+    QFile file(request.path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        emit logError(QString("Unable to open file ") + request.path);
+        return false;
+    }
+
+    success = writeSeriesCSV(&file, columns, timestep > 0 ? timestep : seconds_per_day);
+    file.close();
+    if(!success) emit logError(QString("Unable to write the series to ") + request.path);
+    return success;
+}
+
+bool DataService::exportColumnar(const ExportRequest &request)
+{
+    //NOTE: Each series is a contiguous block in a columnar file, so they can be written out as they come in, without a spill.
+    QFile file(request.path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        emit logError(QString("Unable to open file ") + request.path);
+        return false;
+    }
+
+    ColumnarSeriesWriter writer;
+    bool success = writer.begin(&file, request.resultIDs, request.names, request.units)
+        && forEachExportChunk(request, [&](const SeriesResult &chunk)
+        {
+            for(int idx = 0; idx < chunk.series.count(); ++idx)
+            {
+                const SeriesData &series = chunk.series[idx];
+                if(!writer.addSeries(chunk.startDates[idx], chunk.timesteps[idx], series.data(), series.count())) return false;
+            }
+            return true;
+        }
+        )
+        && writer.finish();
+
+    file.close();
+    if(!success) emit logError(QString("Unable to write the series to ") + request.path);
+    return success;
+}
+
+void DataService::runRemoteJobs(const RemoteJobRequest &request)
+{
+    if(!remoteJobs_)
+    {
+        remoteJobs_ = new RemoteJobScheduler(sshInterface_, this);
+        QObject::connect(remoteJobs_, &RemoteJobScheduler::jobFinished, this, &DataService::remoteJobFinished);
+        QObject::connect(remoteJobs_, &RemoteJobScheduler::finished, this, &DataService::remoteJobsFinished);
+        QObject::connect(remoteJobs_, &RemoteJobScheduler::instanceDisconnected, this, &DataService::instanceDisconnected);
+        QObject::connect(remoteJobs_, &RemoteJobScheduler::log, this, &DataService::log);
+        QObject::connect(remoteJobs_, &RemoteJobScheduler::logError, this, &DataService::logError);
+    }
+
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit instanceDisconnected();
+        emit remoteJobsFinished(request.batch, true);
+        return;
+    }
+
+    //NOTE: The jobs of a batch are checked on together, so we only run one batch at a time.
+    if(!remoteJobs_->start(request))
+    {
+        emit logError("Another batch of jobs is already running on the instance. Wait for it to finish or cancel it first.");
+        emit remoteJobsFinished(request.batch, true);
+    }
+}
+
+void DataService::cancelRemoteJobs()
+{
+    if(remoteJobs_) remoteJobs_->cancel();
+}
+
+void DataService::checkConnectionAfterError()
+{
+    if(!instanceIsLeased_ || sshInterface_->isInstanceConnected()) return;
+
+    instanceIsLeased_ = false;
+    emit logError(QString("SSH Disconnected:") + sshInterface_->getDisconnectionMessage());
+    emit instanceDisconnected();
+}
+
+void DataService::connectInstance(const QString &username)
+{
+    QByteArray username2 = username.toLatin1();
+    bool success = sshInterface_->createInstance(username2.data());
+    instanceIsLeased_ = success;
+    emit instanceConnected(success);
+}
+
+void DataService::releaseInstance()
+{
+    instanceIsLeased_ = false;
+    sshInterface_->releaseInstance(); //TODO: If we were not successful releasing the instance, what do we do?
+}
+
+void DataService::uploadInputFile(const QString &path)
+{
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit instanceDisconnected();
+        emit inputFileUploaded(path, false);
+        return;
+    }
+
+    QByteArray path2 = path.toLatin1();
+    bool success = sshInterface_->uploadEntireFile(path2.data(), "~/", "uploadedinputs.dat");
+    emit inputFileUploaded(path, success);
+}
+
+void DataService::downloadFile(const QString &remotePath, const QString &localPath)
+{
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit instanceDisconnected();
+        emit fileDownloaded(localPath, false);
+        return;
+    }
+
+    //NOTE: The local file is replaced, so we can not have a connection open to it.
+    if(localDb_) localDb_->closeDatabase(localPath);
+
+    QByteArray remotePath2 = remotePath.toLatin1();
+    QByteArray localPath2 = localPath.toLatin1();
+    bool success = sshInterface_->downloadEntireFile(localPath2.data(), remotePath2.data());
+    emit fileDownloaded(localPath, success);
+}
+
+void DataService::createParameterDatabase(const QString &exename, const QString &parameterFilePath, const QString &databasePath)
+{
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit instanceDisconnected();
+        emit parameterDatabaseCreated(databasePath, false);
+        return;
+    }
+
+    const char *remoteParameterFileName = "parameters.dat";
+    const char *remoteParameterDbName   = "parameters.db";
+
+    QByteArray exename2 = exename.toLatin1();
+    QByteArray filename2 = parameterFilePath.toLatin1();
+    QByteArray databasePath2 = databasePath.toLatin1();
+
+    if(localDb_) localDb_->closeDatabase(databasePath);
+
+    //TODO: Don't hard code the location of the remote parameter database file?
+    bool success = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteParameterFileName)
+                && sshInterface_->createParameterDatabase(exename2.data(), remoteParameterFileName, remoteParameterDbName)
+                && sshInterface_->downloadEntireFile(databasePath2.data(), remoteParameterDbName);
+
+    emit parameterDatabaseCreated(databasePath, success);
+}
+
+void DataService::exportParameters(const QString &exename, const QString &parameterDbPath, const QString &exportPath)
+{
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit instanceDisconnected();
+        emit parametersExported(exportPath, false, false);
+        return;
+    }
+
+    const char *remoteParameterFileName = "parameters.dat";
+    const char *remoteParameterDbName = "parameters.db";
+
+    QByteArray exename2 = exename.toLatin1();
+    QByteArray dbfilename2 = parameterDbPath.toLatin1();
+    QByteArray exportPath2 = exportPath.toLatin1();
+
+    bool uploaded = sshInterface_->uploadEntireFile(dbfilename2.data(), "~/", remoteParameterDbName);
+    bool success = uploaded
+                && sshInterface_->exportParameters(exename2.data(), remoteParameterDbName, remoteParameterFileName)
+                && sshInterface_->downloadEntireFile(exportPath2.data(), remoteParameterFileName);
+
+    emit parametersExported(exportPath, uploaded, success);
+}
@@ -0,0 +1,189 @@
+#ifndef DATASERVICE_H
+#define DATASERVICE_H
+
+#include "sshInterface.h"
+#include "sqlinterface.h"
+#include "treemodel.h"
+#include "calibration.h"
+#include "remotejobs.h"
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <atomic>
+#include <functional>
+
+//NOTE: A request for the value series of a set of result and input IDs. The input IDs are the database IDs, i.e. they are not offset by maxresultID_.
+struct SeriesRequest
+{
+    quint64 generation = 0;
+    quint64 resultsGeneration = 0; //NOTE: The cache generations of the two databases when this was requested. They are handed back in the result.
+    quint64 inputsGeneration = 0;
+    bool prefetch = false; //NOTE: Speculative fetch of series that are likely to be selected next. These are never cancelled.
+    bool remote = false;
+    QString projectDirectory;
+    QString remoteDirectory; //NOTE: Where the databases are on the instance, relative to the home directory. Empty for the home directory itself.
+    QVector<int> resultIDs;
+    QVector<int> inputIDs;
+    int inputIDOffset = 0;
+};
+
+//NOTE: The IDs in here are the internal INCAView IDs, i.e. input IDs have been offset by inputIDOffset again.
+struct SeriesResult
+{
+    quint64 generation = 0;
+    quint64 resultsGeneration = 0;
+    quint64 inputsGeneration = 0;
+    bool prefetch = false;
+    QVector<int> IDs;
+    QVector<SeriesData> series;
+    QVector<int64_t> startDates;
+    QVector<int64_t> timesteps;
+};
+
+struct ModelRunRequest
+{
+    bool remote = false;
+    QString projectDirectory;
+    QString parameterDbPath;
+    QString inputFilePath;
+    bool uploadInputFile = false;
+    bool loadStructure = false;
+    //NOTE: For a remote run. If the parameters.db on the instance is known to match the parameter database except for the values that
+    // were saved since it was last brought up to date, only those values are sent. Otherwise the whole database is uploaded.
+    bool uploadParameterDb = true;
+    QVector<parameter_serial_entry> changedParameters;
+};
+
+struct ModelRunResult
+{
+    bool success = false;
+    bool inputFileWasUploaded = false;
+    bool parameterUploadFailed = false; //NOTE: The parameters.db on the instance could not be brought up to date.
+    bool structureWasLoaded = false;
+    QString inputFilePath; //NOTE: The input file that the run was made with.
+    QVector<TreeData> resultStructure;
+    QVector<TreeData> inputStructure;
+};
+
+//NOTE: Scores every result series that has an observed counterpart, without going through the plot cache.
+struct CalibrationRequest
+{
+    quint64 run = 0; //NOTE: Which model run the report is for, so that reports for older runs can be recognized.
+    bool remote = false;
+    QString projectDirectory;
+    QString remoteDirectory;
+    QVector<CalibrationPair> pairs;
+    int sweepRun = -1;            //NOTE: The index of the parameter sweep run that is scored, or -1 if it is not part of a sweep.
+    bool closeDatabases = false;  //NOTE: Let go of the databases when done, e.g. since a sweep run's directory is not looked at again.
+};
+
+struct CalibrationReport
+{
+    quint64 run = 0;
+    int sweepRun = -1;
+    bool success = false;
+    QVector<CalibrationRow> rows;
+};
+
+enum ExportFormat
+{
+    ExportFormat_CSV,
+    ExportFormat_Columnar, //NOTE: The columnar series file described in serialization.h.
+};
+
+//NOTE: Writes result series to a file straight from the database, without going through the plot cache.
+struct ExportRequest
+{
+    bool remote = false;
+    QString projectDirectory;
+    QString path;
+    ExportFormat format = ExportFormat_CSV;
+    QVector<int> resultIDs;
+    QVector<QString> names;
+    QVector<QString> units;
+};
+
+Q_DECLARE_METATYPE(SeriesRequest)
+Q_DECLARE_METATYPE(SeriesResult)
+Q_DECLARE_METATYPE(ModelRunRequest)
+Q_DECLARE_METATYPE(ModelRunResult)
+Q_DECLARE_METATYPE(CalibrationRequest)
+Q_DECLARE_METATYPE(CalibrationReport)
+Q_DECLARE_METATYPE(ExportRequest)
+Q_DECLARE_METATYPE(RemoteJobRequest)
+
+//NOTE: The DataService does all the database and SSH work that can take a while, so that the GUI does not freeze. It is moved to a worker thread
+// by the MainWindow, and requests are sent to it with queued signals. Only one request is worked on at a time, in the order they were sent.
+class DataService : public QObject
+{
+    Q_OBJECT
+
+public:
+    DataService(SSHInterface *sshInterface);
+    ~DataService();
+
+    //NOTE: Thread safe. Fetches with a generation older than this are dropped instead of being carried out, so that a user clicking through the
+    // tree does not leave a queue of fetches that nobody wants the result of anymore.
+    void cancelFetchesBefore(quint64 generation) { latestGeneration_ = generation; }
+
+public slots:
+    void fetchSeries(const SeriesRequest &request);
+    void runModel(const ModelRunRequest &request);
+    void finishLocalModelRun(const ModelRunRequest &request, bool success);
+    void scoreCalibration(const CalibrationRequest &request);
+    void exportSeries(const ExportRequest &request);
+    void runRemoteJobs(const RemoteJobRequest &request);
+    void cancelRemoteJobs();
+
+    //NOTE: Connecting, giving the instance back and moving files to and from it all block on the session, which may be busy with a model run
+    // or a data fetch, so they are done here like everything else that uses the session.
+    void connectInstance(const QString &username);
+    void releaseInstance();
+    void uploadInputFile(const QString &path);
+    void downloadFile(const QString &remotePath, const QString &localPath);
+    void createParameterDatabase(const QString &exename, const QString &parameterFilePath, const QString &databasePath);
+    void exportParameters(const QString &exename, const QString &parameterDbPath, const QString &exportPath);
+
+signals:
+    void seriesReady(const SeriesResult &result);
+    void seriesFailed(quint64 generation, bool prefetch);
+    void localModelRunReady(const ModelRunRequest &request, const QString &program, const QStringList &arguments);
+    void modelRunFinished(const ModelRunResult &result);
+    void calibrationScored(const CalibrationReport &report);
+    void exportFinished(const QString &path, bool success);
+    void remoteJobFinished(quint64 batch, int index, bool success);
+    void remoteJobsFinished(quint64 batch, bool cancelled);
+    void instanceConnected(bool success);
+    void instanceDisconnected();
+    void inputFileUploaded(const QString &path, bool success);
+    void fileDownloaded(const QString &localPath, bool success);
+    void parameterDatabaseCreated(const QString &databasePath, bool success);
+    void parametersExported(const QString &exportPath, bool parameterDbWasUploaded, bool success);
+
+    void log(const QString &);
+    void logError(const QString &);
+
+private slots:
+    void checkConnectionAfterError();
+
+private:
+    bool isStale(const SeriesRequest &request) { return !request.prefetch && request.generation < latestGeneration_; }
+
+    bool getDataSets(const SeriesRequest &request, const char *dbname, const QVector<int> &IDs, const char *table, SeriesResult &result, int IDOffset);
+    bool forEachExportChunk(const ExportRequest &request, const std::function<bool(const SeriesResult &)> &process);
+    bool exportCSV(const ExportRequest &request);
+    bool exportColumnar(const ExportRequest &request);
+    bool getStructure(const ModelRunRequest &request, const char *dbname, const char *table, QVector<TreeData> &structure);
+    void finishModelRun(const ModelRunRequest &request, ModelRunResult &result);
+
+    SQLInterface *localDb();
+
+    SSHInterface *sshInterface_;
+    SQLInterface *localDb_ = nullptr; //NOTE: Created on first use, since it has to be created on the worker thread.
+    RemoteJobScheduler *remoteJobs_ = nullptr; //NOTE: Likewise, since its timer has to live on the worker thread.
+
+    std::atomic<quint64> latestGeneration_{0};
+    bool instanceIsLeased_ = false; //NOTE: Whether we have an instance that we have not given back, i.e. whether losing the connection is news.
+};
+
+#endif // DATASERVICE_H
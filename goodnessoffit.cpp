@@ -0,0 +1,106 @@
+#include "goodnessoffit.h"
+#include <QtConcurrent>
+#include <cmath>
+#include <limits>
+
+AlignmentResult alignSeries(const TimeSeriesView &observed, const TimeSeriesView &modeled, AlignedSeriesPair &out)
+{
+    out = AlignedSeriesPair();
+
+    int64_t timestep = modeled.timestep;
+    if(timestep <= 0 || timestep != observed.timestep) return Alignment_DifferentTimesteps;
+    if((modeled.startDate - observed.startDate) % timestep != 0) return Alignment_MisalignedSteps;
+
+    //NOTE: Skip the beginning of whichever series starts first so that the two are aligned on the same dates.
+    int64_t startDate = std::max(modeled.startDate, observed.startDate);
+    int64_t alignmod = (startDate - modeled.startDate)/timestep;
+    int64_t alignobs = (startDate - observed.startDate)/timestep;
+
+    int64_t count = std::min(observed.count - alignobs, modeled.count - alignmod);
+    if(count <= 0) return Alignment_NoOverlap;
+
+    out.observed = observed.values + alignobs;
+    out.modeled = modeled.values + alignmod;
+    out.count = count;
+    out.startDate = startDate;
+    out.timestep = timestep;
+    return Alignment_Ok;
+}
+
+GoodnessOfFit computeGoodnessOfFit(const AlignedSeriesPair &pair)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    GoodnessOfFit fit;
+    fit.alignment = Alignment_Ok;
+
+    fit.residuals = residualStatistics(pair.observed, pair.modeled, pair.count, (double)pair.startDate, (double)pair.timestep);
+    const ResidualStatistics &stats = fit.residuals;
+
+    //NOTE: With no overlapping values everything is NaN already, and the divisions below just keep it that way.
+    double sdobs = std::sqrt(stats.observedVariance);
+    double sdmod = std::sqrt(stats.modeledVariance);
+    double correlation = stats.covariance / (sdobs*sdmod);
+
+    fit.meanError            = stats.meanError;
+    fit.meanAbsoluteError    = stats.meanAbsoluteError;
+    fit.meanSquaredError     = stats.meanSquaredError;
+    fit.rootMeanSquaredError = std::sqrt(stats.meanSquaredError);
+    fit.nashSutcliffe        = 1.0 - stats.meanSquaredError / stats.observedVariance;
+    fit.percentBias          = 100.0 * (stats.modeledMean - stats.observedMean) / stats.observedMean;
+    fit.rSquared             = correlation*correlation;
+    fit.kgeCorrelation       = correlation;
+    fit.kgeVariability       = sdmod / sdobs;
+    fit.kgeBias              = stats.modeledMean / stats.observedMean;
+    fit.klingGupta           = 1.0 - std::sqrt((correlation - 1.0)*(correlation - 1.0)
+                                               + (fit.kgeVariability - 1.0)*(fit.kgeVariability - 1.0)
+                                               + (fit.kgeBias - 1.0)*(fit.kgeBias - 1.0));
+
+    //NOTE: The log transform emphasizes low flows. The epsilon keeps zero flows finite. Values that are still not positive are treated as
+    // missing, as are the ones that were missing before (NaN > 0.0 is false).
+    fit.logNashSutcliffe = nan;
+    if(stats.count > 0)
+    {
+        double epsilon = std::abs(stats.observedMean) / 100.0;
+        QVector<double> logobs(pair.count);
+        QVector<double> logmod(pair.count);
+        for(int64_t i = 0; i < pair.count; ++i)
+        {
+            double o = pair.observed[i] + epsilon;
+            double m = pair.modeled[i] + epsilon;
+            logobs[i] = o > 0.0 ? std::log(o) : nan;
+            logmod[i] = m > 0.0 ? std::log(m) : nan;
+        }
+        ResidualStatistics logstats = residualStatistics(logobs.constData(), logmod.constData(), pair.count);
+        fit.logNashSutcliffe = 1.0 - logstats.meanSquaredError / logstats.observedVariance;
+    }
+
+    return fit;
+}
+
+GoodnessOfFit computeGoodnessOfFit(const GoodnessOfFitInput &input)
+{
+    AlignedSeriesPair pair;
+    AlignmentResult alignment = alignSeries(input.observed, input.modeled, pair);
+    if(alignment != Alignment_Ok)
+    {
+        GoodnessOfFit fit = computeGoodnessOfFit(AlignedSeriesPair()); //NOTE: Everything NaN.
+        fit.alignment = alignment;
+        return fit;
+    }
+    return computeGoodnessOfFit(pair);
+}
+
+QVector<GoodnessOfFit> computeGoodnessOfFit(const QVector<GoodnessOfFitInput> &inputs)
+{
+    //NOTE: Starting threads for a single pair (the usual case in the error plots) costs more than it saves.
+    if(inputs.count() <= 1)
+    {
+        QVector<GoodnessOfFit> result;
+        for(const GoodnessOfFitInput &input : inputs) result.push_back(computeGoodnessOfFit(input));
+        return result;
+    }
+
+    GoodnessOfFit (*computeOne)(const GoodnessOfFitInput &) = &computeGoodnessOfFit;
+    return QtConcurrent::blockingMapped<QVector<GoodnessOfFit>>(inputs, computeOne);
+}
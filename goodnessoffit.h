@@ -0,0 +1,71 @@
+#ifndef GOODNESSOFFIT_H
+#define GOODNESSOFFIT_H
+
+#include "statistics.h"
+#include <QVector>
+#include <stdint.h>
+
+//NOTE: A series as the goodness-of-fit engine sees it. The values are not owned, so whatever they point into (e.g. a SeriesData in the
+// series cache) has to stay alive until the computation is done.
+struct TimeSeriesView
+{
+    const double *values = nullptr;
+    int64_t count = 0;
+    int64_t startDate = 0; //NOTE: Seconds since epoch.
+    int64_t timestep = 0;  //NOTE: In seconds.
+};
+
+//NOTE: The part of a modeled and an observed series that covers the same dates, step by step.
+struct AlignedSeriesPair
+{
+    const double *observed = nullptr;
+    const double *modeled = nullptr;
+    int64_t count = 0;
+    int64_t startDate = 0;
+    int64_t timestep = 0;
+};
+
+enum AlignmentResult
+{
+    Alignment_Ok,
+    Alignment_DifferentTimesteps,
+    Alignment_MisalignedSteps, //NOTE: The start dates are not a whole number of timesteps apart.
+    Alignment_NoOverlap,
+};
+
+AlignmentResult alignSeries(const TimeSeriesView &observed, const TimeSeriesView &modeled, AlignedSeriesPair &out);
+
+//NOTE: All metrics are computed over the steps where neither the observed nor the modeled value is missing. The residual is
+// observed - modeled.
+struct GoodnessOfFit
+{
+    AlignmentResult alignment = Alignment_NoOverlap;
+    ResidualStatistics residuals; //NOTE: Has the count, the means, the variances and the regression of the residual over time.
+
+    double meanError;          //NOTE: Bias of the residual.
+    double meanAbsoluteError;
+    double meanSquaredError;
+    double rootMeanSquaredError;
+    double nashSutcliffe;      //NOTE: NSE = 1 - MSE / variance of the observed.
+    double logNashSutcliffe;   //NOTE: NSE of log(value + epsilon), epsilon being a hundredth of the observed mean (Pushpalatha et al. 2012).
+    double percentBias;        //NOTE: PBIAS = 100 * sum(modeled - observed) / sum(observed). Positive if the model overestimates.
+    double rSquared;           //NOTE: Square of the Pearson correlation.
+    double klingGupta;         //NOTE: KGE (Gupta et al. 2009) and its components below.
+    double kgeCorrelation;     //NOTE: r
+    double kgeVariability;     //NOTE: alpha = standard deviation of modeled / standard deviation of observed.
+    double kgeBias;            //NOTE: beta = mean of modeled / mean of observed.
+};
+
+struct GoodnessOfFitInput
+{
+    TimeSeriesView observed;
+    TimeSeriesView modeled;
+};
+
+GoodnessOfFit computeGoodnessOfFit(const AlignedSeriesPair &pair);
+GoodnessOfFit computeGoodnessOfFit(const GoodnessOfFitInput &input);
+
+//NOTE: Scores all the pairs, in parallel on the global QThreadPool. The results are in the same order as the inputs.
+QVector<GoodnessOfFit> computeGoodnessOfFit(const QVector<GoodnessOfFitInput> &inputs);
+
+#endif // GOODNESSOFFIT_H
@@ -0,0 +1,197 @@
+#!/bin/bash
+
+#NOTE: script to run on the incaview-hub which keeps a pool of compute instances warm, so that connecting does not have to wait for an
+# instance to be created from the snapshot, and disconnecting does not throw it away.
+
+# usage:
+# ./instancepool.sh lease <username>     : lease an instance to the user. The last line of the output is "LEASE <instancename> <ip>",
+#                                          or "ERROR <message>" if no instance could be had.
+# ./instancepool.sh release <instancename> : give a leased instance back to the pool.
+# ./instancepool.sh refill               : create instances until there are POOL_SIZE unused ones, and delete the ones that have been idle
+#                                          for longer than POOL_IDLE_SECONDS.
+# ./instancepool.sh status               : list the instances in the pool and their state.
+
+# The state of the pool is kept in pool/, with one file per instance containing one of
+#   provisioning                   : being created by refill
+#   free <ip>                      : created, never leased
+#   leased <ip> <username>
+#   idle <ip> <username> <since>   : released by the user. It is given back to the same user on the next lease (with their files still on
+#                                    it), but never to anybody else, and it is deleted once it has been idle for POOL_IDLE_SECONDS.
+
+ZONE=${POOL_ZONE:-europe-west3-a}
+POOL_SIZE=${POOL_SIZE:-2}
+POOL_IDLE_SECONDS=${POOL_IDLE_SECONDS:-28800}
+POOL_DIR=${POOL_DIR:-pool}
+KEY_DIR=${KEY_DIR:-keys}
+
+mkdir -p $POOL_DIR $KEY_DIR
+
+# All reads and writes of the state files happen under this lock. gcloud is never called while holding it, since creating an instance takes
+# minutes. The lock file is opened again every time, since the subshells of refill would otherwise share the lock with each other.
+lock() { exec 9> $POOL_DIR/.lock; flock 9; }
+unlock() { flock -u 9; exec 9>&-; }
+
+# $1 : instance name. Prints the external ip.
+instance_ip() {
+    gcloud compute instances describe $1 --zone $ZONE --format='get(networkInterfaces[0].accessConfigs[0].natIP)'
+}
+
+# $1 : instance name. Creates the disk from the snapshot-inca, which contains all the exe files we want, and the instance with the disk attached.
+provision() {
+    gcloud compute disks create $1-disk --size 10 --zone $ZONE --source-snapshot snapshot-inca --type pd-standard > /dev/null &&
+    gcloud compute instances create $1 --source-instance-template core-template --zone $ZONE --disk=name=$1-disk,device-name=$1-disk,mode=rw,boot=yes,auto-delete=yes > /dev/null
+}
+
+# $1 : instance name
+destroy() {
+    gcloud compute instances delete $1 --zone=$ZONE -q > /dev/null 2>&1
+}
+
+# $1 : instance name, $2 : username. Generates new keys for the user and gives the instance the user's key only, so that an instance that
+# was leased to somebody else before can not be logged into with their key.
+install_keys() {
+    rm -f $KEY_DIR/$2 $KEY_DIR/$2.pub
+    ssh-keygen -t rsa -f $KEY_DIR/$2 -C $2 -N '' -q
+    echo -n "$2:" | cat - $KEY_DIR/$2.pub | tr '\n' ' ' > $KEY_DIR/$2-list
+    gcloud compute instances add-metadata $1 --zone $ZONE --metadata-from-file ssh-keys=$KEY_DIR/$2-list > /dev/null
+    local result=$?
+    rm -f $KEY_DIR/$2-list
+    return $result
+}
+
+new_name() {
+    echo incaview-pool-$(date +%s)-$RANDOM
+}
+
+# $1 : username
+lease() {
+    local user=$1
+    local name=""
+    local ip=""
+    local previous=""
+
+    lock
+    # An instance that this user had before is preferred, since their files are still on it.
+    for file in $POOL_DIR/*; do
+        [ -f "$file" ] || continue
+        read state fileip fileuser since < $file
+        if [ "$state" = "idle" ] && [ "$fileuser" = "$user" ]; then name=$(basename $file); ip=$fileip; break; fi
+    done
+    if [ -z "$name" ]; then
+        for file in $POOL_DIR/*; do
+            [ -f "$file" ] || continue
+            read state fileip rest < $file
+            if [ "$state" = "free" ]; then name=$(basename $file); ip=$fileip; break; fi
+        done
+    fi
+    if [ -n "$name" ]; then
+        previous=$(cat $POOL_DIR/$name)
+        echo "leased $ip $user" > $POOL_DIR/$name
+    fi
+    unlock
+
+    if [ -z "$name" ]; then
+        # The pool is empty, so this lease has to wait for an instance to be created like before.
+        name=$(new_name)
+        lock; echo "provisioning" > $POOL_DIR/$name; unlock
+        if ! provision $name || ! ip=$(instance_ip $name) || [ -z "$ip" ]; then
+            destroy $name
+            lock; rm -f $POOL_DIR/$name; unlock
+            echo "ERROR Unable to create a compute instance."
+            return 1
+        fi
+        lock; echo "leased $ip $user" > $POOL_DIR/$name; unlock
+        previous="free $ip"
+    fi
+
+    if ! install_keys $name $user; then
+        # Give it back the way it was rather than leaving it leased to nobody.
+        lock; echo "$previous" > $POOL_DIR/$name; unlock
+        echo "ERROR Unable to install the ssh keys on $name."
+        return 1
+    fi
+
+    # Replace the instance that was just taken from the pool, without making the user wait for it.
+    nohup bash $0 refill > /dev/null 2>&1 &
+
+    echo "LEASE $name $ip"
+}
+
+# $1 : instance name
+release() {
+    local name=$1
+
+    lock
+    if [ ! -f $POOL_DIR/$name ]; then
+        unlock
+        echo "ERROR $name is not in the pool."
+        return 1
+    fi
+    read state ip user rest < $POOL_DIR/$name
+    if [ "$state" = "leased" ]; then
+        echo "idle $ip $user $(date +%s)" > $POOL_DIR/$name
+    fi
+    unlock
+
+    echo "RELEASED $name"
+}
+
+refill() {
+    local now=$(date +%s)
+    local expired=""
+    local unused=0
+
+    lock
+    for file in $POOL_DIR/*; do
+        [ -f "$file" ] || continue
+        read state ip user since < $file
+        if [ "$state" = "idle" ] && [ $((now - since)) -ge $POOL_IDLE_SECONDS ]; then
+            expired="$expired $(basename $file)"
+            rm -f $file
+        elif [ "$state" = "free" ] || [ "$state" = "provisioning" ]; then
+            unused=$((unused + 1))
+        fi
+    done
+    local missing=$((POOL_SIZE - unused))
+    local names=""
+    for ((i = 0; i < missing; ++i)); do
+        local name=$(new_name)-$i
+        echo "provisioning" > $POOL_DIR/$name
+        names="$names $name"
+    done
+    unlock
+
+    for name in $expired; do
+        destroy $name
+    done
+
+    # The instances are created in parallel, since each takes a while.
+    for name in $names; do
+        (
+            if provision $name && ip=$(instance_ip $name) && [ -n "$ip" ]; then
+                lock; echo "free $ip" > $POOL_DIR/$name; unlock
+            else
+                destroy $name
+                lock; rm -f $POOL_DIR/$name; unlock
+            fi
+        ) &
+    done
+    wait
+}
+
+status() {
+    lock
+    for file in $POOL_DIR/*; do
+        [ -f "$file" ] || continue
+        echo "$(basename $file) $(cat $file)"
+    done
+    unlock
+}
+
+case "$1" in
+    lease)   lease $2 ;;
+    release) release $2 ;;
+    refill)  refill ;;
+    status)  status ;;
+    *)       echo "ERROR Unknown command: $1"; exit 1 ;;
+esac
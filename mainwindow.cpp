@@ -3,7 +3,10 @@
 #include <functional>
 #include "sshInterface.h"
 #include "sqlhandler/serialization.h"
+#include "dataservice.h"
+#include "sweepdialog.h"
 #include <fstream>
+#include <cmath>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -64,6 +67,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->pushSaveParameters->setEnabled(false);
     ui->pushExportParameters->setEnabled(false);
+    ui->pushExportCalibration->setEnabled(false);
+
+    ui->tableCalibration->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->tableCalibration->verticalHeader()->hide();
     //ui->pushCreateDatabase->setEnabled(false);
     //ui->pushUploadInputs->setEnabled(false);
 
@@ -98,14 +105,106 @@ MainWindow::MainWindow(QWidget *parent) :
     sshInterface_ = new SSHInterface("35.198.76.72", "magnus", "hubkey");
 
     QObject::connect(sshInterface_, &SSHInterface::log, this, &MainWindow::log);
-    QObject::connect(sshInterface_, &SSHInterface::logError, this, &MainWindow::logSSHError);
+    QObject::connect(sshInterface_, &SSHInterface::logError, this, &MainWindow::logError);
+
+    //NOTE: Fetching data and running the model is done by the DataService on a worker thread, so that the GUI does not freeze while it happens.
+    dataService_ = new DataService(sshInterface_);
+    dataService_->moveToThread(&dataThread_);
+    QObject::connect(&dataThread_, &QThread::finished, dataService_, &QObject::deleteLater);
+
+    QObject::connect(this, &MainWindow::requestSeries, dataService_, &DataService::fetchSeries);
+    QObject::connect(this, &MainWindow::requestModelRun, dataService_, &DataService::runModel);
+    QObject::connect(dataService_, &DataService::seriesReady, this, &MainWindow::handleSeriesReady);
+    QObject::connect(dataService_, &DataService::seriesFailed, this, &MainWindow::handleSeriesFailed);
+    QObject::connect(ui->treeViewResults, &QTreeView::expanded, this, &MainWindow::prefetchExpandedResults);
+    QObject::connect(ui->treeViewInputs, &QTreeView::expanded, this, &MainWindow::prefetchExpandedInputs);
+    QObject::connect(dataService_, &DataService::localModelRunReady, this, &MainWindow::handleLocalModelRunReady);
+    QObject::connect(this, &MainWindow::requestFinishLocalModelRun, dataService_, &DataService::finishLocalModelRun);
+    QObject::connect(dataService_, &DataService::modelRunFinished, this, &MainWindow::handleModelRunFinished);
+    QObject::connect(this, &MainWindow::requestCalibration, dataService_, &DataService::scoreCalibration);
+    QObject::connect(dataService_, &DataService::calibrationScored, this, &MainWindow::handleCalibrationScored);
+    QObject::connect(this, &MainWindow::requestExport, dataService_, &DataService::exportSeries);
+    QObject::connect(dataService_, &DataService::exportFinished, this, &MainWindow::handleExportFinished);
+    QObject::connect(dataService_, &DataService::log, this, &MainWindow::log);
+    QObject::connect(dataService_, &DataService::logError, this, &MainWindow::logError);
+    QObject::connect(dataService_, &DataService::instanceDisconnected, this, [this]()
+    {
+        if(weExpectToBeConnected_) handleInvoluntarySSHDisconnect();
+    }
+    );
+
+    //NOTE: Everything that uses the session goes through the DataService, since the session may be busy for minutes with a model run, and
+    // the GUI would freeze if it waited for it. weExpectToBeConnected_ is what the GUI knows of the connection, and it is cleared when the
+    // DataService finds that the connection was lost.
+    QObject::connect(this, &MainWindow::requestConnectInstance, dataService_, &DataService::connectInstance);
+    QObject::connect(this, &MainWindow::requestReleaseInstance, dataService_, &DataService::releaseInstance);
+    QObject::connect(this, &MainWindow::requestInputUpload, dataService_, &DataService::uploadInputFile);
+    QObject::connect(this, &MainWindow::requestDownload, dataService_, &DataService::downloadFile);
+    QObject::connect(this, &MainWindow::requestCreateParameterDatabase, dataService_, &DataService::createParameterDatabase);
+    QObject::connect(this, &MainWindow::requestExportParameters, dataService_, &DataService::exportParameters);
+    QObject::connect(dataService_, &DataService::instanceConnected, this, &MainWindow::handleInstanceConnected);
+    QObject::connect(dataService_, &DataService::inputFileUploaded, this, &MainWindow::handleInputFileUploaded);
+    QObject::connect(dataService_, &DataService::fileDownloaded, this, &MainWindow::handleFileDownloaded);
+    QObject::connect(dataService_, &DataService::parameterDatabaseCreated, this, &MainWindow::handleParameterDatabaseCreated);
+    QObject::connect(dataService_, &DataService::parametersExported, this, &MainWindow::handleParametersExported);
+
+    dataThread_.start();
+
+    graphUpdateTimer_ = new QTimer(this);
+    graphUpdateTimer_->setSingleShot(true);
+    graphUpdateTimer_->setInterval(50);
+    QObject::connect(graphUpdateTimer_, &QTimer::timeout, this, &MainWindow::requestGraphData);
 
     plotter_ = new Plotter(ui->widgetPlotResults, ui->textResultsInfo);
 
+    //NOTE: Local model runs are followed from here, so that their output shows up as it is written and they can be cancelled.
+    modelRunner_ = new ModelRunner(this);
+    QObject::connect(modelRunner_, &ModelRunner::output, this, &MainWindow::log);
+    QObject::connect(modelRunner_, &ModelRunner::errorOutput, this, &MainWindow::logError);
+    QObject::connect(modelRunner_, &ModelRunner::progress, this, &MainWindow::showRunProgress);
+    QObject::connect(modelRunner_, &ModelRunner::finished, this, &MainWindow::handleModelRunnerFinished);
+    ui->pushCancelRun->setEnabled(false);
+
+    //NOTE: A sweep runs its own model processes, next to the modelRunner_.
+    sweep_ = new ParameterSweep(this);
+    QObject::connect(sweep_, &ParameterSweep::log, this, &MainWindow::log);
+    QObject::connect(sweep_, &ParameterSweep::logError, this, &MainWindow::logError);
+    QObject::connect(sweep_, &ParameterSweep::runFinished, this, &MainWindow::handleSweepRunFinished);
+    QObject::connect(sweep_, &ParameterSweep::finished, this, &MainWindow::handleSweepFinished);
+    QObject::connect(sweep_, &ParameterSweep::remoteRunsReady, this, [this](const RemoteJobRequest &request)
+    {
+        RemoteJobRequest batch = request;
+        batch.batch = ++remoteBatch_;
+        sweepBatch_ = batch.batch;
+        emit requestRemoteJobs(batch);
+    }
+    );
+    QObject::connect(sweep_, &ParameterSweep::cancelRemoteRuns, this, &MainWindow::requestCancelRemoteJobs);
+
+    //NOTE: Remote optimizer runs and sweeps are run as jobs on the instance, by the DataService.
+    QObject::connect(this, &MainWindow::requestRemoteJobs, dataService_, &DataService::runRemoteJobs);
+    QObject::connect(this, &MainWindow::requestCancelRemoteJobs, dataService_, &DataService::cancelRemoteJobs);
+    QObject::connect(dataService_, &DataService::remoteJobFinished, this, &MainWindow::handleRemoteJobFinished);
+    QObject::connect(dataService_, &DataService::remoteJobsFinished, this, &MainWindow::handleRemoteJobsFinished);
+
+    //NOTE: This is emitted before the plot is redrawn after a pan or zoom, so the graphs are refined (or coarsened) in time for it.
+    QObject::connect(ui->widgetPlotResults->xAxis, QOverload<const QCPRange &>::of(&QCPAxis::rangeChanged), this, [this]()
+    {
+        plotter_->updateLevelOfDetail();
+    }
+    );
+
 }
 
 MainWindow::~MainWindow()
 {
+    //NOTE: The DataService may be in the middle of something that uses the sshInterface_, so we let it finish before deleting anything.
+    dataThread_.quit();
+    dataThread_.wait();
+
+    //NOTE: The worker has stopped, so nothing else can be using the session, and we have to wait for this anyway before we exit.
+    sshInterface_->releaseInstance(); //TODO: If we were not successful releasing the instance, what do we do?
+
     delete ui;
     delete plotter_;
     delete sshInterface_;
@@ -129,19 +228,6 @@ void MainWindow::logError(const QString& Message)
 }
 
 
-void MainWindow::logSSHError(const QString& message)
-{
-    logError(message);
-
-    //TODO: We may want to do this regularly in some other way instead. It is not too reliable to do it here.. Maybe put it on a regular timer that is called once in a while.
-    if(weExpectToBeConnected_ && !sshInterface_->isInstanceConnected())
-    {
-        const char *disconnectionMessage = sshInterface_->getDisconnectionMessage();
-        logError(QString("SSH Disconnected:") + disconnectionMessage);
-        handleInvoluntarySSHDisconnect();
-    }
-}
-
 void MainWindow::resetWindowTitle()
 {
     QString dbState = selectedParameterDbPath_;
@@ -172,16 +258,16 @@ void MainWindow::on_pushConnect_clicked()
         usernamefile.close();
     }
 
-    //TODO: Check that username is a single word in lower caps or with '-'. If that is not always possible, we should generate the instance name in a different way
-
-    QString instancename = QString("incaview-") + username.data();
-    QByteArray instancename2 = instancename.toLatin1();
+    //TODO: Check that username is a single word in lower caps or with '-', since it is used as the user name on the instance.
 
     log(QString("Attempting to get a google compute instance for ") + username.data());
 
-    //bool success = sshInterface_->connectSession(name.data(), ip.data(), keyPath_);
-    bool success = sshInterface_->createInstance(username.data(), instancename2.data());
+    //NOTE: This can take minutes if the hub has to create an instance. We continue in handleInstanceConnected.
+    emit requestConnectInstance(QString::fromLatin1(username));
+}
 
+void MainWindow::handleInstanceConnected(bool success)
+{
     if(success)
     {
         log("Connection successful");
@@ -233,11 +319,18 @@ void MainWindow::loadParameterDatabase(QString fileName)
         clearGraphsAndResultSummary();
     }
 
+    //NOTE: We only keep a connection to the selected parameter database. The file we load may also have been replaced since we last had it
+    // open (e.g. optimized_parameters.db), so it gets a fresh connection.
+    if(parameterDbWasSelected_) projectDb_.closeDatabase(selectedParameterDbPath_);
+    projectDb_.closeDatabase(fileName);
+
     bool success = projectDb_.setDatabase(fileName);
     if(success)
     {
         parameterDbWasSelected_ = true;
         selectedParameterDbPath_ = fileName;
+        remoteParameterDbIsCurrent_ = false;
+        parametersChangedSinceUpload_.clear();
 
         QFileInfo fileinfo(selectedParameterDbPath_);
         projectDirectory_ = fileinfo.absolutePath();
@@ -259,8 +352,6 @@ void MainWindow::loadParameterDatabase(QString fileName)
         ui->treeViewParameters->setColumnHidden(1, true);
         ui->treeViewParameters->setColumnHidden(2, true);
 
-        ui->pushExportParameters->setEnabled(true);
-
         updateRunButtonState();
 
         setParametersHaveBeenEditedSinceLastSave(false);
@@ -285,11 +376,6 @@ void MainWindow::on_pushCreateDatabase_clicked()
         //NOTE: This should not be possible. The button should not be active in that case.
         return;
     }
-    if(!sshInterface_->isInstanceConnected())
-    {
-        handleInvoluntarySSHDisconnect();
-        return;
-    }
 
     QString fileName = QFileDialog::getOpenFileName(this,
         tr("Select parameter file to convert"), "", tr("Data files (*.dat)"));  //TODO: should not restrict it to .dat
@@ -299,9 +385,6 @@ void MainWindow::on_pushCreateDatabase_clicked()
         return;
     }
 
-    const char *remoteParameterFileName = "parameters.dat";
-    const char *remoteParameterDbName   = "parameters.db";
-
     //TODO: This means that they have to have a parameter database loaded, which is weird since what they are doing here is trying to create one.
     // We should instead query a selection list of models that can be loaded from the server.
     QString exename;
@@ -310,33 +393,28 @@ void MainWindow::on_pushCreateDatabase_clicked()
 
     qDebug() << "exe name was: " << exename;
 
-    QByteArray exename2 = exename.toLatin1();
-
-    QByteArray filename2 = fileName.toLatin1();
-    bool success = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteParameterFileName);
-
-    if(!success) return;
-
-    success = sshInterface_->createParameterDatabase(exename2.data(), remoteParameterFileName, remoteParameterDbName);
-
-    if(!success) return;
-
+    //NOTE: We ask where to store the database before it is created, since the creation happens on the DataService thread.
     QString saveFileName = QFileDialog::getSaveFileName(this,
         tr("Select location to store database file"), "", tr("Database files (*.db)"));
 
-    if(fileName.isEmpty() || fileName.isNull()) //NOTE: In case the user clicked cancel etc.
+    if(saveFileName.isEmpty() || saveFileName.isNull()) //NOTE: In case the user clicked cancel etc.
     {
         return;
     }
 
-    QByteArray saveFileName2 = saveFileName.toLatin1();
+    //NOTE: The parameters.db on the instance is replaced by the new database.
+    remoteParameterDbIsCurrent_ = false;
 
-    //TODO: Don't hard code the location of the remote parameter database file?
-    success = sshInterface_->downloadEntireFile(saveFileName2.data(), remoteParameterDbName);
+    //NOTE: The file is overwritten, so we can not have a connection open to it.
+    projectDb_.closeDatabase(saveFileName);
 
-    if(!success) return;
+    //NOTE: We continue in handleParameterDatabaseCreated.
+    emit requestCreateParameterDatabase(exename, fileName, saveFileName);
+}
 
-    loadParameterDatabase(saveFileName);
+void MainWindow::handleParameterDatabaseCreated(const QString &databasePath, bool success)
+{
+    if(success) loadParameterDatabase(databasePath);
 }
 
 void MainWindow::on_pushExportParameters_clicked()
@@ -358,28 +436,12 @@ void MainWindow::on_pushExportParameters_clicked()
 
     if(weExpectToBeConnected_)
     {
-        if(!sshInterface_->isInstanceConnected())
-        {
-            handleInvoluntarySSHDisconnect();
-            return;
-        }
-
-        const char *remoteParameterFileName = "parameters.dat";
-        const char *remoteParameterDbName = "parameters.db";
-
-        QByteArray dbfilename2 = selectedParameterDbPath_.toLatin1();
-        bool success = sshInterface_->uploadEntireFile(dbfilename2.data(), "~/", remoteParameterDbName);
-        if(!success) return;
+        //NOTE: The whole parameter database is uploaded for the export. Like for a model run, the next run can count on that, and if it
+        // fails handleParametersExported makes the next run upload all of it. We continue there.
+        remoteParameterDbIsCurrent_ = true;
+        parametersChangedSinceUpload_.clear();
 
-        QByteArray exename2 = exename.toLatin1();
-
-        success = sshInterface_->exportParameters(exename2.data(), remoteParameterDbName, remoteParameterFileName);
-
-        if(!success) return;
-
-        QByteArray saveFileName2 = exportParametersPath.toLatin1();
-
-        success = sshInterface_->downloadEntireFile(saveFileName2.data(), remoteParameterFileName);
+        emit requestExportParameters(exename, selectedParameterDbPath_, exportParametersPath);
     }
     else
     {
@@ -391,10 +453,22 @@ void MainWindow::on_pushExportParameters_clicked()
         QStringList arguments;
         arguments << "convert_parameters" <<  selectedParameterDbPath_ << exportParametersPath;
 
-        runModelProcessLocally(program, arguments);
+        if(!modelRunner_->start(program, arguments, projectDirectory_.path()))
+        {
+            logError("The parameters can not be exported while the model is running.");
+            return;
+        }
+        runnerJob_ = RunnerJob_ExportParameters;
+        updateRunButtonState();
     }
 }
 
+void MainWindow::handleParametersExported(const QString &exportPath, bool parameterDbWasUploaded, bool success)
+{
+    if(!parameterDbWasUploaded) remoteParameterDbIsCurrent_ = false;
+    if(success) log("Parameters exported to " + exportPath);
+}
+
 void MainWindow::on_pushUploadInputs_clicked()
 {
 
@@ -415,18 +489,20 @@ void MainWindow::on_pushUploadInputs_clicked()
         return;
     }
 
-    if(!sshInterface_->isInstanceConnected())
-    {
-        handleInvoluntarySSHDisconnect();
-        return;
-    }
-
-    const char *remoteInputFileName = "uploadedinputs.dat";
+    uploadInputFile();
+}
 
-    QByteArray filename2 = selectedInputFilePath_.toLatin1();
-    bool success = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteInputFileName);
+void MainWindow::uploadInputFile()
+{
+    //NOTE: The DataService does the requests in order, so a run that is requested after this can count on the file being there. If the
+    // upload fails, handleInputFileUploaded makes the next run upload it again.
+    inputFileWasUploaded_ = true;
+    emit requestInputUpload(selectedInputFilePath_);
+}
 
-    if(success) inputFileWasUploaded_ = true;
+void MainWindow::handleInputFileUploaded(const QString &path, bool success)
+{
+    if(!success && path == selectedInputFilePath_) inputFileWasUploaded_ = false;
 }
 
 void MainWindow::loadParameterData()
@@ -477,48 +553,26 @@ void MainWindow::loadParameterData()
     }
 }
 
-void MainWindow::loadResultAndInputStructure(const char *ResultDb, const char *InputDb)
+void MainWindow::setResultAndInputStructure(const QVector<TreeData> &resultstreedata, const QVector<TreeData> &inputtreedata)
 {
-    log("Attempting to load result and input structure.");
-
-    bool success = false;
-    QVector<TreeData> resultstreedata;
-    QVector<TreeData> inputtreedata;
-    if(weExpectToBeConnected_)
-    {
-        success = sshInterface_->getStructureData(ResultDb, "ResultsStructure", resultstreedata);
-        success = success && sshInterface_->getStructureData(InputDb, "InputsStructure", inputtreedata);
-    }
-    else
-    {
-        QString resultdbpath = projectDirectory_.absoluteFilePath(ResultDb);
-        projectDb_.setDatabase(resultdbpath);
-        success = projectDb_.getResultOrInputStructure(resultstreedata, "ResultsStructure");
-
-        QString inputdbpath = projectDirectory_.absoluteFilePath(InputDb);
-        projectDb_.setDatabase(inputdbpath);
-        success = success && projectDb_.getResultOrInputStructure(inputtreedata, "InputsStructure");
-    }
-
     if(resultstreedata.empty())
     {
         logError("The result structure is empty. A results database may not have been created, maybe due to an error.");
         return;
     }
 
-    if(!success) return;
-
     // Setup result structure
     if(treeResults_) delete treeResults_;
 
     treeResults_ = new TreeModel("Results structure");
 
     maxresultID_ = 0;
-    for(TreeData& item : resultstreedata)
+    for(const TreeData& item : resultstreedata)
     {
         treeResults_->addItem(item);
         maxresultID_ = item.ID > maxresultID_ ? item.ID : maxresultID_;
     }
+    plotter_->setMaxResultID(maxresultID_);
 
     ui->treeViewResults->setModel(treeResults_);
 
@@ -529,7 +583,7 @@ void MainWindow::loadResultAndInputStructure(const char *ResultDb, const char *I
 
     treeInputs_ = new TreeModel("Input structure");
 
-    for(TreeData &item : inputtreedata)
+    for(TreeData item : inputtreedata)
     {
         //NOTE: We remap the input IDs so that they don't overlap with the result IDs. This makes every timeseries have a unique internal ID in INCAView, and simplifies the Plotter a bit.
         item.ID += maxresultID_;
@@ -539,6 +593,8 @@ void MainWindow::loadResultAndInputStructure(const char *ResultDb, const char *I
 
     ui->treeViewInputs->setModel(treeInputs_);
 
+    calibrationPairs_ = findCalibrationPairs(resultstreedata, inputtreedata);
+
     QObject::connect(ui->treeViewInputs->selectionModel(), &QItemSelectionModel::selectionChanged, this, &MainWindow::updateGraphsAndResultSummary);
 
     //TODO: The following should be done somewhere else?
@@ -566,24 +622,33 @@ void MainWindow::loadResultAndInputStructure(const char *ResultDb, const char *I
 
 void MainWindow::updateRunButtonState()
 {
+    //NOTE: A local model run, a local optimizer run and a local parameter export all use the modelRunner_, which runs one at a time. A local
+    // model run also deletes the results of the previous one before it starts, so nothing else may be started while the runner is busy.
+    bool runnerIsFree = !modelRunner_->isRunning();
+
     if(parameterDbWasSelected_ &&
        inputFileWasSelected_
       )
     {
-        ui->pushRun->setEnabled(true);
-        ui->pushRunOptimizer->setEnabled(true);
+        ui->pushRun->setEnabled(runnerIsFree && !modelRunPending_);
+        ui->pushRunOptimizer->setEnabled(runnerIsFree && !optimizerRunPending_);
+        ui->pushRunSweep->setEnabled(!sweep_->isRunning());
     }
     else
     {
         ui->pushRun->setEnabled(false);
         ui->pushRunOptimizer->setEnabled(false);
+        ui->pushRunSweep->setEnabled(false);
     }
 
+    ui->pushExportParameters->setEnabled(parameterDbWasSelected_ && runnerIsFree);
 }
 
 void MainWindow::setWeExpectToBeConnected(bool connected)
 {
     weExpectToBeConnected_ = connected;
+    remoteParameterDbIsCurrent_ = false; //NOTE: Whatever is on the instance (if it had been leased to us before) can not be relied on.
+    parametersChangedSinceUpload_.clear();
 
     //updateRunButtonState();
 
@@ -601,6 +666,7 @@ void MainWindow::setWeExpectToBeConnected(bool connected)
         ui->pushDisconnect->setEnabled(false);
         ui->pushRun->setEnabled(false);
         ui->pushRunOptimizer->setEnabled(false);
+        ui->pushRunSweep->setEnabled(false);
         //ui->pushCreateDatabase->setEnabled(false);
         ui->radioButtonDaily->setEnabled(false);
         ui->radioButtonDailyNormalized->setEnabled(false);
@@ -616,8 +682,7 @@ void MainWindow::setWeExpectToBeConnected(bool connected)
 
 void MainWindow::on_pushDisconnect_clicked()
 {
-    bool success = sshInterface_->destroyInstance();
-    //TODO: If we were not successful destroying the instance, what do we do?
+    emit requestReleaseInstance();
 
     setWeExpectToBeConnected(false);
 
@@ -657,15 +722,17 @@ void MainWindow::on_pushSaveParameters_clicked()
     {
         log("Saving parameters...");
 
-        //NOTE: Serialize parameter values and send them to the remote database
+        //NOTE: Serialize the values of the parameters that were edited and write them to the database
         QVector<parameter_serial_entry> parameterdata;
-        //TODO: we should probably only save the parameters that have been changed instead of all of them.. However this operation is very fast, so it doesn't seem to matter.
-        parameterModel_->serializeParameterData(parameterdata);
+        parameterModel_->serializeEditedParameterData(parameterdata);
 
         projectDb_.setDatabase(selectedParameterDbPath_);
         bool success = projectDb_.writeParameterValues(parameterdata);
         if(success)
         {
+            for(const parameter_serial_entry &entry : parameterdata) parametersChangedSinceUpload_[entry.ID] = entry;
+
+            parameterModel_->clearEditedParameters();
             setParametersHaveBeenEditedSinceLastSave(false);
 
             editUndoStack_.clear();
@@ -717,7 +784,8 @@ void MainWindow::on_pushRun_clicked()
 
 void MainWindow::on_pushRunOptimizer_clicked()
 {
-    ui->pushRunOptimizer->setEnabled(false);
+    optimizerRunPending_ = true;
+    updateRunButtonState();
 
 
     QString setupScriptPath = QFileDialog::getOpenFileName(this,
@@ -725,6 +793,8 @@ void MainWindow::on_pushRunOptimizer_clicked()
 
     if(setupScriptPath.isEmpty() || setupScriptPath.isNull())     //NOTE: in case the user clicked cancel.
     {
+       optimizerRunPending_ = false;
+       updateRunButtonState();
        return;
     }
 
@@ -734,14 +804,7 @@ void MainWindow::on_pushRunOptimizer_clicked()
 
     if(weExpectToBeConnected_ && inputFileWasSelected_ && !inputFileWasUploaded_) //NOTE: If the input file was selected before we connected it has not been uploaded yet, so we have to do it now.
     {
-        //TODO: This is repeated code from RunModel.
-
-        const char *remoteInputFileName = "uploadedinputs.dat";
-
-        QByteArray filename2 = selectedInputFilePath_.toLatin1();
-        bool success = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteInputFileName);
-
-        if(success) inputFileWasUploaded_ = true;
+        uploadInputFile();
     }
 
     QString exename;
@@ -752,21 +815,53 @@ void MainWindow::on_pushRunOptimizer_clicked()
 
     if(weExpectToBeConnected_)
     {
-        //TODO: Not implemented
+        //NOTE: The optimizer runs as a job in a directory of its own on the instance, so that the session is not held up while it runs.
+        QString setupScriptName = QFileInfo(setupScriptPath).fileName();
+
+        RemoteJob job;
+        job.directory = "incaview_runs/optimizer";
+        job.command = "/home/magnus/" + exename + " run_optimizer $HOME/uploadedinputs.dat parameters.db " + setupScriptName + " optimized_parameters.db";
+        job.uploads.push_back(qMakePair(selectedParameterDbPath_, QString("parameters.db")));
+        job.uploads.push_back(qMakePair(setupScriptPath, setupScriptName));
+
+        RemoteJobRequest request;
+        request.batch = ++remoteBatch_;
+        request.jobs.push_back(job);
+        request.maxConcurrentJobs = 1;
+
+        optimizerBatch_ = request.batch;
+        optimizerJobSucceeded_ = false;
+        ui->pushCancelRun->setEnabled(true);
+        emit requestRemoteJobs(request);
+        return; //NOTE: We continue in handleRemoteJobsFinished.
     }
-    else
-    {
-        //For now, assume the exe is in the same directory as the parameter database.
-        QString program = projectDirectory_.absoluteFilePath(exename);
 
-        qDebug() << "trying to run program with optimization " << program;
+    //For now, assume the exe is in the same directory as the parameter database.
+    QString program = projectDirectory_.absoluteFilePath(exename);
 
-        QStringList arguments;
-        arguments << "run_optimizer" << selectedInputFilePath_ << selectedParameterDbPath_ << setupScriptPath << "optimized_parameters.db";
+    qDebug() << "trying to run program with optimization " << program;
+
+    QStringList arguments;
+    arguments << "run_optimizer" << selectedInputFilePath_ << selectedParameterDbPath_ << setupScriptPath << "optimized_parameters.db";
 
-        runModelProcessLocally(program, arguments);
+    //NOTE: The optimizer overwrites optimized_parameters.db, so we can not have a connection open to it from an earlier optimizer run.
+    projectDb_.closeDatabase(projectDirectory_.filePath("optimized_parameters.db"));
+
+    if(!modelRunner_->start(program, arguments, projectDirectory_.path()))
+    {
+        logError("The optimizer can not be started while another run is in progress.");
+        optimizerRunPending_ = false;
+        updateRunButtonState();
+        return;
     }
+    runnerJob_ = RunnerJob_Optimizer;
+    updateRunButtonState();
+    ui->pushCancelRun->setEnabled(true);
+    //NOTE: We continue in handleModelRunnerFinished.
+}
 
+void MainWindow::finishOptimizerRun()
+{
     log("Optimizer process completed.");
 
     //NOTE: Load in the optimized parameters and run the model one more time to see the results.
@@ -775,133 +870,436 @@ void MainWindow::on_pushRunOptimizer_clicked()
     loadParameterDatabase(dbpath);
     runModel();
 
-    ui->pushRunOptimizer->setEnabled(true);
+    optimizerRunPending_ = false;
+    updateRunButtonState();
 }
 
 
-bool MainWindow::runModelProcessLocally(const QString& program, const QStringList& arguments)
+void MainWindow::runModel()
 {
-    QProcess modelrun;
-    modelrun.setWorkingDirectory(projectDirectory_.path());
-    modelrun.start(program, arguments);
-    if(!modelrun.waitForStarted())
+    if(!parameterDbWasSelected_)
     {
-        logError("Model exe process did not start.");
-        ui->pushRun->setEnabled(true);
-        return false;
+        //it should not be possible to reach this state since the button should be disabled
+        return;
     }
 
-    bool correct = true;
-
-    connect(&modelrun, &QProcess::readyReadStandardOutput, [&](){log(modelrun.readAllStandardOutput());});
-    connect(&modelrun, &QProcess::readyReadStandardError, [&](){logError(modelrun.readAllStandardError()); correct=false;});
-    connect(&modelrun, &QProcess::errorOccurred, [&]()
+    //NOTE: A local run holds on to the modelRunner_ from here, since the DataService deletes the results of the previous run before it
+    // hands the run back to us to start (in handleLocalModelRunReady). That must not happen unless the run is certain to start.
+    if(!weExpectToBeConnected_ && !modelRunner_->reserve())
     {
-        logError("An error occurred while running the model exe.");
-        correct = false;
+        logError("The model can not be started while another run is in progress.");
+        return;
     }
-    );
+    modelRunPending_ = true;
+    updateRunButtonState();
+
+    log("Attempting to run Model...");
+
+    on_pushSaveParameters_clicked(); //NOTE: Save the parameters to the database.
 
-    if(!modelrun.waitForFinished(-1)) //TODO: We could maybe have a timeout, but it is hard to predict what it should be (some models could potentially take a minute or two to run?).
+    ModelRunRequest request;
+    request.remote = weExpectToBeConnected_;
+    request.projectDirectory = projectDirectory_.path();
+    request.parameterDbPath = selectedParameterDbPath_;
+    request.inputFilePath = selectedInputFilePath_;
+    request.uploadInputFile = weExpectToBeConnected_ && inputFileWasSelected_ && !inputFileWasUploaded_; //NOTE: If the input file was selected before we connected it has not been uploaded yet, so we have to do it now.
+    //TODO: We should do a more rigorous check here. If e.g. the user has switched out the input file between runs then the tree structure may no longer be valid and should be recreated.
+    request.loadStructure = !treeResults_;
+    if(weExpectToBeConnected_)
     {
-        logError("Model exe process finished incorrectly.");
-        ui->pushRun->setEnabled(true);
-        return false;
+        request.uploadParameterDb = !remoteParameterDbIsCurrent_;
+        if(remoteParameterDbIsCurrent_)
+        {
+            for(const auto &changed : parametersChangedSinceUpload_) request.changedParameters.push_back(changed.second);
+        }
+        //NOTE: The DataService does the runs in order, so the next run can count on this one having updated the database. If it could
+        // not, handleModelRunFinished makes the next run upload all of it.
+        remoteParameterDbIsCurrent_ = true;
+        parametersChangedSinceUpload_.clear();
     }
 
-    return correct;
+    //NOTE: The upload and the run itself happen on the DataService thread. We continue in handleModelRunFinished.
+    emit requestModelRun(request);
 }
 
-void MainWindow::runModel()
+void MainWindow::handleLocalModelRunReady(const ModelRunRequest &request, const QString &program, const QStringList &arguments)
 {
-    if(!parameterDbWasSelected_)
+    modelRunner_->release();
+    if(!modelRunner_->start(program, arguments, request.projectDirectory))
     {
-        //it should not be possible to reach this state since the button should be disabled
+        logError("The model can not be started while another run is in progress.");
+        emit requestFinishLocalModelRun(request, false);
         return;
     }
+    runnerJob_ = RunnerJob_Model;
+    pendingRunRequest_ = request;
+    ui->pushCancelRun->setEnabled(true);
+}
 
-    ui->pushRun->setEnabled(false);
+void MainWindow::on_pushCancelRun_clicked()
+{
+    modelRunner_->cancel();
+    sweep_->cancel();
+    if(optimizerBatch_) emit requestCancelRemoteJobs();
+}
 
-    log("Attempting to run Model...");
+void MainWindow::updateCancelButtonState()
+{
+    ui->pushCancelRun->setEnabled(modelRunner_->isRunning() || sweep_->isRunning() || optimizerBatch_);
+}
 
-    on_pushSaveParameters_clicked(); //NOTE: Save the parameters to the database.
+void MainWindow::showRunProgress(qint64 elapsedMilliseconds, int percent)
+{
+    qint64 seconds = elapsedMilliseconds / 1000;
+    QString message = QString("%1 running for %2:%3").arg(runnerJob_ == RunnerJob_Optimizer ? "Optimizer" : "Model")
+                          .arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+    if(percent >= 0) message += QString(" (%1%)").arg(percent);
+    ui->statusBar->showMessage(message);
+}
 
-    if(weExpectToBeConnected_ && inputFileWasSelected_ && !inputFileWasUploaded_) //NOTE: If the input file was selected before we connected it has not been uploaded yet, so we have to do it now.
+void MainWindow::handleModelRunnerFinished(bool success, bool cancelled)
+{
+    updateCancelButtonState();
+    updateRunButtonState();
+    ui->statusBar->clearMessage();
+    if(cancelled) log("The run was cancelled.");
+
+    if(runnerJob_ == RunnerJob_Optimizer)
+    {
+        if(success)
+        {
+            finishOptimizerRun();
+        }
+        else
+        {
+            optimizerRunPending_ = false;
+            updateRunButtonState();
+        }
+    }
+    else if(runnerJob_ == RunnerJob_ExportParameters)
+    {
+        if(success) log("Parameters exported.");
+    }
+    else
     {
-        const char *remoteInputFileName = "uploadedinputs.dat";
+        //NOTE: The structure is loaded (if it has to be) on the DataService thread. We continue in handleModelRunFinished.
+        emit requestFinishLocalModelRun(pendingRunRequest_, success);
+    }
+}
+
+void MainWindow::handleModelRunFinished(const ModelRunResult &result)
+{
+    if(result.inputFileWasUploaded) inputFileWasUploaded_ = true;
+    if(result.parameterUploadFailed) remoteParameterDbIsCurrent_ = false;
 
-        QByteArray filename2 = selectedInputFilePath_.toLatin1();
-        bool success = sshInterface_->uploadEntireFile(filename2.data(), "~/", remoteInputFileName);
+    //log("Model run process completed."); //NOTE: This one was just confusing, since it was also printed if there was an error.
 
-        if(success) inputFileWasUploaded_ = true;
+    if(result.success)
+    {
+        //NOTE: A new structure may have given the IDs new meanings, so then nothing in the cache can be trusted. Otherwise the run only
+        // changed the results, and the inputs only if they were generated from a different input file than the cached ones.
+        if(result.structureWasLoaded)
+        {
+            setResultAndInputStructure(result.resultStructure, result.inputStructure);
+            plotter_->clearCache();
+        }
+        else
+        {
+            plotter_->invalidateCache(SeriesDatabase_Results);
+            if(result.inputFilePath != cachedInputFilePath_) plotter_->invalidateCache(SeriesDatabase_Inputs);
+        }
+        cachedInputFilePath_ = result.inputFilePath;
+
+        //NOTE: In case somebody had a graph selected, it is updated with a plot of the data generated from the last run. This is requested
+        // right away instead of through the graphUpdateTimer_, so that it is in the DataService queue before the calibration scoring.
+        graphUpdateTimer_->stop();
+        requestGraphData();
+
+        scoreCalibration();
     }
 
-    const char *ResultDb = "results.db";
-    const char *InputDb  = "inputs.db";
+    modelRunPending_ = false;
+    updateRunButtonState();
+}
 
-    QString exename;
-    projectDb_.setDatabase(selectedParameterDbPath_);
-    projectDb_.getExenameFromParameterInfo(exename);
 
-    qDebug() << "exe name was: " << exename;
+void MainWindow::scoreCalibration()
+{
+    ++calibrationRun_;
 
-    bool success = true;
+    if(calibrationPairs_.empty()) return;
 
-    if(weExpectToBeConnected_)
+    CalibrationRequest request;
+    request.run = calibrationRun_;
+    request.remote = weExpectToBeConnected_;
+    request.projectDirectory = projectDirectory_.path();
+    request.pairs = calibrationPairs_;
+
+    log(QString("Scoring %1 results against their observations.").arg(calibrationPairs_.count()));
+
+    //NOTE: This is queued behind the fetch of the selected graphs that was just requested, so the plots are not held up by it.
+    emit requestCalibration(request);
+}
+
+void MainWindow::handleCalibrationScored(const CalibrationReport &report)
+{
+    if(report.sweepRun >= 0)
     {
-        if(!sshInterface_->isInstanceConnected())
+        handleSweepRunScored(report);
+        return;
+    }
+
+    if(report.run != calibrationRun_ || !report.success) return; //NOTE: Either there has been another run since, or the error was logged already.
+
+    calibrationRows_ = report.rows;
+
+    QStringList columns = calibrationColumnNames();
+    QStringList headers;
+    headers << "Index" << "Series" << columns;
+
+    QTableWidget *table = ui->tableCalibration;
+    table->setSortingEnabled(false); //NOTE: Otherwise the rows are moved around while we fill them in.
+    table->clear();
+    table->setColumnCount(headers.count());
+    table->setHorizontalHeaderLabels(headers);
+    table->setRowCount(calibrationRows_.count());
+
+    for(int row = 0; row < calibrationRows_.count(); ++row)
+    {
+        const CalibrationRow &entry = calibrationRows_[row];
+        table->setItem(row, 0, new QTableWidgetItem(entry.pair.parentName));
+        table->setItem(row, 1, new QTableWidgetItem(entry.pair.name));
+
+        QVector<double> values = calibrationColumnValues(entry.fit);
+        for(int col = 0; col < values.count(); ++col)
         {
-            handleInvoluntarySSHDisconnect();
-            return;
+            QTableWidgetItem *item = new QTableWidgetItem();
+            if(!std::isnan(values[col])) item->setData(Qt::DisplayRole, values[col]); //NOTE: Stored as a number so that the columns sort numerically.
+            table->setItem(row, col + 2, item);
         }
+        if(entry.fit.alignment != Alignment_Ok) table->item(row, 1)->setToolTip("The observed series does not line up with the result in time.");
+    }
 
-        //TODO: Upload the entire parameter database to the instance!
-        const char *remoteParameterDbName = "parameters.db";
+    table->setSortingEnabled(true);
+    table->resizeColumnsToContents();
 
-        QByteArray dbpath = selectedParameterDbPath_.toLatin1();
-        sshInterface_->uploadEntireFile(dbpath.data(), "~/", remoteParameterDbName);
+    ui->pushExportCalibration->setEnabled(!calibrationRows_.empty());
+}
 
+void MainWindow::clearCalibrationReport()
+{
+    ++calibrationRun_; //NOTE: A report that is still being scored is for a structure that is gone.
+    calibrationPairs_.clear();
+    calibrationRows_.clear();
+    ui->tableCalibration->clear();
+    ui->tableCalibration->setRowCount(0);
+    ui->pushExportCalibration->setEnabled(false);
+}
 
-        QByteArray exename2 = exename.toLatin1();
+void MainWindow::on_pushRunSweep_clicked()
+{
+    if(!parameterDbWasSelected_ || !inputFileWasSelected_ || !parameterModel_ || sweep_->isRunning())
+    {
+        //NOTE: This should not be possible. The button should not be active in that case.
+        return;
+    }
 
-        const char *remoteInputFile = "uploadedinputs.dat";
-        sshInterface_->runModel(exename2.data(), remoteInputFile, remoteParameterDbName); //TODO: This one should also report success/error?
+    //NOTE: The parameters to sweep are the ones that are selected in the parameter table.
+    QVector<const Parameter *> parameters;
+    std::set<int> rows;
+    for(const QModelIndex &index : ui->tableViewParameters->selectionModel()->selectedIndexes()) rows.insert(index.row());
+    for(int row : rows)
+    {
+        const Parameter *parameter = parameterModel_->getParameterAtRow(row);
+        if(parameter->type == parametertype_double || parameter->type == parametertype_uint) parameters.push_back(parameter);
+    }
+    if(parameters.empty())
+    {
+        logError("Select the parameters to sweep in the parameter table first. Only decimal and integer parameters can be swept.");
+        return;
+    }
+
+    SweepDialog dialog(parameters, weExpectToBeConnected_, this);
+    if(dialog.exec() != QDialog::Accepted) return;
+
+    if(calibrationPairs_.empty())
+    {
+        log("There are no results with observations to score the sweep runs against yet (run the model once to load them). The runs will not be scored.");
+    }
+
+    on_pushSaveParameters_clicked(); //NOTE: Save the parameters to the database, since every run starts from a copy of it.
+
+    QString exename;
+    projectDb_.setDatabase(selectedParameterDbPath_);
+    projectDb_.getExenameFromParameterInfo(exename);
+
+    QString sweepName = "sweep_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
+    QString directory = projectDirectory_.absoluteFilePath(sweepName); //NOTE: For a remote sweep this is where the parameter databases are prepared.
+
+    QVector<SweepParameter> sweepParameters = dialog.sweepParameters();
+    ++sweepID_;
+    sweepScores_ = QVector<SweepScore>(ParameterSweep::runCount(sweepParameters));
+    sweepScoresPending_ = 0;
+    sweepSummaryWritten_ = false;
+    sweepIsRemote_ = weExpectToBeConnected_;
+
+    //NOTE: The sweep may be over before start returns, if none of the runs could be set up, and then handleSweepFinished resets these.
+    ui->pushRunSweep->setEnabled(false);
+    ui->pushCancelRun->setEnabled(true);
+
+    bool started;
+    if(sweepIsRemote_)
+    {
+        if(inputFileWasSelected_ && !inputFileWasUploaded_) //NOTE: If the input file was selected before we connected it has not been uploaded yet, so we have to do it now.
+        {
+            uploadInputFile();
+        }
+
+        QString program = "/home/magnus/" + exename;
+        started = sweep_->startRemote(program, "$HOME/uploadedinputs.dat", selectedParameterDbPath_, directory, "incaview_runs/" + sweepName,
+                                      sweepParameters, dialog.maxConcurrentRuns());
     }
     else
     {
         //For now, assume the exe is in the same directory as the parameter database.
         QString program = projectDirectory_.absoluteFilePath(exename);
+        started = sweep_->start(program, selectedInputFilePath_, selectedParameterDbPath_, directory, sweepParameters, dialog.maxConcurrentRuns());
+    }
 
-        //TODO: Deleting the previous inputs and results db may not be that clean, but we don't have any system for managing it properly yet, so not deleting them causes errors.
-        QString resultpath = projectDirectory_.absoluteFilePath(ResultDb);
-        QFile::remove(resultpath);
-        QString inputpath = projectDirectory_.absoluteFilePath(InputDb);
-        QFile::remove(inputpath);
+    if(!started)
+    {
+        sweepSummaryWritten_ = true;
+        updateCancelButtonState();
+        updateRunButtonState();
+    }
+}
 
-        qDebug() << "trying to run program " << program;
+void MainWindow::handleSweepRunFinished(int index, bool success)
+{
+    int done = 0;
+    for(const SweepRun &run : sweep_->runs()) if(run.finished) ++done;
+    ui->statusBar->showMessage(QString("Sweep: %1 of %2 runs done").arg(done).arg(sweep_->runs().count()));
 
-        QStringList arguments;
-        arguments << "run" << selectedInputFilePath_ << selectedParameterDbPath_;
+    if(!success)
+    {
+        logError(QString("Sweep run %1 failed.").arg(index));
+        return;
+    }
+
+    if(calibrationPairs_.empty()) return;
 
-        success = runModelProcessLocally(program, arguments);
+    //NOTE: The runs are assumed to produce the same result and input structure as the one that is loaded, since only parameter values differ.
+    CalibrationRequest request;
+    request.run = sweepID_;
+    request.remote = sweepIsRemote_;
+    request.projectDirectory = sweep_->runs()[index].directory;
+    request.remoteDirectory = sweep_->runs()[index].remoteDirectory;
+    request.pairs = calibrationPairs_;
+    request.sweepRun = index;
+    request.closeDatabases = !sweepIsRemote_;
+
+    ++sweepScoresPending_;
+    emit requestCalibration(request);
+}
+
+void MainWindow::handleSweepFinished(bool cancelled)
+{
+    ui->statusBar->clearMessage();
+    updateCancelButtonState();
+    updateRunButtonState();
+
+    if(cancelled) log("The sweep was cancelled.");
+    else          log("All the sweep runs have completed.");
+
+    writeSweepSummaryIfDone();
+}
+
+void MainWindow::handleRemoteJobFinished(quint64 batch, int index, bool success)
+{
+    if(batch == sweepBatch_)          sweep_->handleRemoteJobFinished(index, success);
+    else if(batch == optimizerBatch_) optimizerJobSucceeded_ = success;
+}
+
+void MainWindow::handleRemoteJobsFinished(quint64 batch, bool cancelled)
+{
+    if(batch == sweepBatch_)
+    {
+        sweepBatch_ = 0;
+        sweep_->handleRemoteJobsFinished(cancelled);
     }
+    else if(batch == optimizerBatch_)
+    {
+        optimizerBatch_ = 0;
+        updateCancelButtonState();
+        if(cancelled) log("The run was cancelled.");
 
-    //log("Model run process completed."); //NOTE: This one was just confusing, since it was also printed if there was an error.
+        //NOTE: The optimized parameters are loaded the same way as after a local optimizer run, once they are downloaded. We continue in
+        // handleFileDownloaded.
+        if(optimizerJobSucceeded_ && !cancelled)
+        {
+            projectDb_.closeDatabase(projectDirectory_.filePath("optimized_parameters.db"));
+            emit requestDownload("incaview_runs/optimizer/optimized_parameters.db", projectDirectory_.filePath("optimized_parameters.db"));
+        }
+        else
+        {
+            if(!cancelled) logError("The optimizer did not finish successfully on the instance.");
+            optimizerRunPending_ = false;
+            updateRunButtonState();
+        }
+    }
+}
+
+void MainWindow::handleFileDownloaded(const QString &localPath, bool success)
+{
+    if(localPath != projectDirectory_.filePath("optimized_parameters.db")) return;
 
     if(success)
     {
-        //TODO: We should do a more rigorous check here. If e.g. the user has switched out the input file between runs then the tree structure may no longer be valid and should be recreated.
-        if(!treeResults_)
-            loadResultAndInputStructure(ResultDb, InputDb);
+        finishOptimizerRun();
+    }
+    else
+    {
+        logError("Unable to download the optimized parameters from the instance.");
+        optimizerRunPending_ = false;
+        updateRunButtonState();
+    }
+}
 
-        plotter_->clearCache();
+void MainWindow::handleSweepRunScored(const CalibrationReport &report)
+{
+    if(report.run != sweepID_) return; //NOTE: From an earlier sweep.
 
-        updateGraphsAndResultSummary(); //In case somebody had a graph selected, it is updated with a plot of the data generated from the last run.
-    }
+    --sweepScoresPending_;
+    if(report.success) sweepScores_[report.sweepRun] = summarizeSweepRun(report.rows);
 
-    ui->pushRun->setEnabled(true);
+    writeSweepSummaryIfDone();
 }
 
+void MainWindow::writeSweepSummaryIfDone()
+{
+    if(sweepSummaryWritten_ || sweep_->isRunning() || sweepScoresPending_ > 0) return;
+    sweepSummaryWritten_ = true;
+
+    QString path = QDir(sweep_->directory()).absoluteFilePath("sweep_summary.csv");
+    if(!writeSweepSummary(path, *sweep_, sweepScores_))
+    {
+        logError("Unable to write the sweep summary to " + path);
+        return;
+    }
+    log("The sweep summary was written to " + path);
+
+    int best = -1;
+    for(int idx = 0; idx < sweepScores_.count(); ++idx)
+    {
+        const SweepScore &score = sweepScores_[idx];
+        if(score.pairCount > 0 && (best < 0 || score.meanNashSutcliffe > sweepScores_[best].meanNashSutcliffe)) best = idx;
+    }
+    if(best >= 0)
+    {
+        log(QString("The best run by mean Nash-Sutcliffe was run %1 (%2), in ").arg(best).arg(sweepScores_[best].meanNashSutcliffe)
+            + sweep_->runs()[best].directory);
+    }
+}
 
 void MainWindow::closeEvent (QCloseEvent *event)
 {
@@ -915,14 +1313,10 @@ void MainWindow::closeEvent (QCloseEvent *event)
         if (resBtn != QMessageBox::Yes) {
             event->ignore();
         } else {
-            bool success = sshInterface_->destroyInstance(); //TODO: If we were not successful destroying the instance, what do we do?
             event->accept();
         }
     }
-    else
-    {
-        bool success = sshInterface_->destroyInstance(); //TODO: If we were not successful destroying the instance, what do we do?
-    }
+    //NOTE: The instance is given back in the destructor, once the DataService is done with the session.
 }
 
 void MainWindow::updateParameterView(const QItemSelection& selected, const QItemSelection& deselected)
@@ -941,40 +1335,10 @@ void MainWindow::updateParameterView(const QItemSelection& selected, const QItem
     }
 }
 
-bool MainWindow::getDataSets(const char *dbname, const QVector<int> &IDs, const char *table, QVector<QVector<double>> &seriesout, QVector<int64_t> &startdatesout)
+void MainWindow::collectSelectedIDs(QVector<int> &resultIDs, QVector<int> &inputIDs, QVector<QString> &names)
 {
-    if(weExpectToBeConnected_)
-    {
-        if(!sshInterface_->isInstanceConnected())
-        {
-            handleInvoluntarySSHDisconnect();
-            return false;
-        }
-
-        return sshInterface_->getDataSets(dbname, IDs, table, seriesout, startdatesout);
-    }
-    else
-    {
-        QString dbpath = projectDirectory_.absoluteFilePath(dbname);
-        projectDb_.setDatabase(dbpath);
-        return projectDb_.getResultOrInputValues(table, IDs, seriesout, startdatesout);
-    }
-}
-
-
-void MainWindow::updateGraphsAndResultSummary()
-{
-    if(!treeResults_ || !treeInputs_)
-    {
-        clearGraphsAndResultSummary();
-        return;
-    }
-
     QModelIndexList resultindexes = ui->treeViewResults->selectionModel()->selectedIndexes();
 
-    QVector<QString> names;
-
-    QVector<int> resultIDs;
     for(auto index : resultindexes)
     {
         if(index.column() == 0)
@@ -994,7 +1358,6 @@ void MainWindow::updateGraphsAndResultSummary()
 
     QModelIndexList inputindexes = ui->treeViewInputs->selectionModel()->selectedIndexes();
 
-    QVector<int> inputIDs;
     for(auto index : inputindexes)
     {
         auto idx = index.model()->index(index.row(), index.column() + 1, index.parent());
@@ -1008,67 +1371,214 @@ void MainWindow::updateGraphsAndResultSummary()
             names.push_back(name + " (" + parentName + ") " + unit);
         }
     }
+}
 
-    if(!resultIDs.empty() || !inputIDs.empty())
+void MainWindow::updateGraphsAndResultSummary()
+{
+    //NOTE: Selection changes tend to come in bursts when the user clicks or drags through the trees. We wait until they have settled down
+    // before fetching anything, so that we only fetch what ends up being selected.
+    graphUpdateTimer_->start();
+}
+
+void MainWindow::requestGraphData()
+{
+    if(!treeResults_ || !treeInputs_)
     {
-        QVector<int> uncachedResultIDs;
-        plotter_->filterUncachedIDs(resultIDs, uncachedResultIDs);
+        clearGraphsAndResultSummary();
+        return;
+    }
+
+    QVector<int> resultIDs;
+    QVector<int> inputIDs;
+    QVector<QString> names;
+    collectSelectedIDs(resultIDs, inputIDs, names);
+
+    //NOTE: Whatever was requested before this is not going to be plotted, so the DataService can skip it if it has not started on it yet.
+    ++fetchGeneration_;
+    dataService_->cancelFetchesBefore(fetchGeneration_);
 
-        bool success = true;
-        if(!uncachedResultIDs.empty())
+    QVector<int> uncachedResultIDs;
+    plotter_->filterUncachedIDs(resultIDs, uncachedResultIDs);
+    QVector<int> uncachedInputIDs;
+    plotter_->filterUncachedIDs(inputIDs, uncachedInputIDs);
+
+    //NOTE: Series that are already on their way in a prefetch are not requested again. We come back here when the prefetch arrives.
+    waitingForPrefetch_ = false;
+    auto removePrefetched = [this](QVector<int> &IDs)
+    {
+        for(int idx = IDs.count() - 1; idx >= 0; --idx)
         {
-            //TODO: Formalize the paths to the databases in some way so that they are not just scattered around in the code.
-            const char *resultdb = "results.db";
-            QVector<QVector<double>> resultsets;
-            QVector<int64_t> startDates;
-            success = getDataSets(resultdb, uncachedResultIDs, "Results", resultsets, startDates);
-            plotter_->addToCache(uncachedResultIDs, resultsets, startDates);
+            if(prefetchInFlight_.count(IDs[idx]))
+            {
+                IDs.remove(idx);
+                waitingForPrefetch_ = true;
+            }
         }
+    };
+    removePrefetched(uncachedResultIDs);
+    removePrefetched(uncachedInputIDs);
 
-        QVector<int> uncachedInputIDs;
-        plotter_->filterUncachedIDs(inputIDs, uncachedInputIDs);
+    fetchInFlight_.clear();
+    fetchInFlight_.insert(uncachedResultIDs.begin(), uncachedResultIDs.end());
+    fetchInFlight_.insert(uncachedInputIDs.begin(), uncachedInputIDs.end());
 
-        if(!uncachedInputIDs.empty())
-        {
-            for(int &ID : uncachedInputIDs) ID -= maxresultID_; //NOTE: remap the input IDs back so that we can use them to request from the database.
+    if(uncachedResultIDs.empty() && uncachedInputIDs.empty())
+    {
+        if(!waitingForPrefetch_) plotSelectedGraphs();
+        prefetchNeighbours(resultIDs, inputIDs);
+        return;
+    }
 
-            //TODO: Formalize the paths to the remote databases in some way so that they are not just scattered around in the code.
-            const char *inputdb = "inputs.db";
-            QVector<QVector<double>> inputsets;
-            QVector<int64_t> startDates;
-            success = getDataSets(inputdb, uncachedInputIDs, "Inputs", inputsets, startDates);
+    SeriesRequest request;
+    request.generation = fetchGeneration_;
+    request.resultsGeneration = plotter_->cacheGeneration(SeriesDatabase_Results);
+    request.inputsGeneration = plotter_->cacheGeneration(SeriesDatabase_Inputs);
+    request.remote = weExpectToBeConnected_;
+    request.projectDirectory = projectDirectory_.path();
+    request.resultIDs = uncachedResultIDs;
+    for(int ID : uncachedInputIDs) request.inputIDs.push_back(ID - maxresultID_); //NOTE: remap the input IDs back so that we can use them to request from the database.
+    request.inputIDOffset = maxresultID_;
 
-            for(int &ID : uncachedInputIDs) ID += maxresultID_; //NOTE: map them back AGAIN because we now talk to the internal system.
+    emit requestSeries(request);
 
-            plotter_->addToCache(uncachedInputIDs, inputsets, startDates);
-        }
+    //NOTE: The DataService works on one request at a time, so the prefetch does not delay the series that were actually selected.
+    prefetchNeighbours(resultIDs, inputIDs);
+}
 
-        //NOTE: For now we don't have a individual start date for each time series. Instead, we just get one. And we assume that the start date for the result data
-        // is the same as the one for the input data. That is how the models work currently too (as of 24.09.2018).
+void MainWindow::prefetchNeighbours(const QVector<int> &resultIDs, const QVector<int> &inputIDs)
+{
+    //NOTE: The last ID in the selection is usually the one that was just clicked.
+    QVector<int> candidates;
+    if(!resultIDs.empty()) candidates += treeResults_->getNeighbourLeafIDs(resultIDs.last());
+    if(!inputIDs.empty())  candidates += treeInputs_->getNeighbourLeafIDs(inputIDs.last());
 
-        if(success)
-        {
-            PlotMode mode = PlotMode_Daily;
-            if(ui->radioButtonMonthlyAverages->isChecked()) mode = PlotMode_MonthlyAverages;
-            else if(ui->radioButtonDailyNormalized->isChecked()) mode = PlotMode_DailyNormalized;
-            else if(ui->radioButtonYearlyAverages->isChecked()) mode = PlotMode_YearlyAverages;
-            else if(ui->radioButtonErrors->isChecked()) mode = PlotMode_Error;
-            else if(ui->radioButtonErrorHistogram->isChecked()) mode = PlotMode_ErrorHistogram;
-            else if(ui->radioButtonErrorNormalProbability->isChecked()) mode = PlotMode_ErrorNormalProbability;
+    prefetchSeries(candidates);
+}
+
+void MainWindow::prefetchExpandedResults(const QModelIndex &index)
+{
+    if(!treeResults_) return;
+    prefetchSeries(treeResults_->getChildLeafIDs(treeResults_->getID(index)));
+}
+
+void MainWindow::prefetchExpandedInputs(const QModelIndex &index)
+{
+    if(!treeInputs_) return;
+    prefetchSeries(treeInputs_->getChildLeafIDs(treeInputs_->getID(index)));
+}
 
-            QVector<int> IDs;
-            IDs.append(resultIDs);
-            IDs.append(inputIDs);
+void MainWindow::prefetchSeries(const QVector<int> &IDs)
+{
+    //NOTE: We only allow one prefetch at a time, so that speculative fetches can not pile up in the DataService queue in front of the
+    // ones for what the user actually selected.
+    if(!prefetchInFlight_.empty()) return;
 
+    //NOTE: Expanding a large node should not pull in the entire database.
+    const int maxPrefetchCount = 32;
 
-            QVector<bool> scatter;
-            for(int i = 0; i < resultIDs.size(); ++i) scatter << false;
-            for(int i = 0; i < inputIDs.size(); ++i) scatter << ui->checkBoxScatterInputs->isChecked();
+    SeriesRequest request;
+    request.generation = fetchGeneration_;
+    request.resultsGeneration = plotter_->cacheGeneration(SeriesDatabase_Results);
+    request.inputsGeneration = plotter_->cacheGeneration(SeriesDatabase_Inputs);
+    request.prefetch = true;
+    request.remote = weExpectToBeConnected_;
+    request.projectDirectory = projectDirectory_.path();
+    request.inputIDOffset = maxresultID_;
 
-            bool logarithimicY = ui->checkBoxLogarithmicPlot->isChecked();
-            plotter_->plotGraphs(IDs, names, mode, scatter, logarithimicY);
+    for(int ID : IDs)
+    {
+        if((int)prefetchInFlight_.size() == maxPrefetchCount) break;
+        if(plotter_->findCached(ID) || prefetchInFlight_.count(ID) || fetchInFlight_.count(ID)) continue;
+
+        if(ID <= maxresultID_) request.resultIDs.push_back(ID);
+        else                   request.inputIDs.push_back(ID - maxresultID_);
+        prefetchInFlight_.insert(ID);
+    }
+
+    if(prefetchInFlight_.empty()) return;
+
+    emit requestSeries(request);
+}
+
+void MainWindow::handleSeriesReady(const SeriesResult &result)
+{
+    //NOTE: Data for a selection that is no longer current is still worth caching, but we only plot if it is for the current one. The cache
+    // itself drops series from a database that has been invalidated since they were requested, e.g. results from before the last model run.
+    if(!result.IDs.empty()) plotter_->addToCache(result.IDs, result.series, result.startDates, result.timesteps, result.resultsGeneration, result.inputsGeneration);
+
+    if(result.prefetch)
+    {
+        prefetchInFlight_.clear();
+        if(waitingForPrefetch_)
+        {
+            //NOTE: If the selection also needs series from a fetch of its own that has not arrived yet, it is plotted when that does.
+            if(fetchInFlight_.empty()) requestGraphData();
+            else waitingForPrefetch_ = false;
         }
     }
+    else if(result.generation == fetchGeneration_)
+    {
+        fetchInFlight_.clear();
+        //NOTE: If some of the selection is still on its way in a prefetch, it is plotted when that arrives, so that it is not first drawn
+        // without those series and then again with them.
+        if(!waitingForPrefetch_) plotSelectedGraphs();
+    }
+}
+
+void MainWindow::handleSeriesFailed(quint64 generation, bool prefetch)
+{
+    if(prefetch)
+    {
+        //NOTE: If the selection was waiting for this, it fetches what it needs itself now.
+        prefetchInFlight_.clear();
+        if(waitingForPrefetch_) requestGraphData();
+        return;
+    }
+
+    //NOTE: The reason was already logged by whoever failed. We don't want to leave up graphs for a selection that is no longer current.
+    if(generation == fetchGeneration_)
+    {
+        fetchInFlight_.clear();
+        plotter_->clearPlots();
+        updateGraphToolTip(nullptr);
+    }
+}
+
+void MainWindow::plotSelectedGraphs()
+{
+    if(!treeResults_ || !treeInputs_)
+    {
+        clearGraphsAndResultSummary();
+        return;
+    }
+
+    QVector<int> resultIDs;
+    QVector<int> inputIDs;
+    QVector<QString> names;
+    collectSelectedIDs(resultIDs, inputIDs, names);
+
+    if(!resultIDs.empty() || !inputIDs.empty())
+    {
+        PlotMode mode = PlotMode_Daily;
+        if(ui->radioButtonMonthlyAverages->isChecked()) mode = PlotMode_MonthlyAverages;
+        else if(ui->radioButtonDailyNormalized->isChecked()) mode = PlotMode_DailyNormalized;
+        else if(ui->radioButtonYearlyAverages->isChecked()) mode = PlotMode_YearlyAverages;
+        else if(ui->radioButtonErrors->isChecked()) mode = PlotMode_Error;
+        else if(ui->radioButtonErrorHistogram->isChecked()) mode = PlotMode_ErrorHistogram;
+        else if(ui->radioButtonErrorNormalProbability->isChecked()) mode = PlotMode_ErrorNormalProbability;
+
+        QVector<int> IDs;
+        IDs.append(resultIDs);
+        IDs.append(inputIDs);
+
+
+        QVector<bool> scatter;
+        for(int i = 0; i < resultIDs.size(); ++i) scatter << false;
+        for(int i = 0; i < inputIDs.size(); ++i) scatter << ui->checkBoxScatterInputs->isChecked();
+
+        bool logarithimicY = ui->checkBoxLogarithmicPlot->isChecked();
+        plotter_->plotGraphs(IDs, names, mode, scatter, logarithimicY);
+    }
     else
     {
         plotter_->clearPlots();
@@ -1093,13 +1603,13 @@ void MainWindow::updateGraphToolTip(QMouseEvent *event)
         bool first = true;
         for(int i = 0; i < ui->widgetPlotResults->graphCount(); ++i)
         {
-            int ID = plotter_->currentPlottedIDs_[i];
-
             if(first) first = false;
             else valueString.append("\n");
 
             QCPGraph *graph = ui->widgetPlotResults->graph(i);
-            double value = graph->data()->findBegin(x)->value;
+            int ID;
+            const QCPGraphDataContainer *data = plotter_->graphData(graph, ID);
+            double value = data->findBegin(x)->value;
 
             if(ui->radioButtonErrors->isChecked())
             {
@@ -1179,14 +1689,17 @@ void MainWindow::on_pushExportResults_clicked()
         return;
     }
 
+    QString columnarFilter = tr("Columnar binary files (*.incv)");
+    QString selectedFilter;
     QString saveResultsPath = QFileDialog::getSaveFileName(this,
-                tr("Select file to save results"), "", tr("Data files (*.csv)"));
+                tr("Select file to save results"), "", tr("Data files (*.csv)") + ";;" + columnarFilter, &selectedFilter);
 
     if(saveResultsPath.isEmpty() || saveResultsPath.isNull()) return; //NOTE: In case the user clicked cancel or closed the dialog.
 
     QModelIndexList resultindexes = ui->treeViewResults->selectionModel()->selectedIndexes();
 
     QVector<QString> names;
+    QVector<QString> units;
 
     QVector<int> resultIDs;
     for(auto index : resultindexes)
@@ -1201,61 +1714,54 @@ void MainWindow::on_pushExportResults_clicked()
                 QString name = treeResults_->getName(ID);
                 QString parentName = treeResults_->getParentName(ID);
                 names.push_back(name + " (" + parentName + ")"); //TODO: We should get all the indexes here, not just the immediate one.
+                units.push_back(treeResults_->getUnit(ID));
             }
         }
     }
 
     if(resultIDs.empty()) return;
 
-    std::ofstream file(saveResultsPath.toLatin1().data());
-    if(!file.is_open())
-    {
-        logError(QString("Unable to open file ") + saveResultsPath);
-    }
+    //NOTE: The series are read from the database on the DataService thread, so that exporting many long series neither freezes the GUI nor
+    // needs them to have been plotted first.
+    ExportRequest request;
+    request.remote = weExpectToBeConnected_;
+    request.projectDirectory = projectDirectory_.path();
+    request.path = saveResultsPath;
+    request.format = (selectedFilter == columnarFilter || saveResultsPath.endsWith(".incv", Qt::CaseInsensitive)) ? ExportFormat_Columnar : ExportFormat_CSV;
+    request.resultIDs = resultIDs;
+    request.names = names;
+    request.units = units;
 
-    //NOTE: Since these IDs have been clicked, we can assume that their timeseries have been loaded into the plotter.
-    //NOTE: For result series it is safe to assume that they all have the same length.
-    int seriesCount = resultIDs.count();
-    QVector<QVector<double>*> resultSeries(seriesCount);
-    file << "\"date\",";
-    for(size_t idx = 0; idx < seriesCount; ++idx)
-    {
-        resultSeries[idx] = &plotter_->cache_[resultIDs[idx]];
+    log(QString("Exporting %1 results to ").arg(resultIDs.count()) + saveResultsPath);
 
-        file << "\"" << names[idx].toLatin1().data() << "\"";
-        if(idx < seriesCount - 1) file << ",";
-    }
-    file << std::endl;
-
-    int stepcount = resultSeries[0]->count();
+    emit requestExport(request);
+}
 
-    int64_t date = plotter_->startDateCache_[resultIDs[0]]; //NOTE: We are assuming that all result series start at the same date.
+void MainWindow::handleExportFinished(const QString &path, bool success)
+{
+    if(success) log("Results exported to " + path);
+    //NOTE: Otherwise the DataService has logged what went wrong.
+}
 
-    for(int t = 0; t < stepcount; ++t)
-    {
-        QDateTime workingdate = QDateTime::fromSecsSinceEpoch(date, Qt::OffsetFromUTC, 0);
-        file << workingdate.toString("yyyy-MM-dd").toStdString() << ",";
-        date += 86400;
+void MainWindow::on_pushExportCalibration_clicked()
+{
+    if(calibrationRows_.empty()) return;
 
-        for(int idx = 0; idx < seriesCount; ++idx)
-        {
-            file << resultSeries[idx]->at(t);
-            if(idx < seriesCount - 1) file << ",";
-        }
-        file << std::endl;
-    }
+    QString savePath = QFileDialog::getSaveFileName(this,
+                tr("Select file to save the calibration report"), "", tr("Data files (*.csv)"));
 
-    log("Results exported to " + saveResultsPath);
+    if(savePath.isEmpty() || savePath.isNull()) return; //NOTE: In case the user clicked cancel or closed the dialog.
 
-    file.close();
+    if(writeCalibrationReport(savePath, calibrationRows_)) log("Calibration report exported to " + savePath);
+    else                                                  logError(QString("Unable to write the calibration report to ") + savePath);
 }
 
-
 void MainWindow::clearGraphsAndResultSummary()
 {
     plotter_->clearPlots();
     plotter_->clearCache();
     updateGraphToolTip(nullptr);
+    clearCalibrationReport();
 }
 
 
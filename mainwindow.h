@@ -15,6 +15,13 @@
 #include <QLabel>
 #include "plotter.h"
 #include "sqlinterface.h"
+#include "dataservice.h"
+#include "modelrunner.h"
+#include "parametersweep.h"
+#include <QThread>
+#include <QTimer>
+#include <set>
+#include <map>
 
 
 namespace Ui {
@@ -41,6 +48,9 @@ private slots:
     void on_pushUploadInputs_clicked();
     void on_pushExportParameters_clicked();
     void on_pushExportResults_clicked();
+    void on_pushExportCalibration_clicked();
+    void on_pushCancelRun_clicked();
+    void on_pushRunSweep_clicked();
     void closeEvent (QCloseEvent *);
 
     void updateParameterView(const QItemSelection &, const QItemSelection &);
@@ -58,26 +68,70 @@ private slots:
 
     void log(const QString &);
     void logError(const QString &);
-    void logSSHError(const QString&);
 
     void on_widgetPlotResults_windowTitleChanged(const QString &title);
 
+    void requestGraphData();
+    void handleSeriesReady(const SeriesResult &result);
+    void handleSeriesFailed(quint64 generation, bool prefetch);
+    void prefetchExpandedResults(const QModelIndex &index);
+    void prefetchExpandedInputs(const QModelIndex &index);
+    void handleLocalModelRunReady(const ModelRunRequest &request, const QString &program, const QStringList &arguments);
+    void handleModelRunnerFinished(bool success, bool cancelled);
+    void showRunProgress(qint64 elapsedMilliseconds, int percent);
+    void handleModelRunFinished(const ModelRunResult &result);
+    void handleCalibrationScored(const CalibrationReport &report);
+    void handleExportFinished(const QString &path, bool success);
+    void handleSweepRunFinished(int index, bool success);
+    void handleSweepFinished(bool cancelled);
+    void handleRemoteJobFinished(quint64 batch, int index, bool success);
+    void handleRemoteJobsFinished(quint64 batch, bool cancelled);
+    void handleInstanceConnected(bool success);
+    void handleInputFileUploaded(const QString &path, bool success);
+    void handleFileDownloaded(const QString &localPath, bool success);
+    void handleParameterDatabaseCreated(const QString &databasePath, bool success);
+    void handleParametersExported(const QString &exportPath, bool parameterDbWasUploaded, bool success);
+
+signals:
+    void requestSeries(const SeriesRequest &request);
+    void requestModelRun(const ModelRunRequest &request);
+    void requestFinishLocalModelRun(const ModelRunRequest &request, bool success);
+    void requestCalibration(const CalibrationRequest &request);
+    void requestExport(const ExportRequest &request);
+    void requestRemoteJobs(const RemoteJobRequest &request);
+    void requestCancelRemoteJobs();
+    void requestConnectInstance(const QString &username);
+    void requestReleaseInstance();
+    void requestInputUpload(const QString &path);
+    void requestDownload(const QString &remotePath, const QString &localPath);
+    void requestCreateParameterDatabase(const QString &exename, const QString &parameterFilePath, const QString &databasePath);
+    void requestExportParameters(const QString &exename, const QString &parameterDbPath, const QString &exportPath);
+
 private:
     void setParametersHaveBeenEditedSinceLastSave(bool);
-    bool runModelProcessLocally(const QString& program, const QStringList& arguments);
     void runModel();
+    void finishOptimizerRun();
+    void uploadInputFile();
     void setWeExpectToBeConnected(bool);
 
     void loadParameterDatabase(QString fileName);
 
-    bool getDataSets(const char *dbname, const QVector<int> &IDs, const char *table, QVector<QVector<double>> &seriesout, QVector<int64_t> &startdatesout);
+    void collectSelectedIDs(QVector<int> &resultIDs, QVector<int> &inputIDs, QVector<QString> &names);
+    void plotSelectedGraphs();
+    void prefetchNeighbours(const QVector<int> &resultIDs, const QVector<int> &inputIDs);
+    void prefetchSeries(const QVector<int> &IDs);
+    void scoreCalibration();
+    void clearCalibrationReport();
+    void handleSweepRunScored(const CalibrationReport &report);
+    void writeSweepSummaryIfDone();
 
     void loadParameterData();
-    void loadResultAndInputStructure(const char *remoteResultDb, const char *RemoteInputDb);
+    void setResultAndInputStructure(const QVector<TreeData> &resultstreedata, const QVector<TreeData> &inputtreedata);
 
     void resetWindowTitle();
 
     void updateRunButtonState();
+    void updateCancelButtonState();
 
     Ui::MainWindow *ui;
 
@@ -104,11 +158,52 @@ private:
     SSHInterface *sshInterface_;
     SQLInterface projectDb_;
 
+    QThread dataThread_;
+    DataService *dataService_;
+    QTimer *graphUpdateTimer_;
+
+    ModelRunner *modelRunner_;
+    enum RunnerJob
+    {
+        RunnerJob_Model,
+        RunnerJob_Optimizer,
+        RunnerJob_ExportParameters,
+    };
+    RunnerJob runnerJob_ = RunnerJob_Model; //NOTE: What the modelRunner_ is (or was last) running.
+    ModelRunRequest pendingRunRequest_;     //NOTE: The local run that the modelRunner_ is doing, if it is doing one for runModel.
+    bool modelRunPending_ = false;     //NOTE: From runModel until handleModelRunFinished.
+    bool optimizerRunPending_ = false; //NOTE: From on_pushRunOptimizer_clicked until the optimized parameters have been loaded, or it failed.
+    quint64 fetchGeneration_ = 0; //NOTE: Increased every time the selection is fetched, so that answers to older fetches can be recognized.
+    std::set<int> prefetchInFlight_; //NOTE: The IDs of the prefetch that has been sent to the DataService and not answered yet, if any.
+    bool waitingForPrefetch_ = false; //NOTE: The current selection needs series from the prefetch that is in flight.
+    std::set<int> fetchInFlight_; //NOTE: The IDs of the fetch for the current selection, until it is answered.
+
     int maxresultID_ = 0;
 
     bool inputFileWasSelected_ = false;
     bool inputFileWasUploaded_ = false;
+    //NOTE: Whether the parameters.db on the instance has the values of the selected parameter database, apart from the ones that were saved
+    // since, which are kept here (by ID) to be sent before the next remote run.
+    bool remoteParameterDbIsCurrent_ = false;
+    std::map<uint32_t, parameter_serial_entry> parametersChangedSinceUpload_;
     QString selectedInputFilePath_;
+    QString cachedInputFilePath_; //NOTE: The input file that the inputs database was last generated from.
+
+    QVector<CalibrationPair> calibrationPairs_; //NOTE: Found when the structure is loaded. The input IDs are database IDs.
+    QVector<CalibrationRow> calibrationRows_;   //NOTE: The report of the last run, as shown in the calibration tab.
+    quint64 calibrationRun_ = 0;
+
+    ParameterSweep *sweep_;
+    quint64 sweepID_ = 0;            //NOTE: Increased for every sweep, so that scores for the runs of an older sweep can be recognized.
+    QVector<SweepScore> sweepScores_; //NOTE: One per run of the current sweep.
+    int sweepScoresPending_ = 0;     //NOTE: Runs that have been sent to the DataService for scoring and not answered yet.
+    bool sweepSummaryWritten_ = true;
+    bool sweepIsRemote_ = false;
+
+    quint64 remoteBatch_ = 0;        //NOTE: Increased for every batch of jobs that is sent to the instance.
+    quint64 sweepBatch_ = 0;         //NOTE: The batch of the current remote sweep, if any.
+    quint64 optimizerBatch_ = 0;     //NOTE: The batch of the current remote optimizer run, if any.
+    bool optimizerJobSucceeded_ = false;
 };
 
 
@@ -0,0 +1,99 @@
+#include "minmaxpyramid.h"
+#include <cmath>
+#include <limits>
+
+void MinMaxPyramid::build(const QCPGraphDataContainer &data)
+{
+    levels_.clear();
+
+    int count = data.size();
+    if(count <= branching_) return;
+
+    //NOTE: The lowest level is made from the points, and every level after that from the one below it.
+    QVector<Bucket> level((count + branching_ - 1) / branching_);
+    auto it = data.constBegin();
+    for(int b = 0; b < level.count(); ++b)
+    {
+        Bucket &bucket = level[b];
+        bucket.min = std::numeric_limits<double>::infinity();
+        bucket.max = -std::numeric_limits<double>::infinity();
+        bucket.minIndex = -1;
+        bucket.maxIndex = -1;
+
+        int end = std::min((b + 1)*branching_, count);
+        for(int idx = b*branching_; idx < end; ++idx, ++it)
+        {
+            double value = it->value;
+            if(std::isnan(value)) continue;
+            if(value < bucket.min) { bucket.min = value; bucket.minIndex = idx; }
+            if(value > bucket.max) { bucket.max = value; bucket.maxIndex = idx; }
+        }
+    }
+    levels_.push_back(level);
+
+    while(levels_.last().count() > 1)
+    {
+        const QVector<Bucket> &below = levels_.last();
+        QVector<Bucket> above((below.count() + branching_ - 1) / branching_);
+        for(int b = 0; b < above.count(); ++b)
+        {
+            Bucket &bucket = above[b];
+            bucket = below[b*branching_];
+
+            int end = std::min((b + 1)*branching_, below.count());
+            for(int idx = b*branching_ + 1; idx < end; ++idx)
+            {
+                const Bucket &other = below[idx];
+                if(other.minIndex < 0) continue;
+                if(bucket.minIndex < 0 || other.min < bucket.min) { bucket.min = other.min; bucket.minIndex = other.minIndex; }
+                if(bucket.maxIndex < 0 || other.max > bucket.max) { bucket.max = other.max; bucket.maxIndex = other.maxIndex; }
+            }
+        }
+        levels_.push_back(above);
+    }
+}
+
+bool MinMaxPyramid::decimate(const QCPGraphDataContainer &data, const QCPRange &range, int maxBuckets, QVector<QCPGraphData> &out) const
+{
+    out.clear();
+    if(levels_.empty() || maxBuckets <= 0) return false;
+
+    //NOTE: One point on each side outside of the range, so that the lines going off the edges of the plot are still drawn.
+    int first = (int)(data.findBegin(range.lower, true) - data.constBegin());
+    int last  = (int)(data.findEnd(range.upper, true) - data.constBegin()); //NOTE: One past the end.
+    int visible = last - first;
+    if(visible <= 2*maxBuckets) return false;
+
+    //NOTE: The coarsest level that still has at least half of maxBuckets buckets in the range. With a branching of 4 that gives between
+    // maxBuckets/2 and 2*maxBuckets buckets.
+    int level = 0;
+    int bucketSize = branching_;
+    while(level + 1 < levels_.count() && visible / (bucketSize*branching_) >= maxBuckets/2)
+    {
+        ++level;
+        bucketSize *= branching_;
+    }
+
+    const QVector<Bucket> &buckets = levels_[level];
+    int firstBucket = first / bucketSize;
+    int lastBucket = std::min((last + bucketSize - 1) / bucketSize, buckets.count());
+
+    out.reserve(2*(lastBucket - firstBucket));
+    for(int b = firstBucket; b < lastBucket; ++b)
+    {
+        const Bucket &bucket = buckets[b];
+        if(bucket.minIndex < 0)
+        {
+            //NOTE: Keep the gap.
+            out.push_back(QCPGraphData(data.at(b*bucketSize)->key, std::numeric_limits<double>::quiet_NaN()));
+            continue;
+        }
+
+        int lo = std::min(bucket.minIndex, bucket.maxIndex);
+        int hi = std::max(bucket.minIndex, bucket.maxIndex);
+        out.push_back(*data.at(lo));
+        if(hi != lo) out.push_back(*data.at(hi));
+    }
+
+    return true;
+}
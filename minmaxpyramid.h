@@ -0,0 +1,37 @@
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include "qcustomplot.h"
+#include <QVector>
+
+//NOTE: Level of detail for long graphs. QCustomPlot goes through every point of a graph's data on every replot, which gets slow with many
+// series that are decades of daily values each, even though at most a couple of points per horizontal pixel can be seen. The pyramid
+// stores the minimum and maximum of buckets of 4, 16, 64, ... consecutive points, so that for any visible range we can hand QCustomPlot
+// the envelope of the data (the min and the max of each bucket, in the order they occur) at about the resolution of the screen. Since the
+// extremes are kept, spikes do not disappear when zoomed out.
+class MinMaxPyramid
+{
+public:
+    void build(const QCPGraphDataContainer &data);
+    void clear() { levels_.clear(); }
+
+    //NOTE: Fills out with the envelope of the points of data that fall in range, using buckets small enough that there are about maxBuckets
+    // of them in the range. Returns false if the range has so few points that the full data should be shown instead. data has to be the
+    // container the pyramid was built from.
+    bool decimate(const QCPGraphDataContainer &data, const QCPRange &range, int maxBuckets, QVector<QCPGraphData> &out) const;
+
+private:
+    struct Bucket
+    {
+        double min;
+        double max;
+        int minIndex; //NOTE: -1 if all the values in the bucket are NaN.
+        int maxIndex;
+    };
+
+    static const int branching_ = 4;
+
+    QVector<QVector<Bucket>> levels_; //NOTE: The buckets of levels_[k] each cover branching_^(k+1) points.
+};
+
+#endif // MINMAXPYRAMID_H
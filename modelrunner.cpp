@@ -0,0 +1,170 @@
+#include "modelrunner.h"
+#include <QRegularExpression>
+#include <algorithm>
+
+ModelRunner::ModelRunner(QObject *parent)
+    : QObject(parent)
+{
+    progressTimer_.setInterval(1000);
+    QObject::connect(&progressTimer_, &QTimer::timeout, this, [this]()
+    {
+        emit progress(elapsed_.elapsed(), percent_);
+    }
+    );
+
+    killTimer_.setSingleShot(true);
+    killTimer_.setInterval(3000);
+    QObject::connect(&killTimer_, &QTimer::timeout, this, [this]()
+    {
+        if(process_) process_->kill();
+    }
+    );
+}
+
+ModelRunner::~ModelRunner()
+{
+    if(process_)
+    {
+        //NOTE: We don't want to leave a model running in the background when INCAView is closed.
+        process_->disconnect(this);
+        process_->kill();
+        process_->waitForFinished(1000);
+        delete process_;
+    }
+}
+
+bool ModelRunner::reserve()
+{
+    if(isRunning()) return false;
+    reserved_ = true;
+    return true;
+}
+
+bool ModelRunner::start(const QString &program, const QStringList &arguments, const QString &workingDirectory)
+{
+    if(isRunning()) return false;
+
+    pendingOutput_.clear();
+    pendingError_.clear();
+    wroteErrors_ = false;
+    cancelled_ = false;
+    percent_ = -1;
+
+    process_ = new QProcess(this);
+    process_->setWorkingDirectory(workingDirectory);
+
+    QObject::connect(process_, &QProcess::readyReadStandardOutput, this, &ModelRunner::readStandardOutput);
+    QObject::connect(process_, &QProcess::readyReadStandardError, this, &ModelRunner::readStandardError);
+    QObject::connect(process_, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &ModelRunner::handleFinished);
+    QObject::connect(process_, &QProcess::errorOccurred, this, &ModelRunner::handleError);
+
+    elapsed_.start();
+    progressTimer_.start();
+    process_->start(program, arguments);
+    return true;
+}
+
+void ModelRunner::cancel()
+{
+    if(!process_ || cancelled_) return;
+
+    cancelled_ = true;
+    process_->terminate();
+    killTimer_.start();
+}
+
+void ModelRunner::emitLines(QByteArray &pending, bool isError, bool flushAll)
+{
+    static const QRegularExpression percentPattern("(\\d{1,3})(?:\\.\\d+)?\\s*%");
+
+    int start = 0;
+    for(;;)
+    {
+        int end = pending.indexOf('\n', start);
+        if(end < 0)
+        {
+            if(!flushAll || start >= pending.size()) break;
+            end = pending.size();
+        }
+
+        QString line = QString::fromLocal8Bit(pending.constData() + start, end - start);
+        if(line.endsWith('\r')) line.chop(1);
+        start = end + 1;
+
+        if(isError)
+        {
+            wroteErrors_ = true;
+            emit errorOutput(line);
+        }
+        else
+        {
+            QRegularExpressionMatchIterator matches = percentPattern.globalMatch(line);
+            int percent = -1;
+            while(matches.hasNext()) percent = matches.next().captured(1).toInt();
+            if(percent >= 0 && percent <= 100 && percent != percent_)
+            {
+                percent_ = percent;
+                emit progress(elapsed_.elapsed(), percent_);
+            }
+            emit output(line);
+        }
+    }
+    pending.remove(0, std::min(start, pending.size()));
+}
+
+void ModelRunner::readStandardOutput()
+{
+    pendingOutput_ += process_->readAllStandardOutput();
+    emitLines(pendingOutput_, false, false);
+}
+
+void ModelRunner::readStandardError()
+{
+    pendingError_ += process_->readAllStandardError();
+    emitLines(pendingError_, true, false);
+}
+
+void ModelRunner::handleFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    //NOTE: There may be output left in the pipes that has not been announced yet.
+    pendingOutput_ += process_->readAllStandardOutput();
+    pendingError_ += process_->readAllStandardError();
+    emitLines(pendingOutput_, false, true);
+    emitLines(pendingError_, true, true);
+
+    if(!cancelled_)
+    {
+        if(exitStatus == QProcess::CrashExit) emit errorOutput("The model exe crashed.");
+        else if(exitCode != 0)                emit errorOutput(QString("The model exe exited with code %1.").arg(exitCode));
+    }
+
+    bool success = !cancelled_ && exitStatus == QProcess::NormalExit && exitCode == 0 && !wroteErrors_;
+
+    finish(success);
+}
+
+void ModelRunner::handleError(QProcess::ProcessError error)
+{
+    //NOTE: Everything except a failure to start is followed by finished(), which is where we clean up.
+    if(error == QProcess::FailedToStart)
+    {
+        emit errorOutput("Model exe process did not start.");
+        finish(false);
+    }
+    else if(!cancelled_ && error != QProcess::Crashed)
+    {
+        emit errorOutput("An error occurred while running the model exe.");
+    }
+}
+
+void ModelRunner::finish(bool success)
+{
+    progressTimer_.stop();
+    killTimer_.stop();
+
+    process_->disconnect(this);
+    process_->deleteLater(); //NOTE: We may be inside one of its signals.
+    process_ = nullptr;
+
+    emit finished(success, cancelled_);
+}
@@ -0,0 +1,69 @@
+#ifndef MODELRUNNER_H
+#define MODELRUNNER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+
+//NOTE: Runs a model exe locally without blocking. It owns the QProcess and is driven by its signals, so the event loop keeps running (and the
+// GUI stays responsive) however long the run takes. The output is passed on a line at a time as it arrives.
+//NOTE: Only one process is run at a time. start() fails if one is already running.
+class ModelRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ModelRunner(QObject *parent = nullptr);
+    ~ModelRunner();
+
+    bool start(const QString &program, const QStringList &arguments, const QString &workingDirectory);
+    bool isRunning() const { return process_ != nullptr || reserved_; }
+
+    //NOTE: Holds the runner for a run that is started later, e.g. once the DataService has prepared it, so that nothing else can start in
+    // between. While it is reserved isRunning() is true and start() fails, so the holder has to call release() right before its start().
+    bool reserve();
+    void release() { reserved_ = false; }
+
+public slots:
+    //NOTE: Asks the process to terminate, and kills it if it has not done so a few seconds later. finished() is emitted when it is gone.
+    void cancel();
+
+signals:
+    void output(const QString &line);
+    void errorOutput(const QString &line);
+
+    //NOTE: Emitted every second while the process runs, and whenever it reports how far it has come. percent is -1 if it has not reported
+    // anything yet. The model exes don't have a progress protocol, so we just look for the last "n%" in their output.
+    void progress(qint64 elapsedMilliseconds, int percent);
+
+    //NOTE: success is false if the process could not be started, crashed, exited with a non-zero code or wrote anything to stderr (that
+    // is how the model exes report errors).
+    void finished(bool success, bool cancelled);
+
+private slots:
+    void readStandardOutput();
+    void readStandardError();
+    void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void handleError(QProcess::ProcessError error);
+
+private:
+    void emitLines(QByteArray &pending, bool isError, bool flushAll);
+    void finish(bool success);
+
+    QProcess *process_ = nullptr;
+    QByteArray pendingOutput_; //NOTE: Output after the last line break, which is held back until the rest of the line arrives.
+    QByteArray pendingError_;
+    bool wroteErrors_ = false;
+    bool cancelled_ = false;
+    bool reserved_ = false;
+    int percent_ = -1;
+
+    QElapsedTimer elapsed_;
+    QTimer progressTimer_;
+    QTimer killTimer_;
+};
+
+#endif // MODELRUNNER_H
@@ -0,0 +1,353 @@
+#include "numberformat.h"
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+//NOTE: An unnormalized floating point number f * 2^e with a 64-bit significand.
+struct diy_fp
+{
+    uint64_t f;
+    int e;
+};
+
+static inline diy_fp diy_sub(diy_fp x, diy_fp y)
+{
+    return {x.f - y.f, x.e};
+}
+
+//NOTE: The upper 64 bits of the 128-bit product of the significands, rounded.
+static inline diy_fp diy_mul(diy_fp x, diy_fp y)
+{
+    uint64_t xlo = x.f & 0xFFFFFFFFu, xhi = x.f >> 32;
+    uint64_t ylo = y.f & 0xFFFFFFFFu, yhi = y.f >> 32;
+
+    uint64_t p0 = xlo*ylo;
+    uint64_t p1 = xlo*yhi;
+    uint64_t p2 = xhi*ylo;
+    uint64_t p3 = xhi*yhi;
+
+    uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    mid += (uint64_t)1 << 31;
+
+    return {p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64};
+}
+
+static inline diy_fp diy_normalize(diy_fp x)
+{
+    while((x.f >> 63) == 0)
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+struct cached_power
+{
+    uint64_t f;
+    int e;
+    int k;
+};
+
+//NOTE: Normalized approximations of 10^k for k = -300, -292, ..., 324, i.e. 10^k ~= f * 2^e. Generated with exact rational arithmetic.
+static const cached_power cached_powers[] =
+{
+{ 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+static const int cached_powers_min_k = -300;
+static const int cached_powers_step = 8;
+
+//NOTE: The digit generation needs the scaled value's exponent in [alpha, gamma].
+static const int alpha = -60;
+static const int gamma_ = -32;
+
+static cached_power cached_power_for_binary_exponent(int e)
+{
+    //NOTE: k = ceil((alpha - e - 1) * log10(2)), with 78913 / 2^18 approximating log10(2).
+    int f = alpha - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0 ? 1 : 0);
+    int index = (-cached_powers_min_k + k + (cached_powers_step - 1)) / cached_powers_step;
+    return cached_powers[index];
+}
+
+static inline int largest_pow10(uint32_t n, uint32_t &pow10)
+{
+    if(n >= 1000000000) { pow10 = 1000000000; return 10; }
+    if(n >= 100000000)  { pow10 = 100000000;  return 9; }
+    if(n >= 10000000)   { pow10 = 10000000;   return 8; }
+    if(n >= 1000000)    { pow10 = 1000000;    return 7; }
+    if(n >= 100000)     { pow10 = 100000;     return 6; }
+    if(n >= 10000)      { pow10 = 10000;      return 5; }
+    if(n >= 1000)       { pow10 = 1000;       return 4; }
+    if(n >= 100)        { pow10 = 100;        return 3; }
+    if(n >= 10)         { pow10 = 10;         return 2; }
+    pow10 = 1;
+    return 1;
+}
+
+//NOTE: Moves the last digit towards the exact value while the result stays within the rounding interval.
+static inline void round_weed(char *digits, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenk)
+{
+    while(rest < dist && delta - rest >= tenk && (rest + tenk < dist || dist - rest > rest + tenk - dist))
+    {
+        digits[length - 1]--;
+        rest += tenk;
+    }
+}
+
+//NOTE: Generates the shortest digits d such that d * 10^exponent lies strictly between low and high, and is close to w.
+static void generate_digits(char *digits, int &length, int &exponent, diy_fp low, diy_fp w, diy_fp high)
+{
+    uint64_t delta = diy_sub(high, low).f;
+    uint64_t dist = diy_sub(high, w).f;
+
+    diy_fp one = {(uint64_t)1 << -high.e, high.e};
+    uint32_t p1 = (uint32_t)(high.f >> -one.e); //NOTE: The integral part. Fits in 32 bits since the exponent is at least alpha.
+    uint64_t p2 = high.f & (one.f - 1);         //NOTE: The fractional part.
+
+    uint32_t pow10;
+    int n = largest_pow10(p1, pow10);
+
+    while(n > 0)
+    {
+        uint32_t d = p1 / pow10;
+        p1 %= pow10;
+        digits[length++] = (char)('0' + d);
+        --n;
+
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if(rest <= delta)
+        {
+            exponent += n;
+            round_weed(digits, length, dist, delta, rest, (uint64_t)pow10 << -one.e);
+            return;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for(;;)
+    {
+        p2 *= 10;
+        uint64_t d = p2 >> -one.e;
+        p2 &= one.f - 1;
+        digits[length++] = (char)('0' + d);
+        ++m;
+
+        delta *= 10;
+        dist *= 10;
+        if(p2 <= delta) break;
+    }
+    exponent -= m;
+    round_weed(digits, length, dist, delta, p2, one.f);
+}
+
+//NOTE: value has to be finite and positive.
+static void grisu2(char *digits, int &length, int &exponent, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint64_t hidden_bit = (uint64_t)1 << 52;
+    uint64_t fraction = bits & (hidden_bit - 1);
+    int biased = (int)(bits >> 52);
+
+    diy_fp v = (biased == 0) ? diy_fp{fraction, 1 - 1075} : diy_fp{fraction + hidden_bit, biased - 1075};
+
+    //NOTE: The boundaries are halfway to the neighbouring doubles. The lower one is closer when v is a power of two.
+    bool lower_is_closer = (fraction == 0 && biased > 1);
+    diy_fp plus = diy_normalize({2*v.f + 1, v.e - 1});
+    diy_fp minus = lower_is_closer ? diy_fp{4*v.f - 1, v.e - 2} : diy_fp{2*v.f - 1, v.e - 1};
+    minus.f <<= (minus.e - plus.e);
+    minus.e = plus.e;
+    diy_fp w = diy_normalize(v);
+
+    cached_power cached = cached_power_for_binary_exponent(plus.e);
+    diy_fp c = {cached.f, cached.e};
+
+    diy_fp sw = diy_mul(w, c);
+    diy_fp sminus = diy_mul(minus, c);
+    diy_fp splus = diy_mul(plus, c);
+
+    //NOTE: The products are off by at most one in the last place, so we shrink the interval by that to stay on the safe side.
+    sminus.f += 1;
+    splus.f -= 1;
+
+    length = 0;
+    exponent = -cached.k;
+    generate_digits(digits, length, exponent, sminus, sw, splus);
+}
+
+static inline char *write_exponent(char *out, int e)
+{
+    *out++ = 'e';
+    if(e < 0)
+    {
+        *out++ = '-';
+        e = -e;
+    }
+    else *out++ = '+';
+
+    if(e >= 100)
+    {
+        *out++ = (char)('0' + e / 100);
+        e %= 100;
+    }
+    *out++ = (char)('0' + e / 10);
+    *out++ = (char)('0' + e % 10);
+    return out;
+}
+
+int formatDouble(char *out, double value)
+{
+    char *start = out;
+
+    if(std::signbit(value))
+    {
+        *out++ = '-';
+        value = -value;
+    }
+
+    if(std::isnan(value))
+    {
+        memcpy(start, "nan", 3); //NOTE: Without the sign.
+        return 3;
+    }
+    if(std::isinf(value))
+    {
+        memcpy(out, "inf", 3);
+        return (int)(out - start) + 3;
+    }
+    if(value == 0.0)
+    {
+        *out++ = '0';
+        return (int)(out - start);
+    }
+
+    char digits[20];
+    int length;
+    int exponent;
+    grisu2(digits, length, exponent, value);
+
+    //NOTE: The value is 0.d1d2...dn * 10^point.
+    int point = length + exponent;
+
+    if(length <= point && point <= 17)
+    {
+        //NOTE: An integer, e.g. 1234500
+        memcpy(out, digits, length);
+        out += length;
+        for(int i = length; i < point; ++i) *out++ = '0';
+    }
+    else if(0 < point && point <= 17)
+    {
+        //NOTE: e.g. 123.45
+        memcpy(out, digits, point);
+        out += point;
+        *out++ = '.';
+        memcpy(out, digits + point, length - point);
+        out += length - point;
+    }
+    else if(-4 < point && point <= 0)
+    {
+        //NOTE: e.g. 0.0012345
+        *out++ = '0';
+        *out++ = '.';
+        for(int i = point; i < 0; ++i) *out++ = '0';
+        memcpy(out, digits, length);
+        out += length;
+    }
+    else
+    {
+        //NOTE: e.g. 1.2345e-07
+        *out++ = digits[0];
+        if(length > 1)
+        {
+            *out++ = '.';
+            memcpy(out, digits + 1, length - 1);
+            out += length - 1;
+        }
+        out = write_exponent(out, point - 1);
+    }
+
+    return (int)(out - start);
+}
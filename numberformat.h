@@ -0,0 +1,14 @@
+#ifndef NUMBERFORMAT_H
+#define NUMBERFORMAT_H
+
+//NOTE: Writes value to out with the fewest significant digits that read back (with strtod or QString::toDouble) as exactly the same double,
+// and returns the number of characters written. out must have room for 32 characters. No terminating zero is written.
+// The notation is like printf's %g: plain decimals for moderate magnitudes, otherwise scientific, e.g. 1.5e+20.
+//NOTE: This is about ten times as fast as trying printf with increasing precision until the value reads back, which matters when exporting
+// many long series. The digits are generated with Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", 2010), which always produces a representation that reads back exactly, and the shortest one for all but a tiny fraction of
+// values. For those it is usually one digit longer than necessary. It can be a few digits longer when the shortest representation lies
+// exactly on the halfway point to a neighbouring double, since Grisu2 only looks strictly inside that interval.
+int formatDouble(char *out, double value);
+
+#endif // NUMBERFORMAT_H
@@ -205,6 +205,8 @@ bool ParameterModel::setData(const QModelIndex & index, const QVariant & value,
 
                 if(valueWasChanged)
                 {
+                    editedParamID_.insert(ID);
+
                     ParameterEditAction editAction;
                     editAction.parameterID = ID;
                     editAction.oldValue = oldVal;
@@ -305,6 +307,7 @@ void ParameterModel::setValue(int ID, parameter_value& value)
 {
     beginResetModel();
     IDtoParam_[ID]->value = value;
+    editedParamID_.insert(ID);
     endResetModel();
 }
 
@@ -325,3 +328,21 @@ void ParameterModel::serializeParameterData(QVector<parameter_serial_entry>& out
 
     return;
 }
+
+void ParameterModel::serializeEditedParameterData(QVector<parameter_serial_entry>& outdata)
+{
+    //NOTE: Only the parameters that have been edited since the last save, so that saving is proportional to the number of edits rather than the
+    // size of the model. Call clearEditedParameters() once they have been stored.
+    outdata.reserve(outdata.size() + (int)editedParamID_.size());
+    for(int ID : editedParamID_)
+    {
+        Parameter *param = IDtoParam_.at(ID);
+
+        parameter_serial_entry entry = {};
+        entry.ID = ID;
+        entry.type = param->type;
+        entry.value = param->value;
+
+        outdata.push_back(entry);
+    }
+}
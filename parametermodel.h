@@ -3,6 +3,7 @@
 
 #include <QAbstractTableModel>
 #include "parameter.h"
+#include <set>
 
 struct ParameterEditAction
 {
@@ -31,16 +32,19 @@ public:
     void setChildrenVisible(int);
 
     void serializeParameterData(QVector<parameter_serial_entry> &outdata);
+    void serializeEditedParameterData(QVector<parameter_serial_entry> &outdata);
+    void clearEditedParameters() { editedParamID_.clear(); }
 
     void handleClick(const QModelIndex &index);
 
     void setValue(int, parameter_value&); //NOTE: this is only to be used by the MainWindow's undo function
 
-    const Parameter *getParameterAtRow(int row) const; //NOTE: this is only to be used by the edit delegates
+    const Parameter *getParameterAtRow(int row) const; //NOTE: this is only to be used by the edit delegates and the MainWindow's parameter sweep
 
 private:
     std::vector<int> visibleParamID_;
     std::map<int, Parameter*> IDtoParam_;
+    std::set<int> editedParamID_; //NOTE: The parameters that have been edited since the last time they were saved to the database.
 signals:
     void parameterWasEdited(ParameterEditAction);
 };
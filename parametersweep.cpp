@@ -0,0 +1,329 @@
+#include "parametersweep.h"
+#include "numberformat.h"
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+ParameterSweep::ParameterSweep(QObject *parent)
+    : QObject(parent), db_("ParameterSweep")
+{
+}
+
+ParameterSweep::~ParameterSweep()
+{
+    //NOTE: The ModelRunners are our children, and kill their processes when they are deleted.
+}
+
+int ParameterSweep::runCount(const QVector<SweepParameter> &parameters)
+{
+    if(parameters.empty()) return 0;
+    qint64 count = 1;
+    for(const SweepParameter &parameter : parameters)
+    {
+        count *= std::max(parameter.steps, 1);
+        if(count > std::numeric_limits<int>::max()) return std::numeric_limits<int>::max();
+    }
+    return (int)count;
+}
+
+static parameter_value sweepValue(const SweepParameter &parameter, int step)
+{
+    double t = parameter.steps > 1 ? (double)step / (double)(parameter.steps - 1) : 0.0;
+    parameter_value value;
+    if(parameter.type == parametertype_uint)
+    {
+        double from = (double)parameter.from.val_uint;
+        double to = (double)parameter.to.val_uint;
+        value.val_uint = (uint64_t)std::llround(from + (to - from)*t);
+    }
+    else
+    {
+        value.val_double = parameter.from.val_double + (parameter.to.val_double - parameter.from.val_double)*t;
+    }
+    return value;
+}
+
+bool ParameterSweep::start(const QString &program, const QString &inputFilePath, const QString &parameterDbPath, const QString &sweepDirectory,
+                           const QVector<SweepParameter> &parameters, int maxConcurrentRuns)
+{
+    if(running_) return false;
+
+    program_ = program;
+    inputFilePath_ = inputFilePath;
+    parameterDbPath_ = parameterDbPath;
+    if(!buildRuns(sweepDirectory, parameters)) return false;
+
+    maxConcurrentRuns_ = std::max(maxConcurrentRuns, 1);
+    remote_ = false;
+
+    running_ = true;
+    emit log(QString("Starting a sweep of %1 runs, %2 at a time, in ").arg(runs_.count()).arg(maxConcurrentRuns_) + directory_);
+    launchNext();
+    return true;
+}
+
+bool ParameterSweep::startRemote(const QString &remoteProgram, const QString &remoteInputFilePath, const QString &parameterDbPath, const QString &sweepDirectory,
+                                 const QString &remoteSweepDirectory, const QVector<SweepParameter> &parameters, int maxConcurrentRuns)
+{
+    if(running_) return false;
+
+    program_ = remoteProgram;
+    inputFilePath_ = remoteInputFilePath;
+    parameterDbPath_ = parameterDbPath;
+    if(!buildRuns(sweepDirectory, parameters)) return false;
+
+    remote_ = true;
+    remoteJobRuns_.clear();
+
+    //NOTE: All the parameter databases are prepared up front, since the jobs are started from the DataService thread.
+    RemoteJobRequest request;
+    request.maxConcurrentJobs = maxConcurrentRuns;
+    for(SweepRun &run : runs_)
+    {
+        run.remoteDirectory = remoteSweepDirectory + QString("/run_%1").arg(run.index, 4, 10, QChar('0'));
+        if(!prepareRun(run))
+        {
+            run.finished = true;
+            emit runFinished(run.index, false);
+            continue;
+        }
+
+        RemoteJob job;
+        job.directory = run.remoteDirectory;
+        job.command = program_ + " run " + inputFilePath_ + " parameters.db";
+        job.uploads.push_back(qMakePair(QDir(run.directory).absoluteFilePath("parameters.db"), QString("parameters.db")));
+        request.jobs.push_back(job);
+        remoteJobRuns_.push_back(run.index);
+    }
+
+    if(request.jobs.empty())
+    {
+        emit finished(false);
+        return true;
+    }
+
+    running_ = true;
+    emit log(QString("Starting a sweep of %1 runs on the instance in ").arg(runs_.count()) + remoteSweepDirectory);
+    emit remoteRunsReady(request);
+    return true;
+}
+
+bool ParameterSweep::buildRuns(const QString &sweepDirectory, const QVector<SweepParameter> &parameters)
+{
+    int count = runCount(parameters);
+    if(count == 0) return false;
+
+    QDir directory(sweepDirectory);
+    if(!directory.mkpath("."))
+    {
+        emit logError("Unable to create the sweep directory " + sweepDirectory);
+        return false;
+    }
+
+    parameters_ = parameters;
+    directory_ = directory.absolutePath();
+    nextRun_ = 0;
+    cancelled_ = false;
+
+    //NOTE: The grid is enumerated with the first parameter varying fastest.
+    runs_.clear();
+    runs_.resize(count);
+    for(int index = 0; index < count; ++index)
+    {
+        SweepRun &run = runs_[index];
+        run.index = index;
+        run.directory = directory.absoluteFilePath(QString("run_%1").arg(index, 4, 10, QChar('0')));
+
+        int rest = index;
+        for(const SweepParameter &parameter : parameters_)
+        {
+            int steps = std::max(parameter.steps, 1);
+            parameter_serial_entry entry;
+            entry.type = parameter.type;
+            entry.ID = parameter.ID;
+            entry.value = sweepValue(parameter, rest % steps);
+            run.values.push_back(entry);
+            rest /= steps;
+        }
+    }
+
+    return true;
+}
+
+bool ParameterSweep::prepareRun(SweepRun &run)
+{
+    QDir directory(run.directory);
+    if(!directory.mkpath("."))
+    {
+        emit logError("Unable to create the directory " + run.directory);
+        return false;
+    }
+
+    //NOTE: A directory left over from an earlier sweep may still have its databases in it.
+    directory.remove("results.db");
+    directory.remove("inputs.db");
+
+    QString parameterDbPath = directory.absoluteFilePath("parameters.db");
+    db_.closeDatabase(parameterDbPath);
+    QFile::remove(parameterDbPath);
+    if(!QFile::copy(parameterDbPath_, parameterDbPath))
+    {
+        emit logError("Unable to copy the parameter database to " + run.directory);
+        return false;
+    }
+
+    db_.setDatabase(parameterDbPath);
+    bool success = db_.writeParameterValues(run.values);
+    db_.closeDatabase(parameterDbPath); //NOTE: The model exe has to be able to open it.
+    if(!success) emit logError("Unable to write the parameter values for run " + QString::number(run.index));
+    return success;
+}
+
+void ParameterSweep::launchNext()
+{
+    while(!cancelled_ && active_.count() < maxConcurrentRuns_ && nextRun_ < runs_.count())
+    {
+        SweepRun &run = runs_[nextRun_++];
+        if(!prepareRun(run))
+        {
+            run.finished = true;
+            emit runFinished(run.index, false);
+            continue;
+        }
+
+        ModelRunner *runner = new ModelRunner(this);
+        int index = run.index;
+        QString prefix = QString("[run %1] ").arg(index);
+        QObject::connect(runner, &ModelRunner::output, this, [this, prefix](const QString &line) { emit log(prefix + line); });
+        QObject::connect(runner, &ModelRunner::errorOutput, this, [this, prefix](const QString &line) { emit logError(prefix + line); });
+        QObject::connect(runner, &ModelRunner::finished, this, [this, runner, index](bool success, bool cancelled)
+        {
+            active_.removeOne(runner);
+            runner->deleteLater();
+            handleRunFinished(index, success && !cancelled);
+        }
+        );
+
+        QStringList arguments;
+        arguments << "run" << inputFilePath_ << QDir(run.directory).absoluteFilePath("parameters.db");
+
+        active_.push_back(runner);
+        runner->start(program_, arguments, run.directory);
+    }
+
+    if(running_ && active_.empty() && (cancelled_ || nextRun_ >= runs_.count()))
+    {
+        running_ = false;
+        emit finished(cancelled_);
+    }
+}
+
+void ParameterSweep::handleRunFinished(int index, bool success)
+{
+    runs_[index].finished = true;
+    runs_[index].success = success;
+    emit runFinished(index, success);
+
+    launchNext();
+}
+
+void ParameterSweep::cancel()
+{
+    if(!running_) return;
+
+    cancelled_ = true;
+    if(remote_)
+    {
+        emit cancelRemoteRuns(); //NOTE: We continue in handleRemoteJobsFinished.
+        return;
+    }
+
+    for(ModelRunner *runner : active_) runner->cancel();
+    launchNext(); //NOTE: In case nothing was running.
+}
+
+void ParameterSweep::handleRemoteJobFinished(int job, bool success)
+{
+    if(!running_ || !remote_) return;
+
+    SweepRun &run = runs_[remoteJobRuns_[job]];
+    run.finished = true;
+    run.success = success;
+    emit runFinished(run.index, success);
+}
+
+void ParameterSweep::handleRemoteJobsFinished(bool cancelled)
+{
+    if(!running_ || !remote_) return;
+
+    running_ = false;
+    emit finished(cancelled || cancelled_);
+}
+
+SweepScore summarizeSweepRun(const QVector<CalibrationRow> &rows)
+{
+    SweepScore score;
+    double nse = 0.0, kge = 0.0, pbias = 0.0;
+    for(const CalibrationRow &row : rows)
+    {
+        const GoodnessOfFit &fit = row.fit;
+        if(!std::isfinite(fit.nashSutcliffe) || !std::isfinite(fit.klingGupta) || !std::isfinite(fit.percentBias)) continue;
+        nse += fit.nashSutcliffe;
+        kge += fit.klingGupta;
+        pbias += std::abs(fit.percentBias);
+        ++score.pairCount;
+    }
+
+    double n = (double)score.pairCount;
+    score.meanNashSutcliffe = nse / n; //NOTE: NaN if nothing could be scored.
+    score.meanKlingGupta = kge / n;
+    score.meanAbsolutePercentBias = pbias / n;
+    return score;
+}
+
+bool writeSweepSummary(const QString &path, const ParameterSweep &sweep, const QVector<SweepScore> &scores)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    out << "\"run\",\"success\"";
+    for(const SweepParameter &parameter : sweep.parameters()) out << ",\"" << QString(parameter.name).replace("\"", "\"\"") << "\"";
+    out << ",\"scored pairs\",\"mean NSE\",\"mean KGE\",\"mean |PBIAS|\"\n";
+
+    auto number = [&out](double value)
+    {
+        out << ",";
+        if(std::isnan(value)) return;
+        char buffer[32];
+        int length = formatDouble(buffer, value);
+        out << QLatin1String(buffer, length);
+    };
+
+    for(const SweepRun &run : sweep.runs())
+    {
+        out << run.index << "," << (run.success ? 1 : 0);
+        for(const parameter_serial_entry &entry : run.values)
+        {
+            if(entry.type == parametertype_uint) out << "," << (qulonglong)entry.value.val_uint;
+            else                                 number(entry.value.val_double);
+        }
+
+        const SweepScore &score = scores[run.index];
+        out << "," << score.pairCount;
+        if(score.pairCount > 0)
+        {
+            number(score.meanNashSutcliffe);
+            number(score.meanKlingGupta);
+            number(score.meanAbsolutePercentBias);
+        }
+        else out << ",,,";
+        out << "\n";
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,110 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include "modelrunner.h"
+#include "remotejobs.h"
+#include "sqlinterface.h"
+#include "calibration.h"
+#include "sqlhandler/serialization.h"
+#include <QObject>
+#include <QVector>
+#include <QString>
+
+//NOTE: A parameter that is varied in a sweep, from one value to another in evenly spaced steps (both ends included). Only double and
+// uint parameters can be swept.
+struct SweepParameter
+{
+    int ID;
+    parameter_type type;
+    QString name;
+    parameter_value from;
+    parameter_value to;
+    int steps;
+};
+
+struct SweepRun
+{
+    int index;
+    QString directory; //NOTE: Has the run's own copy of the parameter database, and gets its own results and inputs databases.
+    QString remoteDirectory; //NOTE: Where the run happens on the instance, for a remote sweep. Relative to the home directory.
+    QVector<parameter_serial_entry> values;
+    bool finished = false;
+    bool success = false;
+};
+
+//NOTE: How well a run fit the observations, summed up over all the calibration pairs that could be scored.
+struct SweepScore
+{
+    int pairCount = 0;
+    double meanNashSutcliffe;
+    double meanKlingGupta;
+    double meanAbsolutePercentBias;
+};
+
+//NOTE: Runs the model locally for every combination of the swept parameters' values (a full grid), with as many model processes at a
+// time as there are cores. Every run happens in its own directory with its own copy of the parameter database, so that the runs don't
+// overwrite each other's databases. A remote sweep is run by the RemoteJobScheduler on the DataService thread instead, with one run per core
+// on the instance. The parameter databases are still prepared here and uploaded to each run's directory on the instance.
+class ParameterSweep : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ParameterSweep(QObject *parent = nullptr);
+    ~ParameterSweep();
+
+    static int runCount(const QVector<SweepParameter> &parameters);
+
+    bool start(const QString &program, const QString &inputFilePath, const QString &parameterDbPath, const QString &sweepDirectory,
+               const QVector<SweepParameter> &parameters, int maxConcurrentRuns);
+    bool startRemote(const QString &remoteProgram, const QString &remoteInputFilePath, const QString &parameterDbPath, const QString &sweepDirectory,
+                     const QString &remoteSweepDirectory, const QVector<SweepParameter> &parameters, int maxConcurrentRuns);
+    void cancel();
+
+    //NOTE: For a remote sweep, the reports of the RemoteJobScheduler about the jobs of the request that was handed out in remoteRunsReady.
+    void handleRemoteJobFinished(int job, bool success);
+    void handleRemoteJobsFinished(bool cancelled);
+    bool isRunning() const { return running_; }
+
+    const QVector<SweepParameter> &parameters() const { return parameters_; }
+    const QVector<SweepRun> &runs() const { return runs_; }
+    QString directory() const { return directory_; }
+
+signals:
+    void log(const QString &);
+    void logError(const QString &);
+    void runFinished(int index, bool success);
+    void finished(bool cancelled);
+    void remoteRunsReady(const RemoteJobRequest &request);
+    void cancelRemoteRuns();
+
+private:
+    bool buildRuns(const QString &sweepDirectory, const QVector<SweepParameter> &parameters);
+    void launchNext();
+    bool prepareRun(SweepRun &run);
+    void handleRunFinished(int index, bool success);
+
+    QVector<SweepParameter> parameters_;
+    QVector<SweepRun> runs_;
+    QString program_;
+    QString inputFilePath_;
+    QString parameterDbPath_;
+    QString directory_;
+
+    int maxConcurrentRuns_ = 1;
+    int nextRun_ = 0;
+    QVector<ModelRunner *> active_;
+    bool running_ = false;
+    bool cancelled_ = false;
+    bool remote_ = false;
+    QVector<int> remoteJobRuns_; //NOTE: The run that each job of a remote sweep is for.
+
+    SQLInterface db_; //NOTE: For writing the parameter values into the copies of the parameter database.
+};
+
+SweepScore summarizeSweepRun(const QVector<CalibrationRow> &rows);
+
+//NOTE: One row per run, with the values of the swept parameters and the run's score. Runs that failed or were not scored have empty scores.
+bool writeSweepSummary(const QString &path, const ParameterSweep &sweep, const QVector<SweepScore> &scores);
+
+#endif // PARAMETERSWEEP_H
@@ -1,13 +1,7 @@
 #include "plotter.h"
 
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/stats.hpp>
-#include <boost/accumulators/statistics/mean.hpp>
-#include <boost/accumulators/statistics/min.hpp>
-#include <boost/accumulators/statistics/max.hpp>
-#include <boost/accumulators/statistics/variance.hpp>
-#include <boost/accumulators/statistics/covariance.hpp>
-#include <boost/accumulators/statistics/variates/covariate.hpp>
+#include "statistics.h"
+#include "goodnessoffit.h"
 #include <limits>
 
 double NormalCDFInverse(double p);
@@ -18,37 +12,155 @@ void Plotter::filterUncachedIDs(const QVector<int>& IDs, QVector<int>& uncachedO
 {
     for(int ID : IDs)
     {
-        auto find = cache_.find(ID);
-        if(find == cache_.end()) uncachedOut.push_back(ID);
+        if(!cache_.lookup(databaseOf(ID), ID)) uncachedOut.push_back(ID);
     }
 }
 
-void Plotter::addToCache(const QVector<int>& newIDs, const QVector<QVector<double>>& newResultsets, const QVector<int64_t>& startDates)
+void Plotter::addToCache(const QVector<int>& newIDs, const QVector<SeriesData>& newResultsets, const QVector<int64_t>& startDates, const QVector<int64_t>& timesteps,
+                         quint64 resultsGeneration, quint64 inputsGeneration)
 {
     for(int i = 0; i < newResultsets.count(); ++i)
     {
         int ID = newIDs[i];
-        cache_[ID] = newResultsets[i]; //NOTE: Vector copy
-        startDateCache_[ID] = startDates[i];
+        SeriesDatabase database = databaseOf(ID);
+        CachedSeries series;
+        series.values = newResultsets[i]; //NOTE: Shares the buffer, does not copy the values.
+        series.startDate = startDates[i];
+        series.timestep = timesteps[i];
+        cache_.insert(database, database == SeriesDatabase_Results ? resultsGeneration : inputsGeneration, ID, series);
     }
 }
 
 void Plotter::clearPlots()
 {
-    plot_->clearPlottables();
+    removeAllGraphs();
+    graphs_.clear();
+    updateRetainedSeries();
     plot_->replot();
     resultsInfo_->clear();
 }
 
-void Plotter::plotGraphs(const QVector<int>& IDs, const QVector<QString>& resultnames, PlotMode mode, QVector<bool> &scatter, bool logarithmicY)
+void Plotter::removeAllGraphs()
 {
-    //NOTE: Right now we just throw out all previous graphs and re-create everything. We could keep track of which ID corresponds to which graph (in which plot mode)
-    // and then only update/create the graphs that have changed. However, this should only be necessary if this routine runs very slowly on some user machines.
     plot_->clearPlottables();
+    for(auto &entry : graphs_) entry.second.graph = nullptr; //NOTE: clearPlottables deleted them, but we keep the data for later.
+}
+
+//NOTE: Has to be called whenever graphs_ changes. The entries may outlive the cached series they were built from, e.g. when the series
+// are invalidated by a model run, or when the entry is for a mode that is not shown right now.
+void Plotter::updateRetainedSeries()
+{
+    QVector<SeriesData> retained;
+    for(const auto &entry : graphs_) retained.push_back(entry.second.source);
+    cache_.setRetained(retained);
+}
+
+void Plotter::buildGraphData(int ID, const CachedSeries &series, PlotMode mode, PlottedGraph &entry)
+{
+    const SeriesData& yval = series.values;
+    int64_t startDate = series.startDate;
+    int64_t timestep = series.timestep;
+    int cnt = yval.count();
+
+    entry.source = yval;
+
+    SummaryStatistics stats = summaryStatistics(yval.data(), cnt);
+    entry.min = stats.min;
+    entry.max = stats.max;
+    entry.mean = stats.mean;
+    entry.standardDeviation = stats.standardDeviation();
+
+    double graphmin = std::numeric_limits<double>::max();;
+    double graphmax = std::numeric_limits<double>::min();
+
+    QVector<QCPGraphData> displayeddata;
+
+    if(mode == PlotMode_YearlyAverages || mode == PlotMode_MonthlyAverages)
+    {
+        //NOTE: The aggregates are computed once per cached series, so switching between the modes or redrawing is cheap.
+        QSharedPointer<const SeriesAggregates> aggregatesPointer = cache_.aggregates(databaseOf(ID), ID);
+        const SeriesAggregates &aggregates = *aggregatesPointer;
+        const QVector<AggregateBin> &bins = (mode == PlotMode_YearlyAverages) ? aggregates.yearly_ : aggregates.monthly_;
+
+        displayeddata.resize(bins.count());
+        for(int j = 0; j < bins.count(); ++j)
+        {
+            double value = bins[j].mean(); //NOTE: NaN if the whole bin is missing, which leaves a gap in the graph.
+            displayeddata[j].key = (double)bins[j].date;
+            displayeddata[j].value = value;
+            if(!std::isnan(value))
+            {
+                graphmin = std::min(graphmin, value);
+                graphmax = std::max(graphmax, value);
+            }
+        }
+    }
+    else if(mode == PlotMode_DailyNormalized)
+    {
+        double range = entry.max - entry.min;
+        graphmin = 0.;
+        graphmax = 1.;
+        displayeddata.resize(cnt);
+        for(int j = 0; j < cnt; ++j)
+        {
+            displayeddata[j].key = (double)(startDate + timestep*j);
+            displayeddata[j].value = (yval[j] - entry.min) / range;
+        }
+    }
+    else //mode == PlotMode_Daily
+    {
+        graphmin = entry.min;
+        graphmax = entry.max;
+
+        displayeddata.resize(cnt);
+        for(int j = 0; j < cnt; ++j)
+        {
+            displayeddata[j].key = (double)(startDate + timestep*j);
+            displayeddata[j].value = yval[j];
+        }
+    }
+
+    entry.graphMin = graphmin;
+    entry.graphMax = graphmax;
+
+    //NOTE: Fill the graph's container directly instead of going through separate x and y vectors, so that the values are only copied once,
+    // into the container that the graph keeps.
+    entry.data.reset(new QCPGraphDataContainer);
+    entry.data->add(displayeddata, true);
+
+    entry.pyramid.build(*entry.data);
+    entry.shownData = entry.data;
+}
+
+QColor Plotter::unusedGraphColor()
+{
+    QVector<int> usecount(graphColors_.count());
+    for(const auto &entry : graphs_)
+    {
+        if(!entry.second.graph) continue;
+        int idx = graphColors_.indexOf(entry.second.color);
+        if(idx >= 0) ++usecount[idx];
+    }
+
+    //NOTE: The first color that is used the least, so that colors are only reused when there are more graphs than colors.
+    int best = 0;
+    for(int idx = 1; idx < graphColors_.count(); ++idx)
+    {
+        if(usecount[idx] < usecount[best]) best = idx;
+    }
+    return graphColors_[best];
+}
+
+void Plotter::plotGraphs(const QVector<int>& IDs, const QVector<QString>& resultnames, PlotMode mode, QVector<bool> &scatter, bool logarithmicY)
+{
     resultsInfo_->clear();
 
     currentPlottedIDs_ = IDs;
 
+    QVector<QPair<int, int>> pinned;
+    for(int ID : IDs) pinned.push_back(qMakePair((int)databaseOf(ID), ID));
+    cache_.setPinned(pinned);
+
     if(logarithmicY &&
         (mode == PlotMode_Daily || mode == PlotMode_MonthlyAverages || mode == PlotMode_YearlyAverages || mode == PlotMode_DailyNormalized || mode == PlotMode_Error)
     )
@@ -62,305 +174,244 @@ void Plotter::plotGraphs(const QVector<int>& IDs, const QVector<QString>& result
 
     if(mode == PlotMode_Daily || mode == PlotMode_MonthlyAverages || mode == PlotMode_YearlyAverages || mode == PlotMode_DailyNormalized)
     {
+        //NOTE: The graphs are kept in graphs_ between calls, so that when the selection changes we only add and remove the graphs that changed.
+        // The graph data of a selected series is also kept for the other modes it has been shown in, so that switching back and forth is cheap.
+        std::set<int> selected(IDs.begin(), IDs.end());
+        for(auto it = graphs_.begin(); it != graphs_.end(); )
+        {
+            auto current = it++;
+            bool isSelected = selected.count(current->first.first) != 0;
+            if(current->second.graph && !(isSelected && current->first.second == mode))
+            {
+                plot_->removeGraph(current->second.graph);
+                current->second.graph = nullptr;
+            }
+            if(!isSelected) graphs_.erase(current);
+        }
+        //NOTE: The error modes may have left bars behind, and those are not graphs.
+        for(int idx = plot_->plottableCount() - 1; idx >= 0; --idx)
+        {
+            if(!qobject_cast<QCPGraph*>(plot_->plottable(idx))) plot_->removePlottable(idx);
+        }
+
+        QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
+        if(mode == PlotMode_YearlyAverages)       dateTicker->setDateTimeFormat("yyyy");
+        else if(mode == PlotMode_MonthlyAverages) dateTicker->setDateTimeFormat("MMMM\nyyyy");
+        else                                      dateTicker->setDateTimeFormat("d. MMMM\nyyyy");
+        plot_->xAxis->setTicker(dateTicker);
+
         double minyrange = 0.0;
         double maxyrange = 0.0;
 
-        int firstunassignedcolor = 0;
-
         for(int i = 0; i < IDs.count(); ++i)
         {
-
             int ID = IDs[i];
+            GraphKey key = std::make_pair(ID, mode);
 
-            const QVector<double>& yval = cache_[ID];
-
-            int64_t startDate = startDateCache_[ID];
-
-            if(yval.empty()) continue; //TODO: Log warning?
-
-            int cnt = yval.count();
-
-            if(cnt != 0)
+            //NOTE: If the series was evicted or invalidated after it was fetched, a new fetch is on its way.
+            const CachedSeries *series = findCached(ID);
+            if(!series || series->values.empty()) //TODO: Log warning if it is empty?
             {
-
-                QColor& color = graphColors_[firstunassignedcolor++];
-                if(firstunassignedcolor == graphColors_.count()) firstunassignedcolor = 0; // Cycle the colors
-
-
-                using namespace boost::accumulators;
-                accumulator_set<double, stats<tag::min, tag::max, tag::mean, tag::variance>> acc;
-                for(double d : yval)
+                auto find = graphs_.find(key);
+                if(find != graphs_.end())
                 {
-                    if(!std::isnan(d))
-                        acc(d);
+                    if(find->second.graph) plot_->removeGraph(find->second.graph);
+                    graphs_.erase(find);
                 }
+                continue;
+            }
 
-                resultsInfo_->append(QString(
-                        "%1 <font color=%2>&#9608;&#9608;</font><br/>"
-                        "min: %3<br/>"
-                        "max: %4<br/>"
-                        "average: %5<br/>"
-                        "standard deviation: %6<br/>"
-                        "<br/>"
-                      ).arg(resultnames[i], color.name())
-                       .arg(min(acc), 0, 'g', 5)
-                       .arg(max(acc), 0, 'g', 5)
-                       .arg(mean(acc), 0, 'g', 5)
-                       .arg(std::sqrt(variance(acc)), 0, 'g', 5)
-                );
-
-                QCPGraph* graph = plot_->addGraph();
-                graph->setPen(QPen(color));
-
-                double graphmin = std::numeric_limits<double>::max();;
-                double graphmax = std::numeric_limits<double>::min();
-
-                if(mode == PlotMode_YearlyAverages)
-                {
-                    QDateTime workingdate = QDateTime::fromSecsSinceEpoch(startDate, Qt::OffsetFromUTC, 0);
-                    QVector<double> displayedx, displayedy;
-
-                    int prevyear = workingdate.date().year();
-
-                    int dayscnt = 0;
-                    accumulator_set<double, stats<tag::mean>> localAcc;
-
-                    for(int j = 0; j < cnt; ++j)
-                    {
-                        localAcc(yval[j]);
-                        dayscnt++;
-                        int curyear = workingdate.date().year();
-                        if((curyear != prevyear || (j == cnt-1)) && dayscnt > 0)
-                        {
-                            double value = mean(localAcc);
-                            displayedy.push_back(value);
-                            displayedx.push_back(QDateTime(QDate(prevyear, 1, 1), QTime(), Qt::OffsetFromUTC, 0).toSecsSinceEpoch());
-                            graphmin = std::min(graphmin, value);
-                            graphmax = std::max(graphmax, value);
-
-                            localAcc = accumulator_set<double, stats<tag::mean>>(); //NOTE: Reset it.
-                            dayscnt = 0;
-                            prevyear = curyear;
-                        }
-                        workingdate = workingdate.addDays(1);
-                    }
-                    QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
-                    dateTicker->setDateTimeFormat("yyyy");
-                    plot_->xAxis->setTicker(dateTicker);
-
-                    graph->setData(displayedx, displayedy, true);
-                }
-                else if(mode == PlotMode_MonthlyAverages)
-                {
-                    QVector<double> displayedx, displayedy;
-
-                    QDateTime workingdate = QDateTime::fromSecsSinceEpoch(startDate, Qt::OffsetFromUTC, 0);
-                    int prevmonth = workingdate.date().month();
-                    int prevyear = workingdate.date().year();
-
-                    accumulator_set<double, stats<tag::mean>> localAcc;
-                    //double sum = 0;
-                    int dayscnt = 0;
-                    for(int j = 0; j < cnt; ++j)
-                    {
-                        localAcc(yval[j]);
-                        //sum += yval[j];
-                        dayscnt++;
-                        int curmonth = workingdate.date().month();
-                        if((curmonth != prevmonth || (j == cnt-1)) && dayscnt > 0)
-                        {
-                            double value = mean(localAcc);
-                            displayedy.push_back(value);
-                            displayedx.push_back(QDateTime(QDate(prevyear, prevmonth, 1), QTime(), Qt::OffsetFromUTC, 0).toSecsSinceEpoch());
-                            graphmin = std::min(graphmin, value);
-                            graphmax = std::max(graphmax, value);
-
-                            localAcc = accumulator_set<double, stats<tag::mean>>(); //NOTE: Reset it.
-                            dayscnt = 0;
-                            prevmonth = curmonth;
-                            prevyear = workingdate.date().year();
-                        }
-                        workingdate = workingdate.addDays(1);
-                    }
-                    QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
-                    dateTicker->setDateTimeFormat("MMMM\nyyyy");
-                    plot_->xAxis->setTicker(dateTicker);
-
-                    graph->setData(displayedx, displayedy, true);
-                }
-                else if ( mode == PlotMode_DailyNormalized)
-                {
-//                    double currentMean = mean(acc);
-                    double range = max(acc) - min(acc);
-                    graphmin = 0.;
-                    graphmax = 1.;
-                    QVector<double> displayedx(cnt);
-                    QVector<double> displayedy(cnt);
-                    for(int j = 0; j < cnt; ++j)
-                    {
-                        displayedy[j] = (yval[j] - min(acc)) / range ;
-                        displayedx[j] = (double)(startDate + 24*3600*j);
-                    }
-                    QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
-                    dateTicker->setDateTimeFormat("d. MMMM\nyyyy");
-                    plot_->xAxis->setTicker(dateTicker);
-
-                    if(scatter[i])
-                    {
-                        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, QPen(Qt::black, 1.5), QBrush(Qt::white), 9));
-                    }
-
-                    graph->setData(displayedx, displayedy, true);
-
-                }
-                else //mode == PlotMode_Daily
-                {
-                    graphmin = min(acc);
-                    graphmax = max(acc);
+            PlottedGraph &entry = graphs_[key];
 
-                    QVector<double> displayedx(cnt);
-                    for(int j = 0; j < cnt; ++j)
-                    {
-                        double value = yval[j];
-                        displayedx[j] = (double)(startDate + 24*3600*j);
-                    }
+            //NOTE: The entry keeps the values it was built from alive, so if the cache now has different values for the ID (e.g. after a model
+            // run), they are in a different buffer.
+            if(!entry.data || entry.source.data() != series->values.data() || entry.source.count() != series->values.count())
+            {
+                buildGraphData(ID, *series, mode, entry);
+                if(entry.graph) entry.graph->setData(entry.shownData);
+            }
 
-                    QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
-                    dateTicker->setDateTimeFormat("d. MMMM\nyyyy");
-                    plot_->xAxis->setTicker(dateTicker);
+            if(!entry.graph)
+            {
+                entry.color = unusedGraphColor();
+                entry.graph = plot_->addGraph();
+                entry.graph->setPen(QPen(entry.color));
+                entry.graph->setData(entry.shownData); //NOTE: Shares the container, does not copy it.
+            }
 
-                    if(scatter[i])
-                    {
-                        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, QPen(Qt::black, 1.5), QBrush(Qt::white), 9));
-                    }
+            if(scatter[i] && (mode == PlotMode_Daily || mode == PlotMode_DailyNormalized))
+            {
+                entry.graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, QPen(Qt::black, 1.5), QBrush(Qt::white), 9));
+            }
+            else
+            {
+                entry.graph->setScatterStyle(QCPScatterStyle());
+            }
 
-                    graph->setData(displayedx, yval, true);
-                }
+            resultsInfo_->append(QString(
+                    "%1 <font color=%2>&#9608;&#9608;</font><br/>"
+                    "min: %3<br/>"
+                    "max: %4<br/>"
+                    "average: %5<br/>"
+                    "standard deviation: %6<br/>"
+                    "<br/>"
+                  ).arg(resultnames[i], entry.color.name())
+                   .arg(entry.min, 0, 'g', 5)
+                   .arg(entry.max, 0, 'g', 5)
+                   .arg(entry.mean, 0, 'g', 5)
+                   .arg(entry.standardDeviation, 0, 'g', 5)
+            );
 
+            maxyrange = std::max(entry.graphMax, maxyrange);
+            minyrange = std::min(entry.graphMin, minyrange);
+            if(maxyrange - minyrange < QCPRange::minRange)
+            {
+                maxyrange = minyrange + 2.0*QCPRange::minRange;
+            }
+            plot_->yAxis->setRange(minyrange, maxyrange);
 
-                maxyrange = std::max(graphmax, maxyrange);
-                minyrange = std::min(graphmin, minyrange);
-                if(maxyrange - minyrange < QCPRange::minRange)
-                {
-                    maxyrange = minyrange + 2.0*QCPRange::minRange;
-                }
-                plot_->yAxis->setRange(minyrange, maxyrange);
-
-                if (!isSetXrange_)
-                { 
-                    bool foundrange;
-                    QCPRange range = graph->data()->keyRange(foundrange);
-                    plot_->xAxis->setRange(range);
-                    xrange_ = range;
-                    isSetXrange_ = true;
-                }
-                else
-                {
-                    plot_->xAxis->setRange(xrange_);
-                }
+            if (!isSetXrange_)
+            {
+                bool foundrange;
+                QCPRange range = entry.data->keyRange(foundrange);
+                plot_->xAxis->setRange(range);
+                xrange_ = range;
+                isSetXrange_ = true;
+            }
+            else
+            {
+                plot_->xAxis->setRange(xrange_);
             }
         }
+
+        updateRetainedSeries();
+        updateLevelOfDetail();
     }
     else //mode == PlotMode_Error || mode == PlotMode_ErrorNormalProbability || mode == PlotMode_ErrorHistogram
     {
-        if(IDs.count() == 2)
+        removeAllGraphs();
+
+        //NOTE: Each modeled series (a result) is compared against an observed one (an input): the first selected result with the first
+        // selected input and so on. If the selection is not a mix of results and inputs, the series are taken two by two in the order
+        // they were selected, the modeled one first.
+        QVector<int> modeledIdx;
+        QVector<int> observedIdx;
+        for(int idx = 0; idx < IDs.count(); ++idx)
         {
-            int ID0 = IDs[0];
-            int ID1 = IDs[1];
-
-            int64_t startDatemod = startDateCache_[ID0];
-            int64_t startDateobs = startDateCache_[ID1];
-            int64_t startDate = std::max(startDatemod, startDateobs);
-            int64_t alignmod = 0;
-            int64_t alignobs = 0;
-            if(startDatemod < startDateobs)
-            {
-                alignmod = (startDateobs-startDatemod)/86400; //Again, this assumes one-day-timesteps...
-            }
-            else if(startDateobs < startDatemod)
+            if(databaseOf(IDs[idx]) == SeriesDatabase_Results) modeledIdx.push_back(idx);
+            else observedIdx.push_back(idx);
+        }
+        if(modeledIdx.empty() || observedIdx.empty())
+        {
+            modeledIdx.clear();
+            observedIdx.clear();
+            for(int idx = 0; idx + 1 < IDs.count(); idx += 2)
             {
-                alignobs = (startDatemod-startDateobs)/86400; //Again, this assumes one-day-timesteps...
+                modeledIdx.push_back(idx);
+                observedIdx.push_back(idx + 1);
             }
+        }
+        int paircount = std::min(modeledIdx.count(), observedIdx.count());
 
-            const QVector<double>& modeled = cache_[ID0];
-            const QVector<double>& observed = cache_[ID1];
+        auto viewOf = [](const CachedSeries *series)
+        {
+            TimeSeriesView view;
+            view.values = series->values.data();
+            view.count = series->values.count();
+            view.startDate = series->startDate;
+            view.timestep = series->timestep;
+            return view;
+        };
+
+        //NOTE: The cache does not evict the plotted series (they are pinned), so the views stay valid while the pairs are scored.
+        QVector<GoodnessOfFitInput> inputs;
+        QVector<int> pairOf;
+        for(int pair = 0; pair < paircount; ++pair)
+        {
+            const CachedSeries *modseries = findCached(IDs[modeledIdx[pair]]);
+            const CachedSeries *obsseries = findCached(IDs[observedIdx[pair]]);
+            if(!modseries || !obsseries) continue;
+
+            GoodnessOfFitInput input;
+            input.modeled = viewOf(modseries);
+            input.observed = viewOf(obsseries);
+            inputs.push_back(input);
+            pairOf.push_back(pair);
+        }
 
+        QVector<GoodnessOfFit> fits = computeGoodnessOfFit(inputs);
 
-            //TODO: we actually need to compute an offset here to align them!
+        for(int fitIdx = 0; fitIdx < fits.count(); ++fitIdx)
+        {
+            const GoodnessOfFit &fit = fits[fitIdx];
+            QString modeledName = resultnames[modeledIdx[pairOf[fitIdx]]];
+            QString observedName = resultnames[observedIdx[pairOf[fitIdx]]];
 
-            QString modeledName = resultnames[0];
-            QString observedName = resultnames[1];
+            if(fit.alignment != Alignment_Ok)
+            {
+                QString reason;
+                if(fit.alignment == Alignment_DifferentTimesteps)   reason = "they have different timesteps";
+                else if(fit.alignment == Alignment_MisalignedSteps) reason = "their time steps fall on different dates";
+                else                                                reason = "they do not overlap in time";
+                resultsInfo_->append(QString("Can not compare %1 against %2 since %3.<br/>").arg(modeledName, observedName, reason));
+                continue;
+            }
+
+            resultsInfo_->append(QString(
+                    "Observed: %1, vs Modeled: %2<br/>"
+                    "mean error (bias): %3<br/>"
+                    "mean absolute error: %4<br/>"
+                    "mean squared error: %5<br/>"
+                    "root mean squared error: %6<br/>"
+                    "Nash-Sutcliffe: %7<br/>"
+                    "log Nash-Sutcliffe: %8<br/>"
+                    "Kling-Gupta: %9 (r: %10, alpha: %11, beta: %12)<br/>"
+                    "percent bias: %13<br/>"
+                    "R<sup>2</sup>: %14<br/>"
+                  ).arg(observedName, modeledName)
+                   .arg(fit.meanError, 0, 'g', 5)
+                   .arg(fit.meanAbsoluteError, 0, 'g', 5)
+                   .arg(fit.meanSquaredError, 0, 'g', 5)
+                   .arg(fit.rootMeanSquaredError, 0, 'g', 5)
+                   .arg(fit.nashSutcliffe, 0, 'g', 5)
+                   .arg(fit.logNashSutcliffe, 0, 'g', 5)
+                   .arg(fit.klingGupta, 0, 'g', 5)
+                   .arg(fit.kgeCorrelation, 0, 'g', 5)
+                   .arg(fit.kgeVariability, 0, 'g', 5)
+                   .arg(fit.kgeBias, 0, 'g', 5)
+                   .arg(fit.percentBias, 0, 'g', 5)
+                   .arg(fit.rSquared, 0, 'g', 5)
+            );
+        }
 
-            if(observed.empty() || modeled.empty()) return;
+        //NOTE: Only the first pair is plotted, the others are just scored.
+        if(!fits.empty() && pairOf[0] == 0 && fits[0].alignment == Alignment_Ok && fits[0].residuals.count > 0)
+        {
+            AlignedSeriesPair aligned;
+            alignSeries(inputs[0].observed, inputs[0].modeled, aligned);
+            const ResidualStatistics &stats = fits[0].residuals;
 
-            //TODO: Should we give a warning if the count of the two sets are not equal?
-            int count = std::min((int64_t)observed.count()-alignobs, modeled.count()-alignmod);
+            int count = (int)aligned.count;
+            int64_t startDate = aligned.startDate;
+            int64_t timestep = aligned.timestep;
 
             QVector<double> residuals(count);
             QVector<double> xval(count);
 
-            using namespace boost::accumulators;
-
-            //TODO: Do we really need separate accumulators for residual, absolute residual and squared residual? Could they be handled by one accumulator?
-            accumulator_set<double, stats<tag::variance>> obsacc;
-            accumulator_set<double, stats<tag::mean, tag::min, tag::max>>  residualacc;
-            accumulator_set<double, stats<tag::mean>> residualabsacc;
-            accumulator_set<double, stats<tag::mean>> residualsquareacc;
-            accumulator_set<double, stats<tag::mean, tag::variance, tag::covariance<double, tag::covariate1>>> xacc;
-
             for(int i = 0; i < count; ++i)
             {
-                xval[i] = (double)(startDate + 24*3600*i);
-                double mod = modeled[i+alignmod];
-                double obs = observed[i+alignobs];
-
-                if(!std::isnan(mod) && !std::isnan(obs))
-                {
-                    double residual = obs - mod;
-                    residuals[i] = residual;
-
-                    obsacc(obs);
-                    residualacc(residual);
-                    residualabsacc(std::abs(residual));
-                    residualsquareacc(residual*residual);
-
-                    xacc(xval[i], covariate1=residual);
-                }
-                else
-                {
-                    residuals[i] = std::numeric_limits<double>::quiet_NaN();
-                }
+                xval[i] = (double)(startDate + timestep*i);
+                residuals[i] = aligned.observed[i] - aligned.modeled[i]; //NOTE: NaN if either is missing.
             }
 
-            double observedvariance = variance(obsacc);
-
-            double meanx        = mean(xacc);
-            double xvariance    = variance(xacc);
-            double xycovariance = covariance(xacc);
-
-            double minres = min(residualacc);
-            double maxres = max(residualacc);
-
-            double meanerror         = mean(residualacc);
-            double meanabsoluteerror = mean(residualabsacc);
-            double meansquarederror  = mean(residualsquareacc);
+            double meanx        = stats.xMean;
+            double xvariance    = stats.xVariance;
+            double xycovariance = stats.xResidualCovariance;
 
-            //TODO: There looks like there is something wrong with the Nash-Sutcliffe coefficient, but I don't know what!
+            double minres = stats.minResidual;
+            double maxres = stats.maxResidual;
 
-            double nashsutcliffe = 1.0 - meansquarederror / observedvariance;
-
-            resultsInfo_->append(QString(
-                    "Observed: %1, vs Modeled: %2<br/>"
-                    "mean error (bias): %3<br/>"
-                    "mean absolute error: %4<br/>"
-                    "mean squared error: %5<br/>"
-                    "Nash-Sutcliffe: %6<br/>"
-                  ).arg(observedName, modeledName)
-                   .arg(meanerror, 0, 'g', 5)
-                   .arg(meanabsoluteerror, 0, 'g', 5)
-                   .arg(meansquarederror, 0, 'g', 5)
-                   .arg(nashsutcliffe, 0, 'g', 5)
-            );
+            double meanerror = stats.meanError;
 
             //TODO: Make all the error plots nicer when the error is very small.
             double epsilon = 1e-6; //TODO: Find a less arbitrary epsilon.
@@ -491,6 +542,45 @@ void Plotter::plotGraphs(const QVector<int>& IDs, const QVector<QString>& result
     plot_->replot();
 }
 
+void Plotter::updateLevelOfDetail()
+{
+    QCPRange range = plot_->xAxis->range();
+    int maxBuckets = std::max(1, plot_->xAxis->axisRect()->width()); //NOTE: Each bucket gives up to two points, its min and its max.
+
+    QVector<QCPGraphData> decimated;
+    for(auto &item : graphs_)
+    {
+        PlottedGraph &entry = item.second;
+        if(!entry.graph) continue;
+
+        if(entry.pyramid.decimate(*entry.data, range, maxBuckets, decimated))
+        {
+            if(entry.shownData == entry.data) entry.shownData.reset(new QCPGraphDataContainer);
+            entry.shownData->set(decimated, true);
+        }
+        else
+        {
+            entry.shownData = entry.data;
+        }
+
+        if(entry.graph->data() != entry.shownData) entry.graph->setData(entry.shownData);
+    }
+}
+
+const QCPGraphDataContainer *Plotter::graphData(QCPGraph *graph, int &IDOut) const
+{
+    for(const auto &entry : graphs_)
+    {
+        if(entry.second.graph == graph)
+        {
+            IDOut = entry.first.first;
+            return entry.second.data.data();
+        }
+    }
+    IDOut = 0;
+    return graph->data().data();
+}
+
 void Plotter::setXrange(QCPRange xrange)
 {
     xrange_ = xrange;
@@ -2,7 +2,10 @@
 #define PLOTTER_H
 
 #include "qcustomplot.h"
-#include <unordered_map>
+#include "seriescache.h"
+#include "minmaxpyramid.h"
+#include <map>
+#include <set>
 
 enum PlotMode
 {
@@ -40,17 +43,57 @@ public:
     void filterUncachedIDs(const QVector<int>& IDs, QVector<int>& uncachedOut);
     void plotGraphs(const QVector<int>& IDs, const QVector<QString>& resultnames, PlotMode mode, QVector<bool> &scatter, bool logarithmicY);
 
-    void addToCache(const QVector<int>& newIDs, const QVector<QVector<double>>& newResultsets, const QVector<int64_t>& startDates);
-    void clearCache() { cache_.clear(); startDateCache_.clear(); }
+    //NOTE: The generations are the cache generations of the results and inputs databases at the time the series were requested. Series
+    // from a database that has changed since then are not cached.
+    void addToCache(const QVector<int>& newIDs, const QVector<SeriesData>& newResultsets, const QVector<int64_t>& startDates, const QVector<int64_t>& timesteps,
+                    quint64 resultsGeneration, quint64 inputsGeneration);
+    const CachedSeries *findCached(int ID) const { return cache_.find(databaseOf(ID), ID); }
+    quint64 cacheGeneration(SeriesDatabase database) const { return cache_.generation(database); }
+    void invalidateCache(SeriesDatabase database) { cache_.invalidate(database); }
+    void clearCache() { cache_.clear(); }
+    QString cacheStatistics() const { return cache_.statistics(); }
     void clearPlots();
 
     void setXrange(QCPRange);
+    //NOTE: Has to be called when the visible x range changes, so that long graphs are shown at a resolution that fits it.
+    void updateLevelOfDetail();
+
+    //NOTE: The graphs are not in the same order as currentPlottedIDs_ in the plot, so this is how to find out which ID a graph shows. ID is
+    // set to 0 for graphs that do not show a single series (the error modes).
+    const QCPGraphDataContainer *graphData(QCPGraph *graph, int &IDOut) const;
+    //NOTE: Input IDs are offset by the largest result ID, so this is needed to tell which database an ID belongs to.
+    void setMaxResultID(int maxResultID) { maxResultID_ = maxResultID; }
 
     QVector<int> currentPlottedIDs_;
 
-    std::unordered_map<int, QVector<double>> cache_; //NOTE: We want to be able to access this from the mainwindow, and I can't be bothered to write accessors for it.
-    std::unordered_map<int, int64_t> startDateCache_; //NOTE: For now we just store the start date for the plots and assume daily values. This should probably be improved eventually.
 private:
+    typedef std::pair<int, PlotMode> GraphKey;
+
+    struct PlottedGraph
+    {
+        SeriesData source; //NOTE: The values the graph data was built from. Keeping them here also keeps them alive, so the cache charges
+                           // them against its budget (see SeriesCache::setRetained).
+        QSharedPointer<QCPGraphDataContainer> data;      //NOTE: All the points.
+        QSharedPointer<QCPGraphDataContainer> shownData; //NOTE: What the graph shows, either data or a decimated version of it.
+        MinMaxPyramid pyramid;
+        QCPGraph *graph = nullptr; //NOTE: nullptr if the graph is not shown right now.
+        QColor color;
+
+        double min, max, mean, standardDeviation; //NOTE: Of the values of the series.
+        double graphMin, graphMax;                //NOTE: Of what is displayed.
+    };
+
+    void buildGraphData(int ID, const CachedSeries &series, PlotMode mode, PlottedGraph &entry);
+    void removeAllGraphs();
+    void updateRetainedSeries();
+    QColor unusedGraphColor();
+
+    SeriesDatabase databaseOf(int ID) const { return ID > maxResultID_ ? SeriesDatabase_Inputs : SeriesDatabase_Results; }
+
+    SeriesCache cache_;
+    std::map<GraphKey, PlottedGraph> graphs_;
+    int maxResultID_ = 0;
+
     QCustomPlot *plot_;
     QTextBrowser *resultsInfo_;
 
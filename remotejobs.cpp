@@ -0,0 +1,156 @@
+#include "remotejobs.h"
+
+RemoteJobScheduler::RemoteJobScheduler(SSHInterface *sshInterface, QObject *parent)
+    : QObject(parent), sshInterface_(sshInterface)
+{
+    pollTimer_.setInterval(2000);
+    QObject::connect(&pollTimer_, &QTimer::timeout, this, &RemoteJobScheduler::poll);
+}
+
+bool RemoteJobScheduler::start(const RemoteJobRequest &request)
+{
+    if(running_) return false;
+
+    request_ = request;
+    runningJobs_.clear();
+    nextJob_ = 0;
+    maxConcurrentJobs_ = request_.maxConcurrentJobs > 0 ? request_.maxConcurrentJobs : sshInterface_->getInstanceCoreCount();
+    running_ = true;
+
+    emit log(QString("Starting %1 jobs on the instance, %2 at a time.").arg(request_.jobs.count()).arg(maxConcurrentJobs_));
+
+    launchNext();
+    if(running_) pollTimer_.start();
+    return true;
+}
+
+//NOTE: The directories are quoted in the commands we run in them, but they are also handed to scp as the place to upload to, which older
+// versions of libssh pass to the remote shell as they are.
+static bool isValidJobDirectory(const QString &directory)
+{
+    if(directory.isEmpty() || directory.startsWith('-') || directory.startsWith('/')) return false;
+    for(QChar character : directory)
+    {
+        ushort c = character.unicode();
+        if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '/' || c == '-')) return false;
+    }
+    return true;
+}
+
+bool RemoteJobScheduler::launch(int index)
+{
+    const RemoteJob &job = request_.jobs[index];
+    if(!isValidJobDirectory(job.directory))
+    {
+        emit logError("The job directory \"" + job.directory + "\" can only contain letters, digits and _ . / -, and has to be relative.");
+        return false;
+    }
+    QByteArray directory = job.directory.toLatin1();
+
+    if(!sshInterface_->prepareRemoteJobDirectory(directory.data())) return false;
+
+    QByteArray remotelocation = (job.directory + "/").toLatin1();
+    for(const QPair<QString, QString> &upload : job.uploads)
+    {
+        QByteArray localpath = upload.first.toLatin1();
+        QByteArray remotename = upload.second.toLatin1();
+        if(!sshInterface_->uploadEntireFile(localpath.data(), remotelocation.data(), remotename.data())) return false;
+    }
+
+    QByteArray command = job.command.toLatin1();
+    return sshInterface_->startRemoteJob(directory.data(), command.data());
+}
+
+void RemoteJobScheduler::launchNext()
+{
+    while(running_ && runningJobs_.count() < maxConcurrentJobs_ && nextJob_ < request_.jobs.count())
+    {
+        int index = nextJob_++;
+        if(launch(index))
+        {
+            runningJobs_.push_back(index);
+        }
+        else
+        {
+            emit logError("Unable to start the job in " + request_.jobs[index].directory);
+            finishJob(index, false);
+        }
+    }
+
+    if(running_ && runningJobs_.empty() && nextJob_ >= request_.jobs.count()) finishBatch(false);
+}
+
+void RemoteJobScheduler::poll()
+{
+    if(!running_) return;
+
+    if(!sshInterface_->isInstanceConnected())
+    {
+        emit logError("Lost the connection to the instance while jobs were running on it.");
+        for(int index : runningJobs_) finishJob(index, false);
+        runningJobs_.clear();
+        finishBatch(true);
+        emit instanceDisconnected();
+        return;
+    }
+
+    QVector<QString> directories;
+    for(int index : runningJobs_) directories.push_back(request_.jobs[index].directory);
+
+    QVector<int> exitCodes;
+    if(!sshInterface_->getRemoteJobStatus(directories, exitCodes)) return; //NOTE: We try again at the next tick.
+
+    QVector<int> stillRunning;
+    for(int idx = 0; idx < runningJobs_.count(); ++idx)
+    {
+        int index = runningJobs_[idx];
+        int exitCode = exitCodes[idx];
+        if(exitCode == SSHInterface::remoteJobRunning)
+        {
+            stillRunning.push_back(index);
+            continue;
+        }
+
+        //NOTE: The output of the job is only fetched once it is done, so that checking on the jobs stays cheap.
+        std::string output;
+        QByteArray directory = request_.jobs[index].directory.toLatin1();
+        if(sshInterface_->getRemoteJobLog(directory.data(), output))
+        {
+            QString prefix = QString("[%1] ").arg(request_.jobs[index].directory);
+            for(const QString &line : QString::fromStdString(output).split('\n', QString::SkipEmptyParts)) emit log(prefix + line);
+        }
+
+        if(exitCode == SSHInterface::remoteJobLost) emit logError("The job in " + request_.jobs[index].directory + " stopped without finishing.");
+        finishJob(index, exitCode == 0);
+    }
+    runningJobs_ = stillRunning;
+
+    launchNext();
+}
+
+void RemoteJobScheduler::finishJob(int index, bool success)
+{
+    emit jobFinished(request_.batch, index, success);
+}
+
+void RemoteJobScheduler::finishBatch(bool cancelled)
+{
+    pollTimer_.stop();
+    running_ = false;
+    emit finished(request_.batch, cancelled);
+}
+
+void RemoteJobScheduler::cancel()
+{
+    if(!running_) return;
+
+    QVector<QString> directories;
+    for(int index : runningJobs_) directories.push_back(request_.jobs[index].directory);
+    sshInterface_->cancelRemoteJobs(directories);
+
+    for(int index : runningJobs_) finishJob(index, false);
+    runningJobs_.clear();
+    nextJob_ = request_.jobs.count(); //NOTE: The queued jobs are never started.
+
+    finishBatch(true);
+}
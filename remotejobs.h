@@ -0,0 +1,65 @@
+#ifndef REMOTEJOBS_H
+#define REMOTEJOBS_H
+
+#include "sshInterface.h"
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QString>
+#include <QPair>
+
+struct RemoteJob
+{
+    QString directory; //NOTE: Relative to the home directory on the instance. Has to be unique among the jobs that run at the same time, and
+                       // can only contain the characters A-Z a-z 0-9 _ . / - (a job in any other directory fails to start).
+    QString command;   //NOTE: Run by sh in the directory, which is the only shell that expands it.
+    QVector<QPair<QString, QString>> uploads; //NOTE: Local files to upload to the directory before the job is started, and their remote names.
+};
+
+struct RemoteJobRequest
+{
+    quint64 batch = 0; //NOTE: Handed back with every report about the jobs, so that the sender can tell its batches apart.
+    QVector<RemoteJob> jobs;
+    int maxConcurrentJobs = 0; //NOTE: 0 for one job per core on the instance.
+};
+
+//NOTE: Runs a batch of jobs on the instance, several at a time (by default as many as the instance has cores), and starts the next one in
+// the queue whenever one finishes. The jobs run detached from the session (see SSHInterface::startRemoteJob), so nothing is blocked while
+// they run. Instead we check on all of them with one short command every few seconds. Lives on the DataService thread.
+class RemoteJobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    RemoteJobScheduler(SSHInterface *sshInterface, QObject *parent = nullptr);
+
+    bool start(const RemoteJobRequest &request);
+    void cancel();
+    bool isRunning() const { return running_; }
+
+signals:
+    void jobFinished(quint64 batch, int index, bool success);
+    void finished(quint64 batch, bool cancelled);
+    void instanceDisconnected();
+
+    void log(const QString &);
+    void logError(const QString &);
+
+private:
+    void launchNext();
+    bool launch(int index);
+    void poll();
+    void finishJob(int index, bool success);
+    void finishBatch(bool cancelled);
+
+    SSHInterface *sshInterface_;
+    QTimer pollTimer_;
+
+    RemoteJobRequest request_;
+    QVector<int> runningJobs_;
+    int maxConcurrentJobs_ = 1;
+    int nextJob_ = 0;
+    bool running_ = false;
+};
+
+#endif // REMOTEJOBS_H
@@ -0,0 +1,114 @@
+#include "seriesaggregates.h"
+#include "calendar.h"
+#include <cmath>
+#include <limits>
+
+double AggregateBin::mean() const
+{
+    //NOTE: A bin where all the values are missing has no mean. NaN makes the plot leave a gap there.
+    if(count == 0) return std::numeric_limits<double>::quiet_NaN();
+    return sum / (double)count;
+}
+
+static AggregateBin emptyBin(int64_t date)
+{
+    AggregateBin bin;
+    bin.date = date;
+    bin.sum = 0.0;
+    bin.min = std::numeric_limits<double>::infinity();
+    bin.max = -std::numeric_limits<double>::infinity();
+    bin.count = 0;
+    bin.nanCount = 0;
+    return bin;
+}
+
+static void addValue(AggregateBin &bin, double value)
+{
+    if(std::isnan(value))
+    {
+        ++bin.nanCount;
+        return;
+    }
+    bin.sum += value;
+    bin.min = std::min(bin.min, value);
+    bin.max = std::max(bin.max, value);
+    ++bin.count;
+}
+
+static void addBin(AggregateBin &bin, const AggregateBin &other)
+{
+    bin.sum += other.sum;
+    bin.min = std::min(bin.min, other.min);
+    bin.max = std::max(bin.max, other.max);
+    bin.count += other.count;
+    bin.nanCount += other.nanCount;
+}
+
+static int64_t startOfMonth(int64_t seconds)
+{
+    calendar_date date = date_from_seconds(seconds);
+    return seconds_from_date(date.year, date.month, 1);
+}
+
+static int64_t startOfNextMonth(int64_t monthStart)
+{
+    calendar_date date = date_from_seconds(monthStart);
+    if(date.month == 12) return seconds_from_date(date.year + 1, 1, 1);
+    return seconds_from_date(date.year, date.month + 1, 1);
+}
+
+static int64_t startOfYear(int64_t seconds)
+{
+    return seconds_from_date(date_from_seconds(seconds).year, 1, 1);
+}
+
+//NOTE: Puts the values in bins that start at the times given by binStart. We only have to find the start of a new bin when we step past the
+// end of the current one, so the calendar is consulted once per bin and not once per value.
+template<typename BinStart, typename NextBinStart>
+static void binValues(const SeriesData &values, int64_t startDate, int64_t timestep, BinStart binStart, NextBinStart nextBinStart, QVector<AggregateBin> &binsOut)
+{
+    int64_t date = startDate;
+    int64_t end = std::numeric_limits<int64_t>::min();
+    for(int i = 0; i < values.count(); ++i)
+    {
+        if(date >= end)
+        {
+            int64_t start = binStart(date);
+            end = nextBinStart(start);
+            binsOut.push_back(emptyBin(start));
+        }
+        addValue(binsOut.last(), values[i]);
+        date += timestep;
+    }
+}
+
+template<typename BinStart>
+static void mergeBins(const QVector<AggregateBin> &bins, BinStart binStart, QVector<AggregateBin> &binsOut)
+{
+    for(const AggregateBin &bin : bins)
+    {
+        int64_t start = binStart(bin.date);
+        if(binsOut.empty() || binsOut.last().date != start) binsOut.push_back(emptyBin(start));
+        addBin(binsOut.last(), bin);
+    }
+}
+
+SeriesAggregates::SeriesAggregates(const SeriesData &values, int64_t startDate, int64_t timestep)
+{
+    if(timestep <= 0 || values.empty()) return;
+
+    if(timestep < seconds_per_day)
+    {
+        binValues(values, startDate, timestep,
+                  [](int64_t date) { return day_from_seconds(date)*seconds_per_day; },
+                  [](int64_t start) { return start + seconds_per_day; },
+                  daily_);
+        mergeBins(daily_, startOfMonth, monthly_);
+    }
+    else
+    {
+        binValues(values, startDate, timestep, startOfMonth, startOfNextMonth, monthly_);
+    }
+
+    mergeBins(monthly_, startOfYear, yearly_);
+}
@@ -0,0 +1,37 @@
+#ifndef SERIESAGGREGATES_H
+#define SERIESAGGREGATES_H
+
+#include "seriesdata.h"
+#include <QVector>
+#include <stdint.h>
+
+//NOTE: Summary of the values of a series that fall in one day, month or year. Missing values (NaN) are counted separately and do not
+// take part in the sum, min or max.
+struct AggregateBin
+{
+    int64_t date; //NOTE: Seconds since epoch of the start of the day, month or year.
+    double sum;
+    double min;
+    double max;
+    int32_t count; //NOTE: Number of values that were not NaN.
+    int32_t nanCount;
+
+    double mean() const;
+};
+
+//NOTE: Daily, monthly and yearly aggregates of a series, computed in one pass over the values. Each level is built from the level below it
+// instead of from the values again. The daily level is only stored for series with a timestep shorter than a day, since for a daily
+// series it would just be a (larger) copy of the series itself.
+class SeriesAggregates
+{
+public:
+    SeriesAggregates(const SeriesData &values, int64_t startDate, int64_t timestep);
+
+    qint64 bytes() const { return (qint64)(daily_.count() + monthly_.count() + yearly_.count())*sizeof(AggregateBin); }
+
+    QVector<AggregateBin> daily_;
+    QVector<AggregateBin> monthly_;
+    QVector<AggregateBin> yearly_;
+};
+
+#endif // SERIESAGGREGATES_H
@@ -0,0 +1,183 @@
+#include "seriescache.h"
+
+SeriesCache::SeriesCache(qint64 byteBudget)
+{
+    byteBudget_ = byteBudget;
+}
+
+bool SeriesCache::lookup(int database, int ID)
+{
+    SeriesKey key = {database, generations_[database], ID};
+    auto find = entries_.find(key);
+    if(find == entries_.end())
+    {
+        ++misses_;
+        return false;
+    }
+
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, find->second.lruPosition);
+    return true;
+}
+
+const CachedSeries *SeriesCache::find(int database, int ID) const
+{
+    SeriesKey key = {database, generations_[database], ID};
+    auto find = entries_.find(key);
+    if(find == entries_.end()) return nullptr;
+    return &find->second.series;
+}
+
+void SeriesCache::insert(int database, quint64 generation, int ID, const CachedSeries &series)
+{
+    if(generation != generations_[database]) return;
+
+    SeriesKey key = {database, generation, ID};
+    auto find = entries_.find(key);
+    if(find != entries_.end()) erase(find);
+
+    lru_.push_front(key);
+
+    Entry entry;
+    entry.series = series;
+    entry.buffer = series.values.bufferID();
+    entry.lruPosition = lru_.begin();
+    if(entry.series.aggregates)
+    {
+        entry.aggregateBytes = entry.series.aggregates->bytes();
+        bytesUsed_ += entry.aggregateBytes;
+    }
+    entries_[key] = entry;
+
+    //NOTE: The series that came in one transfer share its buffer, so only the first of them to be inserted is charged for it.
+    BufferUse &use = buffers_[entry.buffer];
+    if(use.series++ == 0)
+    {
+        use.bytes = series.values.bufferSize();
+        bytesUsed_ += use.bytes;
+        auto retained = retained_.find(entry.buffer);
+        if(retained != retained_.end()) retainedBytes_ -= retained->second;
+    }
+
+    evict();
+}
+
+QSharedPointer<const SeriesAggregates> SeriesCache::aggregates(int database, int ID)
+{
+    SeriesKey key = {database, generations_[database], ID};
+    auto find = entries_.find(key);
+    if(find == entries_.end()) return QSharedPointer<const SeriesAggregates>();
+
+    Entry &entry = find->second;
+    if(!entry.series.aggregates)
+    {
+        const CachedSeries &series = entry.series;
+        entry.series.aggregates.reset(new SeriesAggregates(series.values, series.startDate, series.timestep));
+        entry.aggregateBytes = entry.series.aggregates->bytes();
+        bytesUsed_ += entry.aggregateBytes;
+    }
+    return entry.series.aggregates;
+}
+
+void SeriesCache::invalidate(int database)
+{
+    ++generations_[database];
+
+    for(auto it = entries_.begin(); it != entries_.end(); )
+    {
+        auto current = it++;
+        if(current->first.database == database) erase(current);
+    }
+}
+
+void SeriesCache::clear()
+{
+    for(int database = 0; database < SeriesDatabase_Count; ++database) ++generations_[database];
+
+    entries_.clear();
+    lru_.clear();
+    buffers_.clear();
+    bytesUsed_ = 0;
+
+    retainedBytes_ = 0;
+    for(const auto &retained : retained_) retainedBytes_ += retained.second;
+}
+
+void SeriesCache::setPinned(const QVector<QPair<int, int>> &databaseAndIDs)
+{
+    pinned_.clear();
+    for(const QPair<int, int> &pin : databaseAndIDs) pinned_.insert(std::make_pair(pin.first, pin.second));
+
+    //NOTE: Whatever was kept only because it was pinned may have to go now.
+    evict();
+}
+
+void SeriesCache::setRetained(const QVector<SeriesData> &series)
+{
+    retained_.clear();
+    for(const SeriesData &values : series)
+    {
+        if(!values.empty()) retained_[values.bufferID()] = values.bufferSize();
+    }
+
+    retainedBytes_ = 0;
+    for(const auto &retained : retained_)
+    {
+        if(!buffers_.count(retained.first)) retainedBytes_ += retained.second;
+    }
+
+    evict();
+}
+
+void SeriesCache::setByteBudget(qint64 byteBudget)
+{
+    byteBudget_ = byteBudget;
+    evict();
+}
+
+void SeriesCache::evict()
+{
+    auto at = lru_.end();
+    while(bytesUsed_ + retainedBytes_ > byteBudget_ && at != lru_.begin())
+    {
+        --at;
+        SeriesKey key = *at;
+        if(pinned_.count(std::make_pair(key.database, key.ID))) continue;
+
+        ++at; //NOTE: Step past the one we erase so that the iterator stays valid.
+        erase(entries_.find(key));
+        ++evictions_;
+    }
+}
+
+void SeriesCache::erase(std::unordered_map<SeriesKey, Entry, SeriesKeyHash>::iterator find)
+{
+    Entry &entry = find->second;
+    bytesUsed_ -= entry.aggregateBytes;
+
+    //NOTE: Evicting a series that shares its buffer with series that are still cached frees nothing but the aggregates. The series from one
+    // transfer are next to each other in the LRU order, so they usually go together.
+    auto use = buffers_.find(entry.buffer);
+    if(--use->second.series == 0)
+    {
+        bytesUsed_ -= use->second.bytes;
+        auto retained = retained_.find(entry.buffer);
+        if(retained != retained_.end()) retainedBytes_ += retained->second; //NOTE: Still alive, the plots hold it now.
+        buffers_.erase(use);
+    }
+
+    lru_.erase(find->second.lruPosition);
+    entries_.erase(find);
+}
+
+QString SeriesCache::statistics() const
+{
+    return QString("Series cache: %1 series, %2 of %3 MB (%4 MB held only by the plots), %5 hits, %6 misses, %7 evictions")
+            .arg((int)entries_.size())
+            .arg((double)bytesUsed() / (1024.0*1024.0), 0, 'f', 1)
+            .arg((double)byteBudget_ / (1024.0*1024.0), 0, 'f', 0)
+            .arg((double)retainedBytes_ / (1024.0*1024.0), 0, 'f', 1)
+            .arg(hits_)
+            .arg(misses_)
+            .arg(evictions_);
+}
@@ -0,0 +1,119 @@
+#ifndef SERIESCACHE_H
+#define SERIESCACHE_H
+
+#include "seriesdata.h"
+#include "seriesaggregates.h"
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <list>
+#include <set>
+#include <unordered_map>
+
+enum SeriesDatabase
+{
+    SeriesDatabase_Results = 0,
+    SeriesDatabase_Inputs,
+    SeriesDatabase_Count,
+};
+
+struct CachedSeries
+{
+    SeriesData values;
+    int64_t startDate; //NOTE: Seconds since epoch of the first value.
+    int64_t timestep;  //NOTE: In seconds.
+
+    //NOTE: Computed the first time SeriesCache::aggregates is asked for them, and then kept for as long as the series stays in the cache.
+    QSharedPointer<const SeriesAggregates> aggregates;
+};
+
+//NOTE: The generation of a database is increased every time its contents may have changed (e.g. the results after a model run), which
+// invalidates everything that was cached from it before.
+struct SeriesKey
+{
+    int database;
+    quint64 generation;
+    int ID;
+
+    bool operator==(const SeriesKey &other) const { return database == other.database && generation == other.generation && ID == other.ID; }
+};
+
+struct SeriesKeyHash
+{
+    size_t operator()(const SeriesKey &key) const
+    {
+        return std::hash<quint64>()(((quint64)key.ID << 32) ^ ((quint64)key.database << 28) ^ key.generation);
+    }
+};
+
+//NOTE: A least recently used cache of series, bounded by the number of bytes it keeps alive. Series that are views into one received buffer
+// (see SeriesData) are charged for that buffer once between them, since it is only freed when the last of them is evicted. The aggregates of
+// a series are charged to it once they are computed. Pinned series (the ones that are plotted right now) are never evicted, so the cache can
+// go over budget if a single selection is larger than the budget.
+class SeriesCache
+{
+public:
+    SeriesCache(qint64 byteBudget = 256*1024*1024);
+
+    //NOTE: Counts a hit or a miss and marks the series as recently used. Use this when deciding whether a series has to be fetched.
+    bool lookup(int database, int ID);
+    //NOTE: Does not count or reorder anything. Returns nullptr if the series is not cached.
+    const CachedSeries *find(int database, int ID) const;
+
+    //NOTE: Ignored if generation is no longer the current generation of the database, i.e. if the series was requested before the database changed.
+    void insert(int database, quint64 generation, int ID, const CachedSeries &series);
+
+    //NOTE: Returns nullptr if the series is not cached. Nothing is evicted here, so a CachedSeries that the caller holds stays valid. If the
+    // aggregates take the cache over budget it is brought back under it on the next insert.
+    QSharedPointer<const SeriesAggregates> aggregates(int database, int ID);
+
+    quint64 generation(int database) const { return generations_[database]; }
+    void invalidate(int database);
+    void clear();
+
+    void setPinned(const QVector<QPair<int, int>> &databaseAndIDs);
+    //NOTE: The series that are kept alive outside the cache (by the plots). Their buffers are charged against the budget for as long as no
+    // cached series keeps them alive, e.g. after the series were invalidated or evicted, so that what the plots hold is not on top of it.
+    void setRetained(const QVector<SeriesData> &series);
+    void setByteBudget(qint64 byteBudget);
+
+    qint64 bytesUsed() const { return bytesUsed_ + retainedBytes_; }
+    QString statistics() const;
+
+private:
+    struct Entry
+    {
+        CachedSeries series;
+        const void *buffer; //NOTE: The bufferID of the values.
+        qint64 aggregateBytes = 0;
+        std::list<SeriesKey>::iterator lruPosition;
+    };
+
+    struct BufferUse
+    {
+        qint64 bytes = 0;
+        int series = 0; //NOTE: How many entries keep the buffer alive.
+    };
+
+    void evict();
+    void erase(std::unordered_map<SeriesKey, Entry, SeriesKeyHash>::iterator find);
+
+    std::unordered_map<SeriesKey, Entry, SeriesKeyHash> entries_;
+    std::list<SeriesKey> lru_; //NOTE: Most recently used first.
+    std::set<std::pair<int, int>> pinned_;
+    std::unordered_map<const void *, BufferUse> buffers_;
+    std::unordered_map<const void *, qint64> retained_; //NOTE: The sizes of the buffers given to setRetained.
+    qint64 retainedBytes_ = 0;                          //NOTE: Of the retained buffers that are not also in buffers_.
+
+    quint64 generations_[SeriesDatabase_Count] = {};
+
+    qint64 byteBudget_;
+    qint64 bytesUsed_ = 0;
+
+    quint64 hits_ = 0;
+    quint64 misses_ = 0;
+    quint64 evictions_ = 0;
+};
+
+#endif // SERIESCACHE_H
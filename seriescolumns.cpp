@@ -0,0 +1,153 @@
+#include "seriescolumns.h"
+#include <string.h>
+
+static uint64_t alignTo8(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+bool ColumnarSeriesWriter::begin(QFile *file, const QVector<int> &IDs, const QVector<QString> &names, const QVector<QString> &units)
+{
+    file_ = file;
+    added_ = 0;
+    headers_.clear();
+    headers_.resize(IDs.count());
+
+    QByteArray strings;
+    for(int idx = 0; idx < IDs.count(); ++idx)
+    {
+        QByteArray name = names[idx].toUtf8();
+        QByteArray unit = units[idx].toUtf8();
+
+        column_serial_header &header = headers_[idx];
+        memset(&header, 0, sizeof(header));
+        header.ID = (uint32_t)IDs[idx];
+        header.nameOffset = (uint32_t)strings.size();
+        header.nameLen = (uint32_t)name.size();
+        strings += name;
+        header.unitOffset = (uint32_t)strings.size();
+        header.unitLen = (uint32_t)unit.size();
+        strings += unit;
+    }
+
+    stringsOffset_ = sizeof(columns_file_header) + (uint64_t)headers_.count()*sizeof(column_serial_header);
+    stringsSize_ = (uint64_t)strings.size();
+    strings.append(QByteArray((int)(alignTo8(stringsOffset_ + stringsSize_) - (stringsOffset_ + stringsSize_)), '\0'));
+
+    //NOTE: The headers are written in finish(), when the counts and offsets are known. Until then their space is just skipped.
+    return file_->seek((qint64)stringsOffset_) && file_->write(strings) == strings.size();
+}
+
+bool ColumnarSeriesWriter::addSeries(int64_t startDate, int64_t timestep, const double *values, int64_t count)
+{
+    if(added_ >= headers_.count()) return false;
+
+    column_serial_header &header = headers_[added_++];
+    header.startDate = startDate;
+    header.timestep = timestep;
+    header.count = (uint64_t)count;
+    header.valuesOffset = (uint64_t)file_->pos();
+
+    uint64_t nanCount = 0;
+    for(int64_t i = 0; i < count; ++i) nanCount += (values[i] != values[i]) ? 1 : 0;
+    header.nanCount = nanCount;
+
+    //NOTE: The values are always a whole number of doubles, so the next series starts 8-byte aligned too.
+    qint64 bytes = (qint64)count*sizeof(double);
+    return file_->write((const char *)values, bytes) == bytes;
+}
+
+bool ColumnarSeriesWriter::finish()
+{
+    if(added_ != headers_.count()) return false;
+
+    columns_file_header fileheader;
+    fileheader.magic = COLUMNS_FILE_MAGIC;
+    fileheader.version = COLUMNS_FILE_VERSION;
+    fileheader.numseries = (uint64_t)headers_.count();
+    fileheader.stringsOffset = stringsOffset_;
+    fileheader.stringsSize = stringsSize_;
+
+    qint64 headerbytes = (qint64)headers_.count()*sizeof(column_serial_header);
+    return file_->seek(0)
+        && file_->write((const char *)&fileheader, sizeof(fileheader)) == sizeof(fileheader)
+        && file_->write((const char *)headers_.constData(), headerbytes) == headerbytes
+        && file_->flush();
+}
+
+bool ColumnarSeriesReader::open(const QString &path)
+{
+    close();
+
+    file_.setFileName(path);
+    if(!file_.open(QIODevice::ReadOnly)) return false;
+
+    uint64_t size = (uint64_t)file_.size();
+    if(size < sizeof(columns_file_header))
+    {
+        close();
+        return false;
+    }
+
+    const uchar *mapped = file_.map(0, file_.size());
+    if(!mapped)
+    {
+        close();
+        return false;
+    }
+    mapped_ = mapped;
+
+    //NOTE: Everything in the file is checked against its size here, so that the accessors don't have to.
+    const columns_file_header *fileheader = (const columns_file_header *)mapped_;
+    bool valid = fileheader->magic == COLUMNS_FILE_MAGIC && fileheader->version == COLUMNS_FILE_VERSION
+              && fileheader->numseries <= (size - sizeof(columns_file_header)) / sizeof(column_serial_header)
+              && fileheader->stringsOffset <= size && fileheader->stringsSize <= size - fileheader->stringsOffset;
+
+    const column_serial_header *headers = (const column_serial_header *)(mapped_ + sizeof(columns_file_header));
+    for(uint64_t idx = 0; valid && idx < fileheader->numseries; ++idx)
+    {
+        const column_serial_header &header = headers[idx];
+        valid = header.valuesOffset % sizeof(double) == 0
+             && header.valuesOffset <= size && header.count <= (size - header.valuesOffset) / sizeof(double)
+             && (uint64_t)header.nameOffset + header.nameLen <= fileheader->stringsSize
+             && (uint64_t)header.unitOffset + header.unitLen <= fileheader->stringsSize;
+    }
+
+    if(!valid)
+    {
+        close();
+        return false;
+    }
+
+    headers_ = headers;
+    numseries_ = fileheader->numseries;
+    strings_ = (const char *)(mapped_ + fileheader->stringsOffset);
+    return true;
+}
+
+void ColumnarSeriesReader::close()
+{
+    if(mapped_) file_.unmap((uchar *)mapped_);
+    if(file_.isOpen()) file_.close();
+    mapped_ = nullptr;
+    headers_ = nullptr;
+    numseries_ = 0;
+    strings_ = nullptr;
+}
+
+QString ColumnarSeriesReader::name(int idx) const
+{
+    return QString::fromUtf8(strings_ + headers_[idx].nameOffset, (int)headers_[idx].nameLen);
+}
+
+QString ColumnarSeriesReader::unit(int idx) const
+{
+    return QString::fromUtf8(strings_ + headers_[idx].unitOffset, (int)headers_[idx].unitLen);
+}
+
+SeriesData ColumnarSeriesReader::series(int idx) const
+{
+    QVector<double> copy((int)headers_[idx].count);
+    if(!copy.empty()) memcpy(copy.data(), values(idx), (size_t)copy.count()*sizeof(double));
+    return SeriesData(copy);
+}
@@ -0,0 +1,59 @@
+#ifndef SERIESCOLUMNS_H
+#define SERIESCOLUMNS_H
+
+#include "seriesdata.h"
+#include "sqlhandler/serialization.h"
+#include <QFile>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <stdint.h>
+
+//NOTE: Writes a columnar series file (see serialization.h). The names and units have to be known up front, since the string table comes
+// before the values, but the series themselves are handed over one at a time in order, so they never all have to be in memory together.
+class ColumnarSeriesWriter
+{
+public:
+    bool begin(QFile *file, const QVector<int> &IDs, const QVector<QString> &names, const QVector<QString> &units);
+    bool addSeries(int64_t startDate, int64_t timestep, const double *values, int64_t count);
+    bool finish(); //NOTE: Fills in the headers. The file is not valid until this has been called.
+
+private:
+    QFile *file_ = nullptr;
+    QVector<column_serial_header> headers_;
+    uint64_t stringsOffset_ = 0;
+    uint64_t stringsSize_ = 0;
+    int added_ = 0;
+};
+
+//NOTE: Reads a columnar series file by mapping it into memory. The values pointers point straight into the mapping, so they are only valid
+// until the reader is closed or destroyed.
+class ColumnarSeriesReader
+{
+public:
+    ~ColumnarSeriesReader() { close(); }
+
+    bool open(const QString &path); //NOTE: Returns false if the file can not be mapped or is not a valid columnar series file.
+    void close();
+
+    int count() const { return headers_ ? (int)numseries_ : 0; }
+    int ID(int idx) const { return (int)headers_[idx].ID; }
+    QString name(int idx) const;
+    QString unit(int idx) const;
+    int64_t startDate(int idx) const { return headers_[idx].startDate; }
+    int64_t timestep(int idx) const { return headers_[idx].timestep; }
+    int64_t valueCount(int idx) const { return (int64_t)headers_[idx].count; }
+    const double *values(int idx) const { return (const double *)(mapped_ + headers_[idx].valuesOffset); }
+
+    //NOTE: A copy of the values that stays valid after the file is closed. This is a single memcpy.
+    SeriesData series(int idx) const;
+
+private:
+    QFile file_;
+    const uchar *mapped_ = nullptr;
+    const column_serial_header *headers_ = nullptr;
+    uint64_t numseries_ = 0;
+    const char *strings_ = nullptr;
+};
+
+#endif // SERIESCOLUMNS_H
@@ -0,0 +1,70 @@
+#ifndef SERIESDATA_H
+#define SERIESDATA_H
+
+#include <QByteArray>
+#include <QVector>
+#include <string.h>
+
+//NOTE: The values of one time series. A SeriesData does not copy its values, but keeps a reference to the shared buffer that they are stored
+// in. Usually that is the whole buffer that was received from the sqlhandler, so the series that came in one transfer are decoded without
+// copying them, and the plot cache holds on to the received buffer instead of to copies of it. Copying a SeriesData is cheap.
+//NOTE: The buffer must not be modified after a SeriesData has been made from it, since the SeriesData points directly into it.
+class SeriesData
+{
+public:
+    SeriesData() {}
+
+    //NOTE: A view of count doubles starting at byte offset in buffer.
+    SeriesData(const QByteArray &buffer, int offset, int count)
+    {
+        const char *start = buffer.constData() + offset;
+        if((quintptr)start % alignof(double) == 0)
+        {
+            buffer_ = buffer;
+            data_ = (const double *)start;
+        }
+        else
+        {
+            //NOTE: We can't read doubles in place from an unaligned address on every architecture, so in that (unexpected) case we copy.
+            values_.resize(count);
+            memcpy(values_.data(), start, (size_t)count*sizeof(double));
+            data_ = values_.constData();
+        }
+        count_ = count;
+    }
+
+    //NOTE: For series that were not decoded from a transferred buffer. QVector is implicitly shared, so this does not copy either.
+    SeriesData(const QVector<double> &values)
+        : values_(values), data_(values_.constData()), count_(values.count())
+    {
+    }
+
+    SeriesData(const SeriesData &other) = default;
+    SeriesData &operator=(const SeriesData &other) = default;
+
+    const double *data() const { return data_; }
+    int count() const { return count_; }
+    int size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool isEmpty() const { return count_ == 0; }
+
+    const double &operator[](int i) const { return data_[i]; }
+    const double &at(int i) const { Q_ASSERT(i >= 0 && i < count_); return data_[i]; }
+
+    const double *begin() const { return data_; }
+    const double *end() const { return data_ + count_; }
+
+    //NOTE: The size of the shared buffer that this series keeps alive. For a view this is the whole received buffer, which is shared with the
+    // other series from the same transfer.
+    qint64 bufferSize() const { return buffer_.isNull() ? (qint64)values_.count()*sizeof(double) : (qint64)buffer_.size(); }
+    //NOTE: The same for every series that shares the buffer, so it can be used to tell which series keep the same buffer alive.
+    const void *bufferID() const { return buffer_.isNull() ? (const void *)values_.constData() : (const void *)buffer_.constData(); }
+
+private:
+    QByteArray buffer_;
+    QVector<double> values_;
+    const double *data_ = nullptr;
+    int count_ = 0;
+};
+
+#endif // SERIESDATA_H
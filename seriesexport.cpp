@@ -0,0 +1,149 @@
+#include "seriesexport.h"
+#include "calendar.h"
+#include "numberformat.h"
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+BufferedWriter::BufferedWriter(QIODevice *device, int capacity)
+    : device_(device), buffer_(capacity), capacity_(capacity)
+{
+}
+
+bool BufferedWriter::flush()
+{
+    if(used_ > 0 && ok_)
+    {
+        if(device_->write(buffer_.constData(), used_) != used_) ok_ = false;
+    }
+    used_ = 0;
+    return ok_;
+}
+
+void BufferedWriter::write(const char *data, int size)
+{
+    if(size > capacity_)
+    {
+        flush();
+        if(ok_ && device_->write(data, size) != size) ok_ = false;
+        return;
+    }
+    reserve(size);
+    memcpy(buffer_.data() + used_, data, size);
+    used_ += size;
+}
+
+void BufferedWriter::write(const QString &text)
+{
+    QByteArray utf8 = text.toUtf8();
+    write(utf8.constData(), utf8.size());
+}
+
+void BufferedWriter::writeDouble(double value)
+{
+    reserve(32);
+    used_ += formatDouble(buffer_.data() + used_, value);
+}
+
+static inline char *writeDigits(char *out, int value, int digits)
+{
+    for(int d = digits - 1; d >= 0; --d)
+    {
+        out[d] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    return out + digits;
+}
+
+void BufferedWriter::writeDate(int64_t seconds, bool withTime)
+{
+    reserve(32);
+    char *out = buffer_.data() + used_;
+    char *start = out;
+
+    calendar_date date = date_from_seconds(seconds);
+    if(date.year < 0 || date.year > 9999)
+    {
+        out += snprintf(out, 16, "%d", date.year); //NOTE: Not a date any model works with, but we still write something that reads back.
+    }
+    else out = writeDigits(out, date.year, 4);
+    *out++ = '-';
+    out = writeDigits(out, date.month, 2);
+    *out++ = '-';
+    out = writeDigits(out, date.day, 2);
+
+    if(withTime)
+    {
+        int64_t secondOfDay = seconds - day_from_seconds(seconds)*seconds_per_day;
+        *out++ = ' ';
+        out = writeDigits(out, (int)(secondOfDay / 3600), 2);
+        *out++ = ':';
+        out = writeDigits(out, (int)(secondOfDay / 60 % 60), 2);
+        *out++ = ':';
+        out = writeDigits(out, (int)(secondOfDay % 60), 2);
+    }
+
+    used_ += (int)(out - start);
+}
+
+static void writeQuoted(BufferedWriter &writer, const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("\"", "\"\"");
+    writer.write('"');
+    writer.write(escaped);
+    writer.write('"');
+}
+
+bool writeSeriesCSV(QIODevice *device, const QVector<ExportColumn> &columns, int64_t timestep)
+{
+    if(columns.empty() || timestep <= 0) return false;
+
+    //NOTE: Empty series don't have a meaningful start date, so they don't count towards the range of dates.
+    bool first = true;
+    int64_t firstDate = 0;
+    int64_t lastDate = -1;
+    bool withTime = timestep % seconds_per_day != 0;
+    for(const ExportColumn &column : columns)
+    {
+        if(column.count <= 0) continue;
+        if(!first && (column.startDate - firstDate) % timestep != 0) return false;
+        firstDate = first ? column.startDate : std::min(firstDate, column.startDate);
+        lastDate = first ? column.startDate + timestep*(column.count - 1) : std::max(lastDate, column.startDate + timestep*(column.count - 1));
+        if(column.startDate % seconds_per_day != 0) withTime = true;
+        first = false;
+    }
+
+    BufferedWriter writer(device);
+
+    writer.write("\"date\"", 6);
+    for(const ExportColumn &column : columns)
+    {
+        writer.write(',');
+        writeQuoted(writer, column.name);
+    }
+    writer.write('\n');
+
+    //NOTE: Where each column is at in its values. A column's position goes negative before its series starts.
+    QVector<int64_t> position(columns.count());
+    for(int col = 0; col < columns.count(); ++col) position[col] = (firstDate - columns[col].startDate) / timestep;
+
+    for(int64_t date = firstDate; date <= lastDate; date += timestep)
+    {
+        writer.writeDate(date, withTime);
+        for(int col = 0; col < columns.count(); ++col)
+        {
+            writer.write(',');
+            int64_t pos = position[col]++;
+            if(pos < 0 || pos >= columns[col].count) continue;
+            double value = columns[col].values[pos];
+            if(!std::isnan(value)) writer.writeDouble(value);
+        }
+        writer.write('\n');
+
+        if(!writer.ok()) return false;
+    }
+
+    return writer.flush();
+}
@@ -0,0 +1,54 @@
+#ifndef SERIESEXPORT_H
+#define SERIESEXPORT_H
+
+#include <QIODevice>
+#include <QVector>
+#include <QString>
+#include <stdint.h>
+
+//NOTE: Collects output in a large buffer and hands it to the device a block at a time, instead of going through a stream that may be
+// flushed on every line. Numbers and dates are formatted straight into the buffer.
+class BufferedWriter
+{
+public:
+    BufferedWriter(QIODevice *device, int capacity = 1 << 16);
+    ~BufferedWriter() { flush(); }
+
+    void write(const char *data, int size);
+    void write(char c) { if(used_ == capacity_) flush(); buffer_[used_++] = c; }
+    void write(const QString &text);
+
+    //NOTE: With as few digits as reads back as exactly the same double, see formatDouble.
+    void writeDouble(double value);
+
+    //NOTE: yyyy-MM-dd, followed by hh:mm:ss if withTime. The date is UTC seconds since epoch, like all dates in the databases.
+    void writeDate(int64_t seconds, bool withTime);
+
+    bool flush();
+    bool ok() const { return ok_; }
+
+private:
+    void reserve(int size) { if(capacity_ - used_ < size) flush(); }
+
+    QIODevice *device_;
+    QVector<char> buffer_;
+    int capacity_;
+    int used_ = 0;
+    bool ok_ = true;
+};
+
+//NOTE: A series to be written as a column. The values are not owned.
+struct ExportColumn
+{
+    QString name;
+    const double *values = nullptr;
+    int64_t count = 0;
+    int64_t startDate = 0;
+};
+
+//NOTE: Writes the columns side by side with one row per time step, from the earliest start to the latest end among them. All the columns
+// must have the given timestep, and start a whole number of timesteps apart. Where a column has no value (it is missing, or the series
+// does not cover that date) the field is left empty.
+bool writeSeriesCSV(QIODevice *device, const QVector<ExportColumn> &columns, int64_t timestep);
+
+#endif // SERIESEXPORT_H
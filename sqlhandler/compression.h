@@ -0,0 +1,182 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stdint.h>
+#include <string.h>
+
+//NOTE: Gorilla-style XOR encoding of a series of doubles (Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series Database", 2015).
+// Consecutive values of a model output tend to share the sign, the exponent and the high bits of the mantissa, so the XOR of a value with
+// the previous one has long runs of leading and trailing zeros, and we only store the bits in between:
+//      first value:                                        the 64 bits of the value
+//      XOR is 0:                                           '0'
+//      XOR fits in the window of the last stored XOR:      '10', then the bits of that window
+//      otherwise:                                          '11', 5 bits leading zero count, 6 bits meaningful bit count (64 is stored as 0),
+//                                                          then the meaningful bits
+// The bits are packed most significant first. A run of missing values (which are all the same NaN) or of any other repeated value costs
+// one bit per value, and the general-purpose compressor that is applied afterwards (see serialization.h) squeezes those runs further.
+//NOTE: This header is shared between the sqlhandler and INCAView, so keep it free of dependencies.
+
+struct gorilla_bit_writer
+{
+    uint8_t *data;
+    uint64_t pos; //NOTE: In bits.
+};
+
+struct gorilla_bit_reader
+{
+    const uint8_t *data;
+    uint64_t size; //NOTE: In bytes.
+    uint64_t pos;  //NOTE: In bits.
+};
+
+//NOTE: The worst case is 2+5+6+64 = 77 bits per value after the first one.
+static inline uint64_t gorilla_max_encoded_size(uint64_t count)
+{
+    return count*10 + 8;
+}
+
+static inline void gorilla_write_bits(gorilla_bit_writer *writer, uint64_t value, uint32_t numbits)
+{
+    while(numbits > 0)
+    {
+        uint32_t bitoffset = (uint32_t)(writer->pos & 7);
+        uint32_t room = 8 - bitoffset;
+        uint32_t take = numbits < room ? numbits : room;
+        uint8_t chunk = (uint8_t)((value >> (numbits - take)) & ((1u << take) - 1));
+
+        uint8_t *byte = writer->data + (writer->pos >> 3);
+        if(bitoffset == 0) *byte = 0;
+        *byte |= (uint8_t)(chunk << (room - take));
+
+        writer->pos += take;
+        numbits -= take;
+    }
+}
+
+static inline bool gorilla_read_bits(gorilla_bit_reader *reader, uint32_t numbits, uint64_t *valueout)
+{
+    if(reader->pos + numbits > reader->size*8) return false;
+
+    uint64_t value = 0;
+    while(numbits > 0)
+    {
+        uint32_t bitoffset = (uint32_t)(reader->pos & 7);
+        uint32_t room = 8 - bitoffset;
+        uint32_t take = numbits < room ? numbits : room;
+        uint8_t byte = reader->data[reader->pos >> 3];
+
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+
+        reader->pos += take;
+        numbits -= take;
+    }
+    *valueout = value;
+    return true;
+}
+
+//NOTE: out has to have room for gorilla_max_encoded_size(count) bytes. Returns the number of bytes used.
+static inline uint64_t gorilla_encode(const double *values, uint64_t count, uint8_t *out)
+{
+    if(count == 0) return 0;
+
+    gorilla_bit_writer writer = {out, 0};
+
+    uint64_t prev;
+    memcpy(&prev, &values[0], sizeof(uint64_t));
+    gorilla_write_bits(&writer, prev, 64);
+
+    bool haswindow = false;
+    uint32_t windowleading = 0;
+    uint32_t windowtrailing = 0;
+
+    for(uint64_t i = 1; i < count; ++i)
+    {
+        uint64_t current;
+        memcpy(&current, &values[i], sizeof(uint64_t));
+        uint64_t x = current ^ prev;
+        prev = current;
+
+        if(x == 0)
+        {
+            gorilla_write_bits(&writer, 0, 1);
+            continue;
+        }
+
+        uint32_t leading = (uint32_t)__builtin_clzll(x);
+        uint32_t trailing = (uint32_t)__builtin_ctzll(x);
+        if(leading > 31) leading = 31; //NOTE: It has to fit in 5 bits. We just store a few more zeros in that case.
+
+        if(haswindow && leading >= windowleading && trailing >= windowtrailing)
+        {
+            gorilla_write_bits(&writer, 2, 2);
+            gorilla_write_bits(&writer, x >> windowtrailing, 64 - windowleading - windowtrailing);
+        }
+        else
+        {
+            uint32_t meaningful = 64 - leading - trailing;
+            gorilla_write_bits(&writer, 3, 2);
+            gorilla_write_bits(&writer, leading, 5);
+            gorilla_write_bits(&writer, meaningful & 63, 6);
+            gorilla_write_bits(&writer, x >> trailing, meaningful);
+
+            haswindow = true;
+            windowleading = leading;
+            windowtrailing = trailing;
+        }
+    }
+
+    return (writer.pos + 7) / 8;
+}
+
+//NOTE: Returns false if the data ran out before count values had been decoded, or if it is otherwise malformed.
+static inline bool gorilla_decode(const uint8_t *data, uint64_t size, double *values, uint64_t count)
+{
+    if(count == 0) return true;
+
+    gorilla_bit_reader reader = {data, size, 0};
+
+    uint64_t prev;
+    if(!gorilla_read_bits(&reader, 64, &prev)) return false;
+    memcpy(&values[0], &prev, sizeof(uint64_t));
+
+    bool haswindow = false;
+    uint32_t windowleading = 0;
+    uint32_t windowtrailing = 0;
+
+    for(uint64_t i = 1; i < count; ++i)
+    {
+        uint64_t control;
+        if(!gorilla_read_bits(&reader, 1, &control)) return false;
+
+        if(control)
+        {
+            if(!gorilla_read_bits(&reader, 1, &control)) return false;
+
+            if(control)
+            {
+                uint64_t leading, meaningful;
+                if(!gorilla_read_bits(&reader, 5, &leading) || !gorilla_read_bits(&reader, 6, &meaningful)) return false;
+                if(meaningful == 0) meaningful = 64;
+                if(leading + meaningful > 64) return false;
+
+                haswindow = true;
+                windowleading = (uint32_t)leading;
+                windowtrailing = (uint32_t)(64 - leading - meaningful);
+            }
+            else if(!haswindow)
+            {
+                return false;
+            }
+
+            uint64_t bits;
+            if(!gorilla_read_bits(&reader, 64 - windowleading - windowtrailing, &bits)) return false;
+            prev ^= bits << windowtrailing;
+        }
+
+        memcpy(&values[i], &prev, sizeof(uint64_t));
+    }
+
+    return true;
+}
+
+#endif // COMPRESSION_H
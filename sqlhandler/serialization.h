@@ -49,9 +49,137 @@ struct structure_serial_entry
 	uint32_t unitLen;
 };
 
+//NOTE: Layout of the output of EXPORT_VALUES_COMMAND (version 2):
+// values_file_header
+// repeated numseries times, in the order the IDs were requested:
+//      series_serial_header
+//      count doubles (64 bit float). Missing values are NaN.
+//NOTE: Version 1 (which older sqlhandler builds still produce) had no file header. It was just numresults (64 bit uint) and one start
+// date (64 bit int) for all the series, then each series as count (64 bit uint) followed by the values. Since numresults is small, a
+// version 1 file can never start with VALUES_FILE_MAGIC, which is how the recipient tells them apart.
+//NOTE: The headers are a multiple of 8 bytes long so that the doubles stay 8-byte aligned in the file.
+//NOTE: Version 3 is the output of EXPORT_VALUES_COMPRESSED_COMMAND. It is laid out like version 2, except that every series_serial_header
+// has SERIESFLAG_COMPRESSED set and is followed by compressedSize (64 bit uint) and compressedSize bytes instead of the doubles. Those bytes
+// are the size of the Gorilla encoding of the values (see compression.h) as a 32 bit big-endian uint, followed by the zlib compression
+// of the Gorilla encoding. That is the format of Qt's qCompress, so INCAView can unpack it with qUncompress. A series for which this would
+// be larger than the doubles is sent as in version 2, without the flag.
+
+#define VALUES_FILE_MAGIC 0x56564E49  //NOTE: "INVV" in a little-endian file.
+#define VALUES_FILE_VERSION 2
+#define VALUES_FILE_VERSION_COMPRESSED 3
+
+#define SERIESFLAG_COMPRESSED 0x1
+
+struct values_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numseries;
+};
+
+struct series_serial_header
+{
+    uint32_t ID;
+    uint32_t flags;    //NOTE: SERIESFLAG_ bits.
+    int64_t startDate; //NOTE: Seconds since epoch of the first value.
+    int64_t timestep;  //NOTE: Seconds between two consecutive values.
+    uint64_t count;
+    uint64_t nanCount;
+};
+
+//NOTE: Layout of a columnar series file, which is what INCAView writes when results are exported in the binary format. It is meant to be
+// memory mapped by whoever reads it, so that getting at a series is a pointer into the file (or at most a memcpy) instead of a parse:
+// columns_file_header
+// numseries column_serial_header, in the order the series were exported
+// the string table: the names and units of the series, UTF-8, not 0-terminated. The column headers point into it.
+// zero padding up to the next multiple of 8 bytes
+// the values of each series: count doubles (64 bit float) starting at its valuesOffset. Missing values are NaN.
+//NOTE: All offsets are from the start of the file, and everything is little-endian, like the other formats here. The headers are a
+// multiple of 8 bytes long and every valuesOffset is a multiple of 8, so the values can be used in place from a mapping of the file.
+
+#define COLUMNS_FILE_MAGIC 0x43564E49 //NOTE: "INVC" in a little-endian file.
+#define COLUMNS_FILE_VERSION 1
+
+struct columns_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numseries;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+struct column_serial_header
+{
+    uint32_t ID;
+    uint32_t flags;        //NOTE: No flags are defined yet. Always 0.
+    int64_t startDate;     //NOTE: Seconds since epoch of the first value.
+    int64_t timestep;      //NOTE: Seconds between two consecutive values.
+    uint64_t count;
+    uint64_t nanCount;
+    uint64_t valuesOffset;
+    uint32_t nameOffset;   //NOTE: From the start of the string table.
+    uint32_t nameLen;
+    uint32_t unitOffset;
+    uint32_t unitLen;
+};
+
+//NOTE: If the sqlhandler is given STREAM_FILENAME instead of the name of a file to write to, it writes its output to stdout as a sequence
+// of frames instead. Each frame is a stream_frame_header followed by size bytes. The data frames concatenated together make up the same
+// output that would otherwise have been written to the file. The last frame is always either an error or a success frame, and it
+// contains the "ERROR: ..." or "SUCCESS: ..." message that the sqlhandler would otherwise print.
+
+enum stream_frame_type
+{
+    streamframe_data = 1,
+    streamframe_error = 2,
+    streamframe_success = 3,
+};
+
+struct stream_frame_header
+{
+    uint32_t type;
+    uint32_t size;
+};
+
+//NOTE: When the sqlhandler is started with SERVE_COMMAND as its only argument, it keeps running and reads requests from stdin. Each request
+// is a server_request_header followed by the database name (dbNameLen bytes), the table name (tableNameLen bytes) and numIDs IDs (32 bit
+// uint each). The names are not 0-terminated. Each request is answered on stdout with stream frames in the same way as above.
+//NOTE: For servercommand_import_parameters, numIDs is instead the number of parameter_serial_entry records that follow the names. Their
+// values are written to the parameter database in one transaction, so either all of them are stored or none are. The table name is empty.
+
+enum server_command
+{
+    servercommand_export_structure = 1,
+    servercommand_export_values = 2,
+    servercommand_close_databases = 3, //NOTE: Sent before the databases are replaced by a model run. No names or IDs.
+    servercommand_quit = 4,
+    servercommand_export_values_compressed = 5,
+    servercommand_import_parameters = 6,
+};
+
+struct server_request_header
+{
+    uint32_t command;
+    uint32_t dbNameLen;
+    uint32_t tableNameLen;
+    uint32_t numIDs;
+};
+
+//NOTE: The most bytes of IDs or parameter entries that the server accepts after the names of a request, which is 16M IDs and far more
+// than INCAView asks for at once. The size comes straight from the header, so the server replies with an error and quits on anything
+// larger instead of trying to allocate it.
+#define MAX_SERVER_REQUEST_BODY_SIZE (64*1024*1024)
+
 #pragma pack(pop)
 
+#define STREAM_FILENAME "-"
+
+#define DEFAULT_TIMESTEP 86400 //NOTE: Used for series that have less than two values, so that the timestep can not be read from the dates.
+
 #define EXPORT_STRUCTURE_COMMAND "export_structure"
 #define EXPORT_VALUES_COMMAND "export_values"
+#define EXPORT_VALUES_COMPRESSED_COMMAND "export_values_compressed"
+#define SERVE_COMMAND "serve"
 
 #endif // SERIALIZATION_H
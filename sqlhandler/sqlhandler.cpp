@@ -8,6 +8,7 @@ NOTE: This program should always print exactly one of the following:
 	"ERROR: <specification of error>" if an error occured
 	"SUCCESS: <whatever you want>" otherwise.
 They have to be printed to the stdout, because INCAView will only be able to listen to one channel at a time over the ssh connection.
+If the output file name is STREAM_FILENAME, the output is written to stdout instead, and the message is sent as the last frame (see serialization.h).
 */
 
 /*
@@ -21,22 +22,202 @@ Stuff left to do:
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <assert.h>
 #include <limits>
 #include "sqlite3.h"
+#include "zlib.h" //NOTE: The sqlhandler has to be linked with -lz.
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+typedef uint8_t  u8;
 typedef uint64_t u64;
 typedef uint32_t u32;
 typedef int64_t s64;
 typedef double f64;
 
 #include "serialization.h"
+#include "compression.h"
 
 
-bool export_structure(sqlite3 *db, FILE *file, const char *table)
+//NOTE: The output either goes to a file (which INCAView then has to fetch with scp), or, if the file name given is STREAM_FILENAME,
+// to stdout as a sequence of stream frames (see serialization.h). In the latter case the ERROR/SUCCESS message is sent as the final frame.
+struct output_stream
+{
+	FILE *file;
+	bool framed;
+	u8 *buffer;
+	u32 used;
+};
+
+#define OUTPUT_FRAME_SIZE (64*1024)
+
+static void output_flush(output_stream *out)
+{
+	if(out->framed && out->used > 0)
+	{
+		stream_frame_header frame = {streamframe_data, out->used};
+		fwrite(&frame, sizeof(stream_frame_header), 1, stdout);
+		fwrite(out->buffer, 1, out->used, stdout);
+		out->used = 0;
+	}
+}
+
+static void output_write(output_stream *out, const void *data, size_t size)
+{
+	if(!out->framed)
+	{
+		fwrite(data, 1, size, out->file);
+		return;
+	}
+	
+	const u8 *at = (const u8 *)data;
+	while(size > 0)
+	{
+		size_t tocopy = OUTPUT_FRAME_SIZE - out->used;
+		if(tocopy > size) tocopy = size;
+		memcpy(out->buffer + out->used, at, tocopy);
+		out->used += (u32)tocopy;
+		at += tocopy;
+		size -= tocopy;
+		if(out->used == OUTPUT_FRAME_SIZE) output_flush(out);
+	}
+}
+
+static void report_status(output_stream *out, u32 frametype, const char *prefix, const char *format, va_list args)
+{
+	char message[1024];
+	int len = sprintf(message, "%s", prefix);
+	vsnprintf(message + len, sizeof(message) - len, format, args);
+	
+	if(out && out->framed)
+	{
+		output_flush(out);
+		stream_frame_header frame = {frametype, (u32)strlen(message)};
+		fwrite(&frame, sizeof(stream_frame_header), 1, stdout);
+		fwrite(message, 1, frame.size, stdout);
+	}
+	else
+	{
+		fprintf(stdout, "%s", message);
+	}
+	fflush(stdout);
+}
+
+static void report_error(output_stream *out, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	report_status(out, streamframe_error, "ERROR: ", format, args);
+	va_end(args);
+}
+
+static void report_success(output_stream *out, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	report_status(out, streamframe_success, "SUCCESS: ", format, args);
+	va_end(args);
+}
+
+//NOTE: For problems that we can work around. These go to stderr, so that they never end up in the output that the recipient parses.
+static void report_warning(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "WARNING: ");
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fflush(stderr);
+}
+
+//NOTE: An open database together with the statements that have been prepared on it. When the sqlhandler runs as a server (see
+// serve()) these are kept between requests, so that a request does not have to reopen the database or rebuild its statements.
+#define MAX_CACHED_STATEMENTS 16
+#define MAX_OPEN_DATABASES 8
+
+struct cached_statement
+{
+	char *sql;
+	sqlite3_stmt *statement;
+};
+
+struct database_handle
+{
+	char *name;
+	sqlite3 *db;
+	cached_statement statements[MAX_CACHED_STATEMENTS];
+	u32 nextstatement;
+};
+
+static bool open_database(database_handle *handle, const char *dbname, output_stream *out)
+{
+	*handle = {};
+	int rc = sqlite3_open_v2(dbname, &handle->db, SQLITE_OPEN_READWRITE, 0);
+	if(rc != SQLITE_OK)
+	{
+		report_error(out, "Unable to open database %s: %s\n", dbname, sqlite3_errmsg(handle->db));
+		sqlite3_close(handle->db);
+		handle->db = 0;
+		return false;
+	}
+	handle->name = strdup(dbname);
+	return true;
+}
+
+static void close_database(database_handle *handle)
+{
+	for(u32 i = 0; i < MAX_CACHED_STATEMENTS; ++i)
+	{
+		cached_statement &cached = handle->statements[i];
+		if(cached.statement) sqlite3_finalize(cached.statement);
+		if(cached.sql) free(cached.sql);
+	}
+	if(handle->db) sqlite3_close(handle->db);
+	if(handle->name) free(handle->name);
+	*handle = {};
+}
+
+//NOTE: Returns the statement if it was already prepared on this database, reset and with its bindings cleared. Otherwise returns 0.
+static sqlite3_stmt *find_statement(database_handle *handle, const char *sql)
+{
+	for(u32 i = 0; i < MAX_CACHED_STATEMENTS; ++i)
+	{
+		cached_statement &cached = handle->statements[i];
+		if(cached.sql && strcmp(cached.sql, sql) == 0)
+		{
+			sqlite3_reset(cached.statement);
+			sqlite3_clear_bindings(cached.statement);
+			return cached.statement;
+		}
+	}
+	return 0;
+}
+
+static sqlite3_stmt *prepare_statement(database_handle *handle, const char *sql, output_stream *out)
+{
+	sqlite3_stmt *statement;
+	int rc = sqlite3_prepare_v2(handle->db, sql, -1, &statement, 0);
+	if(rc != SQLITE_OK)
+	{
+		report_error(out, "SQL error: %s\n", sqlite3_errmsg(handle->db));
+		return 0;
+	}
+	
+	//NOTE: If the cache is full we replace the statements in the order they were added. We only ever have a few different ones in practice.
+	cached_statement &cached = handle->statements[handle->nextstatement];
+	handle->nextstatement = (handle->nextstatement + 1) % MAX_CACHED_STATEMENTS;
+	if(cached.statement) sqlite3_finalize(cached.statement);
+	if(cached.sql) free(cached.sql);
+	cached.sql = strdup(sql);
+	cached.statement = statement;
+	
+	return statement;
+}
+
+
+static bool export_structure(database_handle *handle, output_stream *out, const char *table)
 {	
 	char sqlcommand[1024];
 	sprintf(sqlcommand,
@@ -53,20 +234,17 @@ bool export_structure(sqlite3 *db, FILE *file, const char *table)
 			table, table, table
 	);
 	
-	sqlite3_stmt *statement;
-	int rc = sqlite3_prepare_v2(db, sqlcommand, -1, &statement, 0);
-	
-	if( rc != SQLITE_OK )
-	{
-		fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
-		return false;
-	}
+	sqlite3_stmt *statement = find_statement(handle, sqlcommand);
+	if(!statement) statement = prepare_statement(handle, sqlcommand, out);
+	if(!statement) return false;
 	
+	int rc;
 	while((rc = sqlite3_step(statement)) != SQLITE_DONE)
 	{
-		if(rc == SQLITE_ERROR)
+		if(rc != SQLITE_ROW)
 		{
-			fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
+			report_error(out, "SQL error: %s\n", sqlite3_errmsg(handle->db));
+			sqlite3_reset(statement);
 			return false;
 		}
 		
@@ -78,141 +256,526 @@ bool export_structure(sqlite3 *db, FILE *file, const char *table)
 		const char *unitName = (const char *)sqlite3_column_text(statement, 3);
 		if(unitName) outdata.unitLen = strlen(unitName);
 		
-		fwrite(&outdata, sizeof(outdata), 1, file);
-		fwrite(childName, 1, outdata.childNameLen, file);
-		if(unitName) fwrite(unitName, 1, outdata.unitLen, file);
+		output_write(out, &outdata, sizeof(outdata));
+		output_write(out, childName, outdata.childNameLen);
+		if(unitName) output_write(out, unitName, outdata.unitLen);
 		
 		//fprintf(stdout, "%u %u %u %u %s %s\n", outdata.parentID, outdata.childID, outdata.childNameLen, outdata.unitLen, childName, unitName);
 	}
 	
-	sqlite3_finalize(statement);
+	sqlite3_reset(statement); //NOTE: Releases the read lock, since the statement is kept around.
 	
 	return true;
 }
 
-static bool export_values(sqlite3 *db, u32 numrequests, u32* requested_ids, FILE *file, const char *table)
+//NOTE: The value export is one indexed range scan per ID if there is an index on the table that starts with (ID, date) and also contains value
+// (a covering index). INCA does not create one for the Results and Inputs tables, so we create it the first time the table is exported from.
+// The model run deletes and recreates results.db and inputs.db, so this happens on the first export after every run. Building the index takes
+// about as long as eight full scans of the table, while without it the export does one full scan per requested ID, so it already pays off on
+// the first fetch of a handful of series. Afterwards a series is read without touching the table itself (see
+// benchmarks/sqlhandler/bench_export_values.sh).
+//NOTE: The index is only an optimization, so if we can't check for it or make it (e.g. the database is read-only, the disk is full, or
+// another process holds a write lock on it) we just warn, and the export runs the same query without it. That is slower but gives the same
+// result.
+static void ensure_value_index(sqlite3 *db, const char *table)
 {
-	u64 numrequests64 = (u64)numrequests;
-	fwrite(&numrequests64, sizeof(u64), 1, file);
-	
-	//NOTE: Write out the start date of the dataset only
-	//NOTE: This is kind of a hack since it is only useful if the recipient knows the timestep. Also will not work if different timeseries have different start dates, 
-	// but at least for now that is not allowed.
-	char sqldate[256];
-	sprintf(sqldate, "SELECT date from %s WHERE ID=%d LIMIT 1", table, requested_ids[0]);
-	sqlite3_stmt *statement;
-	int rc = sqlite3_prepare_v2(db, sqldate, -1, &statement, 0);
-	if( rc != SQLITE_OK )
+	char sqlcommand[512];
+	sprintf(sqlcommand, "SELECT name FROM pragma_index_list('%s')", table);
+	
+	sqlite3_stmt *indexlist;
+	int rc = sqlite3_prepare_v2(db, sqlcommand, -1, &indexlist, 0);
+	if(rc != SQLITE_OK)
+	{
+		report_warning("Unable to check for an index on %s: %s\n", table, sqlite3_errmsg(db));
+		return;
+	}
+	
+	sqlite3_stmt *indexinfo;
+	rc = sqlite3_prepare_v2(db, "SELECT seqno, name FROM pragma_index_xinfo(?) WHERE key = 1 ORDER BY seqno", -1, &indexinfo, 0);
+	if(rc != SQLITE_OK)
+	{
+		report_warning("Unable to check for an index on %s: %s\n", table, sqlite3_errmsg(db));
+		sqlite3_finalize(indexlist);
+		return;
+	}
+	
+	bool found = false;
+	while(!found && (rc = sqlite3_step(indexlist)) == SQLITE_ROW)
+	{
+		sqlite3_reset(indexinfo);
+		sqlite3_bind_text(indexinfo, 1, (const char *)sqlite3_column_text(indexlist, 0), -1, SQLITE_TRANSIENT);
+		
+		//NOTE: The index has to lead with ID then date for the scan to come out sorted by date, and it has to contain value to be covering.
+		bool hasID = false, hasdate = false, hasvalue = false;
+		while(sqlite3_step(indexinfo) == SQLITE_ROW)
+		{
+			int seqno = sqlite3_column_int(indexinfo, 0);
+			const char *column = (const char *)sqlite3_column_text(indexinfo, 1);
+			if(!column) continue;
+			if(seqno == 0 && sqlite3_stricmp(column, "ID") == 0) hasID = true;
+			if(seqno == 1 && sqlite3_stricmp(column, "date") == 0) hasdate = true;
+			if(sqlite3_stricmp(column, "value") == 0) hasvalue = true;
+		}
+		found = hasID && hasdate && hasvalue;
+	}
+	
+	sqlite3_finalize(indexinfo);
+	sqlite3_finalize(indexlist);
+	
+	if(rc != SQLITE_ROW && rc != SQLITE_DONE)
+	{
+		report_warning("Unable to check for an index on %s: %s\n", table, sqlite3_errmsg(db));
+		return;
+	}
+	
+	if(!found)
+	{
+		sprintf(sqlcommand, "CREATE INDEX IF NOT EXISTS %s_ID_date_value ON %s (ID, date, value)", table, table);
+		char *errmsg = 0;
+		rc = sqlite3_exec(db, sqlcommand, 0, 0, &errmsg);
+		if(rc != SQLITE_OK)
+		{
+			report_warning("Unable to create an index on %s, exporting without it: %s\n", table, errmsg);
+			sqlite3_free(errmsg);
+		}
+	}
+}
+
+static bool ensure_capacity(u8 **buffer, u64 *capacity, u64 needed)
+{
+	if(*capacity >= needed) return true;
+	u8 *newbuffer = (u8 *)realloc(*buffer, needed);
+	if(!newbuffer) return false;
+	*buffer = newbuffer;
+	*capacity = needed;
+	return true;
+}
+
+//NOTE: Writes the values of one series in the compressed format (see VALUES_FILE_VERSION_COMPRESSED in serialization.h), or as plain
+// doubles if that turns out to be smaller. The buffers are reused between series.
+static bool write_series_compressed(output_stream *out, series_serial_header *header, f64 *values, u8 **encoded, u64 *encodedcapacity, u8 **compressed, u64 *compressedcapacity)
+{
+	u64 count = header->count;
+	u64 rawsize = count*sizeof(f64);
+	
+	if(!ensure_capacity(encoded, encodedcapacity, gorilla_max_encoded_size(count)))
+	{
+		report_error(out, "Out of memory\n");
+		return false;
+	}
+	u64 encodedsize = gorilla_encode(values, count, *encoded);
+	
+	//NOTE: Noisy series have close to random low mantissa bits, and the XOR encoding can then end up larger than the doubles themselves.
+	if(encodedsize >= rawsize)
+	{
+		output_write(out, header, sizeof(series_serial_header));
+		output_write(out, values, rawsize);
+		return true;
+	}
+	
+	//NOTE: zlib mostly pays off when the encoding has shrunk a lot, since that means there were runs (missing values, zero precipitation
+	// etc.) that it can squeeze further. Otherwise it costs far more time than it saves bytes, so we just store (level 0).
+	int level = (encodedsize < rawsize/2) ? 1 : 0;
+	
+	uLongf compressedsize = compressBound((uLong)encodedsize);
+	if(!ensure_capacity(compressed, compressedcapacity, 4 + compressedsize))
+	{
+		report_error(out, "Out of memory\n");
+		return false;
+	}
+	
+	//NOTE: The size is big-endian, as qUncompress expects.
+	(*compressed)[0] = (u8)(encodedsize >> 24);
+	(*compressed)[1] = (u8)(encodedsize >> 16);
+	(*compressed)[2] = (u8)(encodedsize >> 8);
+	(*compressed)[3] = (u8)(encodedsize);
+	
+	int rc = compress2(*compressed + 4, &compressedsize, *encoded, (uLong)encodedsize, level);
+	if(rc != Z_OK)
 	{
-		fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
+		report_error(out, "Compression failed with zlib error %d\n", rc);
 		return false;
 	}
-	rc = sqlite3_step(statement);
-	if(rc == SQLITE_ERROR)
+	
+	header->flags |= SERIESFLAG_COMPRESSED;
+	output_write(out, header, sizeof(series_serial_header));
+	
+	u64 totalsize = 4 + (u64)compressedsize;
+	output_write(out, &totalsize, sizeof(u64));
+	output_write(out, *compressed, totalsize);
+	return true;
+}
+
+static bool export_values(database_handle *handle, u32 numrequests, u32* requested_ids, output_stream *out, const char *table, bool compress)
+{
+	//NOTE: One statement is prepared for the entire request and re-bound for each ID. The IDs are streamed in the order they were
+	// requested (which is what the recipient expects), and each of them is one ordered range scan of the (ID, date, value) index.
+	char sqlcommand[256];
+	sprintf(sqlcommand, "SELECT date, value FROM %s WHERE ID=? ORDER BY date", table);
+	
+	sqlite3_stmt *statement = find_statement(handle, sqlcommand);
+	if(!statement)
+	{
+		//NOTE: We only have to check for the index the first time we export from this table.
+		ensure_value_index(handle->db, table);
+		statement = prepare_statement(handle, sqlcommand, out);
+		if(!statement) return false;
+	}
+	
+	int rc;
+	
+	values_file_header fileheader = {};
+	fileheader.magic = VALUES_FILE_MAGIC;
+	fileheader.version = compress ? VALUES_FILE_VERSION_COMPRESSED : VALUES_FILE_VERSION;
+	fileheader.numseries = (u64)numrequests;
+	output_write(out, &fileheader, sizeof(values_file_header));
+	
+	//NOTE: We don't know the count of a series before we have read it, so instead of doing a count(*) pre-pass we collect each series
+	// in this buffer and write it out after its header once we are done with it. The buffer is reused between series.
+	u64 capacity = 4096;
+	f64 *values = (f64 *)malloc(capacity*sizeof(f64));
+	if(!values)
 	{
-		fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
+		report_error(out, "Out of memory\n");
 		return false;
 	}
-	s64 date = sqlite3_column_int64(statement, 0);
 	
-	fwrite(&date, sizeof(s64), 1, file);
+	u8 *encoded = 0;
+	u64 encodedcapacity = 0;
+	u8 *compressed = 0;
+	u64 compressedcapacity = 0;
 	
-	sqlite3_finalize(statement);
+	bool success = true;
 	
-	for(u32 i = 0; i < numrequests; ++i)
+	for(u32 i = 0; i < numrequests && success; ++i)
 	{
-		char sqlcount[256];
-		sprintf(sqlcount, "SELECT count(*) FROM %s WHERE ID=%d;", table, requested_ids[i]);
+		sqlite3_reset(statement);
+		sqlite3_bind_int64(statement, 1, (s64)requested_ids[i]);
 		
-		rc = sqlite3_prepare_v2(db, sqlcount, -1, &statement, 0);
-		if( rc != SQLITE_OK )
-		{
-			fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
-			return false;
-		}
+		series_serial_header header = {};
+		header.ID = requested_ids[i];
+		header.timestep = DEFAULT_TIMESTEP;
 		
-		u64 count;
+		u64 count = 0;
 		
-		rc = sqlite3_step(statement);
-		if(rc == SQLITE_ERROR)
+		while((rc = sqlite3_step(statement)) == SQLITE_ROW)
 		{
-			fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
-			return false;
+			//NOTE: Each series gets its own start date, and the timestep is read off the first two dates. The model only produces
+			// series with a fixed timestep, so we don't have to send the rest of the dates.
+			if(count == 0)
+			{
+				header.startDate = sqlite3_column_int64(statement, 0);
+			}
+			else if(count == 1)
+			{
+				header.timestep = sqlite3_column_int64(statement, 0) - header.startDate;
+			}
+			
+			if(count == capacity)
+			{
+				capacity *= 2;
+				f64 *newvalues = (f64 *)realloc(values, capacity*sizeof(f64));
+				if(!newvalues)
+				{
+					report_error(out, "Out of memory\n");
+					success = false;
+					break;
+				}
+				values = newvalues;
+			}
+			
+			if(sqlite3_column_type(statement, 1) == SQLITE_NULL)
+			{
+				values[count] = std::numeric_limits<double>::quiet_NaN();
+				header.nanCount++;
+			}
+			else
+			{
+				values[count] = sqlite3_column_double(statement, 1);
+			}
+			++count;
 		}
 		
-		count = (u64)sqlite3_column_int(statement, 0);
-		fwrite(&count, sizeof(u64), 1, file);
-		
-		sqlite3_finalize(statement);
-		
-		char sqlcommand[256];
-		sprintf(sqlcommand, "SELECT value FROM %s WHERE ID=%d;", table, requested_ids[i]);
-		
-		rc = sqlite3_prepare_v2(db, sqlcommand, -1, &statement, 0);
-		if( rc != SQLITE_OK )
+		if(success && rc != SQLITE_DONE)
 		{
-			fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
-			return false;
+			report_error(out, "SQL error: %s\n", sqlite3_errmsg(handle->db));
+			success = false;
 		}
 		
-		while((rc = sqlite3_step(statement)) != SQLITE_DONE)
+		if(success)
 		{
-			if(rc == SQLITE_ERROR)
-			{
-				fprintf(stdout, "ERROR: SQL error: %s\n", sqlite3_errmsg(db));
-				return false;
-			}
-			
-			double value;
-			if(sqlite3_column_type(statement, 0) == SQLITE_NULL)
+			header.count = count;
+			if(compress)
 			{
-				value = std::numeric_limits<double>::quiet_NaN();
+				success = write_series_compressed(out, &header, values, &encoded, &encodedcapacity, &compressed, &compressedcapacity);
 			}
 			else
 			{
-				value = sqlite3_column_double(statement, 0);
+				output_write(out, &header, sizeof(series_serial_header));
+				output_write(out, values, count*sizeof(f64));
 			}
-			fwrite(&value, sizeof(double), 1, file);
 		}
+	}
+	
+	free(values);
+	free(encoded);
+	free(compressed);
+	sqlite3_reset(statement); //NOTE: Releases the read lock, since the statement is kept around.
+	
+	return success;
+}
+
+
+//NOTE: Writes the parameter values that INCAView has changed since the database was last uploaded, with the same updates as
+// SQLInterface::writeParameterValues does locally. It is all one transaction, so if an entry can not be stored (e.g. since the database on
+// the instance does not have that parameter) nothing is, and INCAView uploads the whole database instead.
+static bool import_parameters(database_handle *handle, u32 numentries, parameter_serial_entry *entries, output_stream *out)
+{
+	const char *sqlcommand[4] = //NOTE: Indexed by parameter_type.
+	{
+		"UPDATE ParameterValues_bool SET value = ? WHERE ID = ?;",
+		"UPDATE ParameterValues_double SET value = ? WHERE ID = ?;",
+		"UPDATE ParameterValues_int SET value = ? WHERE ID = ?;",
+		"UPDATE ParameterValues_ptime SET value = ? WHERE ID = ?;",
+	};
+	
+	char *errmsg = 0;
+	int rc = sqlite3_exec(handle->db, "BEGIN TRANSACTION;", 0, 0, &errmsg);
+	if(rc != SQLITE_OK)
+	{
+		report_error(out, "SQL error: %s\n", errmsg);
+		sqlite3_free(errmsg);
+		return false;
+	}
+	
+	bool success = true;
+	for(u32 i = 0; i < numentries && success; ++i)
+	{
+		parameter_serial_entry &entry = entries[i];
+		if(entry.type >= parametertype_notsupported)
+		{
+			report_error(out, "Unsupported type %u of parameter %u\n", entry.type, entry.ID);
+			success = false;
+			break;
+		}
+		
+		//NOTE: A model may not have parameters of every type, so the statements are only prepared for the types that are imported.
+		sqlite3_stmt *statement = find_statement(handle, sqlcommand[entry.type]);
+		if(!statement) statement = prepare_statement(handle, sqlcommand[entry.type], out);
+		if(!statement)
+		{
+			success = false;
+			break;
+		}
+		
+		switch(entry.type)
+		{
+			case parametertype_bool:   sqlite3_bind_int64(statement, 1, entry.value.val_bool ? 1 : 0); break;
+			case parametertype_double: sqlite3_bind_double(statement, 1, entry.value.val_double); break;
+			case parametertype_uint:   sqlite3_bind_int64(statement, 1, (s64)entry.value.val_uint); break;
+			case parametertype_ptime:  sqlite3_bind_int64(statement, 1, entry.value.val_ptime); break;
+		}
+		sqlite3_bind_int64(statement, 2, (s64)entry.ID);
 		
-		sqlite3_finalize(statement);
+		rc = sqlite3_step(statement);
+		if(rc != SQLITE_DONE)
+		{
+			report_error(out, "SQL error: %s\n", sqlite3_errmsg(handle->db));
+			success = false;
+		}
+		else if(sqlite3_changes(handle->db) != 1)
+		{
+			report_error(out, "The database has no parameter with ID %u of type %u\n", entry.ID, entry.type);
+			success = false;
+		}
+		sqlite3_reset(statement);
+	}
+	
+	rc = sqlite3_exec(handle->db, success ? "COMMIT;" : "ROLLBACK;", 0, 0, &errmsg);
+	if(rc != SQLITE_OK)
+	{
+		if(success) report_error(out, "SQL error: %s\n", errmsg);
+		sqlite3_free(errmsg);
+		if(success) sqlite3_exec(handle->db, "ROLLBACK;", 0, 0, 0);
+		return false;
 	}
 	
+	return success;
+}
+
+
+static bool read_request_string(char *buffer, u32 length, u32 maxlength)
+{
+	if(length >= maxlength) return false;
+	if(length > 0 && fread(buffer, length, 1, stdin) != 1) return false;
+	buffer[length] = 0;
 	return true;
 }
 
+//NOTE: Server mode. INCAView starts this once per session on a channel that it keeps open, and sends requests on stdin (see
+// server_request_header in serialization.h). Every request is answered on stdout with stream frames ending in an error or a
+// success frame. The databases are kept open and their statements prepared between requests, so that a request costs the
+// query and not the startup of the process. We exit when stdin is closed or on servercommand_quit.
+static void serve()
+{
+	output_stream out = {};
+	out.framed = true;
+	out.buffer = (u8 *)malloc(OUTPUT_FRAME_SIZE);
+	if(!out.buffer)
+	{
+		report_error(0, "Out of memory");
+		return;
+	}
+	
+	database_handle databases[MAX_OPEN_DATABASES] = {};
+	u32 nextdatabase = 0;
+	
+	//NOTE: What follows the names in a request: the IDs, or the parameter entries of an import.
+	u8 *body = 0;
+	u64 bodycapacity = 0;
+	
+	server_request_header request;
+	while(fread(&request, sizeof(server_request_header), 1, stdin) == 1)
+	{
+		char dbname[1024];
+		char table[256];
+		if(!read_request_string(dbname, request.dbNameLen, sizeof(dbname)) || !read_request_string(table, request.tableNameLen, sizeof(table)))
+		{
+			//NOTE: We can't trust the rest of the input stream after this, so we have to quit.
+			report_error(&out, "Malformed request");
+			break;
+		}
+		
+		u64 elementsize = request.command == servercommand_import_parameters ? sizeof(parameter_serial_entry) : sizeof(u32);
+		u64 bodysize = (u64)request.numIDs * elementsize;
+		if(bodysize > MAX_SERVER_REQUEST_BODY_SIZE)
+		{
+			//NOTE: Like a malformed name, we can't skip past this reliably, so we have to quit.
+			report_error(&out, "Request too large: %llu bytes of IDs or parameter values, the limit is %u", (unsigned long long)bodysize, (u32)MAX_SERVER_REQUEST_BODY_SIZE);
+			break;
+		}
+		if(!ensure_capacity(&body, &bodycapacity, bodysize))
+		{
+			report_error(&out, "Out of memory");
+			break;
+		}
+		if(bodysize > 0 && fread(body, bodysize, 1, stdin) != 1)
+		{
+			report_error(&out, "Malformed request");
+			break;
+		}
+		u32 *requested_ids = (u32 *)body;
+		
+		if(request.command == servercommand_quit) break;
+		
+		if(request.command == servercommand_close_databases)
+		{
+			//NOTE: INCAView sends this before the model run replaces the databases.
+			for(u32 i = 0; i < MAX_OPEN_DATABASES; ++i) close_database(&databases[i]);
+			report_success(&out, "Closed databases");
+			continue;
+		}
+		
+		if(request.command == servercommand_import_parameters)
+		{
+			//NOTE: The parameter database is not kept open like the others, since INCAView sometimes replaces it by uploading the whole file.
+			database_handle parameterdb;
+			if(!open_database(&parameterdb, dbname, &out)) continue;
+			if(import_parameters(&parameterdb, request.numIDs, (parameter_serial_entry *)body, &out))
+			{
+				report_success(&out, "Imported %u parameter values", request.numIDs);
+			}
+			close_database(&parameterdb);
+			continue;
+		}
+		
+		database_handle *handle = 0;
+		for(u32 i = 0; i < MAX_OPEN_DATABASES; ++i)
+		{
+			if(databases[i].name && strcmp(databases[i].name, dbname) == 0) handle = &databases[i];
+		}
+		if(!handle)
+		{
+			handle = &databases[nextdatabase];
+			nextdatabase = (nextdatabase + 1) % MAX_OPEN_DATABASES;
+			close_database(handle);
+			if(!open_database(handle, dbname, &out)) continue;
+		}
+		
+		bool success = false;
+		if(request.command == servercommand_export_values || request.command == servercommand_export_values_compressed)
+		{
+			success = export_values(handle, request.numIDs, requested_ids, &out, table, request.command == servercommand_export_values_compressed);
+		}
+		else if(request.command == servercommand_export_structure)
+		{
+			success = export_structure(handle, &out, table);
+		}
+		else
+		{
+			report_error(&out, "Unexpected server command: %u\n", request.command);
+		}
+		
+		if(success)
+		{
+			report_success(&out, "Successfully executed server command: %u", request.command);
+		}
+	}
+	
+	for(u32 i = 0; i < MAX_OPEN_DATABASES; ++i) close_database(&databases[i]);
+	free(body);
+	free(out.buffer);
+}
 
 int main(int argc, char *argv[])
 {
 	assert(sizeof(f64)==8);
-		
-	if(argc >= 5)
+	
+	if(argc == 2 && strcmp(argv[1], SERVE_COMMAND) == 0)
+	{
+		serve();
+	}
+	else if(argc >= 5)
 	{
 		//NOTE: exename is argv[0];
 		const char *command  = argv[1];
 		const char *dbname   = argv[2];
 		const char *filename = argv[3];
 		const char *table    = argv[4];
-		sqlite3 *db;
-		FILE *file = fopen(filename, "w");
-
-		if(!file)
+		
+		output_stream out = {};
+		out.framed = strcmp(filename, STREAM_FILENAME) == 0;
+		if(out.framed)
 		{
-			fprintf(stdout, "ERROR: Unable to open file %s", filename);
-			return 0;
+			out.buffer = (u8 *)malloc(OUTPUT_FRAME_SIZE);
+			if(!out.buffer)
+			{
+				report_error(0, "Out of memory");
+				return 0;
+			}
+		}
+		else
+		{
+			out.file = fopen(filename, "w");
+			if(!out.file)
+			{
+				report_error(&out, "Unable to open file %s", filename);
+				return 0;
+			}
 		}
 		
-		int rc = sqlite3_open_v2(dbname, &db, SQLITE_OPEN_READWRITE, 0);
-		
-		if(rc != SQLITE_OK)
+		database_handle handle;
+		if(!open_database(&handle, dbname, &out))
 		{
-			fprintf(stdout, "ERROR: Unable to open database %s: %s\n", dbname, sqlite3_errmsg(db));
 			return 0;
 		}
 
 		bool success = false;
 		
-		if(strcmp(command, EXPORT_VALUES_COMMAND) == 0)
+		bool isvalues = strcmp(command, EXPORT_VALUES_COMMAND) == 0;
+		bool iscompressedvalues = strcmp(command, EXPORT_VALUES_COMPRESSED_COMMAND) == 0;
+		
+		if(isvalues || iscompressedvalues)
 		{
 			u32 numrequests = argc - 5;
 			if(numrequests > 0)
@@ -224,7 +787,7 @@ int main(int argc, char *argv[])
 					//TODO: check if format was correct
 					requested_ids[i] = ID;
 				}
-				success = export_values(db, numrequests, requested_ids, file, table);
+				success = export_values(&handle, numrequests, requested_ids, &out, table, iscompressedvalues);
 				
 				free(requested_ids);
 				
@@ -233,24 +796,25 @@ int main(int argc, char *argv[])
 		}
 		else if(strcmp(command, EXPORT_STRUCTURE_COMMAND) == 0)
 		{
-			success = export_structure(db, file, table);
+			success = export_structure(&handle, &out, table);
 		}
 		else
 		{
-			fprintf(stdout, "ERROR: Unexpected command: %s\n", argv[1]);
+			report_error(&out, "Unexpected command: %s\n", argv[1]);
 		}
 		
 		if(success)
 		{
-			fprintf(stdout, "SUCCESS: Successfully executed command: %s", argv[1]);
+			report_success(&out, "Successfully executed command: %s", argv[1]);
 		}
 			
-		sqlite3_close(db);
-		fclose(file);
+		close_database(&handle);
+		if(out.file) fclose(out.file);
+		if(out.buffer) free(out.buffer);
 	}
 	else
 	{
-		fprintf(stdout, "ERROR: To few arguments to sqlhandler. Got %d arguments, expected at least 4", argc);
+		report_error(0, "To few arguments to sqlhandler. Got %d arguments, expected at least 4", argc);
 	}
 	return 0;
 }
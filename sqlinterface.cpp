@@ -5,30 +5,102 @@
 #include <QSqlError>
 #include <limits>
 
-SQLInterface::SQLInterface()
+SQLInterface::SQLInterface(const QString &connectionPrefix)
 {
-    db_ = QSqlDatabase::addDatabase("QSQLITE");
+    //NOTE: A connection can only be used from the thread that created it, so every thread that talks to a database needs its own SQLInterface with its own connection prefix.
+    connectionPrefix_ = connectionPrefix;
 }
 
 SQLInterface::~SQLInterface()
 {
-    if(dbIsSet_ && db_.open())
+    while(!connections_.empty())
     {
-        db_.close();
+        QString path = connections_.begin()->first;
+        closeDatabase(path);
     }
 }
 
 bool SQLInterface::setDatabase(QString& path)
 {
-    db_.setDatabaseName(path);
+    auto find = connections_.find(path);
+    if(find == connections_.end())
+    {
+        Connection connection;
+        connection.name = connectionPrefix_ + "_" + QString::number(connectionCount_++);
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection.name);
+        db.setDatabaseName(path);
+
+        find = connections_.insert(std::make_pair(path, connection)).first;
+    }
+
+    current_ = &find->second;
+    db_ = QSqlDatabase::database(current_->name, false);
 
     dbIsSet_ = true;
     return true;
 }
 
-bool SQLInterface::getParameterStructure(QVector<TreeData> &structuredata)
+void SQLInterface::closeDatabase(const QString& path)
+{
+    //NOTE: The connection has to be closed before somebody else deletes or replaces the database file, e.g. before a model run.
+    auto find = connections_.find(path);
+    if(find == connections_.end()) return;
+
+    QString name = find->second.name;
+    if(current_ == &find->second)
+    {
+        current_ = nullptr;
+        db_ = QSqlDatabase();
+        dbIsSet_ = false;
+    }
+    connections_.erase(find); //NOTE: This finalizes the prepared statements.
+
+    {
+        QSqlDatabase db = QSqlDatabase::database(name, false);
+        db.close();
+    }
+    //NOTE: Every QSqlDatabase copy for the connection has to be out of scope before it can be removed.
+    QSqlDatabase::removeDatabase(name);
+}
+
+bool SQLInterface::openDatabase()
 {
+    if(!dbIsSet_) return false;
+    if(db_.isOpen()) return true;
+
     if(!db_.open())
+    {
+        qDebug() << db_.lastError();
+        return false;
+    }
+    return true;
+}
+
+QSqlQuery *SQLInterface::cachedQuery(const QString& sql)
+{
+    //NOTE: Returns the prepared statement for this sql text on the current database, preparing it if it is the first time it is used.
+    auto find = current_->statements.find(sql);
+    if(find != current_->statements.end())
+    {
+        find->second.finish(); //NOTE: Let go of any result set that is left over from the last time it was used.
+        return &find->second;
+    }
+
+    QSqlQuery query(db_);
+    query.setForwardOnly(true); //NOTE: We only ever step through the results once, and this lets the driver avoid caching them.
+    if(!query.prepare(sql))
+    {
+        qDebug() << query.lastError();
+        return nullptr;
+    }
+
+    find = current_->statements.insert(std::make_pair(sql, query)).first;
+    return &find->second;
+}
+
+bool SQLInterface::getParameterStructure(QVector<TreeData> &structuredata)
+{
+    if(!openDatabase())
     {
         return false;
     }
@@ -43,37 +115,36 @@ bool SQLInterface::getParameterStructure(QVector<TreeData> &structuredata)
                                   "FROM ParameterStructure as child "
                                   "WHERE child.dpt = 0 "
                                   "ORDER BY child.ID";
-    QSqlQuery query;
-    if(!query.prepare(command))
+    QSqlQuery *query = cachedQuery(command);
+    if(!query)
     {
-        qDebug() << query.lastError();
+        return false;
     }
-    if(!query.exec())
+    if(!query->exec())
     {
-        // emit logError(query.lastError());
-        qDebug() << query.lastError();
-        db_.close();
+        // emit logError(query->lastError());
+        qDebug() << query->lastError();
         return false;
     }
 
-    while(query.next())
+    while(query->next())
     {
         TreeData item;
-        item.parentID    = query.value(0).toInt();
-        item.ID          = query.value(1).toInt();
-        item.name        = query.value(2).toString();
-        item.unit        = query.value(3).toString();
-        item.description = query.value(4).toString();
+        item.parentID    = query->value(0).toInt();
+        item.ID          = query->value(1).toInt();
+        item.name        = query->value(2).toString();
+        item.unit        = query->value(3).toString();
+        item.description = query->value(4).toString();
         structuredata.push_back(item);
     }
 
-    db_.close();
+    query->finish();
     return true;
 }
 
 bool SQLInterface::getParameterValuesMinMax(std::map<uint32_t, parameter_min_max_val_serial_entry>& IDtoParam)
 {
-    if(!db_.open())
+    if(!openDatabase())
     {
         return false;
     }
@@ -104,70 +175,70 @@ bool SQLInterface::getParameterValuesMinMax(std::map<uint32_t, parameter_min_max
              "ON ParameterStructure.ID = ParameterValues_%s.ID; ",
              value_tables[i], value_tables[i], value_tables[i], value_tables[i], value_tables[i]);
 
-        QSqlQuery query;
-        query.prepare(commandbuf);
-        if(!query.exec())
+        QSqlQuery *query = cachedQuery(commandbuf);
+        if(!query || !query->exec())
         {
-            // emit logError(query.lastError());
-            db_.close();
+            // emit logError(query->lastError());
             return false;
         }
 
-        while(query.next())
+        while(query->next())
         {
             parameter_min_max_val_serial_entry entry;
-            entry.ID = query.value(0).toInt();
-            QString typetxt = query.value(1).toString();
+            entry.ID = query->value(0).toInt();
+            QString typetxt = query->value(1).toString();
             entry.type = Parameter::parseType(typetxt);
             if(entry.type != types[i])
             {
                 //TODO:
                 // emit logError("Database: Parameter with ID %d is registered as having type %s, but is in the table for %s.\n")
                 //                                   entry.ID, typetxt, value_tables[i]);
-                db_.close();
+                query->finish();
                 return false;
             }
             switch(types[i])
             {
                 case parametertype_bool :
                 {
-                    entry.min.val_bool = (bool)query.value(2).toInt();
-                    entry.max.val_bool = (bool)query.value(3).toInt();
-                    entry.value.val_bool = (bool)query.value(4).toInt();
+                    entry.min.val_bool = (bool)query->value(2).toInt();
+                    entry.max.val_bool = (bool)query->value(3).toInt();
+                    entry.value.val_bool = (bool)query->value(4).toInt();
                 } break;
 
                 case parametertype_double :
                 {
-                    entry.min.val_double = query.value(2).toDouble();
-                    entry.max.val_double = query.value(3).toDouble();
-                    entry.value.val_double = query.value(4).toDouble();
+                    entry.min.val_double = query->value(2).toDouble();
+                    entry.max.val_double = query->value(3).toDouble();
+                    entry.value.val_double = query->value(4).toDouble();
                 } break;
 
                 case parametertype_uint :
                 {
-                    entry.min.val_uint = query.value(2).toULongLong();
-                    entry.max.val_uint = query.value(3).toULongLong();
-                    entry.value.val_uint = query.value(4).toULongLong();
+                    entry.min.val_uint = query->value(2).toULongLong();
+                    entry.max.val_uint = query->value(3).toULongLong();
+                    entry.value.val_uint = query->value(4).toULongLong();
                 } break;
 
                 case parametertype_ptime :
                 {
-                    entry.min.val_ptime = query.value(2).toLongLong();
-                    entry.max.val_ptime = query.value(3).toLongLong();
-                    entry.value.val_ptime = query.value(4).toLongLong();
+                    entry.min.val_ptime = query->value(2).toLongLong();
+                    entry.max.val_ptime = query->value(3).toLongLong();
+                    entry.value.val_ptime = query->value(4).toLongLong();
                 } break;
             }
 
             IDtoParam[entry.ID] = entry;
         }
+        query->finish();
     }
-    db_.close();
     return true;
 }
 
 bool SQLInterface::writeParameterValues(QVector<parameter_serial_entry>& writedata)
 {
-    if(!db_.open())
+    if(writedata.empty()) return true;
+
+    if(!openDatabase())
     {
         return false;
     }
@@ -181,65 +252,87 @@ bool SQLInterface::writeParameterValues(QVector<parameter_serial_entry>& writeda
         "UPDATE ParameterValues_ptime SET value = (:value) WHERE ID = (:id);",
     };
 
-    size_t numparameters = writedata.size();
+    //NOTE: Group the values by type so that each type is written with one batch on one prepared statement.
+    QVariantList IDs[4];
+    QVariantList values[4];
 
-    QSqlDatabase::database().transaction();
-    for(int i = 0; i < numparameters; ++i)
+    for(parameter_serial_entry &entry : writedata)
     {
-        parameter_serial_entry &entry = writedata[i];
-
-        QSqlQuery query;
-        query.prepare(sqlcommand[entry.type]);
-        query.bindValue(":id", entry.ID);
         switch(entry.type)
         {
             case parametertype_double:
             {
-                query.bindValue(":value", entry.value.val_double);
+                values[entry.type].push_back(entry.value.val_double);
             } break;
 
             case parametertype_bool:
             {
-                query.bindValue(":value", (int)entry.value.val_bool);
+                values[entry.type].push_back((int)entry.value.val_bool);
             } break;
 
             case parametertype_uint:
             {
-                query.bindValue(":value", qulonglong(entry.value.val_uint));
+                values[entry.type].push_back(qulonglong(entry.value.val_uint));
             } break;
 
             case parametertype_ptime:
             {
-                query.bindValue(":value", qlonglong( entry.value.val_ptime));
+                values[entry.type].push_back(qlonglong( entry.value.val_ptime));
             } break;
 
             default:
             {
                 //TODO: invalid type, log error
-                db_.close();
                 return false;
             } break;
         }
+        IDs[entry.type].push_back(entry.ID);
+    }
+
+    if(!db_.transaction())
+    {
+        qDebug() << db_.lastError();
+        return false;
+    }
+
+    for(int type = 0; type < 4; ++type)
+    {
+        if(IDs[type].empty()) continue;
+
+        QSqlQuery *query = cachedQuery(sqlcommand[type]);
+        if(!query)
+        {
+            db_.rollback();
+            return false;
+        }
 
-        if(!query.exec())
+        query->bindValue(":value", values[type]);
+        query->bindValue(":id", IDs[type]);
+
+        if(!query->execBatch())
         {
-            qDebug() << query.lastError();
-            // emit logError(query.lastError());
-            db_.close();
+            qDebug() << query->lastError();
+            // emit logError(query->lastError());
+            db_.rollback();
             return false;
         }
     }
-    QSqlDatabase::database().commit();
 
-    db_.close();
+    if(!db_.commit())
+    {
+        qDebug() << db_.lastError();
+        db_.rollback();
+        return false;
+    }
+
     return true;
 }
 
 bool SQLInterface::getResultOrInputStructure(QVector<TreeData> &structuredata, const char *table)
 {
-    if(!db_.open())
+    if(!openDatabase())
     {
-        db_.close();
+        return false;
     }
 
     char sqlcommand[512];
@@ -257,108 +350,118 @@ bool SQLInterface::getResultOrInputStructure(QVector<TreeData> &structuredata, c
         table, table, table
     );
 
-    QSqlQuery query;
-    query.prepare(sqlcommand);
+    QSqlQuery *query = cachedQuery(sqlcommand);
 
-    if(!query.exec())
+    if(!query || !query->exec())
     {
-        // emit logError(query.lastError());
+        // emit logError(query->lastError());
         return false;
     }
 
-    while(query.next())
+    while(query->next())
     {
         TreeData entry;
-        entry.parentID = query.value(0).toInt();
-        entry.ID       = query.value(1).toInt();
-        entry.name     = query.value(2).toString();
-        entry.unit     = query.value(3).toString();
+        entry.parentID = query->value(0).toInt();
+        entry.ID       = query->value(1).toInt();
+        entry.name     = query->value(2).toString();
+        entry.unit     = query->value(3).toString();
         structuredata.push_back(entry);
     }
 
-    db_.close();
+    query->finish();
 
     return true;
 }
 
-bool SQLInterface::getResultOrInputValues(const char *table, const QVector<int>& IDs, QVector<QVector<double>> &seriesout, QVector<int64_t> &startdatesout)
+bool SQLInterface::getResultOrInputValues(const char *table, const QVector<int>& IDs, QVector<SeriesData> &seriesout, QVector<int64_t> &startdatesout, QVector<int64_t> &timestepsout)
 {
 
-    if(!db_.open())
+    if(!openDatabase())
     {
         return false;
     }
 
     char sqlcommand[512];
+    sprintf(sqlcommand, "SELECT date, value FROM %s WHERE ID=? ORDER BY date;", table);
 
-    //NOTE: For now we only handle cases where the timestep is one day. Otherwise we would also have to read the timestep from somewhere or read out the entire series of time values.
-    for(int ID : IDs)
+    QSqlQuery *query = cachedQuery(sqlcommand);
+    if(!query)
     {
-        sprintf(sqlcommand, "SELECT date, value FROM %s WHERE ID=%d;", table, ID);
+        return false;
+    }
 
-        QSqlQuery query;
-        query.prepare(sqlcommand);
+    int reservesize = 100; // We don't know how large the first one is, but this tends to speed things up.
 
-        if(!query.exec())
+    //NOTE: The timestep is read off the first two dates of each series. The models only produce series with a fixed timestep.
+    for(int ID : IDs)
+    {
+        query->bindValue(0, ID);
+
+        if(!query->exec())
         {
-            // emit logError(query.lastError());
-            db_.close();
+            // emit logError(query->lastError());
             return false;
         }
 
         QVector<double> series;
-        series.reserve(100); // We don't know how large it is, but this tends to speed things up.
+        series.reserve(reservesize);
 
-        int64_t startDate;
-        bool first = true;
+        int64_t startDate = 0;
+        int64_t timestep = DEFAULT_TIMESTEP;
 
-        while(query.next())
+        while(query->next())
         {
-            if(first)
+            if(series.empty())
+            {
+                startDate = query->value(0).toLongLong();
+            }
+            else if(series.count() == 1)
             {
-                startDate = query.value(0).toLongLong();
-                first = false;
+                timestep = query->value(0).toLongLong() - startDate;
             }
 
-            if(query.value(1).isNull())
+            QVariant value = query->value(1);
+            if(value.isNull())
             {
                 series.push_back(std::numeric_limits<double>::quiet_NaN());
             }
             else
             {
-                series.push_back(query.value(1).toDouble());
+                series.push_back(value.toDouble());
             }
         }
+        query->finish();
+
+        //NOTE: Series in the same table tend to have the same length, so the next one is probably as long as this one.
+        if(series.count() > reservesize) reservesize = series.count();
 
-        seriesout.push_back(series);
+        seriesout.push_back(SeriesData(series));
         startdatesout.push_back(startDate);
+        timestepsout.push_back(timestep);
     }
 
-    db_.close();
     return true;
 }
 
 bool SQLInterface::getExenameFromParameterInfo(QString& exename)
 {
-    if(!db_.open())
+    if(!openDatabase())
     {
         return false;
     }
 
-    QSqlQuery query;
-    query.prepare("SELECT Exename FROM Info");
+    QSqlQuery *query = cachedQuery("SELECT Exename FROM Info");
 
-    if(!query.exec())
+    if(!query || !query->exec())
     {
-        // emit logError(query.lastError());
-        qDebug() << query.lastError();
-        db_.close();
+        // emit logError(query->lastError());
+        if(query) qDebug() << query->lastError();
         return false;
     }
 
-    query.next();
-    exename = query.value(0).toString();
+    query->next();
+    exename = query->value(0).toString();
 
-    db_.close();
+    query->finish();
     return true;
 }
@@ -3,12 +3,15 @@
 
 #include "sqlhandler/serialization.h"
 #include "treemodel.h"
+#include "seriesdata.h"
 #include <QSqlDatabase>
+#include <QSqlQuery>
+#include <map>
 
 class SQLInterface
 {
 public:
-    SQLInterface();
+    SQLInterface(const QString &connectionPrefix = QLatin1String(QSqlDatabase::defaultConnection));
     ~SQLInterface();
 
     bool getParameterStructure(QVector<TreeData> &structuredata);
@@ -16,16 +19,33 @@ public:
     bool writeParameterValues(QVector<parameter_serial_entry>& writedata);
 
     bool getResultOrInputStructure(QVector<TreeData> &structuredata, const char *table);
-    bool getResultOrInputValues(const char *table, const QVector<int>& IDs, QVector<QVector<double>> &seriesout, QVector<int64_t> &startdatesout);
+    bool getResultOrInputValues(const char *table, const QVector<int>& IDs, QVector<SeriesData> &seriesout, QVector<int64_t> &startdatesout, QVector<int64_t> &timestepsout);
 
     bool getExenameFromParameterInfo(QString& exename);
 
     bool setDatabase(QString& path);
     bool databaseIsSet() { return dbIsSet_; }
+    void closeDatabase(const QString& path);
 
 private:
+    //NOTE: One open connection per database file, with the statements that have been prepared on it, so that switching back and forth
+    // between the parameter, result and input databases does not cost us opening the file and preparing the statements again.
+    struct Connection
+    {
+        QString name;
+        std::map<QString, QSqlQuery> statements;
+    };
+
+    bool openDatabase();
+    QSqlQuery *cachedQuery(const QString& sql);
+
     bool dbIsSet_ = false;
     QSqlDatabase db_;
+    Connection *current_ = nullptr;
+
+    QString connectionPrefix_;
+    int connectionCount_ = 0;
+    std::map<QString, Connection> connections_; //NOTE: Keyed by database path.
 };
 
 #endif // SQLINTERFACE_H
@@ -1,4 +1,6 @@
 #include "sshInterface.h"
+#include "channelreader.h"
+#include "sqlhandler/compression.h"
 #include <QDebug>
 #include <QTime>
 //#include <QRandomGenerator>
@@ -29,9 +31,8 @@ SSHInterface::SSHInterface(const char *hubIp, const char *hubUsername, const cha
 
     //NOTE: We send a no-op to the server every 5 minutes to keep the session alive. This will hopefully stop the firewall from thinking
     // it is dead and close it.
-    //NOTE: According to my understanding, the QTimer does not work on a separate thread but rather in the main application's event loop, so this
-    // function will never be called while the sshInterface is doing something else, meaning we should not get conflicts when using the session_ in sendNoop()
-    // as we would if we used it in a separate thread.
+    //NOTE: The QTimer runs in the main application's event loop, while data fetches and model runs use the session from the DataService worker
+    // thread, so sendNoop() has to take the session lock like every other public function.
     sendNoopTimer = new QTimer(this);
     QObject::connect(sendNoopTimer, &QTimer::timeout, this, &SSHInterface::sendNoop);
     sendNoopTimer->start(1000*60*5);
@@ -41,7 +42,7 @@ SSHInterface::~SSHInterface()
 {
     if(isSessionConnected() && loggedInToInstance_)
     {
-       destroyInstance();
+       releaseInstance();
     }
 
     if(isSessionConnected())
@@ -63,8 +64,10 @@ void SSHInterface::sshStatusCallback(void *data, float status)
 }
 
 
-bool SSHInterface::createInstance(const char *username, const char *instancename)
+bool SSHInterface::createInstance(const char *username)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     bool success = connectSession(hubUsername_.data(), hubIp_.data(), hubKey_.data());
 
     if(!success)
@@ -74,130 +77,53 @@ bool SSHInterface::createInstance(const char *username, const char *instancename
 
     loggedInToHub_ = true;
 
-    //NOTE: An instance will most of the time not already exist. The main example where it may exist is
-    // if we crashed out of INCAView in a previous session so that it did not get to close down the
-    // instance properly.
-
-    //TODO: We should probably have a script running on the hub that closes down instances that have
-    // been idle for more than e.g 8 hours.
+    //NOTE: The hub keeps a pool of instances running (see instancepool.sh), so most of the time we get one that is ready right away instead
+    // of waiting for one to be created from the snapshot. The pool manager also installs new ssh keys for this user on the instance.
+    emit log("Asking the hub for a compute instance. If none are ready, one has to be created, which may take a few minutes ...");
 
-    bool instancealreadyexists = false;
+    char command[512];
+    sprintf(command, "./instancepool.sh lease %s", username);
 
+    std::stringstream output;
+    success = runCommand(command, output);
+
+    //NOTE: Format of the answer, on the last line of the output:
+    // LEASE instancename xx.xx.xx.xx
+    // or
+    // ERROR message
+    std::string leasedname;
+    std::string line;
+    std::string errormessage = "No answer from the instance pool.";
+    while(std::getline(output, line))
     {
-        emit log(QString("Checking to see if instance ") + instancename + " already exists.");
-
-        std::stringstream output;
-        bool success = runCommand("gcloud compute instances list", output); //TODO: Check success and handle errors
-
-        //NOTE: Format of what we have to parse to see if the instancename already exists:
-        // (NOTE HOWEVER: google state that they don't guarantee the format of output from gcloud to stay constant!!!)
-        // If we want to remove the uncertainty of this format maybe changing we have to make our own
-        // python script that runs on the hub and calls into the google compute api so that we don't
-        // rely on gcloud at all.
-
-        // NAME   ZONE    MACHINE_TYPE    PREEMPTIBLE    INTERNAL_IP  EXTERNAL_IP  STATUS
-        // instancename   europe-west2-a    n1-standard2  xx.xx.xx.xx  xx.xx.xx.xx  TERMINATED
-        // ...
-
-        //NOTE: split on whitespace:
-        std::vector<std::string> words((std::istream_iterator<std::string>(output)),
-                                         std::istream_iterator<std::string>());
-        bool instanceisrunning = false;
-        int foundipcount = 0;
-        std::regex ippattern("[[:digit:]]+.[[:digit:]]+.[[:digit:]]+.[[:digit:]]+");
-        for(std::string& word : words)
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if(keyword == "LEASE")
         {
-            if(word == instancename)
-            {
-                instancealreadyexists = true;
-            }
-            if(instancealreadyexists)
-            {
-                if(std::regex_match(word, ippattern))
-                {
-                    if(foundipcount == 0) foundipcount = 1;
-                    instanceIp_ = word;
-                }
-            }
-            if(foundipcount == 1)
-            {
-                if(word == "RUNNING")
-                {
-                    instanceisrunning = true;
-                    break;
-                }
-                else if(word == "TERMINATED") break;
-            }
-            if(foundipcount > 1) break;
+            words >> leasedname >> instanceIp_;
         }
-
-        if(instancealreadyexists && !instanceisrunning)
+        else if(keyword == "ERROR")
         {
-            //TODO: Restart it I guess, but this is very unlikely to happen?
-            qDebug() << "Found existing compute instance " << instancename << " and it was not running ";
+            std::getline(words >> std::ws, errormessage);
+            leasedname.clear();
         }
     }
 
-    //NOTE: There is a case to make for it being better to kill an existing instance and recreate it
-    // than it is to just reuse it. We have to think about this
-
-    if(instancealreadyexists)
+    std::regex ippattern("[[:digit:]]+.[[:digit:]]+.[[:digit:]]+.[[:digit:]]+");
+    if(!success || leasedname.empty() || !std::regex_match(instanceIp_, ippattern))
     {
-        emit log("Instance found to already exist.");
+        emit logError(QString("Unable to get a compute instance from the hub: ") + errormessage.data());
+        disconnectSession();
+        loggedInToHub_ = false;
+        return false;
     }
-    else
-    {
-        emit log("Instance does not exist, attempting to create it. This may take a few seconds ...");
-
-        char command[512];
-        sprintf(command, "./createinstance.sh %s %s", instancename, username);
-
-        std::stringstream output;
-        bool success = runCommand(command, output); //TODO: Check success and handle errors
-
-        //NOTE: Format of what we want to parse to get the external ip of the newly created instance.
-        // (NOTE HOWEVER: google state that they don't guarantee the format of output from gcloud to stay constant!!!)
-        // If we want to remove the uncertainty of this format maybe changing we have to make our own
-        // python script that runs on the hub and calls into the google compute api so that we don't
-        // rely on gcloud at all. (the createinstance.sh script currently calls gcloud)
-
-        // NAME             ZONE            MACHINE_TYPE   PREEMPTIBLE  INTERNAL_IP  EXTERNAL_IP    STATUS
-        // incaview-magnus  europe-west3-a  n1-standard-2               xx.xx.xx.xx  xx.xx.xx.xx  RUNNING
-
-        //NOTE: split on whitespace:
-        std::vector<std::string> words((std::istream_iterator<std::string>(output)),
-                                         std::istream_iterator<std::string>());
-
-        //NOTE: find the second word that looks like an ip address.
-        std::regex ippattern("[[:digit:]]+.[[:digit:]]+.[[:digit:]]+.[[:digit:]]+");
-        bool foundone = false;
-        bool foundtwo = false;
-        for(std::string& word : words)
-        {
-            if(std::regex_match(word, ippattern))
-            {
-                if(foundone)
-                {
-                    instanceIp_ = word;
-                    foundtwo = true;
-                    break;
-                }
-                foundone = true;
-            }
-        }
 
-        if(!foundtwo)
-        {
-            emit logError("Something went wrong with creating an instance. Could not parse an external ip from output of gcloud command. Output was:");
-            emit logError(output.str().data());
-            return false;
-        }
+    emit log(QString("Got compute instance ") + leasedname.data() + " with ip " + instanceIp_.data());
 
-        emit log(QString("Created compute instance with ip ") + instanceIp_.data());
-    }
-
-    instanceName_ = instancename;
+    instanceName_ = leasedname;
     instanceUser_ = username;
+    instanceExists_ = true; //NOTE: So that it is given back to the pool if we fail to connect to it.
 
 
     //NOTE: download ssh keys for the instance.
@@ -236,7 +162,7 @@ bool SSHInterface::createInstance(const char *username, const char *instancename
     {
         emit logError("Unable to connect");
 
-        destroyInstance();
+        releaseInstance();
 
         return false;
     }
@@ -245,13 +171,16 @@ bool SSHInterface::createInstance(const char *username, const char *instancename
     runCommand("export PATH=$PATH:/home/magnus:/home/magnus/incaview", out, false); //our exe files are in these locations.
 
     loggedInToInstance_ = true;
-    instanceExists_ = true;
+
+    startSqlHandlerServer();
 
     return true;
 }
 
-bool SSHInterface::destroyInstance()
+bool SSHInterface::releaseInstance()
 {
+    QMutexLocker lock(&sessionMutex_);
+
     if(!instanceExists_) return true;
 
 
@@ -266,24 +195,29 @@ bool SSHInterface::destroyInstance()
         bool success = connectSession(hubUsername_.data(), hubIp_.data(), hubKey_.data());
         if(!success)
         {
-            emit logError("SSH: Unable to connect to the hub in order to destroy the compute instance.");
+            emit logError("SSH: Unable to connect to the hub in order to give the compute instance back.");
             return false;
         }
         loggedInToHub_ = true;
     }
 
-    emit log(QString("SSH: Sending command to destroy compute instance ") + instanceName_.data() + " This may take a few seconds ...");
+    //NOTE: The instance is kept running in the pool on the hub, so that we get it back quickly if we connect again soon. The pool manager
+    // deletes it once it has been idle for a while.
+    emit log(QString("SSH: Giving compute instance ") + instanceName_.data() + " back to the pool.");
 
     char command[512];
-    sprintf(command, "./destroyinstance.sh %s", instanceName_.data());
+    sprintf(command, "./instancepool.sh release %s", instanceName_.data());
 
     std::stringstream output;
-    bool success = runCommand(command, output);
+    bool success = runCommand(command, output) && output.str().find("RELEASED") != std::string::npos;
 
     if(success)
     {
-        //TODO: Parse output to see if gcloud reported a successful deletion?
-        emit log(QString("SSH: Successfully destroyed compute instance ") + instanceName_.data());
+        emit log(QString("SSH: Gave compute instance ") + instanceName_.data() + " back to the pool.");
+    }
+    else
+    {
+        emit logError(QString("SSH: The instance pool did not take back compute instance ") + instanceName_.data() + ": " + output.str().data());
     }
 
     instanceExists_ = false;
@@ -293,6 +227,8 @@ bool SSHInterface::destroyInstance()
 
 bool SSHInterface::isInstanceConnected()
 {
+    QMutexLocker lock(&sessionMutex_);
+
     return loggedInToInstance_ && isSessionConnected();
 }
 
@@ -306,6 +242,7 @@ bool SSHInterface::connectSession(const char *user, const char *address, const c
 
     if(session_)
     {
+        stopSqlHandlerServer();
         ssh_free(session_);
         session_ = nullptr;
     }
@@ -351,6 +288,7 @@ void SSHInterface::disconnectSession()
 {
     if(session_)
     {
+        stopSqlHandlerServer();
         ssh_disconnect(session_);
         ssh_free(session_);
         session_ = nullptr;
@@ -369,6 +307,8 @@ bool SSHInterface::isSessionConnected()
 
 const char * SSHInterface::getDisconnectionMessage()
 {
+    QMutexLocker lock(&sessionMutex_);
+
     const char *message = ssh_get_disconnect_message(session_);
     if(!message) message = ssh_get_error(session_);
     return message;
@@ -380,6 +320,20 @@ bool SSHInterface::runCommand(const char *command, std::stringstream &out, bool
     //  It does not say whether or not the program that was called ran successfully. For that one has
     //  to parse the out strngstream.
 
+    return streamCommand(command, [&](const char *data, size_t size)
+    {
+        std::string text(data, size);
+        if(logAsItHappens)
+        {
+            emit log(QString::fromStdString(text));
+        }
+        out << text;
+        return true;
+    });
+}
+
+bool SSHInterface::streamCommand(const char *command, const std::function<bool(const char *, size_t)> &handleOutput)
+{
     if(!isSessionConnected())
     {
         emit logError(QString("SSH: Tried to run command \"%1\" without having an open ssh session.").arg(command));
@@ -397,36 +351,24 @@ bool SSHInterface::runCommand(const char *command, std::stringstream &out, bool
 
     ssh_channel_request_exec(channel, command);
 
-    int poll_rc;
-    char readData[256];
-
-    while((poll_rc = ssh_channel_poll(channel, 0)) != SSH_EOF)
-    {
-        if(poll_rc == SSH_ERROR)
-        {
-            emit logError(QString("SSH: Error while reading from channel: %1").arg(ssh_get_error(session_)));
-            break;
-        }
-        int rc = ssh_channel_read(channel, readData, sizeof(readData)-1, 0);
-        readData[rc] = 0;
-
-        if(rc > 0)
-        {
-           if(logAsItHappens)
-           {
-               emit log(QString(readData));
-           }
-
-           out << readData;
-        }
-
-        QThread::msleep(50); //TODO: We should check that this actually does what we want.
-    }
+    bool success = readFromChannel(channel, handleOutput);
 
     ssh_channel_close(channel);
     ssh_channel_free(channel);
 
-    return true;
+    return success;
+}
+
+bool SSHInterface::readFromChannel(ssh_channel channel, const std::function<bool(const char *, size_t)> &handleOutput)
+{
+    //NOTE: Reads stdout of the channel until EOF, or until handleOutput returns false to say that it does not want any more.
+    std::string error;
+    bool success = readChannel(session_, channel, handleOutput, error);
+    if(!success)
+    {
+        emit logError(QString("SSH: ") + error.data());
+    }
+    return success;
 }
 
 
@@ -558,6 +500,8 @@ bool SSHInterface::readFile(void **buffer, size_t* buffersize, const char *remot
 
 bool SSHInterface::uploadEntireFile(const char *localpath, const char *remotelocation, const char *remotefilename)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     std::ifstream file(localpath, std::ios::binary | std::ios::ate);
 
     if(file.fail())
@@ -589,6 +533,8 @@ bool SSHInterface::uploadEntireFile(const char *localpath, const char *remoteloc
 
 bool SSHInterface::downloadEntireFile(const char *localpath, const char *remotefilename)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     void *filebuf = nullptr;
     size_t filebufsize;
 
@@ -625,184 +571,430 @@ bool startsWith(const char *pre, const char *str)
     return lenstr < lenpre ? false : strncmp(pre, str, lenpre) == 0;
 }
 
-bool SSHInterface::runSqlHandler(const char *command, const char *db, const char *tempfile, const QVector<QString> *extraParam)
+//NOTE: Decodes the stream frames (see serialization.h) that the sqlhandler writes to stdout when it is told to stream its output,
+// incrementally as the bytes arrive from the channel. The data frames are appended to payload, and decoding stops at the final
+// error or success frame.
+struct StreamFrameDecoder
+{
+    QByteArray payload;
+    QByteArray message;
+    uint32_t status = 0;     //NOTE: streamframe_error or streamframe_success once the final frame has been decoded.
+    bool malformed = false;
+
+    bool feed(const char *data, size_t size);
+
+private:
+    stream_frame_header header_;
+    size_t headerBytes_ = 0;
+    size_t bodyRemaining_ = 0;
+};
+
+bool StreamFrameDecoder::feed(const char *data, size_t size)
 {
-    char commandbuf[512];
-    //int len = sprintf(commandbuf, "./incaview/sqlhandler %s %s %s", command, db, tempfile);
-    int len = sprintf(commandbuf, "/home/magnus/incaview/sqlhandler %s %s %s", command, db, tempfile);
-    if(extraParam)
+    //NOTE: Returns false once no more input is wanted.
+    while(size > 0 && !status && !malformed)
     {
-        for(const QString &par : *extraParam)
+        if(headerBytes_ < sizeof(stream_frame_header))
         {
-            len += sprintf(commandbuf + len, " %s", par.toLatin1().data());
+            size_t tocopy = std::min(size, sizeof(stream_frame_header) - headerBytes_);
+            memcpy((char *)&header_ + headerBytes_, data, tocopy);
+            headerBytes_ += tocopy;
+            data += tocopy;
+            size -= tocopy;
+
+            if(headerBytes_ < sizeof(stream_frame_header)) break;
+
+            if(header_.type < streamframe_data || header_.type > streamframe_success)
+            {
+                //NOTE: This is not frames, so most likely it is text output. Keep it so that it can be reported.
+                malformed = true;
+                message.append((const char *)&header_, sizeof(stream_frame_header));
+                message.append(data, (int)size);
+                break;
+            }
+            bodyRemaining_ = header_.size;
+        }
+
+        size_t tocopy = std::min(size, bodyRemaining_);
+        if(header_.type == streamframe_data) payload.append(data, (int)tocopy);
+        else message.append(data, (int)tocopy);
+        data += tocopy;
+        size -= tocopy;
+        bodyRemaining_ -= tocopy;
+
+        if(bodyRemaining_ == 0)
+        {
+            if(header_.type != streamframe_data) status = header_.type;
+            headerBytes_ = 0;
         }
     }
 
-    //qDebug(commandbuf);
+    return !status && !malformed;
+}
 
-    std::stringstream output;
-    bool success = runCommand(commandbuf, output);
+void SSHInterface::startSqlHandlerServer()
+{
+    //NOTE: The sqlhandler server keeps running on its own channel for the rest of the session, with the databases open and the statements
+    // prepared, so that a request does not cost the startup of a new sqlhandler process. See serve() in sqlhandler.cpp.
+    stopSqlHandlerServer();
 
-    //qDebug(resultbuf);
+    ssh_channel channel = ssh_channel_new(session_);
+    if(!channel) return;
 
-    if(startsWith("ERROR:", output.str().data()))
+    if(ssh_channel_open_session(channel) != SSH_OK || ssh_channel_request_exec(channel, "/home/magnus/incaview/sqlhandler " SERVE_COMMAND) != SSH_OK)
     {
-        emit logError(QString("SSH: SQL: Unsuccessful operation on remote database:</br>&emsp;") + output.str().data());
-        success = false;
+        emit log("SSH: Could not start the sqlhandler server on the instance. The sqlhandler will be started for each request instead.");
+        ssh_channel_free(channel);
+        return;
     }
 
-    return success;
+    sqlHandlerChannel_ = channel;
 }
 
-void SSHInterface::deleteTransactionFile(const char *filename)
+void SSHInterface::stopSqlHandlerServer()
 {
-    char command[512];
-    sprintf(command, "rm %s", filename);
-    std::stringstream output;
-    runCommand(command, output);
-    //NOTE: It should not be necessary to parse the output of this?
+    if(sqlHandlerChannel_)
+    {
+        if(isSessionConnected())
+        {
+            ssh_channel_send_eof(sqlHandlerChannel_); //NOTE: The server exits when its stdin is closed.
+            ssh_channel_close(sqlHandlerChannel_);
+        }
+        ssh_channel_free(sqlHandlerChannel_);
+        sqlHandlerChannel_ = nullptr;
+    }
 }
 
-
-bool SSHInterface::getStructureData(const char *remoteDB, const char *table, QVector<TreeData> &outdata)
+bool SSHInterface::requestFromSqlHandlerServer(uint32_t servercommand, const char *db, const char *table, const QVector<int> *IDs, StreamFrameDecoder &decoder)
 {
-    const char *tmpname = "data.dat";
+    //NOTE: Returns false if the request could not be carried out over the server channel. An error reported by the server (like an SQL error)
+    // is still a successful request, and is reported through the decoder.
+    server_request_header header = {};
+    header.command = servercommand;
+    header.dbNameLen = (uint32_t)strlen(db);
+    header.tableNameLen = (uint32_t)strlen(table);
+    header.numIDs = IDs ? (uint32_t)IDs->count() : 0;
+
+    QByteArray request;
+    request.reserve(sizeof(server_request_header) + header.dbNameLen + header.tableNameLen + header.numIDs*sizeof(uint32_t));
+    request.append((const char *)&header, sizeof(server_request_header));
+    request.append(db, header.dbNameLen);
+    request.append(table, header.tableNameLen);
+    if(IDs)
+    {
+        for(int ID : *IDs)
+        {
+            uint32_t ID32 = (uint32_t)ID;
+            request.append((const char *)&ID32, sizeof(uint32_t));
+        }
+    }
 
-    QVector<QString> extracommand;
-    extracommand.push_back(QString(table));
+    return sendToSqlHandlerServer(request, decoder);
+}
 
-    bool success = runSqlHandler(EXPORT_STRUCTURE_COMMAND, remoteDB, tmpname, &extracommand);
+bool SSHInterface::sendToSqlHandlerServer(const QByteArray &request, StreamFrameDecoder &decoder)
+{
+    int rc = ssh_channel_write(sqlHandlerChannel_, request.constData(), (uint32_t)request.size());
+    if(rc != request.size()) return false;
 
-    if(success)
+    bool success = readFromChannel(sqlHandlerChannel_, [&decoder](const char *data, size_t size)
     {
-        void *filedata = nullptr;
-        size_t filesize;
-        success = readFile(&filedata, &filesize, tmpname);
-        if(success)
-        {
-            //qDebug() << "File size: " << filesize;
-
-            //NOTE:
-            // We expect to get a binary file on the following format:
-            // the entire file is a series of structure entries repeated after each other.
-            // each structure entry is a struct of type structure_serial_entry (128 bit) (see serialization.h):
-            // structure_serial_entry: (parent_id (32bit uint), child_id (32bit uint), childnamelen (32bit uint), unitlen (32bit uint))
-            // followed by
-            // childname (childnamelen bytes char string (not 0-terminated))
-            // unit      (unitlen      bytes char string (not 0-terminated))
-
-            uint8_t *at = (uint8_t *)filedata;
-            while(at < (uint8_t *)filedata + filesize)
-            {
-                structure_serial_entry *entry = (structure_serial_entry *)at;
-                at += sizeof(structure_serial_entry);
+        return decoder.feed(data, size);
+    });
 
-                int parentID = (int)entry->parentID;
-                int childID = (int)entry->childID;
+    return success && decoder.status != 0;
+}
 
-                std::string namestr((char *)at, (char *)at + entry->childNameLen); //Is there a better way to get a QString from a range based char * (not nullterminated) than going via a std::string?
-                at += entry->childNameLen;
-                std::string unitstr((char *)at, (char *)at + entry->unitLen);
-                at += entry->unitLen;
+void SSHInterface::closeRemoteDatabases()
+{
+    //NOTE: The sqlhandler server keeps the databases open, so it has to let go of them before a model run deletes and recreates them.
+    if(!sqlHandlerChannel_) return;
 
-                //NOTE: Uncomment the following line to see what we got.
-                //qDebug() << "parentid: " << parentID << "childid: " << childID << "name: " << namestr.data() << "unit: " << unitstr.data();
+    StreamFrameDecoder decoder;
+    if(!requestFromSqlHandlerServer(servercommand_close_databases, "", "", nullptr, decoder))
+    {
+        stopSqlHandlerServer();
+    }
+}
+
+bool SSHInterface::runSqlHandler(uint32_t servercommand, const char *db, const char *table, const QVector<int> *IDs, QByteArray &payload)
+{
+    //NOTE: The sqlhandler streams its output back over the channel, so we don't have to have it write a file on the instance and
+    // then fetch and delete that file afterwards.
+    StreamFrameDecoder decoder;
+    bool success = false;
 
-                outdata.push_back({childID, parentID, QString::fromStdString(namestr), QString::fromStdString(unitstr)});
+    if(sqlHandlerChannel_)
+    {
+        success = requestFromSqlHandlerServer(servercommand, db, table, IDs, decoder);
+        if(!success)
+        {
+            emit log("SSH: Lost contact with the sqlhandler server on the instance. The sqlhandler will be started for each request instead.");
+            stopSqlHandlerServer();
+            decoder = StreamFrameDecoder();
+        }
+    }
+
+    if(!success)
+    {
+        const char *command = EXPORT_STRUCTURE_COMMAND;
+        if(servercommand == servercommand_export_values) command = EXPORT_VALUES_COMMAND;
+        else if(servercommand == servercommand_export_values_compressed) command = EXPORT_VALUES_COMPRESSED_COMMAND;
+        std::string commandstr = std::string("/home/magnus/incaview/sqlhandler ") + command + " " + db + " " + STREAM_FILENAME + " " + table;
+        if(IDs)
+        {
+            for(int ID : *IDs)
+            {
+                commandstr += " " + std::to_string(ID);
             }
         }
-        if(filedata) free(filedata);
+
+        success = streamCommand(commandstr.data(), [&decoder](const char *data, size_t size)
+        {
+            return decoder.feed(data, size);
+        });
+
+        if(!success) return false;
     }
 
-    deleteTransactionFile(tmpname);
+    if(decoder.status == streamframe_success)
+    {
+        payload.swap(decoder.payload);
+        return true;
+    }
 
-    return success;
+    if(decoder.status == streamframe_error)
+    {
+        emit logError(QString("SSH: SQL: Unsuccessful operation on remote database:</br>&emsp;") + decoder.message);
+    }
+    else if(decoder.malformed)
+    {
+        emit logError(QString("SSH: SQL: Unexpected output from the sqlhandler on the instance. It may be too old to support streaming:</br>&emsp;") + decoder.message);
+    }
+    else
+    {
+        emit logError("SSH: SQL: The sqlhandler on the instance exited without reporting success.");
+    }
+    return false;
 }
 
 
-bool SSHInterface::getDataSets(const char *remoteDB, const QVector<int>& IDs, const char *table, QVector<QVector<double>> &valuedata, QVector<int64_t> &startdates)
+bool SSHInterface::importParameterValues(const char *remoteDB, const QVector<parameter_serial_entry> &parameterdata)
 {
-    const char *tmpname = "data.dat";
+    QMutexLocker lock(&sessionMutex_);
+
+    //NOTE: Returns false if the values were not stored, in which case the caller should upload the whole database instead. This is only
+    // done over the sqlhandler server, since a few hundred bytes of values are not worth starting a new sqlhandler process for either.
+    if(!sqlHandlerChannel_) return false;
+
+    server_request_header header = {};
+    header.command = servercommand_import_parameters;
+    header.dbNameLen = (uint32_t)strlen(remoteDB);
+    header.tableNameLen = 0;
+    header.numIDs = (uint32_t)parameterdata.count();
+
+    QByteArray request;
+    request.reserve(sizeof(server_request_header) + header.dbNameLen + header.numIDs*sizeof(parameter_serial_entry));
+    request.append((const char *)&header, sizeof(server_request_header));
+    request.append(remoteDB, header.dbNameLen);
+    request.append((const char *)parameterdata.constData(), header.numIDs*sizeof(parameter_serial_entry));
+
+    StreamFrameDecoder decoder;
+    if(!sendToSqlHandlerServer(request, decoder))
+    {
+        emit log("SSH: Lost contact with the sqlhandler server on the instance. The sqlhandler will be started for each request instead.");
+        stopSqlHandlerServer();
+        return false;
+    }
 
-    QVector<QString> IDstrs;
-    IDstrs.push_back(QString(table));
-    for(int ID : IDs)
+    if(decoder.status != streamframe_success)
     {
-        IDstrs.push_back(QString::number(ID));
+        //NOTE: Not an error as such, since the caller falls back to uploading the database.
+        emit log(QString("SSH: Could not update the parameters on the instance:</br>&emsp;") + decoder.message);
+        return false;
     }
 
-    bool success = runSqlHandler(EXPORT_VALUES_COMMAND, remoteDB, tmpname, &IDstrs);
+    return true;
+}
+
+bool SSHInterface::getStructureData(const char *remoteDB, const char *table, QVector<TreeData> &outdata)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    QByteArray payload;
+    bool success = runSqlHandler(servercommand_export_structure, remoteDB, table, nullptr, payload);
 
     if(success)
     {
-        void *filedata = nullptr;
-        size_t filesize;
-        success = readFile(&filedata, &filesize, tmpname);
-        if(success)
+        //NOTE:
+        // We expect to get a binary payload on the following format:
+        // the entire payload is a series of structure entries repeated after each other.
+        // each structure entry is a struct of type structure_serial_entry (128 bit) (see serialization.h):
+        // structure_serial_entry: (parent_id (32bit uint), child_id (32bit uint), childnamelen (32bit uint), unitlen (32bit uint))
+        // followed by
+        // childname (childnamelen bytes char string (not 0-terminated))
+        // unit      (unitlen      bytes char string (not 0-terminated))
+
+        const uint8_t *at = (const uint8_t *)payload.constData();
+        const uint8_t *end = at + payload.size();
+        while(at + sizeof(structure_serial_entry) <= end)
         {
+            const structure_serial_entry *entry = (const structure_serial_entry *)at;
+            at += sizeof(structure_serial_entry);
 
-            //NOTE:
-            // We expect a to get a binary file on the following format:
-            // numresults (64 bit uint)  - the number of result series that was returned by the request.
-            // repeated numresults times:
-            //      count (64 bit uint)  - the number of numbers in the current result series.
-            //      repeated count times:
-            //          double (64 bit float)
+            int parentID = (int)entry->parentID;
+            int childID = (int)entry->childID;
 
-            uint8_t *data = (uint8_t *)filedata;
+            std::string namestr((char *)at, (char *)at + entry->childNameLen); //Is there a better way to get a QString from a range based char * (not nullterminated) than going via a std::string?
+            at += entry->childNameLen;
+            std::string unitstr((char *)at, (char *)at + entry->unitLen);
+            at += entry->unitLen;
 
-            uint64_t numresults = *(uint64_t *)data;
-            data += sizeof(uint64_t);
-            int64_t date = *(int64_t *)data;
-            data += sizeof(int64_t);
+            //NOTE: Uncomment the following line to see what we got.
+            //qDebug() << "parentid: " << parentID << "childid: " << childID << "name: " << namestr.data() << "unit: " << unitstr.data();
 
-            if((int)numresults == IDs.count())
-            {
-                valuedata.resize(numresults);
-                startdates.resize(numresults);
+            outdata.push_back({childID, parentID, QString::fromStdString(namestr), QString::fromStdString(unitstr)});
+        }
+    }
 
-                //qDebug() << "number of result series returned: " << numresults;
+    return success;
+}
 
-                for(uint i = 0; i < numresults; ++i)
-                {
-                    startdates[i] = date; //TODO: This is BROKEN!!!!!! We instead have to update the sqlhandler so that it sends one start date per timeseries.
 
-                    //TODO: Check that we never overstep the filesize;
-                    uint64_t count = *(uint64_t *)data;
-                    data += sizeof(uint64_t);
-                    size_t cnt = (size_t)count;
+bool SSHInterface::getDataSets(const char *remoteDB, const QVector<int>& IDs, const char *table, QVector<SeriesData> &valuedata, QVector<int64_t> &startdates, QVector<int64_t> &timesteps)
+{
+    QMutexLocker lock(&sessionMutex_);
 
-                    //qDebug() << "size of " << i << "th result series: " << cnt;
+    QByteArray payload;
+    uint32_t command = compressTransfers_ ? servercommand_export_values_compressed : servercommand_export_values;
+    bool success = runSqlHandler(command, remoteDB, table, &IDs, payload);
 
-                    QVector<double>& current = valuedata[i];
-                    current.resize(cnt);
+    if(success)
+    {
+        //NOTE: The decoded series keep the payload alive, so we don't want them to also keep the slack that was left from growing it.
+        if(payload.capacity() > payload.size() + payload.size()/8) payload.squeeze();
 
-                    double *data_d = (double *)data;
-                    for(int j = 0; j < cnt; ++j)
-                    {
-                        current[j] = *data_d++;
-                    }
-                    data += cnt*sizeof(double);
-                }
+        success = decodeDataSets(payload, IDs, valuedata, startdates, timesteps);
+    }
+
+    return success;
+}
+
+bool SSHInterface::decodeDataSets(const QByteArray &payload, const QVector<int>& IDs, QVector<SeriesData> &valuedata, QVector<int64_t> &startdates, QVector<int64_t> &timesteps)
+{
+    //NOTE: See serialization.h for a description of the format. We also accept the version 1 format in case the instance runs an old build of the sqlhandler.
+    //NOTE: Uncompressed series are not copied out of the payload. The SeriesData are views into it, and keep it alive for as long as they live.
+    const uint8_t *begin = (const uint8_t *)payload.constData();
+    const uint8_t *data = begin;
+    size_t datasize = (size_t)payload.size();
+    const uint8_t *end = data + datasize;
+
+    if(datasize < sizeof(values_file_header))
+    {
+        emit logError(QString("SSH: SQL: Got a truncated value file of %1 bytes").arg(datasize));
+        return false;
+    }
+
+    const values_file_header *fileheader = (const values_file_header *)data;
+    bool isversion1 = fileheader->magic != VALUES_FILE_MAGIC;
+
+    if(!isversion1 && fileheader->version != VALUES_FILE_VERSION && fileheader->version != VALUES_FILE_VERSION_COMPRESSED)
+    {
+        emit logError(QString("SSH: SQL: Got a value file of unsupported version %1").arg(fileheader->version));
+        return false;
+    }
+
+    uint64_t numresults = isversion1 ? *(const uint64_t *)data : fileheader->numseries;
+    int64_t version1date = isversion1 ? *(const int64_t *)(data + sizeof(uint64_t)) : 0;
+    data += isversion1 ? sizeof(uint64_t) + sizeof(int64_t) : sizeof(values_file_header);
+
+    if((int)numresults != IDs.count())
+    {
+        emit logError(QString("SSH: SQL: Requested %1 data sets, got %2").arg(IDs.count()).arg(numresults));
+        return false;
+    }
+
+    valuedata.resize(numresults);
+    startdates.resize(numresults);
+    timesteps.resize(numresults);
+
+    bool truncated = false;
+    for(uint i = 0; i < numresults; ++i)
+    {
+        uint64_t count = 0;
+        if(isversion1)
+        {
+            truncated = (size_t)(end - data) < sizeof(uint64_t);
+            if(truncated) break;
+            count = *(const uint64_t *)data;
+            data += sizeof(uint64_t);
+
+            startdates[i] = version1date; //NOTE: Version 1 only had the start date of the first series, and no timestep.
+            timesteps[i] = DEFAULT_TIMESTEP;
+        }
+        else
+        {
+            truncated = (size_t)(end - data) < sizeof(series_serial_header);
+            if(truncated) break;
+            const series_serial_header *header = (const series_serial_header *)data;
+            data += sizeof(series_serial_header);
+
+            if((int)header->ID != IDs[i])
+            {
+                emit logError(QString("SSH: SQL: Requested data set %1, got %2").arg(IDs[i]).arg(header->ID));
+                return false;
             }
-            else
+
+            count = header->count;
+            startdates[i] = header->startDate;
+            timesteps[i] = header->timestep;
+
+            if(header->flags & SERIESFLAG_COMPRESSED)
             {
-                emit logError(QString("SSH: SQL: Requested %1 data sets, got %2").arg(IDs.count()).arg(numresults));
-                success = false;
+                truncated = (size_t)(end - data) < sizeof(uint64_t);
+                if(truncated) break;
+                uint64_t compressedsize = *(const uint64_t *)data;
+                data += sizeof(uint64_t);
+
+                truncated = (uint64_t)(end - data) < compressedsize;
+                if(truncated) break;
+
+                QByteArray encoded = qUncompress(data, (int)compressedsize);
+                data += compressedsize;
+
+                QVector<double> values((int)count);
+                if((count > 0 && encoded.isEmpty()) || !gorilla_decode((const uint8_t *)encoded.constData(), (uint64_t)encoded.size(), values.data(), count))
+                {
+                    emit logError(QString("SSH: SQL: Unable to decompress data set %1").arg(IDs[i]));
+                    return false;
+                }
+                valuedata[i] = SeriesData(values);
+                continue;
             }
         }
 
-        if(filedata) free(filedata);
+        size_t cnt = (size_t)count;
+        truncated = (size_t)(end - data)/sizeof(double) < cnt;
+        if(truncated) break;
+
+        valuedata[i] = SeriesData(payload, (int)(data - begin), (int)cnt);
+        data += cnt*sizeof(double);
     }
 
-    deleteTransactionFile(tmpname);
+    if(truncated)
+    {
+        emit logError("SSH: SQL: The value file was shorter than what its headers said.");
+        return false;
+    }
 
-    return success;
+    return true;
 }
 
 
 bool SSHInterface::createParameterDatabase(const char *remoteexename, const char *remoteparameterfile, const char *remoteparameterdb)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     if(!isInstanceConnected())
     {
         //NOTE: should never happen if interface behaves correctly
@@ -829,6 +1021,8 @@ bool SSHInterface::createParameterDatabase(const char *remoteexename, const char
 
 bool SSHInterface::exportParameters(const char *remoteexename, const char *remoteparameterdb, const char *remoteparameterfile)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     if(!isInstanceConnected())
     {
         //NOTE: should never happen if interface behaves correctly
@@ -848,6 +1042,8 @@ bool SSHInterface::exportParameters(const char *remoteexename, const char *remot
 
 void SSHInterface::runModel(const char *exename, const char *remoteInputFile, const char *remotedbname)
 {
+    QMutexLocker lock(&sessionMutex_);
+
     if(!isInstanceConnected())
     {
         //NOTE: should never happen if interface behaves correctly
@@ -860,17 +1056,154 @@ void SSHInterface::runModel(const char *exename, const char *remoteInputFile, co
 
     sprintf(runcommand, "rm results.db; rm inputs.db;/home/magnus/%s run %s %s", exename, remoteInputFile, remotedbname);
 
+    closeRemoteDatabases();
+
     std::stringstream out;
     runCommand(runcommand, out, true);
 }
 
 
-void SSHInterface::sendNoop()
+#define REMOTEJOB_LOG_FILE "incaview_job.log"
+#define REMOTEJOB_PID_FILE "incaview_job.pid"
+#define REMOTEJOB_STATUS_FILE "incaview_job.status"
+
+//NOTE: Single quotes text for the remote shell, so that it is passed on as one word and nothing in it is expanded. A single quote in the
+// text ends the quoting, is escaped, and starts it again.
+static std::string shellQuote(const char *text)
 {
-    qDebug() << "SSH - we sent a No-op";
+    std::string quoted = "'";
+    for(const char *c = text; *c; ++c)
+    {
+        if(*c == '\'') quoted += "'\\''";
+        else quoted += *c;
+    }
+    quoted += "'";
+    return quoted;
+}
+
+bool SSHInterface::prepareRemoteJobDirectory(const char *directory)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    if(!isInstanceConnected()) return false;
+
+    //NOTE: The model does not like it if results.db and inputs.db are already there (see runModel), and a status file left from an
+    // earlier job would make this one look like it is done already.
+    std::string quoted = shellQuote(directory);
+    std::string command = "mkdir -p " + quoted + " && cd " + quoted
+        + " && rm -f results.db inputs.db " REMOTEJOB_LOG_FILE " " REMOTEJOB_PID_FILE " " REMOTEJOB_STATUS_FILE " && echo ok";
+
+    closeRemoteDatabases(); //NOTE: The sqlhandler server may have the databases of an earlier job in this directory open.
+
+    std::stringstream out;
+    return runCommand(command.data(), out) && out.str().find("ok") != std::string::npos;
+}
+
+bool SSHInterface::startRemoteJob(const char *directory, const char *command)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    if(!isInstanceConnected()) return false;
+
+    //NOTE: setsid puts the job in a process group of its own, so that cancelRemoteJobs can stop the model along with the shell that runs it.
+    // All of the job's file descriptors are redirected, so the channel is closed as soon as it has been started. The command is run by
+    // the inner shell, which gets it single quoted, so that only the inner shell expands anything in it.
+    std::string jobscript = std::string("(") + command + ") > " REMOTEJOB_LOG_FILE " 2>&1; echo $? > " REMOTEJOB_STATUS_FILE;
+    std::string commandstr = "cd " + shellQuote(directory) + " && (setsid sh -c " + shellQuote(jobscript.data())
+        + " < /dev/null > /dev/null 2>&1 & echo $! > " REMOTEJOB_PID_FILE ") && echo started";
+
+    std::stringstream out;
+    bool success = runCommand(commandstr.data(), out) && out.str().find("started") != std::string::npos;
+    if(!success) emit logError(QString("SSH: Unable to start a job in ") + directory);
+    return success;
+}
+
+bool SSHInterface::getRemoteJobStatus(const QVector<QString> &directories, QVector<int> &exitCodes)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    exitCodes.clear();
+    if(directories.empty()) return true;
+    if(!isInstanceConnected()) return false;
+
+    //NOTE: All the jobs are checked with one command, which prints one line per directory. The status file is looked at again if the job
+    // is not alive, since it may have written it and exited in between. A job that is neither alive nor has written its status was killed.
+    std::string command = "for d in";
+    for(const QString &directory : directories) command += " " + shellQuote(directory.toLatin1().data());
+    command += "; do if [ -s \"$d\"/" REMOTEJOB_STATUS_FILE " ]; then cat \"$d\"/" REMOTEJOB_STATUS_FILE ";"
+               " elif kill -0 -$(cat \"$d\"/" REMOTEJOB_PID_FILE " 2>/dev/null) 2>/dev/null; then echo running;"
+               " elif [ -s \"$d\"/" REMOTEJOB_STATUS_FILE " ]; then cat \"$d\"/" REMOTEJOB_STATUS_FILE "; else echo lost; fi; done";
+
+    std::stringstream out;
+    if(!runCommand(command.data(), out)) return false;
+
+    std::string line;
+    while(std::getline(out, line) && exitCodes.count() < directories.count())
+    {
+        if(line == "running")   exitCodes.push_back(remoteJobRunning);
+        else if(line == "lost") exitCodes.push_back(remoteJobLost);
+        else                    exitCodes.push_back(atoi(line.data()));
+    }
+
+    if(exitCodes.count() != directories.count())
+    {
+        emit logError("SSH: Unexpected output when checking on the remote jobs.");
+        return false;
+    }
+    return true;
+}
+
+bool SSHInterface::getRemoteJobLog(const char *directory, std::string &log)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    if(!isInstanceConnected()) return false;
+
+    //NOTE: Only the end of the log, in case the model was very talkative.
+    std::string command = "tail -c 65536 " + shellQuote(directory) + "/" REMOTEJOB_LOG_FILE;
+
+    std::stringstream out;
+    if(!runCommand(command.data(), out)) return false;
+    log = out.str();
+    return true;
+}
+
+void SSHInterface::cancelRemoteJobs(const QVector<QString> &directories)
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    if(directories.empty() || !isInstanceConnected()) return;
 
+    std::string command = "for d in";
+    for(const QString &directory : directories) command += " " + shellQuote(directory.toLatin1().data());
+    command += "; do kill -TERM -$(cat \"$d\"/" REMOTEJOB_PID_FILE " 2>/dev/null) 2>/dev/null; done; true";
+
+    std::stringstream out;
+    runCommand(command.data(), out);
+}
+
+int SSHInterface::getInstanceCoreCount()
+{
+    QMutexLocker lock(&sessionMutex_);
+
+    if(!isInstanceConnected()) return 1;
+
+    std::stringstream out;
+    if(!runCommand("nproc", out)) return 1;
+
+    int count = 0;
+    out >> count;
+    return count > 0 ? count : 1;
+}
+
+
+void SSHInterface::sendNoop()
+{
     //NOTE: This function is supposed to be called in a regular interval so that the session is not idle (and so that the firewall does not shut down
-    // the connection).
+    // the connection). If somebody else is using the session it is not idle, and we don't want to block the GUI thread waiting for them.
+    if(!sessionMutex_.tryLock()) return;
+
+    qDebug() << "SSH - we sent a No-op";
 
     if(session_)
     {
@@ -882,4 +1215,6 @@ void SSHInterface::sendNoop()
             qDebug() << "No-op caused error";
         }
     }
+
+    sessionMutex_.unlock();
 }
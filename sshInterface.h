@@ -5,11 +5,16 @@
 #include <libssh/callbacks.h>
 #include "sqlhandler/serialization.h"
 #include "treemodel.h"
+#include "seriesdata.h"
 #include <QThread>
 #include <QTimer>
+#include <QMutex>
 #include <QString>
 #include <sstream>
 #include <regex>
+#include <functional>
+
+struct StreamFrameDecoder;
 
 //NOTE: we have to define these if we are not on Linux.
 #ifndef S_IRWXU
@@ -27,14 +32,15 @@ public:
     SSHInterface(const char *hubIp, const char *hubUsername, const char *hubKey);
     ~SSHInterface();
 
-    bool createInstance(const char *user, const char *instancename);
-    bool destroyInstance();
+    bool createInstance(const char *user);
+    bool releaseInstance();
     bool isInstanceConnected();
 
     bool getStructureData(const char *remoteDB, const char *table, QVector<TreeData> &outdata);
-    bool getDataSets(const char *remoteDB, const QVector<int>& IDs, const char *table, QVector<QVector<double>> &valuedata, QVector<int64_t> &startdates);
+    bool getDataSets(const char *remoteDB, const QVector<int>& IDs, const char *table, QVector<SeriesData> &valuedata, QVector<int64_t> &startdates, QVector<int64_t> &timesteps);
     bool uploadEntireFile(const char *localpath, const char *remotelocation, const char *remotefilename);
     bool downloadEntireFile(const char *localpath, const char *remotefilename);
+    bool importParameterValues(const char *remoteDB, const QVector<parameter_serial_entry> &parameterdata);
 
     bool createParameterDatabase(const char *, const char *, const char*);
     bool exportParameters(const char *, const char *, const char *);
@@ -43,6 +49,19 @@ public:
 
     void runModel(const char *exename, const char *remoteInputFile, const char *remotedbname);
 
+    //NOTE: Remote jobs run detached from the session, each in its own directory (relative to the home directory on the instance). A job
+    // writes its output to incaview_job.log, the ID of its process group to incaview_job.pid and, when it is done, its exit code to
+    // incaview_job.status. Starting a job and checking on it are short commands, so any number of jobs can run at once over the one session.
+    bool prepareRemoteJobDirectory(const char *directory);
+    bool startRemoteJob(const char *directory, const char *command);
+    bool getRemoteJobStatus(const QVector<QString> &directories, QVector<int> &exitCodes);
+    bool getRemoteJobLog(const char *directory, std::string &log);
+    void cancelRemoteJobs(const QVector<QString> &directories);
+    int getInstanceCoreCount();
+
+    static const int remoteJobRunning = -1; //NOTE: Exit codes reported by getRemoteJobStatus for jobs that have not exited normally (yet).
+    static const int remoteJobLost = -2;    //NOTE: The job is not running, but it did not write its exit code, e.g. since it was killed.
+
     void sendNoop();
 
 
@@ -51,6 +70,11 @@ public:
 
 private:
     ssh_session session_;
+    //NOTE: Every public function that uses the session holds this lock, since the session is used both from the GUI thread and from the DataService worker thread.
+    // It is recursive since the public functions call each other.
+    QMutex sessionMutex_{QMutex::Recursive};
+    ssh_channel sqlHandlerChannel_ = nullptr; //NOTE: The channel that the sqlhandler server runs on, if it is running.
+    bool compressTransfers_ = true; //NOTE: Whether value series are requested in the compressed format (see serialization.h).
 
     //NOTE: These two bools only reflect whether or not we have logged in and not logged out. We could have been disconnected by error, so one should always test for isSessionConnected().
     bool loggedInToHub_ = false;
@@ -71,11 +95,19 @@ private:
     bool isSessionConnected();
 
     bool runCommand(const char *command, std::stringstream &out, bool logAsItHappens = false);
+    bool streamCommand(const char *command, const std::function<bool(const char *, size_t)> &handleOutput);
+    bool readFromChannel(ssh_channel channel, const std::function<bool(const char *, size_t)> &handleOutput);
     bool writeFile(const void *contents, size_t contentssize, const char *remotelocation, const char *remotefilename);
     bool readFile(void **buffer, size_t *buffersize, const char *remotefilename);
-    bool runSqlHandler(const char *command, const char *db, const char *tempfile, const QVector<QString> *extraParam = 0);
+    bool runSqlHandler(uint32_t servercommand, const char *db, const char *table, const QVector<int> *IDs, QByteArray &payload);
+
+    void startSqlHandlerServer();
+    void stopSqlHandlerServer();
+    bool requestFromSqlHandlerServer(uint32_t servercommand, const char *db, const char *table, const QVector<int> *IDs, StreamFrameDecoder &decoder);
+    bool sendToSqlHandlerServer(const QByteArray &request, StreamFrameDecoder &decoder);
+    void closeRemoteDatabases();
 
-    void deleteTransactionFile(const char *filename);
+    bool decodeDataSets(const QByteArray &payload, const QVector<int>& IDs, QVector<SeriesData> &valuedata, QVector<int64_t> &startdates, QVector<int64_t> &timesteps);
 
 signals:
     void log(const QString&);
@@ -0,0 +1,234 @@
+#include "statistics.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+static const int64_t block_size = 1024; //NOTE: 8 kB of doubles per series, so a block is still in the L1 cache for the second loop over it.
+static const int lanes = 4;
+
+static const double nan_value = std::numeric_limits<double>::quiet_NaN();
+static const double infinity = std::numeric_limits<double>::infinity();
+
+//NOTE: Count, mean and sum of squared deviations from the mean of a set of values (or co-deviations of two sets), merged pairwise.
+struct moments
+{
+    double n = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+};
+
+struct comoments
+{
+    double n = 0.0;
+    double meanx = 0.0;
+    double meany = 0.0;
+    double c = 0.0;
+};
+
+static void merge(moments &total, double n, double mean, double m2)
+{
+    if(n == 0.0) return;
+    double sum = total.n + n;
+    double delta = mean - total.mean;
+    total.mean += delta * n / sum;
+    total.m2 += m2 + delta*delta * total.n * n / sum;
+    total.n = sum;
+}
+
+static void merge(comoments &total, double n, double meanx, double meany, double c)
+{
+    if(n == 0.0) return;
+    double sum = total.n + n;
+    double deltax = meanx - total.meanx;
+    double deltay = meany - total.meany;
+    total.c += c + deltax*deltay * total.n * n / sum;
+    total.meanx += deltax * n / sum;
+    total.meany += deltay * n / sum;
+    total.n = sum;
+}
+
+double SummaryStatistics::standardDeviation() const
+{
+    return std::sqrt(variance);
+}
+
+SummaryStatistics summaryStatistics(const double *values, int64_t count)
+{
+    SummaryStatistics result;
+
+    moments total;
+    double min = infinity;
+    double max = -infinity;
+
+    for(int64_t start = 0; start < count; start += block_size)
+    {
+        int64_t end = std::min(start + block_size, count);
+
+        double n[lanes] = {}, sum[lanes] = {};
+        double mn[lanes] = {infinity, infinity, infinity, infinity};
+        double mx[lanes] = {-infinity, -infinity, -infinity, -infinity};
+
+        auto accumulate = [&](int l, int64_t i)
+        {
+            double v = values[i];
+            bool valid = (v == v); //NOTE: False for NaN.
+            n[l]   += valid ? 1.0 : 0.0;
+            sum[l] += valid ? v : 0.0;
+            mn[l]   = v < mn[l] ? v : mn[l]; //NOTE: Comparisons with NaN are false, so NaN is skipped here without a branch.
+            mx[l]   = v > mx[l] ? v : mx[l];
+        };
+        int64_t i = start;
+        for(; i + lanes <= end; i += lanes)
+        {
+            for(int l = 0; l < lanes; ++l) accumulate(l, i + l);
+        }
+        for(; i < end; ++i) accumulate(0, i);
+
+        double blockn = (n[0] + n[1]) + (n[2] + n[3]);
+        if(blockn == 0.0) continue;
+        double blockmean = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / blockn;
+        min = std::min(min, std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3])));
+        max = std::max(max, std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3])));
+
+        double m2[lanes] = {};
+        auto deviate = [&](int l, int64_t i)
+        {
+            double v = values[i];
+            double d = (v == v) ? v - blockmean : 0.0;
+            m2[l] += d*d;
+        };
+        i = start;
+        for(; i + lanes <= end; i += lanes)
+        {
+            for(int l = 0; l < lanes; ++l) deviate(l, i + l);
+        }
+        for(; i < end; ++i) deviate(0, i);
+
+        merge(total, blockn, blockmean, (m2[0] + m2[1]) + (m2[2] + m2[3]));
+    }
+
+    result.count = (int64_t)total.n;
+    result.nanCount = count - result.count;
+    if(result.count == 0)
+    {
+        result.min = result.max = result.mean = result.variance = nan_value;
+        return result;
+    }
+    result.min = min;
+    result.max = max;
+    result.mean = total.mean;
+    result.variance = total.m2 / total.n;
+    return result;
+}
+
+ResidualStatistics residualStatistics(const double *observed, const double *modeled, int64_t count, double x0, double dx)
+{
+    ResidualStatistics result;
+
+    moments obs, mod, x;
+    comoments obsmod, xres;
+    double absolutesum = 0.0;
+    double squaresum = 0.0;
+    double minres = infinity;
+    double maxres = -infinity;
+
+    for(int64_t start = 0; start < count; start += block_size)
+    {
+        int64_t end = std::min(start + block_size, count);
+
+        //NOTE: First loop over the block: the counts, sums and extremes.
+        double n[lanes] = {}, sumo[lanes] = {}, summ[lanes] = {}, sumr[lanes] = {}, sumx[lanes] = {}, sumabs[lanes] = {}, sumsq[lanes] = {};
+        double mn[lanes] = {infinity, infinity, infinity, infinity};
+        double mx[lanes] = {-infinity, -infinity, -infinity, -infinity};
+
+        auto accumulate = [&](int l, int64_t i)
+        {
+            double o = observed[i];
+            double m = modeled[i];
+            double residual = o - m; //NOTE: NaN if either of them is.
+            bool valid = (residual == residual);
+            double r = valid ? residual : 0.0;
+            n[l]      += valid ? 1.0 : 0.0;
+            sumo[l]   += valid ? o : 0.0;
+            summ[l]   += valid ? m : 0.0;
+            sumr[l]   += r;
+            sumx[l]   += valid ? x0 + dx*(double)i : 0.0;
+            sumabs[l] += std::abs(r);
+            sumsq[l]  += r*r;
+            mn[l]      = residual < mn[l] ? residual : mn[l];
+            mx[l]      = residual > mx[l] ? residual : mx[l];
+        };
+        int64_t i = start;
+        for(; i + lanes <= end; i += lanes)
+        {
+            for(int l = 0; l < lanes; ++l) accumulate(l, i + l);
+        }
+        for(; i < end; ++i) accumulate(0, i);
+
+        double blockn = (n[0] + n[1]) + (n[2] + n[3]);
+        if(blockn == 0.0) continue;
+        double meano = ((sumo[0] + sumo[1]) + (sumo[2] + sumo[3])) / blockn;
+        double meanm = ((summ[0] + summ[1]) + (summ[2] + summ[3])) / blockn;
+        double meanr = ((sumr[0] + sumr[1]) + (sumr[2] + sumr[3])) / blockn;
+        double meanx = ((sumx[0] + sumx[1]) + (sumx[2] + sumx[3])) / blockn;
+        absolutesum += (sumabs[0] + sumabs[1]) + (sumabs[2] + sumabs[3]);
+        squaresum   += (sumsq[0] + sumsq[1]) + (sumsq[2] + sumsq[3]);
+        minres = std::min(minres, std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3])));
+        maxres = std::max(maxres, std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3])));
+
+        //NOTE: Second loop over the block, while it is still in the cache: the deviations from the block means.
+        double m2o[lanes] = {}, m2m[lanes] = {}, m2x[lanes] = {}, com[lanes] = {}, cxr[lanes] = {};
+        auto deviate = [&](int l, int64_t i)
+        {
+            double o = observed[i];
+            double m = modeled[i];
+            bool valid = (o - m == o - m);
+            double d_o = valid ? o - meano : 0.0;
+            double d_m = valid ? m - meanm : 0.0;
+            double d_r = valid ? (o - m) - meanr : 0.0;
+            double d_x = valid ? (x0 + dx*(double)i) - meanx : 0.0;
+            m2o[l] += d_o*d_o;
+            m2m[l] += d_m*d_m;
+            m2x[l] += d_x*d_x;
+            com[l] += d_o*d_m;
+            cxr[l] += d_x*d_r;
+        };
+        i = start;
+        for(; i + lanes <= end; i += lanes)
+        {
+            for(int l = 0; l < lanes; ++l) deviate(l, i + l);
+        }
+        for(; i < end; ++i) deviate(0, i);
+
+        merge(obs, blockn, meano, (m2o[0] + m2o[1]) + (m2o[2] + m2o[3]));
+        merge(mod, blockn, meanm, (m2m[0] + m2m[1]) + (m2m[2] + m2m[3]));
+        merge(x,   blockn, meanx, (m2x[0] + m2x[1]) + (m2x[2] + m2x[3]));
+        merge(obsmod, blockn, meano, meanm, (com[0] + com[1]) + (com[2] + com[3]));
+        merge(xres,   blockn, meanx, meanr, (cxr[0] + cxr[1]) + (cxr[2] + cxr[3]));
+    }
+
+    result.count = (int64_t)obs.n;
+    if(result.count == 0)
+    {
+        result.observedMean = result.observedVariance = result.modeledMean = result.modeledVariance = result.covariance = nan_value;
+        result.meanError = result.meanAbsoluteError = result.meanSquaredError = result.minResidual = result.maxResidual = nan_value;
+        result.xMean = result.xVariance = result.xResidualCovariance = nan_value;
+        return result;
+    }
+
+    double n = obs.n;
+    result.observedMean        = obs.mean;
+    result.observedVariance    = obs.m2 / n;
+    result.modeledMean         = mod.mean;
+    result.modeledVariance     = mod.m2 / n;
+    result.covariance          = obsmod.c / n;
+    result.meanError           = xres.meany;
+    result.meanAbsoluteError   = absolutesum / n;
+    result.meanSquaredError    = squaresum / n;
+    result.minResidual         = minres;
+    result.maxResidual         = maxres;
+    result.xMean               = x.mean;
+    result.xVariance           = x.m2 / n;
+    result.xResidualCovariance = xres.c / n;
+    return result;
+}
@@ -0,0 +1,51 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+
+//NOTE: Summary statistics of series, computed in one pass over the values. Missing values (NaN) are skipped without branching on them.
+// The values are processed in blocks that fit in the L1 cache: in a block the sums are accumulated in independent lanes (so that the
+// compiler can vectorize the loops), then the moments of the block are computed around the block's own mean and merged into the totals
+// with the pairwise update of Chan, Golub and LeVeque. That is as accurate as Welford's algorithm, without a division per value.
+
+struct SummaryStatistics
+{
+    int64_t count = 0;    //NOTE: Number of values that are not NaN.
+    int64_t nanCount = 0;
+    double min;           //NOTE: NaN if count is 0, as are the others.
+    double max;
+    double mean;
+    double variance;      //NOTE: Population variance, i.e. divided by count.
+
+    double standardDeviation() const;
+};
+
+//NOTE: Statistics of a modeled series against an observed one, over the time steps where neither is missing. The residual is
+// observed - modeled. x is the time of each step, with the steps at x0, x0 + dx, x0 + 2*dx, ... It is used for the linear regression of
+// the residual over time.
+struct ResidualStatistics
+{
+    int64_t count = 0;
+
+    double observedMean;
+    double observedVariance;
+    double modeledMean;
+    double modeledVariance;
+    double covariance;          //NOTE: Between observed and modeled.
+
+    double meanError;           //NOTE: Mean of the residual, i.e. the bias.
+    double meanAbsoluteError;
+    double meanSquaredError;
+    double minResidual;
+    double maxResidual;
+
+    double xMean;
+    double xVariance;
+    double xResidualCovariance;
+};
+
+SummaryStatistics summaryStatistics(const double *values, int64_t count);
+
+ResidualStatistics residualStatistics(const double *observed, const double *modeled, int64_t count, double x0 = 0.0, double dx = 1.0);
+
+#endif // STATISTICS_H
@@ -0,0 +1,161 @@
+#include "sweepdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QThread>
+#include <algorithm>
+
+SweepDialog::SweepDialog(const QVector<const Parameter *> &parameters, bool remote, QWidget *parent)
+    : QDialog(parent), parameters_(parameters)
+{
+    setWindowTitle(tr("Parameter sweep"));
+
+    table_ = new QTableWidget(parameters_.count(), 4, this);
+    table_->setHorizontalHeaderLabels(QStringList() << tr("Parameter") << tr("From") << tr("To") << tr("Steps"));
+    table_->verticalHeader()->hide();
+
+    for(int row = 0; row < parameters_.count(); ++row)
+    {
+        const Parameter *parameter = parameters_[row];
+
+        QTableWidgetItem *name = new QTableWidgetItem(parameter->name);
+        name->setFlags(name->flags() & ~Qt::ItemIsEditable);
+        table_->setItem(row, 0, name);
+
+        //NOTE: The default is the whole range the parameter is allowed to have.
+        table_->setItem(row, 1, new QTableWidgetItem(Parameter::getValueDisplayString(parameter->min, parameter->type)));
+        table_->setItem(row, 2, new QTableWidgetItem(Parameter::getValueDisplayString(parameter->max, parameter->type)));
+        table_->setItem(row, 3, new QTableWidgetItem("5"));
+    }
+    table_->resizeColumnsToContents();
+
+    spinConcurrent_ = new QSpinBox(this);
+    spinConcurrent_->setToolTip(tr("How many model runs to have going at the same time. The default is the number of cores."));
+    if(remote)
+    {
+        //NOTE: We don't know how many cores the instance has until the sweep is started.
+        spinConcurrent_->setRange(0, 256);
+        spinConcurrent_->setSpecialValueText(tr("One per core on the instance"));
+        spinConcurrent_->setValue(0);
+    }
+    else
+    {
+        spinConcurrent_->setRange(1, 256);
+        spinConcurrent_->setValue(std::max(QThread::idealThreadCount(), 1));
+    }
+
+    labelRunCount_ = new QLabel(this);
+
+    QHBoxLayout *concurrentLayout = new QHBoxLayout();
+    concurrentLayout->addWidget(new QLabel(tr("Simultaneous runs:"), this));
+    concurrentLayout->addWidget(spinConcurrent_);
+    concurrentLayout->addStretch();
+    concurrentLayout->addWidget(labelRunCount_);
+
+    buttons_ = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    buttons_->button(QDialogButtonBox::Ok)->setText(tr("Run sweep"));
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table_);
+    layout->addLayout(concurrentLayout);
+    layout->addWidget(buttons_);
+
+    QObject::connect(buttons_, &QDialogButtonBox::accepted, this, &SweepDialog::accept);
+    QObject::connect(buttons_, &QDialogButtonBox::rejected, this, &SweepDialog::reject);
+    QObject::connect(table_, &QTableWidget::itemChanged, this, &SweepDialog::updateRunCount);
+
+    updateRunCount();
+}
+
+bool SweepDialog::readRow(int row, SweepParameter &parameter, QString &error) const
+{
+    const Parameter *source = parameters_[row];
+    parameter.ID = source->ID;
+    parameter.type = source->type;
+    parameter.name = source->name;
+
+    bool ok;
+    parameter.steps = table_->item(row, 3)->text().toInt(&ok);
+    if(!ok || parameter.steps < 1)
+    {
+        error = tr("The number of steps for %1 has to be a positive whole number.").arg(source->name);
+        return false;
+    }
+
+    for(int col = 1; col <= 2; ++col)
+    {
+        QString text = table_->item(row, col)->text();
+        parameter_value &value = (col == 1) ? parameter.from : parameter.to;
+        if(source->type == parametertype_uint) value.val_uint = text.toULongLong(&ok);
+        else                                   value.val_double = text.toDouble(&ok);
+        if(!ok)
+        {
+            error = tr("\"%1\" is not a valid value for %2.").arg(text, source->name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QVector<SweepParameter> SweepDialog::sweepParameters() const
+{
+    QVector<SweepParameter> result;
+    for(int row = 0; row < parameters_.count(); ++row)
+    {
+        SweepParameter parameter;
+        QString error;
+        if(readRow(row, parameter, error)) result.push_back(parameter);
+    }
+    return result;
+}
+
+void SweepDialog::updateRunCount()
+{
+    QVector<SweepParameter> parameters = sweepParameters();
+    if(parameters.count() != parameters_.count())
+    {
+        labelRunCount_->setText(tr("Invalid ranges"));
+        return;
+    }
+    int count = ParameterSweep::runCount(parameters);
+    labelRunCount_->setText(tr("%1 runs").arg(count));
+    buttons_->button(QDialogButtonBox::Ok)->setEnabled(count > 0 && count <= maxRuns);
+}
+
+void SweepDialog::accept()
+{
+    QVector<SweepParameter> parameters;
+    for(int row = 0; row < parameters_.count(); ++row)
+    {
+        SweepParameter parameter;
+        QString error;
+        if(!readRow(row, parameter, error))
+        {
+            QMessageBox::warning(this, tr("Invalid sweep"), error);
+            return;
+        }
+
+        //NOTE: The model may misbehave outside the range the parameter is declared with, but that is for the user to judge.
+        Parameter check = *parameters_[row];
+        if(check.isNotInRange(parameter.from) || check.isNotInRange(parameter.to))
+        {
+            QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Values out of range"),
+                tr("The range for %1 goes outside its minimum and maximum. Do you want to sweep it anyway?").arg(check.name),
+                QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+            if(answer != QMessageBox::Yes) return;
+        }
+        parameters.push_back(parameter);
+    }
+
+    int count = ParameterSweep::runCount(parameters);
+    if(count > maxRuns)
+    {
+        QMessageBox::warning(this, tr("Invalid sweep"), tr("The sweep would have %1 runs. It can have at most %2.").arg(count).arg(maxRuns));
+        return;
+    }
+
+    QDialog::accept();
+}
@@ -0,0 +1,39 @@
+#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+
+#include "parameter.h"
+#include "parametersweep.h"
+#include <QDialog>
+#include <QTableWidget>
+#include <QSpinBox>
+#include <QLabel>
+#include <QDialogButtonBox>
+
+//NOTE: Lets the user pick the range and the number of steps of each parameter in a sweep, and how many model runs to have going at a time.
+class SweepDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    SweepDialog(const QVector<const Parameter *> &parameters, bool remote, QWidget *parent = nullptr);
+
+    QVector<SweepParameter> sweepParameters() const;
+    int maxConcurrentRuns() const { return spinConcurrent_->value(); } //NOTE: 0 for a remote sweep means one run per core on the instance.
+
+    static const int maxRuns = 10000; //NOTE: A larger grid is most likely a mistake, and would fill up the disk with databases.
+
+public slots:
+    void accept() override;
+
+private:
+    bool readRow(int row, SweepParameter &parameter, QString &error) const;
+    void updateRunCount();
+
+    QVector<const Parameter *> parameters_;
+    QTableWidget *table_;
+    QSpinBox *spinConcurrent_;
+    QLabel *labelRunCount_;
+    QDialogButtonBox *buttons_;
+};
+
+#endif // SWEEPDIALOG_H
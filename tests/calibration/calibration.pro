@@ -0,0 +1,15 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core
+QT       -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_calibration
+TEMPLATE = app
+
+SOURCES += tst_calibration.cpp \
+    ../../calibration.cpp
+
+HEADERS += ../../calibration.h
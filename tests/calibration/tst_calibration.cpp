@@ -0,0 +1,166 @@
+#include "../../calibration.h"
+#include <stdio.h>
+#include <vector>
+
+//NOTE: Table-driven test of findCalibrationPairs. Each case is a result structure, an input structure and the pairs that are expected, in
+// order. The structures are written like the databases give them: ID, parent ID (0 at the top) and name.
+
+static int failures = 0;
+
+struct ExpectedPair
+{
+    int resultID;
+    int inputID;
+    const char *name;
+    const char *parentName;
+};
+
+struct PairCase
+{
+    const char *testcase;
+    std::vector<TreeData> results;
+    std::vector<TreeData> inputs;
+    std::vector<ExpectedPair> expected;
+};
+
+static TreeData item(int ID, int parentID, const char *name)
+{
+    TreeData data;
+    data.ID = ID;
+    data.parentID = parentID;
+    data.name = name;
+    return data;
+}
+
+static void runCase(const PairCase &c)
+{
+    QVector<TreeData> results, inputs;
+    for(const TreeData &data : c.results) results.push_back(data);
+    for(const TreeData &data : c.inputs) inputs.push_back(data);
+
+    QVector<CalibrationPair> pairs = findCalibrationPairs(results, inputs);
+
+    bool ok = pairs.count() == (int)c.expected.size();
+    for(int idx = 0; ok && idx < pairs.count(); ++idx)
+    {
+        const CalibrationPair &got = pairs[idx];
+        const ExpectedPair &expected = c.expected[idx];
+        ok = got.resultID == expected.resultID && got.inputID == expected.inputID
+          && got.name == QString(expected.name) && got.parentName == QString(expected.parentName);
+    }
+    if(ok) return;
+
+    ++failures;
+    printf("FAIL %s: got", c.testcase);
+    for(const CalibrationPair &got : pairs) printf(" (%d, %d)", got.resultID, got.inputID);
+    printf(", expected");
+    for(const ExpectedPair &expected : c.expected) printf(" (%d, %d)", expected.resultID, expected.inputID);
+    printf("\n");
+}
+
+int main()
+{
+    const PairCase cases[] =
+    {
+        {
+            "same name under a parent with the same name",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {item(10, 0, "Tay"), item(11, 10, "Reach flow")},
+            {{2, 11, "Reach flow", "Tay"}},
+        },
+        {
+            "same name under a parent with another name",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {item(10, 0, "Dee"), item(11, 10, "Reach flow")},
+            {},
+        },
+        {
+            "same parent, another name",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {item(10, 0, "Tay"), item(11, 10, "Observed flow")},
+            {},
+        },
+        {
+            "names are case sensitive",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {item(10, 0, "tay"), item(11, 10, "Reach Flow")},
+            {},
+        },
+        {
+            "only the matching parent of several",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow"), item(3, 0, "Dee"), item(4, 3, "Reach flow")},
+            {item(10, 0, "Dee"), item(11, 10, "Reach flow")},
+            {{4, 11, "Reach flow", "Dee"}},
+        },
+        {
+            "the first input wins",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {item(10, 0, "Tay"), item(11, 10, "Reach flow"), item(12, 0, "Tay"), item(13, 12, "Reach flow")},
+            {{2, 11, "Reach flow", "Tay"}},
+        },
+        {
+            "every result gets the same first input",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow"), item(3, 0, "Tay"), item(4, 3, "Reach flow")},
+            {item(10, 0, "Tay"), item(11, 10, "Reach flow"), item(13, 10, "Reach flow")},
+            {{2, 11, "Reach flow", "Tay"}, {4, 11, "Reach flow", "Tay"}},
+        },
+        {
+            "a result that is not a leaf is not paired",
+            {item(1, 0, "Catchment"), item(2, 1, "Tay"), item(3, 2, "Reach flow")},
+            {item(10, 0, "Catchment"), item(11, 10, "Tay")},
+            {},
+        },
+        {
+            "an input that is not a leaf is not paired",
+            {item(1, 0, "Catchment"), item(2, 1, "Tay")},
+            {item(10, 0, "Catchment"), item(11, 10, "Tay"), item(12, 11, "Reach flow")},
+            {},
+        },
+        {
+            "the parent is the nearest one only",
+            {item(1, 0, "Catchment A"), item(2, 1, "Tay"), item(3, 2, "Reach flow")},
+            {item(10, 0, "Catchment B"), item(11, 10, "Tay"), item(12, 11, "Reach flow")},
+            {{3, 12, "Reach flow", "Tay"}},
+        },
+        {
+            "leaves at the top level",
+            {item(1, 0, "Precipitation"), item(2, 0, "Tay"), item(3, 2, "Reach flow")},
+            {item(10, 0, "Precipitation")},
+            {{1, 10, "Precipitation", ""}},
+        },
+        {
+            "in the order of the results, whatever the order of the inputs",
+            {item(1, 0, "Tay"), item(5, 1, "Nitrate"), item(2, 1, "Reach flow"), item(3, 0, "Dee"), item(4, 3, "Reach flow")},
+            {item(20, 0, "Dee"), item(21, 20, "Reach flow"), item(10, 0, "Tay"), item(11, 10, "Reach flow"), item(12, 10, "Nitrate")},
+            {{5, 12, "Nitrate", "Tay"}, {2, 11, "Reach flow", "Tay"}, {4, 21, "Reach flow", "Dee"}},
+        },
+        {
+            "children listed before their parents",
+            {item(2, 1, "Reach flow"), item(1, 0, "Tay")},
+            {item(11, 10, "Reach flow"), item(10, 0, "Tay")},
+            {{2, 11, "Reach flow", "Tay"}},
+        },
+        {
+            "no results",
+            {},
+            {item(10, 0, "Tay"), item(11, 10, "Reach flow")},
+            {},
+        },
+        {
+            "no inputs",
+            {item(1, 0, "Tay"), item(2, 1, "Reach flow")},
+            {},
+            {},
+        },
+    };
+
+    for(const PairCase &c : cases) runCase(c);
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All calibration pairing tests passed\n");
+    return 0;
+}
@@ -0,0 +1,11 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+TARGET = tst_compression
+TEMPLATE = app
+
+SOURCES += tst_compression.cpp
+
+HEADERS += ../../sqlhandler/compression.h
@@ -0,0 +1,166 @@
+#include "../../sqlhandler/compression.h"
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+//NOTE: Round trips series through gorilla_encode and gorilla_decode and checks that every value comes back with the same bits, including the
+// sign of zeros, the payload of NaNs and subnormals. Also checks that the encoding stays inside gorilla_max_encoded_size and that a
+// truncated encoding is rejected instead of read past its end.
+
+static int failures = 0;
+
+static uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(uint64_t));
+    return bits;
+}
+
+static double fromBits(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(uint64_t));
+    return value;
+}
+
+static void testRoundTrip(const char *testcase, const std::vector<double> &values)
+{
+    uint64_t count = values.size();
+    std::vector<uint8_t> encoded(gorilla_max_encoded_size(count) + 16, 0xCD);
+    uint64_t size = gorilla_encode(values.data(), count, encoded.data());
+
+    if(size > gorilla_max_encoded_size(count))
+    {
+        ++failures;
+        printf("FAIL %s: encoded to %llu bytes, the maximum is %llu\n", testcase, (unsigned long long)size,
+               (unsigned long long)gorilla_max_encoded_size(count));
+    }
+    for(uint64_t i = gorilla_max_encoded_size(count); i < encoded.size(); ++i)
+    {
+        if(encoded[i] != 0xCD)
+        {
+            ++failures;
+            printf("FAIL %s: wrote past the maximum encoded size\n", testcase);
+            break;
+        }
+    }
+
+    std::vector<double> decoded(count);
+    if(!gorilla_decode(encoded.data(), size, decoded.data(), count))
+    {
+        ++failures;
+        printf("FAIL %s: the decoding failed\n", testcase);
+        return;
+    }
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        if(bitsOf(decoded[i]) != bitsOf(values[i]))
+        {
+            ++failures;
+            printf("FAIL %s: value %llu was 0x%016llx, expected 0x%016llx\n", testcase, (unsigned long long)i,
+                   (unsigned long long)bitsOf(decoded[i]), (unsigned long long)bitsOf(values[i]));
+            return;
+        }
+    }
+
+    //NOTE: The encoding is rounded up to whole bytes, so the last byte always holds bits that are needed, and without it the decoding has
+    // to fail instead of making up the values at the end.
+    if(count > 0 && gorilla_decode(encoded.data(), size - 1, decoded.data(), count))
+    {
+        ++failures;
+        printf("FAIL %s: an encoding with the last byte cut off was accepted\n", testcase);
+    }
+
+    if(count > 1 && gorilla_decode(encoded.data(), 7, decoded.data(), count))
+    {
+        ++failures;
+        printf("FAIL %s: an encoding shorter than the first value was accepted\n", testcase);
+    }
+}
+
+int main()
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    const double denorm = std::numeric_limits<double>::denorm_min();
+    const double smallest = std::numeric_limits<double>::min();
+
+    testRoundTrip("empty", {});
+    testRoundTrip("one value", {3.25});
+    testRoundTrip("one NaN", {nan});
+
+    testRoundTrip("constant", std::vector<double>(1000, 17.125));
+    testRoundTrip("constant zero", std::vector<double>(1000, 0.0));
+
+    {
+        //NOTE: Missing values in the databases are all the same NaN, and come in runs.
+        std::vector<double> values;
+        for(int i = 0; i < 200; ++i) values.push_back(1.0 + 0.01*i);
+        for(int i = 0; i < 500; ++i) values.push_back(nan);
+        for(int i = 0; i < 200; ++i) values.push_back(2.0 - 0.01*i);
+        for(int i = 0; i < 3; ++i) values.push_back(nan);
+        values.push_back(4.0);
+        testRoundTrip("NaN runs", values);
+        testRoundTrip("all NaN", std::vector<double>(1000, nan));
+    }
+
+    {
+        //NOTE: NaNs with other sign and payload bits must come back as they were, not as the canonical NaN.
+        std::vector<double> values = {fromBits(0x7FF8000000000001ull), fromBits(0xFFF8000000000000ull), fromBits(0x7FF0000000000001ull),
+                                      nan, fromBits(0x7FFFFFFFFFFFFFFFull), 1.0, fromBits(0xFFFFFFFFFFFFFFFFull), nan};
+        testRoundTrip("NaN payloads", values);
+    }
+
+    testRoundTrip("signed zeros", {0.0, -0.0, 0.0, 0.0, -0.0, -0.0, 1.0, -0.0, 0.0});
+    testRoundTrip("infinities", {inf, -inf, inf, inf, 0.0, -inf, nan, inf});
+
+    {
+        std::vector<double> values = {denorm, -denorm, 2*denorm, smallest, smallest - denorm, -smallest, fromBits(0x000FFFFFFFFFFFFFull),
+                                      0.0, denorm, 1e-310, -1e-320, 1e300, denorm};
+        for(int i = 0; i < 100; ++i) values.push_back(denorm*i);
+        testRoundTrip("subnormals", values);
+    }
+
+    {
+        //NOTE: XORs with more than 31 leading zeros (which do not fit in the 5 bit count) and with all 64 bits meaningful (which is stored
+        // as 0 in the 6 bit count).
+        std::vector<double> values = {1.0, fromBits(bitsOf(1.0) ^ 1), 1.0, fromBits(bitsOf(1.0) ^ 0x8000000000000001ull), 1.0,
+                                      fromBits(bitsOf(1.0) ^ 0x8000000000000000ull), fromBits(bitsOf(1.0) ^ 0x100000000ull), 1.0};
+        testRoundTrip("window edges", values);
+    }
+
+    {
+        std::mt19937_64 rng(12345);
+        std::vector<double> values(5000);
+
+        //NOTE: Random bits are the worst case for the encoding.
+        for(double &value : values) value = fromBits(rng());
+        testRoundTrip("random bits", values);
+
+        std::normal_distribution<double> noise(0.0, 1.0);
+        double level = 10.0;
+        for(double &value : values)
+        {
+            level = 0.95*level + 0.5 + 0.1*noise(rng);
+            value = level;
+        }
+        testRoundTrip("noisy series", values);
+
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for(double &value : values)
+        {
+            double u = uniform(rng);
+            value = u < 0.6 ? 0.0 : (u < 0.65 ? nan : 20.0*uniform(rng));
+        }
+        testRoundTrip("precipitation-like series", values);
+    }
+
+    if(failures != 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All compression tests passed\n");
+    return 0;
+}
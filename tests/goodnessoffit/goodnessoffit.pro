@@ -0,0 +1,17 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core concurrent
+QT       -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_goodnessoffit
+TEMPLATE = app
+
+SOURCES += tst_goodnessoffit.cpp \
+    ../../goodnessoffit.cpp \
+    ../../statistics.cpp
+
+HEADERS += ../../goodnessoffit.h \
+    ../../statistics.h
@@ -0,0 +1,257 @@
+#include "../../goodnessoffit.h"
+#include <cmath>
+#include <limits>
+#include <stdio.h>
+#include <vector>
+
+//NOTE: Known answers for alignSeries and computeGoodnessOfFit: a perfect fit, a constant offset, series that start on different dates,
+// series that can not be aligned or do not overlap, missing values, and the log NSE of series with zero flows. The expected values are
+// worked out by hand from the definitions in goodnessoffit.h.
+
+static int failures = 0;
+static const double nan_value = std::numeric_limits<double>::quiet_NaN();
+static const int64_t day = 86400;
+
+static void checkNear(const char *testcase, const char *what, double got, double expected)
+{
+    bool ok = std::isnan(expected) ? std::isnan(got) : std::abs(got - expected) <= 1e-12*std::max(1.0, std::abs(expected));
+    if(ok) return;
+    ++failures;
+    printf("FAIL %s: %s was %.17g, expected %.17g\n", testcase, what, got, expected);
+}
+
+static void checkTrue(const char *testcase, const char *what, bool ok)
+{
+    if(ok) return;
+    ++failures;
+    printf("FAIL %s: %s\n", testcase, what);
+}
+
+static TimeSeriesView view(const std::vector<double> &values, int64_t startDate, int64_t timestep = day)
+{
+    TimeSeriesView v;
+    v.values = values.data();
+    v.count = (int64_t)values.size();
+    v.startDate = startDate;
+    v.timestep = timestep;
+    return v;
+}
+
+static GoodnessOfFit fitOf(const std::vector<double> &observed, const std::vector<double> &modeled, int64_t observedStart = 0, int64_t modeledStart = 0)
+{
+    GoodnessOfFitInput input;
+    input.observed = view(observed, observedStart);
+    input.modeled = view(modeled, modeledStart);
+    return computeGoodnessOfFit(input);
+}
+
+static void checkAllNaN(const char *testcase, const GoodnessOfFit &fit)
+{
+    checkTrue(testcase, "count is not 0", fit.residuals.count == 0);
+    double metrics[] = {fit.meanError, fit.meanAbsoluteError, fit.meanSquaredError, fit.rootMeanSquaredError, fit.nashSutcliffe,
+                        fit.logNashSutcliffe, fit.percentBias, fit.rSquared, fit.klingGupta, fit.kgeCorrelation, fit.kgeVariability, fit.kgeBias};
+    for(double metric : metrics) checkTrue(testcase, "a metric is not NaN", std::isnan(metric));
+}
+
+static void testPerfectFit()
+{
+    const char *testcase = "perfect fit";
+    std::vector<double> observed = {1.0, 3.0, 2.0, 5.0, 4.0, 0.5};
+    GoodnessOfFit fit = fitOf(observed, observed);
+
+    checkTrue(testcase, "alignment is not Ok", fit.alignment == Alignment_Ok);
+    checkTrue(testcase, "count is not 6", fit.residuals.count == 6);
+    checkNear(testcase, "ME", fit.meanError, 0.0);
+    checkNear(testcase, "MAE", fit.meanAbsoluteError, 0.0);
+    checkNear(testcase, "RMSE", fit.rootMeanSquaredError, 0.0);
+    checkNear(testcase, "NSE", fit.nashSutcliffe, 1.0);
+    checkNear(testcase, "log NSE", fit.logNashSutcliffe, 1.0);
+    checkNear(testcase, "PBIAS", fit.percentBias, 0.0);
+    checkNear(testcase, "R2", fit.rSquared, 1.0);
+    checkNear(testcase, "KGE", fit.klingGupta, 1.0);
+    checkNear(testcase, "KGE r", fit.kgeCorrelation, 1.0);
+    checkNear(testcase, "KGE alpha", fit.kgeVariability, 1.0);
+    checkNear(testcase, "KGE beta", fit.kgeBias, 1.0);
+}
+
+static void testConstantOffset()
+{
+    //NOTE: The model is 1 too high everywhere. The observed mean is 3 and the variance is 2.
+    const char *testcase = "constant offset";
+    std::vector<double> observed = {1.0, 2.0, 3.0, 4.0, 5.0};
+    std::vector<double> modeled = {2.0, 3.0, 4.0, 5.0, 6.0};
+    GoodnessOfFit fit = fitOf(observed, modeled);
+
+    checkNear(testcase, "ME", fit.meanError, -1.0); //NOTE: The residual is observed - modeled.
+    checkNear(testcase, "MAE", fit.meanAbsoluteError, 1.0);
+    checkNear(testcase, "MSE", fit.meanSquaredError, 1.0);
+    checkNear(testcase, "RMSE", fit.rootMeanSquaredError, 1.0);
+    checkNear(testcase, "NSE", fit.nashSutcliffe, 0.5);
+    checkNear(testcase, "PBIAS", fit.percentBias, 100.0/3.0);
+    checkNear(testcase, "R2", fit.rSquared, 1.0);
+    checkNear(testcase, "KGE alpha", fit.kgeVariability, 1.0);
+    checkNear(testcase, "KGE beta", fit.kgeBias, 4.0/3.0);
+    checkNear(testcase, "KGE", fit.klingGupta, 2.0/3.0);
+
+    //NOTE: Scaling the model by 2 instead: alpha = 2, beta = 2, r = 1, so KGE = 1 - sqrt(2).
+    std::vector<double> doubled = {2.0, 4.0, 6.0, 8.0, 10.0};
+    fit = fitOf(observed, doubled);
+    checkNear("doubled", "PBIAS", fit.percentBias, 100.0);
+    checkNear("doubled", "KGE", fit.klingGupta, 1.0 - std::sqrt(2.0));
+    checkNear("doubled", "R2", fit.rSquared, 1.0);
+    checkNear("doubled", "NSE", fit.nashSutcliffe, 1.0 - 11.0/2.0);
+}
+
+static void testAlignment()
+{
+    std::vector<double> observed = {10.0, 11.0, 12.0, 13.0, 14.0, 15.0};
+    std::vector<double> modeled = {12.0, 13.0, 14.0, 15.0, 16.0, 17.0, 18.0};
+    AlignedSeriesPair pair;
+
+    //NOTE: The model starts two days after the observations, so the observations are skipped ahead by two steps, and the pair ends with the
+    // observations.
+    AlignmentResult result = alignSeries(view(observed, 1000*day), view(modeled, 1002*day), pair);
+    checkTrue("model starts later", "alignment is not Ok", result == Alignment_Ok);
+    checkTrue("model starts later", "wrong observed start", pair.observed == observed.data() + 2);
+    checkTrue("model starts later", "wrong modeled start", pair.modeled == modeled.data());
+    checkTrue("model starts later", "wrong count", pair.count == 4);
+    checkTrue("model starts later", "wrong start date", pair.startDate == 1002*day);
+    checkTrue("model starts later", "wrong timestep", pair.timestep == day);
+    GoodnessOfFit fit = fitOf(observed, modeled, 1000*day, 1002*day);
+    checkNear("model starts later", "MSE", fit.meanSquaredError, 0.0);
+    checkTrue("model starts later", "count is not 4", fit.residuals.count == 4);
+
+    //NOTE: The other way around, and before 1970.
+    result = alignSeries(view(modeled, -10*day), view(observed, -13*day), pair);
+    checkTrue("observations start later", "alignment is not Ok", result == Alignment_Ok);
+    checkTrue("observations start later", "wrong observed start", pair.observed == modeled.data());
+    checkTrue("observations start later", "wrong modeled start", pair.modeled == observed.data() + 3);
+    checkTrue("observations start later", "wrong count", pair.count == 3);
+    checkTrue("observations start later", "wrong start date", pair.startDate == -10*day);
+
+    //NOTE: Sub-daily steps.
+    result = alignSeries(view(observed, 7200, 3600), view(modeled, 3600, 3600), pair);
+    checkTrue("hourly", "alignment is not Ok", result == Alignment_Ok && pair.count == 6 && pair.modeled == modeled.data() + 1);
+
+    result = alignSeries(view(observed, 0), view(modeled, day/2), pair);
+    checkTrue("half a step apart", "not MisalignedSteps", result == Alignment_MisalignedSteps);
+    result = alignSeries(view(observed, 0), view(modeled, -day/2), pair);
+    checkTrue("half a step apart before", "not MisalignedSteps", result == Alignment_MisalignedSteps);
+
+    result = alignSeries(view(observed, 0, day), view(modeled, 0, 3600), pair);
+    checkTrue("different timesteps", "not DifferentTimesteps", result == Alignment_DifferentTimesteps);
+    result = alignSeries(view(observed, 0, 0), view(modeled, 0, 0), pair);
+    checkTrue("zero timestep", "not DifferentTimesteps", result == Alignment_DifferentTimesteps);
+
+    //NOTE: The observations end the day before the model starts.
+    result = alignSeries(view(observed, 0), view(modeled, 6*day), pair);
+    checkTrue("adjacent", "not NoOverlap", result == Alignment_NoOverlap && pair.count == 0);
+    result = alignSeries(view(observed, 100*day), view(modeled, 0), pair);
+    checkTrue("model ends before", "not NoOverlap", result == Alignment_NoOverlap && pair.count == 0);
+    std::vector<double> empty;
+    result = alignSeries(view(empty, 0), view(modeled, 0), pair);
+    checkTrue("empty", "not NoOverlap", result == Alignment_NoOverlap);
+
+    fit = fitOf(observed, modeled, 0, day/2);
+    checkTrue("misaligned fit", "alignment is not MisalignedSteps", fit.alignment == Alignment_MisalignedSteps);
+    checkAllNaN("misaligned fit", fit);
+    fit = fitOf(observed, modeled, 0, 6*day);
+    checkTrue("no overlap fit", "alignment is not NoOverlap", fit.alignment == Alignment_NoOverlap);
+    checkAllNaN("no overlap fit", fit);
+}
+
+static void testMissingValues()
+{
+    //NOTE: Steps where either side is missing are left out, so this is the constant offset case again.
+    const char *testcase = "NaN gaps";
+    std::vector<double> observed = {1.0, nan_value, 2.0, 3.0, 100.0, 4.0, nan_value, 5.0};
+    std::vector<double> modeled = {2.0, 7.0, 3.0, 4.0, nan_value, 5.0, nan_value, 6.0};
+    GoodnessOfFit fit = fitOf(observed, modeled);
+
+    checkTrue(testcase, "count is not 5", fit.residuals.count == 5);
+    checkNear(testcase, "ME", fit.meanError, -1.0);
+    checkNear(testcase, "NSE", fit.nashSutcliffe, 0.5);
+    checkNear(testcase, "PBIAS", fit.percentBias, 100.0/3.0);
+    checkNear(testcase, "KGE", fit.klingGupta, 2.0/3.0);
+
+    std::vector<double> allnan(8, nan_value);
+    fit = fitOf(allnan, modeled);
+    checkTrue("all NaN", "alignment is not Ok", fit.alignment == Alignment_Ok);
+    checkAllNaN("all NaN", fit);
+}
+
+static void testLogNashSutcliffe()
+{
+    //NOTE: The observed mean is 2, so epsilon is 0.02 and the zeros become log(0.02) on both sides. The log observed are then
+    // log(0.02) and log(4.02), with variance (log(4.02/0.02)/2)^2, and the squared log errors are 0 and log(4.02/2.02)^2.
+    const char *testcase = "log NSE with zero flows";
+    std::vector<double> observed = {0.0, 4.0};
+    std::vector<double> modeled = {0.0, 2.0};
+    GoodnessOfFit fit = fitOf(observed, modeled);
+    double expected = 1.0 - (std::pow(std::log(4.02/2.02), 2)/2.0) / std::pow(std::log(4.02/0.02)/2.0, 2);
+    checkNear(testcase, "log NSE", fit.logNashSutcliffe, expected);
+    checkTrue(testcase, "log NSE is not finite", std::isfinite(fit.logNashSutcliffe));
+
+    std::vector<double> zeros = {0.0, 0.0, 3.0, 0.0, 5.0, 0.0};
+    fit = fitOf(zeros, zeros);
+    checkNear("zero flows perfect fit", "log NSE", fit.logNashSutcliffe, 1.0);
+
+    //NOTE: A modeled value below -epsilon has no log and is left out of the log NSE only. Here that leaves the perfect fit.
+    std::vector<double> negative = {0.0, 0.0, 3.0, -1.0, 5.0, 0.0};
+    fit = fitOf(zeros, negative);
+    checkNear("negative modeled flow", "log NSE", fit.logNashSutcliffe, 1.0);
+    checkTrue("negative modeled flow", "count is not 6", fit.residuals.count == 6);
+
+    //NOTE: With only zeros observed, epsilon is 0 and nothing has a log.
+    std::vector<double> allzero(4, 0.0);
+    fit = fitOf(allzero, allzero);
+    checkTrue("all zero", "log NSE is not NaN", std::isnan(fit.logNashSutcliffe));
+}
+
+static void testBatch()
+{
+    //NOTE: The batch is computed in parallel, but has to give the same results in the same order as one at a time.
+    std::vector<std::vector<double>> series;
+    for(int s = 0; s < 9; ++s)
+    {
+        series.push_back(std::vector<double>());
+        for(int i = 0; i < 200; ++i) series.back().push_back(std::sin(0.1*i*(s + 1)) + 2.0 + 0.1*s);
+    }
+
+    QVector<GoodnessOfFitInput> inputs;
+    for(int s = 1; s < (int)series.size(); ++s)
+    {
+        GoodnessOfFitInput input;
+        input.observed = view(series[0], 0);
+        input.modeled = view(series[s], (s % 3)*day);
+        inputs.push_back(input);
+    }
+
+    QVector<GoodnessOfFit> fits = computeGoodnessOfFit(inputs);
+    checkTrue("batch", "wrong number of results", fits.count() == inputs.count());
+    for(int i = 0; i < fits.count() && i < inputs.count(); ++i)
+    {
+        GoodnessOfFit single = computeGoodnessOfFit(inputs[i]);
+        checkTrue("batch", "a result differs from the single computation",
+                  fits[i].residuals.count == single.residuals.count && fits[i].klingGupta == single.klingGupta
+                  && fits[i].nashSutcliffe == single.nashSutcliffe && fits[i].logNashSutcliffe == single.logNashSutcliffe);
+    }
+}
+
+int main()
+{
+    testPerfectFit();
+    testConstantOffset();
+    testAlignment();
+    testMissingValues();
+    testLogNashSutcliffe();
+    testBatch();
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All goodness-of-fit tests passed\n");
+    return 0;
+}
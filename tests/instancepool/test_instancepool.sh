@@ -0,0 +1,125 @@
+#!/bin/bash
+
+#NOTE: Runs instancepool.sh against the mock of gcloud in mock/, in a temporary directory. Prints what failed and exits with a nonzero code if
+# anything did.
+# usage: bash test_instancepool.sh
+
+HERE=$(cd $(dirname $0) && pwd)
+POOL_SCRIPT=$HERE/../../instancepool.sh
+
+WORK=$(mktemp -d)
+export MOCK_DIR=$WORK/mock
+export POOL_DIR=$WORK/pool
+export KEY_DIR=$WORK/keys
+export POOL_SIZE=2
+export PATH=$HERE/mock:$PATH
+mkdir -p $MOCK_DIR
+
+FAILURES=0
+
+fail() {
+    echo "FAIL: $1"
+    FAILURES=$((FAILURES + 1))
+}
+
+pool() {
+    bash $POOL_SCRIPT "$@"
+}
+
+# $1 : state. Prints the number of instances in the pool in that state.
+count_state() {
+    pool status | awk -v state=$1 '$2 == state' | wc -l
+}
+
+# The refill that a lease starts runs in the background, so we have to wait for it before looking at the pool.
+wait_for_refill() {
+    for ((i = 0; i < 100; ++i)); do
+        [ $(count_state provisioning) -eq 0 ] && return
+        sleep 0.1
+    done
+    fail "the refill did not finish"
+}
+
+# $1 : output of a lease. Prints the instance name, or nothing if it was not a lease.
+leased_name() {
+    echo "$1" | tail -n 1 | awk '$1 == "LEASE" { print $2 }'
+}
+
+cleanup() {
+    wait_for_refill
+    rm -rf $WORK
+}
+trap cleanup EXIT
+
+
+echo "lease from an empty pool"
+OUT=$(pool lease alice)
+ALICE=$(leased_name "$OUT")
+[ -n "$ALICE" ] || fail "lease from an empty pool gave: $OUT"
+[ "$(echo "$OUT" | tail -n 1 | awk '{ print $3 }')" = "$(cat $MOCK_DIR/vm-$ALICE 2>/dev/null)" ] || fail "the lease does not have the ip of the instance"
+[ -f $KEY_DIR/alice ] && [ -f $KEY_DIR/alice.pub ] || fail "no keys were made for alice"
+read STATE IP USER < $POOL_DIR/$ALICE
+[ "$STATE $USER" = "leased alice" ] || fail "$ALICE is '$STATE $USER', expected 'leased alice'"
+
+echo "the pool is refilled in the background"
+wait_for_refill
+[ $(count_state free) -eq $POOL_SIZE ] || fail "expected $POOL_SIZE free instances after the refill, the pool is: $(pool status)"
+
+echo "lease from a warm pool"
+> $MOCK_DIR/calls.log
+OUT=$(pool lease bob)
+BOB=$(leased_name "$OUT")
+[ -n "$BOB" ] || fail "lease from a warm pool gave: $OUT"
+grep -q "instances create $BOB" $MOCK_DIR/calls.log && fail "a warm lease created its instance"
+grep -q "add-metadata $BOB" $MOCK_DIR/calls.log || fail "the keys were not installed on $BOB"
+[ "$BOB" != "$ALICE" ] || fail "bob got alice's instance"
+wait_for_refill
+
+echo "release and lease again"
+OUT=$(pool release $ALICE)
+[ "$OUT" = "RELEASED $ALICE" ] || fail "release gave: $OUT"
+read STATE IP USER SINCE < $POOL_DIR/$ALICE
+[ "$STATE $USER" = "idle alice" ] || fail "$ALICE is '$STATE $USER' after the release, expected 'idle alice'"
+[ "$(leased_name "$(pool lease alice)")" = "$ALICE" ] || fail "alice did not get her idle instance back"
+wait_for_refill
+
+echo "an idle instance is not leased to anybody else"
+pool release $ALICE > /dev/null
+CAROL=$(leased_name "$(pool lease carol)")
+[ -n "$CAROL" ] && [ "$CAROL" != "$ALICE" ] || fail "carol got '$CAROL', alice's is $ALICE"
+wait_for_refill
+
+echo "idle instances expire"
+POOL_IDLE_SECONDS=0 pool refill
+[ -f $POOL_DIR/$ALICE ] && fail "the idle instance is still in the pool"
+[ -f $MOCK_DIR/vm-$ALICE ] && fail "the idle instance was not deleted"
+[ $(count_state free) -eq $POOL_SIZE ] || fail "the refill did not keep $POOL_SIZE free instances"
+
+echo "concurrent leases get different instances"
+pool lease dave > $WORK/dave.out &
+pool lease erin > $WORK/erin.out &
+wait
+DAVE=$(leased_name "$(cat $WORK/dave.out)")
+ERIN=$(leased_name "$(cat $WORK/erin.out)")
+[ -n "$DAVE" ] && [ -n "$ERIN" ] && [ "$DAVE" != "$ERIN" ] || fail "concurrent leases gave '$DAVE' and '$ERIN'"
+wait_for_refill
+
+echo "a failed create leaves nothing behind"
+rm -f $POOL_DIR/*
+OUT=$(MOCK_FAIL_CREATE=1 pool lease frank)
+RC=$?
+[ $RC -ne 0 ] || fail "a failed lease exited with 0"
+echo "$OUT" | tail -n 1 | grep -q "^ERROR " || fail "a failed lease gave: $OUT"
+wait_for_refill
+[ -z "$(ls $POOL_DIR)" ] || fail "a failed lease left $(ls $POOL_DIR) in the pool"
+
+echo "releasing an unknown instance"
+OUT=$(pool release nosuch)
+[ $? -ne 0 ] || fail "releasing an unknown instance exited with 0"
+echo "$OUT" | grep -q "^ERROR " || fail "releasing an unknown instance gave: $OUT"
+
+if [ $FAILURES -ne 0 ]; then
+    echo "$FAILURES checks failed"
+    exit 1
+fi
+echo "All instance pool tests passed"
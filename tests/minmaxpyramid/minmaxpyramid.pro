@@ -0,0 +1,16 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core gui widgets printsupport
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_minmaxpyramid
+TEMPLATE = app
+
+SOURCES += tst_minmaxpyramid.cpp \
+    ../../minmaxpyramid.cpp \
+    ../../qcustomplot.cpp
+
+HEADERS += ../../minmaxpyramid.h \
+    ../../qcustomplot.h
@@ -0,0 +1,168 @@
+#include "../../minmaxpyramid.h"
+#include <cmath>
+#include <limits>
+#include <stdio.h>
+
+//NOTE: Checks MinMaxPyramid::decimate against the envelope computed directly from the points. The pyramid is free to pick its level, so
+// the output is accepted if it is exactly the envelope for one of the bucket sizes 4, 16, 64, ... and that bucket size gives about the
+// number of buckets that was asked for.
+
+static int failures = 0;
+static const double nan_value = std::numeric_limits<double>::quiet_NaN();
+
+static void fail(const char *testcase, const char *message)
+{
+    ++failures;
+    printf("FAIL %s: %s\n", testcase, message);
+}
+
+static bool samePoint(const QCPGraphData &a, const QCPGraphData &b)
+{
+    if(a.key != b.key) return false;
+    if(std::isnan(a.value) || std::isnan(b.value)) return std::isnan(a.value) && std::isnan(b.value);
+    return a.value == b.value;
+}
+
+//NOTE: The min and the max point of every bucket of bucketSize points from firstBucket up to lastBucket, in the order they occur, found by
+// looking at every point. If several points have the extreme value, the first of them counts. A bucket of only NaN is one NaN point.
+static QVector<QCPGraphData> bruteForceEnvelope(const QCPGraphDataContainer &data, int bucketSize, int firstBucket, int lastBucket)
+{
+    QVector<QCPGraphData> out;
+    for(int b = firstBucket; b < lastBucket; ++b)
+    {
+        int minIndex = -1, maxIndex = -1;
+        int end = std::min((b + 1)*bucketSize, data.size());
+        for(int idx = b*bucketSize; idx < end; ++idx)
+        {
+            double value = data.at(idx)->value;
+            if(std::isnan(value)) continue;
+            if(minIndex < 0 || value < data.at(minIndex)->value) minIndex = idx;
+            if(maxIndex < 0 || value > data.at(maxIndex)->value) maxIndex = idx;
+        }
+        if(minIndex < 0)
+        {
+            out.push_back(QCPGraphData(data.at(b*bucketSize)->key, nan_value));
+            continue;
+        }
+        int lo = std::min(minIndex, maxIndex);
+        int hi = std::max(minIndex, maxIndex);
+        out.push_back(*data.at(lo));
+        if(hi != lo) out.push_back(*data.at(hi));
+    }
+    return out;
+}
+
+static void testDecimate(const char *testcase, const QCPGraphDataContainer &data, const MinMaxPyramid &pyramid, const QCPRange &range, int maxBuckets)
+{
+    QVector<QCPGraphData> out;
+    bool decimated = pyramid.decimate(data, range, maxBuckets, out);
+
+    int first = (int)(data.findBegin(range.lower, true) - data.constBegin());
+    int last  = (int)(data.findEnd(range.upper, true) - data.constBegin());
+    int visible = last - first;
+
+    if(!decimated)
+    {
+        //NOTE: Only allowed when showing all the points is about as cheap as the envelope.
+        if(data.size() > 4 && visible > 2*maxBuckets) fail(testcase, "not decimated although there are many more points than buckets");
+        if(!out.empty()) fail(testcase, "output not empty when not decimated");
+        return;
+    }
+
+    if(visible <= 2*maxBuckets) fail(testcase, "decimated although there are few points");
+
+    for(int bucketSize = 4; bucketSize/4 < data.size(); bucketSize *= 4)
+    {
+        int firstBucket = first / bucketSize;
+        int lastBucket = std::min((last + bucketSize - 1) / bucketSize, (data.size() + bucketSize - 1) / bucketSize);
+        QVector<QCPGraphData> expected = bruteForceEnvelope(data, bucketSize, firstBucket, lastBucket);
+        if(expected.count() != out.count()) continue;
+
+        bool same = true;
+        for(int i = 0; i < out.count() && same; ++i) same = samePoint(out[i], expected[i]);
+        if(!same) continue;
+
+        //NOTE: Two buckets more or less than the bounds are for the partial buckets at the edges of the range. Fewer buckets are allowed if
+        // the top of the pyramid was reached.
+        int buckets = lastBucket - firstBucket;
+        bool isTop = bucketSize >= data.size();
+        if(buckets > 2*maxBuckets + 2)           fail(testcase, "more buckets than asked for");
+        if(buckets < maxBuckets/2 - 1 && !isTop) fail(testcase, "fewer buckets than asked for");
+        return;
+    }
+    fail(testcase, "output is not the envelope for any bucket size");
+}
+
+static void fillData(QCPGraphDataContainer &data, int count, int nanEvery, int nanRunStart, int nanRunLength, unsigned seed)
+{
+    QVector<QCPGraphData> points(count);
+    for(int i = 0; i < count; ++i)
+    {
+        seed = seed*1103515245u + 12345u;
+        double value = std::sin(i*0.01)*10.0 + (double)(seed >> 16)/65536.0;
+        if(i % 1000 == 500) value = 1000.0; //NOTE: Spikes, which the envelope must not lose.
+        if(nanEvery > 0 && i % nanEvery == 0) value = nan_value;
+        if(i >= nanRunStart && i < nanRunStart + nanRunLength) value = nan_value;
+        points[i] = QCPGraphData(946684800.0 + 86400.0*i, value);
+    }
+    data.set(points, true);
+}
+
+int main()
+{
+    const int counts[] = {1, 4, 5, 17, 64, 65, 1000, 4097, 50000};
+    const int bucketCounts[] = {1, 3, 100, 1000};
+
+    char testcase[160];
+    for(int count : counts)
+    {
+        for(int nanEvery : {0, 7})
+        {
+            QCPGraphDataContainer data;
+            fillData(data, count, nanEvery, count/3, count/10, (unsigned)count);
+
+            MinMaxPyramid pyramid;
+            pyramid.build(data);
+
+            double start = 946684800.0, end = 946684800.0 + 86400.0*(count - 1);
+            QCPRange ranges[] =
+            {
+                QCPRange(start, end),                                   //NOTE: All of it.
+                QCPRange(start + (end - start)*0.3, end - (end - start)*0.2), //NOTE: Zoomed in, not on bucket boundaries.
+                QCPRange(start - 1e7, start + (end - start)*0.01),      //NOTE: Past the start.
+                QCPRange(end - (end - start)*0.6, end + 1e7),           //NOTE: Past the end.
+            };
+            for(const QCPRange &range : ranges)
+            {
+                for(int maxBuckets : bucketCounts)
+                {
+                    snprintf(testcase, sizeof(testcase), "%d points, NaN every %d, range %.0f to %.0f, %d buckets",
+                             count, nanEvery, range.lower, range.upper, maxBuckets);
+                    testDecimate(testcase, data, pyramid, range, maxBuckets);
+                }
+            }
+        }
+    }
+
+    //NOTE: A series that is missing entirely has to come out as gaps, not as made up values.
+    QCPGraphDataContainer allnan;
+    fillData(allnan, 5000, 1, 0, 0, 1);
+    MinMaxPyramid pyramid;
+    pyramid.build(allnan);
+    QVector<QCPGraphData> out;
+    if(pyramid.decimate(allnan, QCPRange(0.0, 1e12), 100, out))
+    {
+        for(const QCPGraphData &point : out)
+        {
+            if(!std::isnan(point.value)) { fail("all NaN", "a bucket of only NaN got a value"); break; }
+        }
+    }
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All min/max pyramid tests passed\n");
+    return 0;
+}
@@ -0,0 +1,12 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+TARGET = tst_numberformat
+TEMPLATE = app
+
+SOURCES += tst_numberformat.cpp \
+    ../../numberformat.cpp
+
+HEADERS += ../../numberformat.h
@@ -0,0 +1,210 @@
+#include "../../numberformat.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+//NOTE: Checks formatDouble against known strings, and round trips a large number of doubles through it and strtod, checking that the same
+// bits come back and that the number of significant digits is at most one more than the shortest representation that reads back, unless
+// that representation is on the edge of the rounding interval (see numberformat.h).
+
+static int failures = 0;
+
+static uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(uint64_t));
+    return bits;
+}
+
+static double fromBits(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(uint64_t));
+    return value;
+}
+
+//NOTE: Formats into a buffer with a guard area after the 32 characters formatDouble may use, and checks that nothing past the returned
+// length was touched.
+static std::string format(double value)
+{
+    char buffer[48];
+    memset(buffer, '#', sizeof(buffer));
+    int length = formatDouble(buffer, value);
+    if(length <= 0 || length > 32)
+    {
+        ++failures;
+        printf("FAIL formatting 0x%016llx: returned the length %d\n", (unsigned long long)bitsOf(value), length);
+        return std::string();
+    }
+    for(int i = length; i < (int)sizeof(buffer); ++i)
+    {
+        if(buffer[i] != '#')
+        {
+            ++failures;
+            printf("FAIL formatting 0x%016llx: wrote past the returned length\n", (unsigned long long)bitsOf(value));
+            break;
+        }
+    }
+    return std::string(buffer, length);
+}
+
+static void checkString(double value, const char *expected)
+{
+    std::string got = format(value);
+    if(got == expected) return;
+    ++failures;
+    printf("FAIL formatting %.17g: got \"%s\", expected \"%s\"\n", value, got.c_str(), expected);
+}
+
+static int significantDigits(const std::string &text)
+{
+    int digits = 0;
+    bool leading = true;
+    int trailingZeros = 0;
+    for(char c : text)
+    {
+        if(c == 'e') break;
+        if(c < '0' || c > '9') continue;
+        if(leading && c == '0') continue;
+        leading = false;
+        ++digits;
+        trailingZeros = (c == '0') ? trailingZeros + 1 : 0;
+    }
+    return digits - trailingZeros;
+}
+
+//NOTE: The fewest significant digits with which printf gives a string that reads back as the value.
+static int shortestDigits(double value, std::string &shortest)
+{
+    char buffer[64];
+    for(int precision = 1; precision <= 17; ++precision)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, value);
+        if(bitsOf(strtod(buffer, nullptr)) == bitsOf(value))
+        {
+            shortest = buffer;
+            return precision;
+        }
+    }
+    return 17;
+}
+
+//NOTE: Whether text is on, or within a small fraction of a unit in the last place of, the halfway point between value and one of its
+// neighbours. strtod reads such a text back as value, but Grisu2 does not consider it, since it only looks strictly inside the interval
+// and shrinks that by the error of its products.
+static bool isOnIntervalEdge(const char *text, double value)
+{
+    long double v = std::abs((long double)value);
+    long double x = std::abs(strtold(text, nullptr));
+    long double below = v - (long double)std::nextafter(std::abs(value), 0.0);
+    double up = std::nextafter(std::abs(value), std::numeric_limits<double>::infinity());
+    long double above = std::isinf(up) ? below : (long double)up - v;
+
+    return std::abs(x - (v - below/2)) <= below/256 || std::abs(x - (v + above/2)) <= above/256;
+}
+
+static int longer = 0; //NOTE: How many values came out one digit longer than the shortest.
+static int edge = 0;   //NOTE: How many values came out longer than that because the shortest was on the edge.
+
+static void checkRoundTrip(double value)
+{
+    std::string text = format(value);
+    char *end;
+    double back = strtod(text.c_str(), &end);
+    if(*end != '\0' || bitsOf(back) != bitsOf(value))
+    {
+        ++failures;
+        printf("FAIL round trip of 0x%016llx: \"%s\" reads back as 0x%016llx\n", (unsigned long long)bitsOf(value), text.c_str(),
+               (unsigned long long)bitsOf(back));
+        return;
+    }
+
+    int digits = significantDigits(text);
+    std::string shortestText;
+    int shortest = shortestDigits(value, shortestText);
+    if(digits > shortest + 1 && isOnIntervalEdge(shortestText.c_str(), value))
+    {
+        ++edge;
+    }
+    else if(digits > shortest + 1)
+    {
+        ++failures;
+        printf("FAIL round trip of %.17g: \"%s\" has %d significant digits, the shortest has %d\n", value, text.c_str(), digits, shortest);
+    }
+    else if(digits > shortest) ++longer;
+}
+
+int main()
+{
+    checkString(0.0, "0");
+    checkString(-0.0, "-0");
+    checkString(1.0, "1");
+    checkString(-1.0, "-1");
+    checkString(0.1, "0.1");
+    checkString(0.3, "0.3");
+    checkString(0.1 + 0.2, "0.30000000000000004");
+    checkString(123.45, "123.45");
+    checkString(-2.5, "-2.5");
+    checkString(1234500.0, "1234500");
+    checkString(0.0012345, "0.0012345");
+    checkString(0.001, "0.001");
+    checkString(0.0001, "0.0001");
+    checkString(0.00001, "1e-05");
+    checkString(1.2345e-7, "1.2345e-07");
+    checkString(1e16, "10000000000000000");
+    checkString(1e17, "1e+17");
+    checkString(1.5e20, "1.5e+20");
+    checkString(1e100, "1e+100");
+    checkString(1e-100, "1e-100");
+    checkString(9007199254740993.0, "9007199254740992"); //NOTE: 2^53 + 1 is not a double, it is rounded to 2^53.
+    checkString(std::numeric_limits<double>::max(), "1.7976931348623157e+308");
+    checkString(std::numeric_limits<double>::min(), "2.2250738585072014e-308");
+    checkString(std::numeric_limits<double>::infinity(), "inf");
+    checkString(-std::numeric_limits<double>::infinity(), "-inf");
+    checkString(std::numeric_limits<double>::quiet_NaN(), "nan");
+    checkString(-std::numeric_limits<double>::quiet_NaN(), "nan");
+
+    //NOTE: Powers of two are where the lower boundary is closer, and the subnormals and the edges of the exponent range are where the
+    // cached powers run out.
+    for(int e = -1074; e <= 1023; ++e) checkRoundTrip(std::ldexp(1.0, e));
+    for(int e = -1074; e <= 1023; ++e) checkRoundTrip(std::nextafter(std::ldexp(1.0, e), 0.0));
+    for(int e = -1074; e <= 1022; ++e) checkRoundTrip(std::nextafter(std::ldexp(1.0, e), 1e308));
+    for(uint64_t bits = 1; bits < 2000; ++bits) checkRoundTrip(fromBits(bits));
+    for(uint64_t bits = 0x7FEFFFFFFFFFFFFFull; bits > 0x7FEFFFFFFFFFF000ull; --bits) checkRoundTrip(fromBits(bits));
+    for(int i = -1000; i <= 1000; ++i) checkRoundTrip(i * 0.001);
+    for(int i = 1; i <= 1000; ++i) checkRoundTrip(1.0 / i);
+
+    std::mt19937_64 rng(20100601);
+    int randomCount = 0;
+    while(randomCount < 200000)
+    {
+        double value = fromBits(rng());
+        if(!std::isfinite(value)) continue;
+        checkRoundTrip(value);
+        ++randomCount;
+    }
+
+    //NOTE: Values like the ones in model outputs, with a few significant digits.
+    std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+    for(int i = 0; i < 100000; ++i)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.4g", uniform(rng));
+        checkRoundTrip(strtod(buffer, nullptr));
+    }
+
+    printf("%d of the round-tripped values were one digit longer than the shortest, and %d longer than that with the shortest on the edge\n",
+           longer, edge);
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All number format tests passed\n");
+    return 0;
+}
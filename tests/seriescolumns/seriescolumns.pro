@@ -0,0 +1,17 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core
+QT       -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_seriescolumns
+TEMPLATE = app
+
+SOURCES += tst_seriescolumns.cpp \
+    ../../seriescolumns.cpp
+
+HEADERS += ../../seriescolumns.h \
+    ../../seriesdata.h \
+    ../../sqlhandler/serialization.h
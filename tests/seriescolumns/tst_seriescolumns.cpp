@@ -0,0 +1,244 @@
+#include "../../seriescolumns.h"
+#include <QTemporaryDir>
+#include <cmath>
+#include <limits>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+//NOTE: Writes columnar series files with ColumnarSeriesWriter and reads them back with ColumnarSeriesReader, checking that the IDs, names,
+// units, dates and the bits of every value come back as they were written. Then damages the header of a valid file in every way that
+// open() checks for, and truncates it, and checks that open() refuses each of them.
+
+static int failures = 0;
+
+static void fail(const char *testcase, const char *message)
+{
+    ++failures;
+    printf("FAIL %s: %s\n", testcase, message);
+}
+
+struct TestSeries
+{
+    int ID;
+    QString name;
+    QString unit;
+    int64_t startDate;
+    int64_t timestep;
+    std::vector<double> values;
+};
+
+static bool writeFile(const QString &path, const std::vector<TestSeries> &series)
+{
+    QVector<int> IDs;
+    QVector<QString> names, units;
+    for(const TestSeries &s : series)
+    {
+        IDs.push_back(s.ID);
+        names.push_back(s.name);
+        units.push_back(s.unit);
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    ColumnarSeriesWriter writer;
+    bool success = writer.begin(&file, IDs, names, units);
+    for(const TestSeries &s : series) success = success && writer.addSeries(s.startDate, s.timestep, s.values.data(), (int64_t)s.values.size());
+    success = success && writer.finish();
+    file.close();
+    return success;
+}
+
+static void testRoundTrip(const char *testcase, const QString &path, const std::vector<TestSeries> &series)
+{
+    if(!writeFile(path, series))
+    {
+        fail(testcase, "the writer failed");
+        return;
+    }
+
+    ColumnarSeriesReader reader;
+    if(!reader.open(path))
+    {
+        fail(testcase, "the reader could not open the file");
+        return;
+    }
+
+    if(reader.count() != (int)series.size())
+    {
+        fail(testcase, "wrong number of series");
+        return;
+    }
+
+    for(int idx = 0; idx < reader.count(); ++idx)
+    {
+        const TestSeries &s = series[idx];
+        if(reader.ID(idx) != s.ID) fail(testcase, "wrong ID");
+        if(reader.name(idx) != s.name) fail(testcase, "wrong name");
+        if(reader.unit(idx) != s.unit) fail(testcase, "wrong unit");
+        if(reader.startDate(idx) != s.startDate) fail(testcase, "wrong start date");
+        if(reader.timestep(idx) != s.timestep) fail(testcase, "wrong timestep");
+        if(reader.valueCount(idx) != (int64_t)s.values.size())
+        {
+            fail(testcase, "wrong value count");
+            continue;
+        }
+        if((quintptr)reader.values(idx) % alignof(double) != 0) fail(testcase, "the values are not aligned");
+
+        size_t bytes = s.values.size()*sizeof(double);
+        if(bytes > 0 && memcmp(reader.values(idx), s.values.data(), bytes) != 0) fail(testcase, "the mapped values differ");
+
+        SeriesData copy = reader.series(idx);
+        if(copy.count() != (int)s.values.size() || (bytes > 0 && memcmp(copy.data(), s.values.data(), bytes) != 0))
+        {
+            fail(testcase, "the copied values differ");
+        }
+    }
+}
+
+static QByteArray readAll(const QString &path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    return file.readAll();
+}
+
+static void writeAll(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if(file.open(QIODevice::WriteOnly | QIODevice::Truncate)) file.write(data);
+}
+
+template<typename T> static void put(QByteArray &data, size_t offset, T value)
+{
+    memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+static void expectRejected(const char *testcase, const QString &path, const QByteArray &data)
+{
+    writeAll(path, data);
+    ColumnarSeriesReader reader;
+    if(reader.open(path)) fail(testcase, "open() accepted the file");
+}
+
+int main()
+{
+    QTemporaryDir dir;
+    if(!dir.isValid())
+    {
+        printf("FAIL: could not make a temporary directory\n");
+        return 1;
+    }
+    QString path = dir.filePath("series.incv");
+    QString damagedPath = dir.filePath("damaged.incv");
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    testRoundTrip("no series", path, {});
+
+    std::vector<TestSeries> series;
+    series.push_back({1, "Reach flow", "m3/s", 946684800, 86400, {1.5, 2.25, nan, -0.0, 0.0, 1e-310, 3.0}});
+    //NOTE: A name that is not ASCII, no unit, and a start before 1970.
+    series.push_back({7, QString::fromUtf8("Nedb\xc3\xb8r (\xc3\xa5r)"), "", -631152000, 86400, std::vector<double>(1000, nan)});
+    series.push_back({42, "", "mm", 0, 3600, {}});
+    series.push_back({2000000000, "Snow depth", "cm", 1262304000, 900, {}});
+    for(int i = 0; i < 5000; ++i) series.back().values.push_back(i % 13 == 0 ? nan : 0.001*i*i - 3.0);
+    //NOTE: A NaN with a payload, to see that the values are not passed through arithmetic on the way.
+    uint64_t payload = 0x7FF8000000012345ull;
+    double payloadNan;
+    memcpy(&payloadNan, &payload, sizeof(double));
+    series.push_back({9, "Odd length name.", "kg/ha/year", 1, 1, {payloadNan, 5.0, payloadNan}});
+
+    testRoundTrip("several series", path, series);
+
+    {
+        //NOTE: The writer has to be given exactly as many series as it was told about.
+        QFile file(path);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        ColumnarSeriesWriter writer;
+        double value = 1.0;
+        writer.begin(&file, QVector<int>{1, 2}, QVector<QString>{"a", "b"}, QVector<QString>{"", ""});
+        writer.addSeries(0, 86400, &value, 1);
+        if(writer.finish()) fail("too few series", "finish() succeeded");
+        writer.addSeries(0, 86400, &value, 1);
+        if(writer.addSeries(0, 86400, &value, 1)) fail("too many series", "addSeries() accepted a series past the count");
+        file.close();
+    }
+
+    if(!writeFile(path, series))
+    {
+        fail("damaged files", "the writer failed");
+    }
+    else
+    {
+        QByteArray good = readAll(path);
+        const size_t fileheader = sizeof(columns_file_header);
+        const size_t first = fileheader;                                //NOTE: The header of the first series.
+        const size_t second = fileheader + sizeof(column_serial_header); //NOTE: The header of the second series.
+        uint64_t stringsOffset, stringsSize;
+        memcpy(&stringsOffset, good.constData() + offsetof(columns_file_header, stringsOffset), sizeof(uint64_t));
+        memcpy(&stringsSize, good.constData() + offsetof(columns_file_header, stringsSize), sizeof(uint64_t));
+
+        {
+            ColumnarSeriesReader reader;
+            writeAll(damagedPath, good);
+            if(!reader.open(damagedPath)) fail("undamaged copy", "open() refused the file");
+        }
+
+        expectRejected("empty file", damagedPath, QByteArray());
+        expectRejected("truncated file header", damagedPath, good.left((int)fileheader - 1));
+        expectRejected("truncated series headers", damagedPath, good.left((int)second + 5));
+        expectRejected("truncated strings", damagedPath, good.left((int)(stringsOffset + stringsSize - 1)));
+        expectRejected("truncated values", damagedPath, good.left(good.size() - 8));
+
+        QByteArray data;
+
+        data = good; put<uint32_t>(data, offsetof(columns_file_header, magic), 0x12345678);
+        expectRejected("wrong magic", damagedPath, data);
+
+        data = good; put<uint32_t>(data, offsetof(columns_file_header, version), COLUMNS_FILE_VERSION + 1);
+        expectRejected("wrong version", damagedPath, data);
+
+        data = good; put<uint64_t>(data, offsetof(columns_file_header, numseries), 100000);
+        expectRejected("more series than fit", damagedPath, data);
+
+        data = good; put<uint64_t>(data, offsetof(columns_file_header, numseries), ~(uint64_t)0);
+        expectRejected("overflowing series count", damagedPath, data);
+
+        data = good; put<uint64_t>(data, offsetof(columns_file_header, stringsOffset), (uint64_t)good.size() + 1);
+        expectRejected("strings offset past the end", damagedPath, data);
+
+        data = good; put<uint64_t>(data, offsetof(columns_file_header, stringsSize), (uint64_t)good.size() - stringsOffset + 1);
+        expectRejected("strings past the end", damagedPath, data);
+
+        data = good; put<uint64_t>(data, first + offsetof(column_serial_header, valuesOffset), stringsOffset + 4);
+        expectRejected("unaligned values", damagedPath, data);
+
+        data = good; put<uint64_t>(data, first + offsetof(column_serial_header, valuesOffset), (uint64_t)good.size() + 8);
+        expectRejected("values offset past the end", damagedPath, data);
+
+        data = good; put<uint64_t>(data, second + offsetof(column_serial_header, count), (uint64_t)good.size());
+        expectRejected("values past the end", damagedPath, data);
+
+        data = good; put<uint64_t>(data, second + offsetof(column_serial_header, count), ~(uint64_t)0);
+        expectRejected("overflowing value count", damagedPath, data);
+
+        data = good; put<uint32_t>(data, first + offsetof(column_serial_header, nameLen), (uint32_t)stringsSize + 1);
+        expectRejected("name past the strings", damagedPath, data);
+
+        data = good; put<uint32_t>(data, second + offsetof(column_serial_header, nameOffset), 0xFFFFFFFF);
+        expectRejected("overflowing name offset", damagedPath, data);
+
+        data = good; put<uint32_t>(data, first + offsetof(column_serial_header, unitOffset), (uint32_t)stringsSize);
+        expectRejected("unit past the strings", damagedPath, data);
+    }
+
+    if(failures != 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All columnar series file tests passed\n");
+    return 0;
+}
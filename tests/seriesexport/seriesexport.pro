@@ -0,0 +1,18 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+QT       += core
+QT       -= gui
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_seriesexport
+TEMPLATE = app
+
+SOURCES += tst_seriesexport.cpp \
+    ../../seriesexport.cpp \
+    ../../numberformat.cpp
+
+HEADERS += ../../seriesexport.h \
+    ../../numberformat.h \
+    ../../calendar.h
@@ -0,0 +1,209 @@
+#include "../../seriesexport.h"
+#include <QBuffer>
+#include <cmath>
+#include <limits>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//NOTE: Checks the layout of the files writeSeriesCSV writes: columns that start a whole number of timesteps apart, empty columns, missing
+// values, dates before 1970, sub-daily timestamps, and output that is larger than the buffer of the BufferedWriter.
+
+static int failures = 0;
+static const double nan_value = std::numeric_limits<double>::quiet_NaN();
+static const int64_t day = 86400;
+static const int64_t jan1st2000 = 946684800;
+
+static ExportColumn column(const char *name, const std::vector<double> &values, int64_t startDate)
+{
+    ExportColumn c;
+    c.name = name;
+    c.values = values.data();
+    c.count = (int64_t)values.size();
+    c.startDate = startDate;
+    return c;
+}
+
+//NOTE: Returns false if writeSeriesCSV did.
+static bool write(const QVector<ExportColumn> &columns, int64_t timestep, std::string &out)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    bool success = writeSeriesCSV(&buffer, columns, timestep);
+    out = std::string(buffer.data().constData(), (size_t)buffer.data().size());
+    return success;
+}
+
+static void checkCSV(const char *testcase, const QVector<ExportColumn> &columns, int64_t timestep, const std::string &expected)
+{
+    std::string got;
+    if(!write(columns, timestep, got))
+    {
+        ++failures;
+        printf("FAIL %s: writeSeriesCSV failed\n", testcase);
+        return;
+    }
+    if(got == expected) return;
+
+    ++failures;
+    printf("FAIL %s: got\n%s\nexpected\n%s\n", testcase, got.c_str(), expected.c_str());
+}
+
+static void checkRefused(const char *testcase, const QVector<ExportColumn> &columns, int64_t timestep)
+{
+    std::string got;
+    if(!write(columns, timestep, got)) return;
+    ++failures;
+    printf("FAIL %s: writeSeriesCSV did not refuse it\n", testcase);
+}
+
+static bool isLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+int main()
+{
+    std::vector<double> a = {1.0, 2.0, 3.0};
+    std::vector<double> b = {4.5, nan_value, 6.0};
+    std::vector<double> empty;
+
+    //NOTE: b starts two days after a. The empty column has a start date that is not aligned with the others, which should not matter.
+    checkCSV("offset columns", {column("A", a, jan1st2000), column("B", b, jan1st2000 + 2*day), column("C", empty, 12345)}, day,
+             "\"date\",\"A\",\"B\",\"C\"\n"
+             "2000-01-01,1,,\n"
+             "2000-01-02,2,,\n"
+             "2000-01-03,3,4.5,\n"
+             "2000-01-04,,,\n"
+             "2000-01-05,,6,\n");
+
+    checkCSV("the later column first", {column("B", b, jan1st2000 + 2*day), column("A", a, jan1st2000)}, day,
+             "\"date\",\"B\",\"A\"\n"
+             "2000-01-01,,1\n"
+             "2000-01-02,,2\n"
+             "2000-01-03,4.5,3\n"
+             "2000-01-04,,\n"
+             "2000-01-05,6,\n");
+
+    std::vector<double> allnan = {nan_value, nan_value};
+    checkCSV("missing values", {column("A", a, jan1st2000), column("NaN", allnan, jan1st2000)}, day,
+             "\"date\",\"A\",\"NaN\"\n"
+             "2000-01-01,1,\n"
+             "2000-01-02,2,\n"
+             "2000-01-03,3,\n");
+
+    checkCSV("only empty columns", {column("A", empty, 0), column("B", empty, 0)}, day, "\"date\",\"A\",\"B\"\n");
+
+    checkCSV("quotes in names", {column("Flow \"Tay\", daily", a, jan1st2000)}, day,
+             "\"date\",\"Flow \"\"Tay\"\", daily\"\n"
+             "2000-01-01,1\n"
+             "2000-01-02,2\n"
+             "2000-01-03,3\n");
+
+    std::vector<double> c = {0.1, -0.25, 1e-7, 1.5e20};
+    checkCSV("before 1970", {column("A", c, -2*day)}, day,
+             "\"date\",\"A\"\n"
+             "1969-12-30,0.1\n"
+             "1969-12-31,-0.25\n"
+             "1970-01-01,1e-07\n"
+             "1970-01-02,1.5e+20\n");
+
+    checkCSV("leap day", {column("A", a, 951696000 /*2000-02-28*/)}, day,
+             "\"date\",\"A\"\n"
+             "2000-02-28,1\n"
+             "2000-02-29,2\n"
+             "2000-03-01,3\n");
+
+    checkCSV("hourly before 1970", {column("A", a, -2*3600)}, 3600,
+             "\"date\",\"A\"\n"
+             "1969-12-31 22:00:00,1\n"
+             "1969-12-31 23:00:00,2\n"
+             "1970-01-01 00:00:00,3\n");
+
+    checkCSV("15 minutes, offset", {column("A", a, jan1st2000 + 45*60), column("B", b, jan1st2000 + 15*60)}, 900,
+             "\"date\",\"A\",\"B\"\n"
+             "2000-01-01 00:15:00,,4.5\n"
+             "2000-01-01 00:30:00,,\n"
+             "2000-01-01 00:45:00,1,6\n"
+             "2000-01-01 01:00:00,2,\n"
+             "2000-01-01 01:15:00,3,\n");
+
+    //NOTE: A daily series that does not start at midnight gets the time too, since the dates alone would not say when the values are.
+    checkCSV("daily at noon", {column("A", a, jan1st2000 + day/2)}, day,
+             "\"date\",\"A\"\n"
+             "2000-01-01 12:00:00,1\n"
+             "2000-01-02 12:00:00,2\n"
+             "2000-01-03 12:00:00,3\n");
+
+    checkCSV("after 9999", {column("A", a, 253402300800 /*10000-01-01*/)}, day,
+             "\"date\",\"A\"\n"
+             "10000-01-01,1\n"
+             "10000-01-02,2\n"
+             "10000-01-03,3\n");
+
+    checkRefused("half a step apart", {column("A", a, jan1st2000), column("B", b, jan1st2000 + day/2)}, day);
+    checkRefused("zero timestep", {column("A", a, jan1st2000)}, 0);
+    checkRefused("no columns", {}, day);
+
+    {
+        //NOTE: Much more than the 64 kB buffer of the BufferedWriter, with the dates worked out by counting days.
+        std::vector<double> values, shifted;
+        for(int i = 0; i < 30000; ++i) values.push_back(i % 7 == 3 ? nan_value : i*0.5);
+        for(int i = 0; i < 100; ++i) shifted.push_back(-i);
+
+        std::string expected = "\"date\",\"long\",\"shifted\"\n";
+        const int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        int year = 1950, month = 1, dayOfMonth = 1;
+        for(int i = 0; i < 30000; ++i)
+        {
+            char line[128];
+            int length = snprintf(line, sizeof(line), "%04d-%02d-%02d,", year, month, dayOfMonth);
+            expected.append(line, length);
+            if(i % 7 != 3)
+            {
+                length = snprintf(line, sizeof(line), (i % 2) ? "%d.5" : "%d", i/2);
+                expected.append(line, length);
+            }
+            expected += ',';
+            if(i >= 1000 && i < 1100)
+            {
+                length = snprintf(line, sizeof(line), "%d", -(i - 1000));
+                expected.append(line, length);
+            }
+            expected += '\n';
+
+            int inMonth = monthDays[month - 1] + (month == 2 && isLeapYear(year) ? 1 : 0);
+            if(++dayOfMonth > inMonth)
+            {
+                dayOfMonth = 1;
+                if(++month > 12)
+                {
+                    month = 1;
+                    ++year;
+                }
+            }
+        }
+
+        int64_t start = -631152000; //NOTE: 1950-01-01
+        checkCSV("larger than the buffer", {column("long", values, start), column("shifted", shifted, start + 1000*day)}, day, expected);
+    }
+
+    {
+        //NOTE: A device that can not be written to has to make it fail, not just leave the file short.
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadOnly);
+        if(writeSeriesCSV(&buffer, {column("A", a, jan1st2000)}, day))
+        {
+            ++failures;
+            printf("FAIL unwritable device: writeSeriesCSV succeeded\n");
+        }
+    }
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All series export tests passed\n");
+    return 0;
+}
@@ -0,0 +1,12 @@
+QMAKE_CXXFLAGS += -std=c++14
+
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+TARGET = tst_statistics
+TEMPLATE = app
+
+SOURCES += tst_statistics.cpp \
+    ../../statistics.cpp
+
+HEADERS += ../../statistics.h
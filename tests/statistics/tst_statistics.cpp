@@ -0,0 +1,189 @@
+#include "../../statistics.h"
+#include <cmath>
+#include <limits>
+#include <stdio.h>
+#include <vector>
+
+//NOTE: Checks the statistics kernel against a naive two-pass computation in long double. The lengths are chosen around the lane count (4) and
+// the block size (1024) so that the ragged tails of both are covered.
+
+static int failures = 0;
+static const double nan_value = std::numeric_limits<double>::quiet_NaN();
+
+static void check(bool ok, const char *what, const char *testcase, double got, double expected)
+{
+    if(ok) return;
+    ++failures;
+    printf("FAIL %s: %s was %.17g, expected %.17g\n", testcase, what, got, expected);
+}
+
+static void checkNear(const char *what, const char *testcase, double got, long double expected, double scale)
+{
+    //NOTE: The tolerance is relative to scale, which is the size of the values that went into the number, since that is what the rounding
+    // errors of the sums are relative to.
+    if(std::isnan((double)expected))
+    {
+        check(std::isnan(got), what, testcase, got, (double)expected);
+        return;
+    }
+    double tolerance = 1e-12 * std::max(scale, 1.0);
+    check(std::abs((long double)got - expected) <= tolerance, what, testcase, got, (double)expected);
+}
+
+static void checkCount(const char *what, const char *testcase, int64_t got, int64_t expected)
+{
+    check(got == expected, what, testcase, (double)got, (double)expected);
+}
+
+static void testSummary(const char *testcase, const std::vector<double> &values)
+{
+    long double n = 0, sum = 0, scale = 0;
+    double min = nan_value, max = nan_value;
+    for(double v : values)
+    {
+        if(std::isnan(v)) continue;
+        n += 1;
+        sum += v;
+        scale = std::max(scale, (long double)std::abs(v));
+        if(std::isnan(min) || v < min) min = v;
+        if(std::isnan(max) || v > max) max = v;
+    }
+    long double mean = n > 0 ? sum / n : nan_value;
+    long double m2 = 0;
+    for(double v : values)
+    {
+        if(std::isnan(v)) continue;
+        m2 += (v - mean)*(v - mean);
+    }
+    long double variance = n > 0 ? m2 / n : nan_value;
+
+    SummaryStatistics stats = summaryStatistics(values.data(), (int64_t)values.size());
+
+    checkCount("count", testcase, stats.count, (int64_t)n);
+    checkCount("nanCount", testcase, stats.nanCount, (int64_t)values.size() - (int64_t)n);
+    checkNear("min", testcase, stats.min, min, 0.0);
+    checkNear("max", testcase, stats.max, max, 0.0);
+    checkNear("mean", testcase, stats.mean, mean, (double)scale);
+    checkNear("variance", testcase, stats.variance, variance, (double)(scale*scale));
+}
+
+static void testResiduals(const char *testcase, const std::vector<double> &observed, const std::vector<double> &modeled, double x0, double dx)
+{
+    size_t count = observed.size();
+
+    long double n = 0, sumo = 0, summ = 0, sumr = 0, sumx = 0, sumabs = 0, sumsq = 0, scale = 0, xscale = 0;
+    double minres = nan_value, maxres = nan_value;
+    for(size_t i = 0; i < count; ++i)
+    {
+        double o = observed[i], m = modeled[i];
+        if(std::isnan(o) || std::isnan(m)) continue;
+        double r = o - m;
+        long double x = (long double)x0 + (long double)dx*(long double)i;
+        n += 1;
+        sumo += o; summ += m; sumr += r; sumx += x;
+        sumabs += std::abs(r);
+        sumsq += (long double)r*r;
+        scale = std::max(scale, (long double)std::max(std::abs(o), std::abs(m)));
+        xscale = std::max(xscale, std::abs(x));
+        if(std::isnan(minres) || r < minres) minres = r;
+        if(std::isnan(maxres) || r > maxres) maxres = r;
+    }
+
+    long double meano = sumo/n, meanm = summ/n, meanr = sumr/n, meanx = sumx/n;
+    long double m2o = 0, m2m = 0, m2x = 0, com = 0, cxr = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        double o = observed[i], m = modeled[i];
+        if(std::isnan(o) || std::isnan(m)) continue;
+        long double x = (long double)x0 + (long double)dx*(long double)i;
+        m2o += (o - meano)*(o - meano);
+        m2m += (m - meanm)*(m - meanm);
+        m2x += (x - meanx)*(x - meanx);
+        com += (o - meano)*(m - meanm);
+        cxr += (x - meanx)*((o - m) - meanr);
+    }
+
+    ResidualStatistics stats = residualStatistics(observed.data(), modeled.data(), (int64_t)count, x0, dx);
+
+    checkCount("count", testcase, stats.count, (int64_t)n);
+    if(n == 0)
+    {
+        check(std::isnan(stats.observedMean) && std::isnan(stats.meanError) && std::isnan(stats.meanSquaredError) && std::isnan(stats.xResidualCovariance),
+              "everything NaN", testcase, stats.meanError, nan_value);
+        return;
+    }
+
+    double s = (double)scale;
+    checkNear("observedMean", testcase, stats.observedMean, meano, s);
+    checkNear("observedVariance", testcase, stats.observedVariance, m2o/n, s*s);
+    checkNear("modeledMean", testcase, stats.modeledMean, meanm, s);
+    checkNear("modeledVariance", testcase, stats.modeledVariance, m2m/n, s*s);
+    checkNear("covariance", testcase, stats.covariance, com/n, s*s);
+    checkNear("meanError", testcase, stats.meanError, meanr, s);
+    checkNear("meanAbsoluteError", testcase, stats.meanAbsoluteError, sumabs/n, s);
+    checkNear("meanSquaredError", testcase, stats.meanSquaredError, sumsq/n, s*s);
+    checkNear("minResidual", testcase, stats.minResidual, minres, s);
+    checkNear("maxResidual", testcase, stats.maxResidual, maxres, s);
+    checkNear("xMean", testcase, stats.xMean, meanx, (double)xscale);
+    checkNear("xVariance", testcase, stats.xVariance, m2x/n, (double)(xscale*xscale));
+    checkNear("xResidualCovariance", testcase, stats.xResidualCovariance, cxr/n, (double)xscale*s);
+}
+
+//NOTE: A simple deterministic generator, so that a failure can be reproduced.
+static double noise(uint64_t &state)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (double)(state >> 11) / (double)(1ULL << 53) - 0.5;
+}
+
+static std::vector<double> makeSeries(int64_t count, double offset, double amplitude, int nanEvery, uint64_t seed)
+{
+    std::vector<double> values(count);
+    for(int64_t i = 0; i < count; ++i)
+    {
+        values[i] = offset + amplitude*noise(seed);
+        if(nanEvery > 0 && i % nanEvery == nanEvery - 1) values[i] = nan_value;
+    }
+    return values;
+}
+
+int main()
+{
+    const int64_t lengths[] = {0, 1, 2, 3, 4, 5, 7, 1023, 1024, 1025, 1027, 4096, 5001};
+
+    char testcase[128];
+    for(int64_t length : lengths)
+    {
+        for(int nanEvery : {0, 1, 3, 1024})
+        {
+            snprintf(testcase, sizeof(testcase), "summary length %lld, NaN every %d", (long long)length, nanEvery);
+            testSummary(testcase, makeSeries(length, 10.0, 4.0, nanEvery, 1 + length));
+
+            snprintf(testcase, sizeof(testcase), "residuals length %lld, NaN every %d", (long long)length, nanEvery);
+            std::vector<double> observed = makeSeries(length, 10.0, 4.0, nanEvery, 2 + length);
+            std::vector<double> modeled = makeSeries(length, 9.0, 5.0, nanEvery ? nanEvery + 1 : 0, 3 + length);
+            testResiduals(testcase, observed, modeled, 946684800.0, 86400.0);
+        }
+    }
+
+    //NOTE: A large offset compared to the spread is where a single-pass sum of squares would lose all its digits.
+    testSummary("summary with a large offset", makeSeries(100000, 1e9, 1.0, 0, 7));
+    testResiduals("residuals with a large offset", makeSeries(100000, 1e9, 1.0, 0, 8), makeSeries(100000, 1e9, 1.0, 0, 9), 0.0, 1.0);
+
+    std::vector<double> allnan(2000, nan_value);
+    testSummary("summary all NaN", allnan);
+    testResiduals("residuals all NaN", allnan, makeSeries(2000, 1.0, 1.0, 0, 10), 0.0, 1.0);
+
+    std::vector<double> infinite = makeSeries(10, 1.0, 1.0, 0, 11);
+    infinite[3] = std::numeric_limits<double>::infinity();
+    SummaryStatistics stats = summaryStatistics(infinite.data(), (int64_t)infinite.size());
+    check(stats.max == std::numeric_limits<double>::infinity() && stats.count == 10, "max with an infinite value", "summary with infinity", stats.max, std::numeric_limits<double>::infinity());
+
+    if(failures)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All statistics tests passed\n");
+    return 0;
+}
@@ -0,0 +1,12 @@
+#NOTE: Each test is a program that prints what failed and exits with a nonzero code if anything did. "make check" builds and runs them all.
+
+TEMPLATE = subdirs
+
+SUBDIRS += statistics \
+    minmaxpyramid \
+    compression \
+    seriescolumns \
+    goodnessoffit \
+    calibration \
+    numberformat \
+    seriesexport
@@ -123,6 +123,62 @@ int TreeModel::childCount(int ID)
     return 0;
 }
 
+int TreeModel::getID(const QModelIndex &index)
+{
+    if(!index.isValid()) return 0;
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    return item->data(1).toInt();
+}
+
+static void appendLeafChildren(TreeItem *parent, QVector<int> &IDsOut, int excludeID = 0, const QString *onlyName = nullptr)
+{
+    for(int row = 0; row < parent->childCount(); ++row)
+    {
+        TreeItem *child = parent->child(row);
+        if(child->childCount() != 0) continue;
+        int ID = child->data(1).toInt();
+        if(ID == excludeID) continue;
+        if(onlyName && child->data(0).toString() != *onlyName) continue;
+        IDsOut.push_back(ID);
+    }
+}
+
+QVector<int> TreeModel::getChildLeafIDs(int ID)
+{
+    QVector<int> result;
+    auto treeItem = IDtoTreeItem_.find(ID);
+    if(treeItem != IDtoTreeItem_.end()) appendLeafChildren(treeItem->second, result);
+    return result;
+}
+
+QVector<int> TreeModel::getNeighbourLeafIDs(int ID)
+{
+    QVector<int> result;
+    auto treeItem = IDtoTreeItem_.find(ID);
+    if(treeItem == IDtoTreeItem_.end()) return result;
+
+    TreeItem *item = treeItem->second;
+    TreeItem *parent = item->parentItem();
+    if(!parent) return result;
+
+    //NOTE: First the other series under the same parent, then the series with the same name in the parent's siblings, i.e. the same result
+    // for the other reaches or land classes.
+    appendLeafChildren(parent, result, ID);
+
+    TreeItem *grandparent = parent->parentItem();
+    if(grandparent)
+    {
+        QString name = item->data(0).toString();
+        for(int row = 0; row < grandparent->childCount(); ++row)
+        {
+            TreeItem *uncle = grandparent->child(row);
+            if(uncle != parent) appendLeafChildren(uncle, result, ID, &name);
+        }
+    }
+
+    return result;
+}
+
 
 TreeModel::~TreeModel()
 {
@@ -54,6 +54,7 @@
 #include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QVariant>
+#include <QVector>
 #include "unordered_map"
 
 class TreeItem;
@@ -92,6 +93,11 @@ public:
     QString getParentName(int);
     QString getUnit(int);
     int childCount(int);
+    int getID(const QModelIndex &index);
+
+    //NOTE: IDs of series (items without children) that the user is likely to look at after the given one. Used for prefetching.
+    QVector<int> getChildLeafIDs(int);
+    QVector<int> getNeighbourLeafIDs(int);
 
 private:
     std::unordered_map<int,TreeItem*> IDtoTreeItem_;